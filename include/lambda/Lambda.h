@@ -109,12 +109,18 @@ enum LAMBDA_Integrator INT_ENUM {
 	LAMBDA_INTEGRATOR_DIRECT,
 	LAMBDA_INTEGRATOR_NORMAL,
 	LAMBDA_INTEGRATOR_DEPTH,
-	LAMBDA_INTEGRATOR_AOV
+	LAMBDA_INTEGRATOR_AOV,
+	LAMBDA_INTEGRATOR_WAVEFRONT_PATH,
+	LAMBDA_INTEGRATOR_MIS_VOLPATH,
+	LAMBDA_INTEGRATOR_BDPT,
+	LAMBDA_INTEGRATOR_PHOTON
 };
 
 enum LAMBDA_LightStrategy INT_ENUM {
 	LAMBDA_LIGHT_STRATEGY_POWER,
-	LAMBDA_LIGHT_STRATEGY_TREE
+	LAMBDA_LIGHT_STRATEGY_TREE,
+	LAMBDA_LIGHT_STRATEGY_RESERVOIR_POWER,	/* Resampled direct lighting, candidates drawn by power */
+	LAMBDA_LIGHT_STRATEGY_RESERVOIR_TREE	/* Resampled direct lighting, candidates drawn from the light tree */
 };
 
 /* Create a film render target. */
@@ -125,6 +131,16 @@ LAMBDA_API void lambdaReleaseFilm(LAMBDA_Film *_film) {
 	delete _film;
 }
 
+enum LAMBDA_FilterType INT_ENUM {
+	LAMBDA_FILTER_BOX,
+	LAMBDA_FILTER_GAUSSIAN,
+	LAMBDA_FILTER_MITCHELL,
+	LAMBDA_FILTER_BLACKMAN_HARRIS
+};
+
+/* Set the pixel reconstruction filter of _film, _radius in pixels. Call before creating render directives using _film. */
+LAMBDA_API void lambdaSetFilmFilter(LAMBDA_Film *_film, LAMBDA_FilterType _filterType, float _radius);
+
 enum LAMBDA_CameraType INT_ENUM {
 	LAMBDA_CAMERA_THIN_LENS,
 	LAMBDA_CAMERA_SPHERICAL
@@ -153,11 +169,20 @@ LAMBDA_API void lambdaSetCameraApertureSize(LAMBDA_Camera *_camera, float _size)
 
 /*
 * LAMBDA_RenderProperties:
-*  spp -------------------- samples per pixel for offline rendering if applicable
+*  spp -------------------- samples per pixel for lambdaRender(), the most per pixel when adaptive
 *  tileSizeX, tileSizeY --- size in pixels of render tiles
-*  numThreads ------------- target number of render threads. 0 = automatic
+*  numThreads ------------- target number of lambdaRender() threads. 0 = automatic
 *  integrator ------------- renderng method to use
 *  lightStrategy ---------- light sampling strategy to use
+*  errorThreshold --------- relative pixel error at which adaptive sampling stops sampling a pixel. 0 = uniform sampling
+*  minSpp ----------------- samples every pixel gets before adaptive sampling estimates its error
+*  spectralDispersion ----- 1 = paths sample a wavelength so dispersive Fresnel BSDFs split light. Transport and the film stay RGB
+*  lightCacheDirectory ---- directory the light tree is saved to and reloaded from while the scene's lights are unchanged. NULL = always build
+*  lightCandidates -------- candidate light samples resampled per shading point by the reservoir strategies
+*  lightReuse ------------- reservoir strategies reuse light samples across passes and pixels: 0 = none, 1 = temporal, 2 = spatial, 3 = both. Slightly biased
+*  pathGuiding ------------ 1 = path and MIS volumetric path integrators learn where light comes from during progressive rendering and guide paths towards it
+*  photonsPerPass --------- photons the photon mapping integrator traces per progressive pass
+*  photonRadius ----------- photon gather radius of the first pass, shrinking every pass after. 0 = 1% of the scene's longest side
 */
 struct LAMBDA_RenderProperties {
 	unsigned spp;
@@ -166,6 +191,15 @@ struct LAMBDA_RenderProperties {
 	unsigned numThreads;
 	LAMBDA_Integrator integrator;
 	LAMBDA_LightStrategy lightStrategy;
+	float errorThreshold;
+	unsigned minSpp;
+	int spectralDispersion;
+	const char *lightCacheDirectory;
+	unsigned lightCandidates;
+	int lightReuse;
+	int pathGuiding;
+	unsigned photonsPerPass;
+	float photonRadius;
 };
 
 /* Creates render properties with default values. */
@@ -183,6 +217,13 @@ LAMBDA_API void lambdaSetCamera(LAMBDA_RenderDirective *_directive, LAMBDA_Camer
 /* Bind a scene to the directive. */
 LAMBDA_API void lambdaSetScene(LAMBDA_RenderDirective *_directive, LAMBDA_Scene *_scene);
 
+/*
+* Renders _directive's film from scratch and blocks until done. Every pixel gets spp samples, or with an
+* errorThreshold, samples until its error falls below it or it reaches spp. Returns a pointer to the
+* first RGBA32f pixel of the result, valid until the next call, and stores _width and _height.
+*/
+LAMBDA_API void *lambdaRender(LAMBDA_RenderDirective *_directive, int *_width, int *_height);
+
 /* Create a progressive renderer instance. */
 LAMBDA_API LAMBDA_ProgressiveRenderer *lambdaCreateProgressiveRenderer(LAMBDA_Device *_device, LAMBDA_RenderDirective *_directive);
 
@@ -162,14 +162,14 @@ int main() {
 	AssetImporter ai;
 	ai.Import("../content/Figurine.obj");
 
-	//Push the mesh objects to the resource manager...
-	ai.PushToResourceManager(&resources, (ImportOptions)(IMP_MESHES));
+	//Push the mesh objects to the resource manager, committing each to the scene's device as it finishes converting...
+	ai.PushToResourceManager(&resources, (ImportOptions)(IMP_MESHES), scene.device);
 
-	//...and add all the meshes from that asset
+	//...and attach all the meshes from that asset, they are already committed
 	for (auto &it : resources.objectPool.pool) {
 		//it.second->material = MaterialImport::GetMaterial(ai.scene, &resources, it.first);
 		it.second->material = &glass_material;
-		scene.AddObject(it.second);
+		scene.AttachObject(it.second);
 	}
 
 	//InstanceProxy proxy(resources.objectPool.pool["lucy_1"]);
@@ -5,14 +5,20 @@
 #include <core/TriangleMesh.h>
 #include <core/Instance.h>
 #include <render/ProgressiveRender.h>
+#include <render/MosaicRenderer.h>
 #include <sampling/HaltonSampler.h>
 #include <integrators/PathIntegrator.h>
+#include <integrators/WavefrontPathIntegrator.h>
 #include <integrators/VolumetricPathIntegrator.h>
+#include <integrators/MISVolumetricPathIntegrator.h>
 #include <integrators/DirectLightingIntegrator.h>
+#include <integrators/BDPTIntegrator.h>
+#include <integrators/PhotonMappingIntegrator.h>
 #include <integrators/UtilityIntegrators.h>
 #include <shading/graph/GraphBxDF.h>
 #include <shading/graph/GraphInputs.h>
 #include <lighting/ManyLightSampler.h>
+#include <lighting/ReservoirLightSampler.h>
 
 namespace sg = lambda::ShaderGraph;
 
@@ -110,6 +116,10 @@ struct LAMBDA_RenderDirective {
 	std::unique_ptr<lambda::Sampler> sampler;
 	std::unique_ptr<lambda::SampleShifter> sampleShifter;
 	std::unique_ptr<lambda::LightSampler> lightSampler;
+	std::unique_ptr<lambda::GuidingField> guidingField;
+	std::unique_ptr<lambda::PhotonMap> photonMap;
+	lambda::Texture outputTexture;	//Result of lambdaRender()
+	unsigned numThreads;
 };
 
 struct LAMBDA_ProgressiveRenderer {
@@ -301,6 +311,23 @@ LAMBDA_Film *lambdaCreateFilm(LAMBDA_Device *_device, int _width, int _height) {
 	return film;
 }
 
+void lambdaSetFilmFilter(LAMBDA_Film *_film, LAMBDA_FilterType _filterType, float _radius) {
+	switch (_filterType) {
+	case LAMBDA_FILTER_GAUSSIAN:
+		_film->film.SetFilter(lambda::GaussianFilter(_radius));
+		break;
+	case LAMBDA_FILTER_MITCHELL:
+		_film->film.SetFilter(lambda::MitchellFilter(_radius));
+		break;
+	case LAMBDA_FILTER_BLACKMAN_HARRIS:
+		_film->film.SetFilter(lambda::BlackmanHarrisFilter(_radius));
+		break;
+	default:
+		_film->film.SetFilter(lambda::BoxFilter(_radius));
+		break;
+	}
+}
+
 LAMBDA_Camera *lambdaCreateCamera(LAMBDA_Device *_device, LAMBDA_CameraType _cameraType, float _pos[3], float _phi, float _theta) {
 	LAMBDA_Camera *camera = new LAMBDA_Camera();
 	camera->type = _cameraType;
@@ -350,6 +377,15 @@ LAMBDA_RenderProperties *lambdaCreateRenderProperties() {
 	props->spp = 1;
 	props->tileSizeX = 16;
 	props->tileSizeY = 16;
+	props->errorThreshold = 0;
+	props->minSpp = 16;
+	props->spectralDispersion = 0;
+	props->lightCacheDirectory = nullptr;
+	props->lightCandidates = 8;
+	props->lightReuse = 0;
+	props->pathGuiding = 0;
+	props->photonsPerPass = 1 << 18;
+	props->photonRadius = 0;
 	return props;
 }
 
@@ -370,6 +406,19 @@ static void SetIntegrator(LAMBDA_RenderDirective *_directive, LAMBDA_Integrator
 	case LAMBDA_INTEGRATOR_DEPTH:
 		_directive->integrator.reset(new lambda::DepthPass(_directive->sampler.get(), 100));
 		break;
+	case LAMBDA_INTEGRATOR_WAVEFRONT_PATH:
+		_directive->integrator.reset(new lambda::WavefrontPathIntegrator(_directive->sampler.get()));
+		break;
+	case LAMBDA_INTEGRATOR_MIS_VOLPATH:
+		_directive->integrator.reset(new lambda::MISVolumetricPathIntegrator(_directive->sampler.get()));
+		break;
+	case LAMBDA_INTEGRATOR_BDPT:
+		_directive->integrator.reset(new lambda::BDPTIntegrator(_directive->sampler.get()));
+		break;
+	case LAMBDA_INTEGRATOR_PHOTON:
+		if (!_directive->photonMap) _directive->photonMap.reset(new lambda::PhotonMap());
+		_directive->integrator.reset(new lambda::PhotonMappingIntegrator(_directive->sampler.get(), _directive->photonMap.get()));
+		break;
 	default:
 		_directive->integrator.reset(new lambda::PathIntegrator(_directive->sampler.get()));
 		break;
@@ -377,17 +426,29 @@ static void SetIntegrator(LAMBDA_RenderDirective *_directive, LAMBDA_Integrator
 	_directive->directive->integrator = _directive->integrator.get();
 }
 
-static void SetLightSampler(LAMBDA_RenderDirective *_directive, LAMBDA_LightStrategy _lightStrategy) {
-	switch (_lightStrategy) {
+static void SetLightSampler(LAMBDA_RenderDirective *_directive, const LAMBDA_RenderProperties *_properties) {
+	const lambda::Scene &scene = *_directive->directive->scene;
+	lambda::ManyLightSampler *tree = nullptr;
+	lambda::LightSampler *base;
+	switch (_properties->lightStrategy) {
 	case LAMBDA_LIGHT_STRATEGY_POWER:
-		_directive->lightSampler.reset(new lambda::PowerLightSampler(*_directive->directive->scene));
+	case LAMBDA_LIGHT_STRATEGY_RESERVOIR_POWER:
+		base = new lambda::PowerLightSampler(scene);
 		break;
 	case LAMBDA_LIGHT_STRATEGY_TREE:
-		_directive->lightSampler.reset(new lambda::ManyLightSampler(*_directive->directive->scene));
-		break;
+	case LAMBDA_LIGHT_STRATEGY_RESERVOIR_TREE:
 	default:
-		_directive->lightSampler.reset(new lambda::ManyLightSampler(*_directive->directive->scene));
+		base = tree = new lambda::ManyLightSampler(scene);
+	}
+	if (tree && _properties->lightCacheDirectory) tree->cacheDirectory = _properties->lightCacheDirectory;
+	if (_properties->lightStrategy == LAMBDA_LIGHT_STRATEGY_RESERVOIR_POWER || _properties->lightStrategy == LAMBDA_LIGHT_STRATEGY_RESERVOIR_TREE) {
+		lambda::ReservoirLightSampler *reservoir = new lambda::ReservoirLightSampler(scene, base, std::max(_properties->lightCandidates, 1u));
+		reservoir->temporalReuse = (_properties->lightReuse & 1) != 0;
+		reservoir->spatialReuse = (_properties->lightReuse & 2) != 0;
+		reservoir->SetResolution(_directive->directive->film->filmData.GetWidth(), _directive->directive->film->filmData.GetHeight());
+		base = reservoir;
 	}
+	_directive->lightSampler.reset(base);
 	_directive->directive->scene->lightSampler = _directive->lightSampler.get();
 }
 
@@ -409,8 +470,20 @@ LAMBDA_RenderDirective *lambdaCreateRenderDirective(LAMBDA_Device *_device, LAMB
 	directive->directive->spp = _properties->spp;
 	directive->directive->tileSizeX = _properties->tileSizeX;
 	directive->directive->tileSizeY = _properties->tileSizeY;
+	directive->directive->errorThreshold = _properties->errorThreshold;
+	directive->directive->minSpp = _properties->minSpp;
+	directive->numThreads = _properties->numThreads;
 	SetIntegrator(directive, _properties->integrator);
-	SetLightSampler(directive, _properties->lightStrategy);
+	directive->integrator->spectralDispersion = _properties->spectralDispersion != 0;
+	if (_properties->pathGuiding) {
+		directive->guidingField.reset(new lambda::GuidingField());
+		directive->integrator->guidingField = directive->guidingField.get();
+	}
+	if (directive->photonMap) {
+		directive->photonMap->photonsPerPass = std::max(_properties->photonsPerPass, 1u);
+		directive->photonMap->initialRadius = _properties->photonRadius;
+	}
+	SetLightSampler(directive, _properties);
 
 	_device->freeFuncs.push_back(FreeFunc(&lambdaReleaseRenderDirective, directive));
 	return directive;
@@ -428,9 +501,24 @@ void lambdaSetScene(LAMBDA_RenderDirective *_directive, LAMBDA_Scene *_scene) {
 	_directive->directive->scene = &_scene->scene;
 }
 
+void *lambdaRender(LAMBDA_RenderDirective *_directive, int *_width, int *_height) {
+	lambda::RenderDirective &directive = *_directive->directive.get();
+	const lambda::TileRenderer tileRenderer = directive.errorThreshold > 0 ? &lambda::TileRenderers::Adaptive : &lambda::TileRenderers::UniformSpp;
+	const unsigned numThreads = _directive->numThreads > 0 ? _directive->numThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	directive.film->Clear();	//Adaptive tiles restart every pixel's sample sequence, so don't add to an earlier render
+	lambda::OMPMosaicRenderer renderer(directive, tileRenderer, numThreads);
+	renderer.Render();
+	*_width = directive.film->filmData.GetWidth();
+	*_height = directive.film->filmData.GetHeight();
+	_directive->outputTexture = lambda::Texture(*_width, *_height);
+	directive.film->ToRGBTexture(&_directive->outputTexture);
+	return _directive->outputTexture.GetData();
+}
+
 LAMBDA_ProgressiveRenderer *lambdaCreateProgressiveRenderer(LAMBDA_Device *_device, LAMBDA_RenderDirective *_directive) {
 	LAMBDA_ProgressiveRenderer *renderer = new LAMBDA_ProgressiveRenderer;
 	renderer->renderer.reset(new lambda::ProgressiveRender(*_directive->directive.get()));
+	if (_directive->directive->errorThreshold > 0) renderer->renderer->tileRenderer = &lambda::TileRenderers::AdaptiveIncrement;
 	_device->freeFuncs.push_back(FreeFunc(&lambdaReleaseProgressiveRenderer, renderer));
 	return renderer;
 }
@@ -83,7 +83,10 @@ void lambdaSetMaterialBXDF(LAMBDA_Material *_material, LAMBDA_ShaderNode *_node)
 			break;
 		}
 	}
-	if(verifyBxDF) _material->material.bxdf = (lambda::BxDF*)_node->node;
+	if (verifyBxDF) {
+		_material->material.bxdf = dynamic_cast<lambda::BxDF *>(_node->node);
+		_material->material.Compile();
+	}
 }
 
 LAMBDA_Shader *lambdaCreateShader() {
@@ -203,7 +206,7 @@ void lambdaLinkSocketsTag(LAMBDA_ShaderNode *_outNode, char *_outSocketTag, LAMB
 }
 
 void lambdaLinkSockets(LAMBDA_ShaderNode *_outNode, int _outSocketIndex, LAMBDA_ShaderNode *_inNode, int _inSocketIndex) {
-	sg::Socket outSocket = _outNode->node->outputSockets[_outSocketIndex];
+	sg::Socket &outSocket = _outNode->node->outputSockets[_outSocketIndex];
 	sg::SocketRef &inSocket = _inNode->node->inputSockets[_inSocketIndex];
 	sg::Connect(outSocket, inSocket);
 }
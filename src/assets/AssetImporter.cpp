@@ -4,13 +4,31 @@ LAMBDA_BEGIN
 
 constexpr int DEFAULT_IMPORT_FLAGS = aiProcess_Triangulate;// | aiProcess_GenSmoothNormals | aiProcess_GenNormals | aiProcess_ImproveCacheLocality;
 
+static std::unordered_set<const Texture *> ExistingTextures(const ResourceManager *_resources) {
+	std::unordered_set<const Texture *> textures;
+	for (const auto &it : _resources->texturePool.pool) textures.insert(it.second);
+	return textures;
+}
+
 AssetImporter::AssetImporter() {
 	scene = nullptr;
+	writeCache = false;
 }
 
-bool AssetImporter::Import(const char *_path) {
+bool AssetImporter::Import(const char *_path, const bool _useCache) {
 	path = _path;
+	cache.Close();
+	writeCache = false;
 	std::cout << std::endl << "Loading " << _path;
+	if (_useCache) {
+		source.Read(path);
+		if (source.IsValid() && cache.Open(path + ".lsc", source)) {
+			scene = nullptr;
+			std::cout << std::endl << "Loaded scene cache " << path << ".lsc";
+			return true;
+		}
+		writeCache = source.IsValid();
+	}
 	scene = importer.ReadFile(_path, DEFAULT_IMPORT_FLAGS);
 	importer.ApplyPostProcessing(aiProcess_CalcTangentSpace);
 	if (!scene) {
@@ -21,16 +39,21 @@ bool AssetImporter::Import(const char *_path) {
 	return true;
 }
 
-void AssetImporter::PushToResourceManager(ResourceManager *_resources, const ImportOptions _impOpt) {
-	if (scene) {
-		if (_impOpt & IMP_MESHES) {
-			ImportUtilities::ImportMetrics meshImportMetrics(std::string(path.c_str()) + " meshes", path);
-			if (!MeshImport::PushMeshes(scene, _resources, &meshImportMetrics)) std::cout << std::endl << "Mesh import failed.";
-			meshImportMetrics.LogAll();
-		}
+void AssetImporter::PushToResourceManager(ResourceManager *_resources, const ImportOptions _impOpt, const RTCDevice _device) {
+	if (cache.IsOpen()) PushFromCache(_resources, _impOpt, _device);
+	else if (scene) {
+		ImportUtilities::ImportMetrics meshImportMetrics(std::string(path.c_str()) + " meshes", path);
+		ImportUtilities::ImportMetrics textureImportMetrics(std::string(path.c_str()) + " textures", path);
+		std::vector<ImportUtilities::SharedTask> meshTasks, textureTasks;
+		const std::unordered_set<const Texture *> texturesBefore = ExistingTextures(_resources);
+		bool meshesPushed = false, texturesPushed = false;
+		if (_impOpt & IMP_MESHES) meshesPushed = MeshImport::EnqueueMeshes(scene, _resources, &meshImportMetrics, &threadPool, &meshTasks, _device);
+		if (_impOpt & IMP_TEXTURES) texturesPushed = MaterialImport::EnqueueTextures(scene, _resources, &textureImportMetrics, &threadPool, &textureTasks);
+
 		if (_impOpt & IMP_TEXTURES) {
-			ImportUtilities::ImportMetrics textureImportMetrics(std::string(path.c_str()) + " textures", path);
-			if (!MaterialImport::PushTextures(scene, _resources, &textureImportMetrics)) std::cout << std::endl << "Texture import failed.";
+			ImportUtilities::WaitAll(textureTasks);
+			if (!texturesPushed) std::cout << std::endl << "Texture import failed.";
+			else if (_impOpt & IMP_COMPACT_TEXTURES) CompactTextures(_resources, texturesBefore);
 			textureImportMetrics.LogAll();
 		}
 		if (_impOpt & IMP_MATERIALS) {
@@ -38,18 +61,67 @@ void AssetImporter::PushToResourceManager(ResourceManager *_resources, const Imp
 			if (!MaterialImport::PushMaterials(scene, _resources, &materialImportMetrics)) std::cout << std::endl << "Material import failed.";
 			materialImportMetrics.LogAll();
 		}
+		if (_impOpt & IMP_MESHES) {
+			ImportUtilities::WaitAll(meshTasks);
+			if (!meshesPushed || meshImportMetrics.HasErrors()) std::cout << std::endl << "Mesh import failed.";
+			meshImportMetrics.LogAll();
+		}
 		if (_impOpt & IMP_GRAPH) {
 			ImportUtilities::ImportMetrics graphImportMetrics(std::string(path.c_str()) + " graph", path);
 			if (!GraphImport::PushGraph(scene, _resources, &graphImportMetrics)) std::cout << std::endl << "Graph import failed.";
 			graphImportMetrics.LogAll();
 		}
+		const int cached = IMP_MESHES | IMP_TEXTURES | IMP_MATERIALS;
+		if (writeCache && (_impOpt & cached) == cached) {
+			if (SceneCache::Write(path + ".lsc", scene, _resources, meshImportMetrics.path, source)) std::cout << std::endl << "Wrote scene cache " << path << ".lsc";
+			writeCache = false;
+		}
 	}
 	else std::cout << std::endl << "Can't transfer to resource manager: No content imported.";
 }
 
+void AssetImporter::PushFromCache(ResourceManager *_resources, const ImportOptions _impOpt, const RTCDevice _device) {
+	if (_impOpt & IMP_MESHES) {
+		ImportUtilities::ImportMetrics meshImportMetrics(std::string(path.c_str()) + " meshes", path);
+		if (!cache.PushMeshes(_resources, &meshImportMetrics, _device)) std::cout << std::endl << "Mesh import failed.";
+		meshImportMetrics.LogAll();
+	}
+	if (_impOpt & IMP_TEXTURES) {
+		ImportUtilities::ImportMetrics textureImportMetrics(std::string(path.c_str()) + " textures", path);
+		std::vector<ImportUtilities::SharedTask> textureTasks;
+		const std::unordered_set<const Texture *> texturesBefore = ExistingTextures(_resources);
+		if (!cache.EnqueueTextures(_resources, &textureImportMetrics, &threadPool, &textureTasks)) std::cout << std::endl << "Texture import failed.";
+		ImportUtilities::WaitAll(textureTasks);
+		if (_impOpt & IMP_COMPACT_TEXTURES) CompactTextures(_resources, texturesBefore);
+		textureImportMetrics.LogAll();
+	}
+	if (_impOpt & IMP_MATERIALS) {
+		ImportUtilities::ImportMetrics materialImportMetrics(std::string(path.c_str()) + " materials", path);
+		if (!cache.PushMaterials(_resources, &materialImportMetrics)) std::cout << std::endl << "Material import failed.";
+		materialImportMetrics.LogAll();
+	}
+}
+
+void AssetImporter::CompactTextures(ResourceManager *_resources, const std::unordered_set<const Texture *> &_before) {
+	std::vector<ImportUtilities::SharedTask> tasks;
+	for (const auto &it : _resources->texturePool.pool) {
+		Texture *tex = it.second;
+		if (!_before.count(tex)) ImportUtilities::Submit(&threadPool, [tex]() { tex->Compact(); }, &tasks);
+	}
+	ImportUtilities::WaitAll(tasks);
+}
+
+Material *AssetImporter::GetMaterial(const ResourceManager *_resources, const std::string &_name) const {
+	if (cache.IsOpen()) return cache.GetMaterial(_resources, _name);
+	if (scene) return MaterialImport::GetMaterial(scene, _resources, _name);
+	return nullptr;
+}
+
 void AssetImporter::Release() {
-	scene->~aiScene();
+	if (scene) scene->~aiScene();
 	scene = nullptr;
+	cache.Close();
+	writeCache = false;
 	path.clear();
 }
 
@@ -5,20 +5,27 @@
 
 #pragma once
 #include <iostream>
+#include <unordered_set>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include "MeshImport.h"
 #include "MaterialImport.h"
 #include "GraphImport.h"
+#include "SceneCache.h"
 
 LAMBDA_BEGIN
 
+/*
+	IMP_COMPACT_TEXTURES isn't part of IMP_ALL: it packs the imported textures with
+	Texture::Compact(), after which their float texels are gone.
+*/
 enum ImportOptions : uint8_t {
 	IMP_ALL = 15,
 	IMP_MESHES = 1,
 	IMP_TEXTURES = 2,
 	IMP_MATERIALS = 4,
-	IMP_GRAPH = 8
+	IMP_GRAPH = 8,
+	IMP_COMPACT_TEXTURES = 16
 };
 
 class AssetImporter {
@@ -29,13 +36,25 @@ class AssetImporter {
 
 		/*
 			Loads and processes asset file, _path, into aiScene.
+				- With _useCache, a scene cache next to the asset (_path + ".lsc") is loaded instead if it
+				  is up to date, and scene stays null. Otherwise the cache is written on the next
+				  PushToResourceManager that pushes meshes, textures and materials.
 		*/
-		bool Import(const char *_path);
+		bool Import(const char *_path, const bool _useCache = false);
 
 		/*
 			Transfers the Assimp data into lambda compatible data in _resources.
+				- Meshes convert and textures decode concurrently on the thread pool. Materials are
+				  built once the textures are done, while meshes may still be converting.
+				- If _device is set, meshes are committed to it as they finish. Add them to the scene
+				  with Scene::AttachObject.
 		*/
-		void PushToResourceManager(ResourceManager *_resources, const ImportOptions _impOpt = IMP_ALL);
+		void PushToResourceManager(ResourceManager *_resources, const ImportOptions _impOpt = IMP_ALL, const RTCDevice _device = nullptr);
+
+		/*
+			Returns the material in _resources that object _name was imported with, from either source.
+		*/
+		Material *GetMaterial(const ResourceManager *_resources, const std::string &_name) const;
 
 		/*
 			Release the imported aiScene from memory.
@@ -45,6 +64,20 @@ class AssetImporter {
 	protected:
 		Assimp::Importer importer;
 		std::string path;
+		ThreadPool threadPool;
+		SceneCache cache;
+		bool writeCache;
+		FileStamp source;
+
+		/*
+			Pushes from the open scene cache rather than the aiScene.
+		*/
+		void PushFromCache(ResourceManager *_resources, const ImportOptions _impOpt, const RTCDevice _device);
+
+		/*
+			Compacts the textures in _resources that aren't in _before, i.e. the ones this import pushed.
+		*/
+		void CompactTextures(ResourceManager *_resources, const std::unordered_set<const Texture *> &_before);
 };
 
 LAMBDA_END
\ No newline at end of file
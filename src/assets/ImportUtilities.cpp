@@ -13,10 +13,12 @@ namespace ImportUtilities {
 	}
 
 	void ImportMetrics::AppendMetric(const std::string &_metric) {
+		std::lock_guard<std::mutex> lock(mutex);
 		metrics.push_back(_metric);
 	}
 
 	void ImportMetrics::AppendError(const std::string &_error) {
+		std::lock_guard<std::mutex> lock(mutex);
 		errors.push_back(_error);
 	}
 
@@ -47,6 +49,19 @@ namespace ImportUtilities {
 		return errors.size() > 0;
 	}
 
+	SharedTask Submit(ThreadPool *_pool, std::function<void()> _func, std::vector<SharedTask> *_tasks, const std::vector<SharedTask> &_after) {
+		SharedTask task(Task::MakeTask<void>(_func));
+		for (const SharedTask &it : _after) task->WaitFor(*it);
+		if (_pool) _pool->Enqueue(task);
+		else (*task)();
+		if (_tasks) _tasks->push_back(task);
+		return task;
+	}
+
+	void WaitAll(const std::vector<SharedTask> &_tasks) {
+		for (const SharedTask &it : _tasks) it->Wait();
+	}
+
 }
 
 LAMBDA_END
\ No newline at end of file
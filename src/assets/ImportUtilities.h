@@ -1,7 +1,9 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <mutex>
 #include <maths/maths.h>
+#include <utility/Concurrency.h>
 #include <assimp/scene.h>
 #include "ResourceManager.h"
 
@@ -9,9 +11,20 @@ LAMBDA_BEGIN
 
 namespace ImportUtilities {
 
+	using SharedTask = std::shared_ptr<Task>;
+
+	/*
+		Vertices or triangles converted per import task, so large meshes are split across workers.
+	*/
+	constexpr size_t IMPORT_CHUNK_SIZE = 1 << 16;
+
+	/*
+		Import tasks append from worker threads, so appends are locked.
+	*/
 	struct ImportMetrics {
 		std::string name, path;
 		std::vector<std::string> metrics, errors;
+		std::mutex mutex;
 
 		ImportMetrics(const std::string &_name, const std::string &_path = "");
 		
@@ -28,6 +41,18 @@ namespace ImportUtilities {
 		bool HasErrors() const;
 	};
 
+	/*
+		Wraps _func in a task and enqueues it on _pool, or runs it straight away if there is no pool.
+		The task is recorded in _tasks so the caller can wait on it.
+			- Without a pool tasks run in the order they are made, so dependencies are already met.
+	*/
+	SharedTask Submit(ThreadPool *_pool, std::function<void()> _func, std::vector<SharedTask> *_tasks, const std::vector<SharedTask> &_after = {});
+
+	/*
+		Blocks until every task in _tasks has finished.
+	*/
+	void WaitAll(const std::vector<SharedTask> &_tasks);
+
 
 
 	/*
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include "MaterialImport.h"
 #include <image/Texture.h>
 #include <image/Colour.h>
@@ -12,6 +13,9 @@ LAMBDA_BEGIN
 //Formats supported by stb_image.
 constexpr const char *const imageFormats[] = { "png", "jpg", "jpeg", "tga", "bmp", "psd", "gif", "hdr", "pic", "pnm" };
 
+//Texture files with more texels than this are paged in through the TextureCache rather than loaded.
+constexpr int tiledTextureMinTexels = 1024 * 1024;
+
 namespace MaterialImport {
 
 	namespace sg = ShaderGraph;
@@ -63,22 +67,11 @@ namespace MaterialImport {
 			return _aiTexture->mHeight == 0 ? true : false;
 		}
 
-		inline bool IsPowerOf2(const int _n) {
-			return (_n & (_n - 1)) == 0;
-		}
-
-		inline void SetEncoder(Texture *_target, const int _w, const int _h) {
-			if (IsPowerOf2(_w) && IsPowerOf2(_h)) {
-				//if (_w == _h) _target->SetEncoder(EncoderMode::ENCODE_HILBERT);
-				//else _target->SetEncoder(EncoderMode::ENCODE_MORTON);
-			}
-		}
-
 		void LoadEmbeddedTexture(const aiTexture *_aiTexture, Texture *_texture, ImportMetrics *_metrics) {
 			if (!IsCompressed(_aiTexture)) {
 				static constexpr Real inv256 = 1. / 256.;
 				const unsigned w = _aiTexture->mWidth, h = _aiTexture->mHeight;
-				SetEncoder(_texture, w, h);
+				_texture->Resize(w, h);
 				for (unsigned y = 0; y < h; ++y) {
 					for (unsigned x = 0; x < w; ++x) {
 						const Real rgba[4] = {
@@ -93,9 +86,6 @@ namespace MaterialImport {
 			}
 			else {
 				if (GetFormat(_aiTexture)) {
-					int w, h;
-					_texture->GetMemoryInfo(_aiTexture->pcData, _aiTexture->mWidth, &w, &h, nullptr);
-					SetEncoder(_texture, w, h);
 					_texture->LoadFromMemory(_aiTexture->pcData, _aiTexture->mWidth);
 				}
 				else {
@@ -107,40 +97,56 @@ namespace MaterialImport {
 		void LoadTextureFile(const std::string &_path, Texture *_target, ImportMetrics *_metrics) {
 			int w, h;
 			if (Texture::GetFileInfo(_path.c_str(), &w, &h, nullptr)) {
-				SetEncoder(_target, w, h);
+				if (w * h > tiledTextureMinTexels && _target->LoadTiled(_path.c_str())) return;
 				_target->LoadImageFile(_path.c_str());
 			}
 			else _metrics->AppendError("Could not open: " + (std::string)_path.c_str());
 		}
 
 		bool HasAlpha(const Texture *_tex) {
-			const size_t s = _tex->GetWidth() * _tex->GetHeight();
-			for (size_t i = 0; i < s; ++i) {
-				const Real a = (*_tex)[i].a;
-				if (std::isnormal(a) && a < (Real)1 && a >(Real)0) return true;
+			if (_tex->IsTiled()) return _tex->tiled->hasAlpha;	//Found when the tiled file was made
+			for (unsigned y = 0; y < _tex->GetHeight(); ++y) {	//Through GetPixelCoord, the texture may already be packed
+				for (unsigned x = 0; x < _tex->GetWidth(); ++x) {
+					const Real a = _tex->GetPixelCoord(x, y).a;
+					if (std::isnormal(a) && a < (Real)1 && a >(Real)0) return true;
+				}
 			}
 			return false;
 		}
 
+		/*
+			_aiScene may be null for textures that are known to be files, e.g. from a scene cache.
+		*/
 		void ParseTexture(const aiScene *_aiScene, const std::string &_path, Texture *_target, ImportMetrics *_metrics) {
-			if (const aiTexture *texture = _aiScene->GetEmbeddedTexture(_path.c_str()))
+			if (const aiTexture *texture = _aiScene ? _aiScene->GetEmbeddedTexture(_path.c_str()) : nullptr)
 				LoadEmbeddedTexture(texture, _target, _metrics);
 			else
 				LoadTextureFile(_path, _target, _metrics);
+			if (!_target->IsTiled()) _target->GenerateMips();	//Tiled files carry their own
+			_target->interpolation = InterpolationMode::INTERP_EWA;
+		}
+
+		inline std::string TexturePath(const aiString &_path, const std::string &_directory) {
+			return (std::string(_path.C_Str()).find(':') != std::string::npos) ? _path.C_Str() : _directory + "\\" + _path.C_Str();
 		}
 
+		/*
+			Textures are pushed to the pool here, on the calling thread, and only decoded by the tasks.
+		*/
 		template<aiTextureType texType>
-		bool PushTextureStacks(const aiScene *_aiScene, ResourceManager *_resources, ImportMetrics *_metrics) {
+		bool EnqueueTextureStacks(const aiScene *_aiScene, ResourceManager *_resources, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks) {
 			aiString path;
 			unsigned i = 0;
 			for (; i < _aiScene->mNumMaterials; ++i) {
 				if (_aiScene->mMaterials[i]->GetTexture(texType, 0, &path) == aiReturn_SUCCESS) {
-					const std::string fullPath = (std::string(path.C_Str()).find(':') != std::string::npos) ? path.C_Str() : _metrics->path + "\\" + path.C_Str();
+					const std::string fullPath = TexturePath(path, _metrics->path);
 					if (!_resources->texturePool.Find(path.C_Str())) {
 						Texture *tex = new Texture;
-						ParseTexture(_aiScene, fullPath, tex, _metrics);
 						_resources->texturePool.Append(path.C_Str(), tex);
-						_metrics->AppendMetric(fullPath + " [" + std::to_string(tex->GetWidth()) + "x" + std::to_string(tex->GetHeight()) + "] pushed.");
+						Submit(_pool, [=]() {
+							ParseTexture(_aiScene, fullPath, tex, _metrics);
+							_metrics->AppendMetric(fullPath + " [" + std::to_string(tex->GetWidth()) + "x" + std::to_string(tex->GetHeight()) + "] pushed.");
+						}, _tasks);
 					}
 					else _metrics->AppendMetric(std::string(path.C_Str()) + " already pushed.");
 				}
@@ -149,24 +155,57 @@ namespace MaterialImport {
 			return i > 0;
 		}
 
+		/*
+			Appends the file textures of one stack to _textures. Returns false if any are embedded.
+		*/
+		template<aiTextureType texType>
+		bool DescribeTextureStacks(const aiScene *_aiScene, const std::string &_directory, std::vector<TextureDesc> *_textures) {
+			aiString path;
+			bool files = true;
+			for (unsigned i = 0; i < _aiScene->mNumMaterials; ++i) {
+				if (_aiScene->mMaterials[i]->GetTexture(texType, 0, &path) == aiReturn_SUCCESS) {
+					const std::string fullPath = TexturePath(path, _directory);
+					if (_aiScene->GetEmbeddedTexture(fullPath.c_str())) files = false;
+					else if (std::none_of(_textures->begin(), _textures->end(), [&](const TextureDesc &_t) { return _t.key == path.C_Str(); }))
+						_textures->push_back({ path.C_Str(), fullPath });
+				}
+			}
+			return files;
+		}
+
 		template<aiTextureType texType>
-		Texture *GetTextureFromPool(const aiMaterial *_aiMaterial, ResourcePool<Texture> *_texPool) {
+		MaterialSlot DescribeSlot(const aiMaterial *_aiMaterial) {
+			MaterialSlot slot;
 			aiString path;
 			if (_aiMaterial->GetTexture(texType, 0, &path) == aiReturn_SUCCESS) {
-				return _texPool->Find(path.C_Str());
+				slot.key = path.C_Str();
+				slot.used = true;
 			}
 			else {
 				typename GetaiType<texType>::type tmp;
 				constexpr MatKey matKey = MatchaiTextureType(texType);
 				if (_aiMaterial->Get(matKey.c, matKey.i1, matKey.i2, tmp) == aiReturn_SUCCESS) {
-					Texture *tex = new Texture(1, 1, aiTypeToColour(tmp));
 					aiString name;
 					_aiMaterial->Get(AI_MATKEY_NAME, name);
-					_texPool->Append((std::string)name.C_Str() + (std::string)matKey.c, tex);
-					return tex;
+					slot.key = (std::string)name.C_Str() + (std::string)matKey.c;
+					slot.used = slot.constant = true;
+					slot.value = aiTypeToColour(tmp);
 				}
 			}
-			return nullptr;
+			return slot;
+		}
+
+		/*
+			Constants become 1x1 textures, made once per key.
+		*/
+		Texture *GetTextureFromPool(const MaterialSlot &_slot, ResourcePool<Texture> *_texPool) {
+			if (!_slot.used) return nullptr;
+			Texture *tex = _texPool->Find(_slot.key);
+			if (!tex && _slot.constant) {
+				tex = new Texture(1, 1, _slot.value);
+				_texPool->Append(_slot.key, tex);
+			}
+			return tex;
 		}
 
 		enum MaterialAttribute {
@@ -228,11 +267,11 @@ namespace MaterialImport {
 			}
 		}
 
-		bool BuildMaterial(const int _model, const aiMaterial *_aiMaterial, ResourcePool<Texture> *_texPool, Material *_material) {
-			switch (_model) {
+		bool BuildMaterial(const MaterialDesc &_desc, ResourcePool<Texture> *_texPool, Material *_material) {
+			switch (_desc.attributes) {
 			case SHADINGMODEL_DIFFUSE:
 			{
-				Texture *diffuseTex = GetTextureFromPool<aiTextureType_DIFFUSE>(_aiMaterial, _texPool);
+				Texture *diffuseTex = GetTextureFromPool(_desc.slots[MTL_SLOT_DIFFUSE], _texPool);
 				if (diffuseTex) {
 					if (HasAlpha(diffuseTex)) {
 						_material->bxdf = MatMake::MakeDiffuseAlpha(_material, diffuseTex);
@@ -245,13 +284,13 @@ namespace MaterialImport {
 			}
 			case SHADINGMODEL_DIFFUSE_ALPHA:
 			{
-				Texture *diffuseTex = GetTextureFromPool<aiTextureType_DIFFUSE>(_aiMaterial, _texPool);
-				Texture *alphaTex = GetTextureFromPool<aiTextureType_OPACITY>(_aiMaterial, _texPool);
+				Texture *diffuseTex = GetTextureFromPool(_desc.slots[MTL_SLOT_DIFFUSE], _texPool);
+				Texture *alphaTex = GetTextureFromPool(_desc.slots[MTL_SLOT_OPACITY], _texPool);
 				if (diffuseTex && alphaTex) {
 					_material->bxdf = MatMake::MakeDiffuseAlphaMap(_material, diffuseTex, alphaTex);
 					return true;
 				}
-				else if (HasAlpha(diffuseTex)) {
+				else if (diffuseTex && HasAlpha(diffuseTex)) {
 					_material->bxdf = MatMake::MakeDiffuseAlpha(_material, diffuseTex);
 					return true;
 				}
@@ -326,16 +365,39 @@ namespace MaterialImport {
 		}
 	}
 
+	bool DescribeTextures(const aiScene *_aiScene, const std::string &_directory, std::vector<TextureDesc> *_textures) {
+		bool files = DescribeTextureStacks<aiTextureType_DIFFUSE>(_aiScene, _directory, _textures);
+		files &= DescribeTextureStacks<aiTextureType_DISPLACEMENT>(_aiScene, _directory, _textures);
+		files &= DescribeTextureStacks<aiTextureType_SHININESS>(_aiScene, _directory, _textures);
+		return files;
+	}
+
+	MaterialDesc DescribeMaterial(const aiMaterial *_aiMaterial) {
+		MaterialDesc desc;
+		aiString matName;
+		_aiMaterial->Get(AI_MATKEY_NAME, matName);
+		desc.name = matName.C_Str();
+		desc.attributes = GetMaterialAttributes(_aiMaterial);
+		desc.slots[MTL_SLOT_DIFFUSE] = DescribeSlot<aiTextureType_DIFFUSE>(_aiMaterial);
+		desc.slots[MTL_SLOT_OPACITY] = DescribeSlot<aiTextureType_OPACITY>(_aiMaterial);
+		return desc;
+	}
+
 	bool PushTextures(const aiScene *_aiScene, ResourceManager *_resourceManager, ImportMetrics *_metrics) {
+		std::vector<SharedTask> tasks;
+		return EnqueueTextures(_aiScene, _resourceManager, _metrics, nullptr, &tasks);
+	}
+
+	bool EnqueueTextures(const aiScene *_aiScene, ResourceManager *_resourceManager, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks) {
 		unsigned numTextures = 0;
 		_metrics->AppendMetric("Diffuse stack:");
-		if (!PushTextureStacks<aiTextureType_DIFFUSE>(_aiScene, _resourceManager, _metrics)) _metrics->AppendMetric("No textures in diffuse stacks.");
+		if (!EnqueueTextureStacks<aiTextureType_DIFFUSE>(_aiScene, _resourceManager, _metrics, _pool, _tasks)) _metrics->AppendMetric("No textures in diffuse stacks.");
 		else numTextures++;
 		_metrics->AppendMetric("Displacement stack:");
-		if (!PushTextureStacks<aiTextureType_DISPLACEMENT>(_aiScene, _resourceManager, _metrics)) _metrics->AppendMetric("No textures in displacement stacks.");
+		if (!EnqueueTextureStacks<aiTextureType_DISPLACEMENT>(_aiScene, _resourceManager, _metrics, _pool, _tasks)) _metrics->AppendMetric("No textures in displacement stacks.");
 		else numTextures++;
 		_metrics->AppendMetric("Glossiness stack:");
-		if (!PushTextureStacks<aiTextureType_SHININESS>(_aiScene, _resourceManager, _metrics)) _metrics->AppendMetric("No textures in glossiness stacks.");
+		if (!EnqueueTextureStacks<aiTextureType_SHININESS>(_aiScene, _resourceManager, _metrics, _pool, _tasks)) _metrics->AppendMetric("No textures in glossiness stacks.");
 		else numTextures++;
 		_metrics->AppendMetric(std::to_string(numTextures) + " total textures pushed.");
 		return numTextures > 0;
@@ -343,24 +405,39 @@ namespace MaterialImport {
 
 	bool PushMaterials(const aiScene *_aiScene, ResourceManager *_resources, ImportMetrics *_metrics) {
 		if (_aiScene->HasMaterials()) {
-			for (unsigned i = 0; i < _aiScene->mNumMaterials; ++i) {	
-				Material *mat = new Material;
-				const int attributes = GetMaterialAttributes(_aiScene->mMaterials[i]);
-				const bool pass = BuildMaterial(attributes, _aiScene->mMaterials[i], &_resources->texturePool, mat);
-				aiString matName;
-				_aiScene->mMaterials[i]->Get(AI_MATKEY_NAME, matName);
-				if (!pass) {
-					_metrics->AppendError("Failed to build " + (std::string)matName.C_Str() + "'s original material graph.");
-				}
-				_resources->materialPool.Append(matName.C_Str(), mat);
-				_metrics->AppendMetric(std::string(matName.C_Str()) + " pushed.");
-			}
-			return true;
+			std::vector<MaterialDesc> descs;
+			for (unsigned i = 0; i < _aiScene->mNumMaterials; ++i) descs.push_back(DescribeMaterial(_aiScene->mMaterials[i]));
+			return PushMaterials(descs, _resources, _metrics);
 		}
 		_metrics->AppendError("No materials in asset.");
 		return false;
 	}
 
+	bool PushMaterials(const std::vector<MaterialDesc> &_descs, ResourceManager *_resources, ImportMetrics *_metrics) {
+		for (const MaterialDesc &desc : _descs) {
+			Material *mat = new Material;
+			if (!BuildMaterial(desc, &_resources->texturePool, mat)) {
+				_metrics->AppendError("Failed to build " + desc.name + "'s original material graph.");
+			}
+			_resources->materialPool.Append(desc.name, mat);
+			_metrics->AppendMetric(desc.name + " pushed.");
+		}
+		return true;
+	}
+
+	void EnqueueTextures(const std::vector<TextureDesc> &_textures, ResourceManager *_resources, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks) {
+		for (const TextureDesc &desc : _textures) {
+			if (_resources->texturePool.Find(desc.key)) continue;
+			Texture *tex = new Texture;
+			_resources->texturePool.Append(desc.key, tex);
+			Submit(_pool, [=]() {
+				ParseTexture(nullptr, desc.path, tex, _metrics);
+				_metrics->AppendMetric(desc.path + " [" + std::to_string(tex->GetWidth()) + "x" + std::to_string(tex->GetHeight()) + "] pushed.");
+			}, _tasks);
+		}
+		_metrics->AppendMetric(std::to_string(_textures.size()) + " textures pushed.");
+	}
+
 	Material *GetMaterial(const aiScene *_aiScene, const ResourceManager *_resources, const std::string &_name) {
 		for (unsigned i = 0; i < _aiScene->mNumMeshes; ++i) {
 			if (_name == _aiScene->mMeshes[i]->mName.C_Str()) {
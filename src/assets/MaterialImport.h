@@ -7,16 +7,72 @@ namespace MaterialImport {
 
 	using namespace ImportUtilities;
 
+	enum MaterialSlotType {
+		MTL_SLOT_DIFFUSE,
+		MTL_SLOT_OPACITY,
+		MTL_SLOT_COUNT
+	};
+
+	/*
+		Source of one material input: the texture pool entry under key, or a constant that is made
+		into a 1x1 texture under key.
+	*/
+	struct MaterialSlot {
+		std::string key;
+		bool used = false, constant = false;
+		Colour value = Colour(0.f);
+	};
+
+	/*
+		Everything BuildMaterial reads from an aiMaterial, so materials can be rebuilt without the aiScene.
+	*/
+	struct MaterialDesc {
+		std::string name;
+		int attributes = 0;
+		MaterialSlot slots[MTL_SLOT_COUNT];
+	};
+
+	/*
+		A texture file and the key it is pushed to the texture pool under.
+	*/
+	struct TextureDesc {
+		std::string key, path;
+	};
+
+	/*
+		Appends the texture files referenced in _aiScene to _textures. Paths are relative to _directory.
+		Returns false if some textures are embedded in the asset, those are left out.
+	*/
+	bool DescribeTextures(const aiScene *_aiScene, const std::string &_directory, std::vector<TextureDesc> *_textures);
+
+	MaterialDesc DescribeMaterial(const aiMaterial *_aiMaterial);
+
 	/*
 		Pushes all textures referenced in _aiScene into _resources.
 	*/
 	bool PushTextures(const aiScene *_aiScene, ResourceManager *_resource, ImportMetrics *_metrics);
 
+	/*
+		Pushes all textures referenced in _aiScene into _resources and queues their decoding on _pool.
+		Textures are empty until all tasks appended to _tasks finish.
+	*/
+	bool EnqueueTextures(const aiScene *_aiScene, ResourceManager *_resources, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks);
+
 	/*
 		Pushes all materials referenced in _aiScene into _resources.
 	*/
 	bool PushMaterials(const aiScene *_aiScene, ResourceManager *_resources, ImportMetrics *_metrics);
 
+	/*
+		Builds and pushes the materials in _descs. Their textures must already be in _resources.
+	*/
+	bool PushMaterials(const std::vector<MaterialDesc> &_descs, ResourceManager *_resources, ImportMetrics *_metrics);
+
+	/*
+		Pushes the texture files in _textures into _resources and queues their decoding on _pool.
+	*/
+	void EnqueueTextures(const std::vector<TextureDesc> &_textures, ResourceManager *_resources, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks);
+
 	/*
 		Returns the corresponding material in _resources to the given object _name from _aiScene.
 	*/
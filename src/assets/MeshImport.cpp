@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "MeshImport.h"
 
 LAMBDA_BEGIN
@@ -9,57 +10,65 @@ namespace MeshImport {
 	}
 
 	void LoadMeshVertexBuffers(const aiMesh *_aiMesh, TriangleMesh *_tMesh) {
+		AllocMeshBuffers(_aiMesh, _tMesh);
+		LoadVertexRange(_aiMesh, _tMesh, 0, _tMesh->numVertices);
+		LoadTriangleRange(_aiMesh, _tMesh, 0, _tMesh->numTriangles);
+	}
 
+	void AllocMeshBuffers(const aiMesh *_aiMesh, TriangleMesh *_tMesh) {
 		_tMesh->AllocData(_aiMesh->mNumVertices, _aiMesh->mNumFaces);
-
-		//	Vertices
-		for (size_t i = 0; i < _tMesh->numVertices; ++i) {
-			_tMesh->vertices[i].x = _aiMesh->mVertices[i].x;
-			_tMesh->vertices[i].y = _aiMesh->mVertices[i].y;
-			_tMesh->vertices[i].z = _aiMesh->mVertices[i].z;
+		_tMesh->smoothNormals = _aiMesh->HasTangentsAndBitangents();
+		if (!_aiMesh->HasTextureCoords(0)) {
+			delete[] _tMesh->textureCoordinates;
+			_tMesh->textureCoordinates = nullptr;
 		}
+	}
 
-		//	Triangles
-		for (size_t i = 0; i < _tMesh->numTriangles; ++i) {
-			_tMesh->triangles[i].v0 = _aiMesh->mFaces[i].mIndices[0];
-			_tMesh->triangles[i].v1 = _aiMesh->mFaces[i].mIndices[1];
-			_tMesh->triangles[i].v2 = _aiMesh->mFaces[i].mIndices[2];
-		}
+	void LoadVertexRange(const aiMesh *_aiMesh, TriangleMesh *_tMesh, const size_t _begin, const size_t _end) {
+		const aiVector3D *vertices = _aiMesh->mVertices;
+		Vec3 *tVertices = _tMesh->vertices;
+
+		//	Vertices
+		for (size_t i = _begin; i < _end; ++i) tVertices[i] = Vec3(vertices[i].x, vertices[i].y, vertices[i].z);
 
 		//	Normals
 		if (_aiMesh->HasNormals()) {
-			for (size_t i = 0; i < _tMesh->numVertices; ++i) {
-				_tMesh->vertexNormals[i].x = _aiMesh->mNormals[i].x;
-				_tMesh->vertexNormals[i].y = _aiMesh->mNormals[i].y;
-				_tMesh->vertexNormals[i].z = _aiMesh->mNormals[i].z;
-			}
+			const aiVector3D *normals = _aiMesh->mNormals;
+			Vec3 *tNormals = _tMesh->vertexNormals;
+			for (size_t i = _begin; i < _end; ++i) tNormals[i] = Vec3(normals[i].x, normals[i].y, normals[i].z);
 		}
 
 		//	Tangents and Bitangent Handednessses
 		if (_aiMesh->HasTangentsAndBitangents()) {
-			for (size_t i = 0; i < _tMesh->numVertices; ++i) {
-				_tMesh->vertexTangents[i].x = CheckReal(_aiMesh->mTangents[i].x);
-				_tMesh->vertexTangents[i].y = CheckReal(_aiMesh->mTangents[i].y);
-				_tMesh->vertexTangents[i].z = CheckReal(_aiMesh->mTangents[i].z);
-				
-				const Vec3 bitangent = Vec3(CheckReal(_aiMesh->mBitangents[i].x), CheckReal(_aiMesh->mBitangents[i].y), CheckReal(_aiMesh->mBitangents[i].z));
-				const Real dot = maths::Dot(maths::Cross(_tMesh->vertexNormals[i], _tMesh->vertexTangents[i]), bitangent);
-				_tMesh->vertexTangents[i].a = (dot < (Real)0) ? (Real)-1 : (Real)1;
+			const aiVector3D *tangents = _aiMesh->mTangents, *bitangents = _aiMesh->mBitangents;
+			Vec3 *tTangents = _tMesh->vertexTangents;
+			const Vec3 *tNormals = _tMesh->vertexNormals;
+			for (size_t i = _begin; i < _end; ++i) {
+				tTangents[i] = Vec3(CheckReal(tangents[i].x), CheckReal(tangents[i].y), CheckReal(tangents[i].z));
+				const Vec3 bitangent = Vec3(CheckReal(bitangents[i].x), CheckReal(bitangents[i].y), CheckReal(bitangents[i].z));
+				const Real dot = maths::Dot(maths::Cross(tNormals[i], tTangents[i]), bitangent);
+				tTangents[i].a = (dot < (Real)0) ? (Real)-1 : (Real)1;
 			}
 		}
-		_tMesh->smoothNormals = _aiMesh->HasTangentsAndBitangents();
 
 		//	Texture Coordinates
 		static const int channel = 0;
-		if (_aiMesh->HasTextureCoords(channel)) {
-			for (size_t i = 0; i < _tMesh->numVertices; ++i) {
-				_tMesh->textureCoordinates[i].x = (Real)1 - _aiMesh->mTextureCoords[channel][i].x;
-				_tMesh->textureCoordinates[i].y = (Real)1 - _aiMesh->mTextureCoords[channel][i].y;
+		if (_tMesh->textureCoordinates) {
+			const aiVector3D *uvs = _aiMesh->mTextureCoords[channel];
+			Vec2 *tUVs = _tMesh->textureCoordinates;
+			for (size_t i = _begin; i < _end; ++i) {
+				tUVs[i].x = (Real)1 - uvs[i].x;
+				tUVs[i].y = (Real)1 - uvs[i].y;
 			}
 		}
-		else {
-			delete[] _tMesh->textureCoordinates;
-			_tMesh->textureCoordinates = nullptr;
+	}
+
+	void LoadTriangleRange(const aiMesh *_aiMesh, TriangleMesh *_tMesh, const size_t _begin, const size_t _end) {
+		const aiFace *faces = _aiMesh->mFaces;
+		Triangle *triangles = _tMesh->triangles;
+		for (size_t i = _begin; i < _end; ++i) {
+			const unsigned *indices = faces[i].mIndices;
+			triangles[i] = { indices[0], indices[1], indices[2] };
 		}
 	}
 
@@ -91,6 +100,36 @@ namespace MeshImport {
 		return false;
 	}
 
+	bool EnqueueMeshes(const aiScene *_scene, ResourceManager *_resourceManager, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks, const RTCDevice _device) {
+		if (!_scene->HasMeshes()) {
+			_metrics->AppendError("Asset has no meshes.");
+			return false;
+		}
+		for (unsigned i = 0; i < _scene->mNumMeshes; ++i) {
+			const aiMesh *aiMesh = _scene->mMeshes[i];
+			TriangleMesh *mesh = new TriangleMesh();
+			AllocMeshBuffers(aiMesh, mesh);	//Serially, so the pool and metrics are only touched from here
+			_resourceManager->objectPool.Append(aiMesh->mName.C_Str(), mesh);
+			_metrics->AppendMetric(std::string(aiMesh->mName.C_Str()) + ":	" +
+				std::to_string(aiMesh->mNumVertices) + " verts, " +
+				std::to_string(aiMesh->mNumFaces) + " tris");
+
+			std::vector<SharedTask> chunks;
+			for (size_t v = 0; v < mesh->numVertices; v += IMPORT_CHUNK_SIZE) {
+				const size_t end = std::min(v + IMPORT_CHUNK_SIZE, mesh->numVertices);
+				Submit(_pool, [=]() { LoadVertexRange(aiMesh, mesh, v, end); }, &chunks);
+			}
+			for (size_t t = 0; t < mesh->numTriangles; t += IMPORT_CHUNK_SIZE) {
+				const size_t end = std::min(t + IMPORT_CHUNK_SIZE, mesh->numTriangles);
+				Submit(_pool, [=]() { LoadTriangleRange(aiMesh, mesh, t, end); }, &chunks);
+			}
+			if (_device) Submit(_pool, [=]() { mesh->Commit(_device); }, _tasks, chunks);
+			_tasks->insert(_tasks->end(), chunks.begin(), chunks.end());
+		}
+		_metrics->AppendMetric(std::to_string(_scene->mNumMeshes) + " meshes pushed.");
+		return true;
+	}
+
 }
 
 LAMBDA_END
\ No newline at end of file
@@ -21,6 +21,22 @@ namespace MeshImport {
 	*/
 	void LoadMeshVertexBuffers(const aiMesh *_aiMesh, TriangleMesh *_tMesh);
 
+	/*
+		Allocates _tMesh's buffers for _aiMesh without filling them.
+	*/
+	void AllocMeshBuffers(const aiMesh *_aiMesh, TriangleMesh *_tMesh);
+
+	/*
+		Fills vertex attributes [_begin, _end) of _tMesh, allocated by AllocMeshBuffers. Ranges don't
+		overlap, so they can be filled from different threads.
+	*/
+	void LoadVertexRange(const aiMesh *_aiMesh, TriangleMesh *_tMesh, const size_t _begin, const size_t _end);
+
+	/*
+		Fills triangles [_begin, _end) of _tMesh, allocated by AllocMeshBuffers.
+	*/
+	void LoadTriangleRange(const aiMesh *_aiMesh, TriangleMesh *_tMesh, const size_t _begin, const size_t _end);
+
 	/*
 		Loads transform data from aiScene into any corresponding objects in the ResourceManager.
 			- Renaming objects from their original in the resource pool will prevent its transform loading.
@@ -32,6 +48,14 @@ namespace MeshImport {
 	*/
 	bool PushMeshes(const aiScene *_scene, ResourceManager *_resourceManager, ImportMetrics *_metrics);
 
+	/*
+		Pushes every mesh in _scene to _resourceManager and queues their conversion on _pool, split
+		into IMPORT_CHUNK_SIZE pieces. Meshes are incomplete until all tasks appended to _tasks finish.
+			- If _device is set each mesh commits its Embree geometry as soon as it is filled. Add
+			  these with Scene::AttachObject instead of Scene::AddObject.
+	*/
+	bool EnqueueMeshes(const aiScene *_scene, ResourceManager *_resourceManager, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks, const RTCDevice _device = nullptr);
+
 }
 
 LAMBDA_END
\ No newline at end of file
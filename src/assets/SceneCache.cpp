@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "SceneCache.h"
+
+LAMBDA_BEGIN
+
+using namespace MaterialImport;
+
+namespace {
+
+	constexpr char cacheMagic[4] = { 'L', 'S', 'C', '1' };
+	constexpr uint32_t cacheVersion = 2;
+	constexpr uint64_t bufferAlignment = 64;
+
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceSize, sourceModified;	//Stamp of the asset the cache was made from, to spot stale files
+		uint64_t fileSize;
+		uint32_t numMeshes, numTextures, numMaterials, stringBytes;
+		uint64_t meshes, textures, materials, strings;
+	};
+
+	struct MeshRecord {
+		uint64_t numVertices, numTriangles;
+		uint64_t vertices, triangles, normals, tangents, uvs;	//0 if the mesh has none
+		float xfm[12];
+		uint32_t name, material, smoothNormals, pad;
+	};
+
+	struct TextureRecord {
+		uint32_t key, path;
+	};
+
+	struct SlotRecord {
+		uint32_t key, used, constant, pad;
+		float value[4];
+	};
+
+	struct MaterialRecord {
+		uint32_t name;
+		int32_t attributes;
+		SlotRecord slots[MTL_SLOT_COUNT];
+	};
+
+	static_assert(sizeof(Vec3) == 16 && sizeof(Vec2) == 8 && sizeof(Triangle) == 12, "Scene cache assumes packed SSE vectors.");
+
+	inline uint64_t Align(const uint64_t _offset, const uint64_t _alignment) {
+		return (_offset + _alignment - 1) / _alignment * _alignment;
+	}
+
+	/*
+		Writes sequentially, zero padding up to each requested offset.
+	*/
+	struct CacheWriter {
+		std::ofstream out;
+		uint64_t offset = 0;
+
+		CacheWriter(const std::string &_path) : out(_path, std::ios::binary | std::ios::trunc) {}
+
+		void Write(const void *_data, const uint64_t _bytes) {
+			out.write((const char *)_data, _bytes);
+			offset += _bytes;
+		}
+
+		void PadTo(const uint64_t _offset) {
+			static const char zeros[bufferAlignment] = {};
+			while (offset < _offset) Write(zeros, std::min(_offset - offset, bufferAlignment));
+		}
+	};
+
+	struct StringTable {
+		std::string blob;
+
+		uint32_t Add(const std::string &_s) {
+			const uint32_t offset = (uint32_t)blob.size();
+			blob.append(_s.c_str(), _s.size() + 1);
+			return offset;
+		}
+	};
+
+	template<class T>
+	inline T *BufferAt(char *_data, const uint64_t _offset) {
+		return _offset ? (T *)(_data + _offset) : nullptr;
+	}
+
+}
+
+bool SceneCache::Open(const std::string &_path, const FileStamp &_source) {
+	Close();
+	std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>();
+	if (!mapped->Open(_path) || mapped->Size() < sizeof(CacheHeader)) return false;
+	const CacheHeader &header = *(const CacheHeader *)mapped->Data();
+	if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion) return false;
+	if (header.sourceSize != _source.size || header.sourceModified != _source.modified || header.fileSize != mapped->Size()) return false;
+
+	//Every record and buffer must lie inside the file
+	const uint64_t size = mapped->Size();
+	auto inside = [size](const uint64_t _offset, const uint64_t _bytes) { return _offset <= size && _bytes <= size - _offset; };
+	if (!inside(header.meshes, (uint64_t)header.numMeshes * sizeof(MeshRecord)) ||
+		!inside(header.textures, (uint64_t)header.numTextures * sizeof(TextureRecord)) ||
+		!inside(header.materials, (uint64_t)header.numMaterials * sizeof(MaterialRecord)) ||
+		!inside(header.strings, header.stringBytes) || header.stringBytes == 0 ||
+		mapped->Data()[header.strings + header.stringBytes - 1] != '\0') return false;
+	auto buffer = [&inside](const uint64_t _offset, const uint64_t _bytes) { return _offset == 0 || inside(_offset, _bytes); };
+	const MeshRecord *meshes = (const MeshRecord *)(mapped->Data() + header.meshes);
+	for (uint32_t i = 0; i < header.numMeshes; ++i) {
+		const MeshRecord &m = meshes[i];
+		if (m.numVertices > size || m.numTriangles > size || !m.vertices || !m.triangles) return false;
+		if (!buffer(m.vertices, m.numVertices * sizeof(Vec3)) || !buffer(m.triangles, m.numTriangles * sizeof(Triangle)) ||
+			!buffer(m.normals, m.numVertices * sizeof(Vec3)) || !buffer(m.tangents, m.numVertices * sizeof(Vec3)) ||
+			!buffer(m.uvs, m.numVertices * sizeof(Vec2))) return false;
+	}
+	file = mapped;
+	return true;
+}
+
+void SceneCache::Close() {
+	file.reset();
+}
+
+const char *SceneCache::String(const uint32_t _offset) const {
+	const CacheHeader &header = *(const CacheHeader *)file->Data();
+	return file->Data() + header.strings + std::min(_offset, header.stringBytes - 1);
+}
+
+bool SceneCache::PushMeshes(ResourceManager *_resources, ImportMetrics *_metrics, const RTCDevice _device) const {
+	const CacheHeader &header = *(const CacheHeader *)file->Data();
+	const MeshRecord *records = (const MeshRecord *)(file->Data() + header.meshes);
+	for (uint32_t i = 0; i < header.numMeshes; ++i) {
+		const MeshRecord &record = records[i];
+		TriangleMesh *mesh = new TriangleMesh();
+		mesh->externalData = file;
+		mesh->numVertices = record.numVertices;
+		mesh->numTriangles = record.numTriangles;
+		mesh->vertices = BufferAt<Vec3>(file->Data(), record.vertices);
+		mesh->triangles = BufferAt<Triangle>(file->Data(), record.triangles);
+		mesh->vertexNormals = BufferAt<Vec3>(file->Data(), record.normals);
+		mesh->vertexTangents = BufferAt<Vec3>(file->Data(), record.tangents);
+		mesh->textureCoordinates = BufferAt<Vec2>(file->Data(), record.uvs);
+		mesh->smoothNormals = record.smoothNormals != 0;
+		for (unsigned j = 0; j < 12; ++j) mesh->xfm[j] = record.xfm[j];
+		if (_device) mesh->Commit(_device);
+		_resources->objectPool.Append(String(record.name), mesh);
+		_metrics->AppendMetric(std::string(String(record.name)) + ":	" +
+			std::to_string(record.numVertices) + " verts, " +
+			std::to_string(record.numTriangles) + " tris");
+	}
+	_metrics->AppendMetric(std::to_string(header.numMeshes) + " meshes pushed from cache.");
+	return header.numMeshes > 0;
+}
+
+bool SceneCache::EnqueueTextures(ResourceManager *_resources, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks) const {
+	const CacheHeader &header = *(const CacheHeader *)file->Data();
+	const TextureRecord *records = (const TextureRecord *)(file->Data() + header.textures);
+	std::vector<TextureDesc> textures(header.numTextures);
+	for (uint32_t i = 0; i < header.numTextures; ++i) textures[i] = { String(records[i].key), String(records[i].path) };
+	MaterialImport::EnqueueTextures(textures, _resources, _metrics, _pool, _tasks);
+	return header.numTextures > 0;
+}
+
+bool SceneCache::PushMaterials(ResourceManager *_resources, ImportMetrics *_metrics) const {
+	const CacheHeader &header = *(const CacheHeader *)file->Data();
+	const MaterialRecord *records = (const MaterialRecord *)(file->Data() + header.materials);
+	std::vector<MaterialDesc> descs(header.numMaterials);
+	for (uint32_t i = 0; i < header.numMaterials; ++i) {
+		descs[i].name = String(records[i].name);
+		descs[i].attributes = records[i].attributes;
+		for (unsigned s = 0; s < MTL_SLOT_COUNT; ++s) {
+			const SlotRecord &slot = records[i].slots[s];
+			descs[i].slots[s].key = String(slot.key);
+			descs[i].slots[s].used = slot.used != 0;
+			descs[i].slots[s].constant = slot.constant != 0;
+			descs[i].slots[s].value = Colour(slot.value[0], slot.value[1], slot.value[2], slot.value[3]);
+		}
+	}
+	if (descs.empty()) {
+		_metrics->AppendError("No materials in cache.");
+		return false;
+	}
+	return MaterialImport::PushMaterials(descs, _resources, _metrics);
+}
+
+Material *SceneCache::GetMaterial(const ResourceManager *_resources, const std::string &_name) const {
+	const CacheHeader &header = *(const CacheHeader *)file->Data();
+	const MeshRecord *records = (const MeshRecord *)(file->Data() + header.meshes);
+	for (uint32_t i = 0; i < header.numMeshes; ++i) {
+		if (_name == String(records[i].name)) return _resources->materialPool.Find(String(records[i].material));
+	}
+	return nullptr;
+}
+
+bool SceneCache::Write(const std::string &_path, const aiScene *_aiScene, const ResourceManager *_resources, const std::string &_directory, const FileStamp &_source) {
+	std::vector<TextureDesc> textures;
+	if (!DescribeTextures(_aiScene, _directory, &textures)) {
+		std::cout << std::endl << "Scene cache not written, asset has embedded textures: " << _path;
+		return false;
+	}
+	StringTable strings;
+	strings.Add("");
+
+	std::vector<const TriangleMesh *> meshes;
+	std::vector<MeshRecord> meshRecords;
+	for (unsigned i = 0; i < _aiScene->mNumMeshes; ++i) {
+		const aiMesh *aiMesh = _aiScene->mMeshes[i];
+		const TriangleMesh *mesh = dynamic_cast<const TriangleMesh *>(_resources->objectPool.Find(aiMesh->mName.C_Str()));
+		if (!mesh) continue;
+		MeshRecord record = {};
+		record.numVertices = mesh->numVertices;
+		record.numTriangles = mesh->numTriangles;
+		for (unsigned j = 0; j < 12; ++j) record.xfm[j] = mesh->xfm[j];
+		record.name = strings.Add(aiMesh->mName.C_Str());
+		aiString matName;
+		if (aiMesh->mMaterialIndex < _aiScene->mNumMaterials) _aiScene->mMaterials[aiMesh->mMaterialIndex]->Get(AI_MATKEY_NAME, matName);
+		record.material = strings.Add(matName.C_Str());
+		record.smoothNormals = mesh->smoothNormals;
+		meshes.push_back(mesh);
+		meshRecords.push_back(record);
+	}
+
+	std::vector<TextureRecord> textureRecords;
+	for (const TextureDesc &desc : textures) textureRecords.push_back({ strings.Add(desc.key), strings.Add(desc.path) });
+
+	std::vector<MaterialRecord> materialRecords;
+	for (unsigned i = 0; i < _aiScene->mNumMaterials; ++i) {
+		const MaterialDesc desc = DescribeMaterial(_aiScene->mMaterials[i]);
+		MaterialRecord record = {};
+		record.name = strings.Add(desc.name);
+		record.attributes = desc.attributes;
+		for (unsigned s = 0; s < MTL_SLOT_COUNT; ++s) {
+			record.slots[s].key = strings.Add(desc.slots[s].key);
+			record.slots[s].used = desc.slots[s].used;
+			record.slots[s].constant = desc.slots[s].constant;
+			const Colour &c = desc.slots[s].value;
+			record.slots[s].value[0] = c.r;
+			record.slots[s].value[1] = c.g;
+			record.slots[s].value[2] = c.b;
+			record.slots[s].value[3] = c.a;
+		}
+		materialRecords.push_back(record);
+	}
+
+	//Lay out the file before writing anything
+	CacheHeader header = {};
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.sourceSize = _source.size;
+	header.sourceModified = _source.modified;
+	header.numMeshes = (uint32_t)meshRecords.size();
+	header.numTextures = (uint32_t)textureRecords.size();
+	header.numMaterials = (uint32_t)materialRecords.size();
+	header.stringBytes = (uint32_t)strings.blob.size();
+	header.meshes = Align(sizeof(CacheHeader), 16);
+	header.textures = Align(header.meshes + meshRecords.size() * sizeof(MeshRecord), 16);
+	header.materials = Align(header.textures + textureRecords.size() * sizeof(TextureRecord), 16);
+	header.strings = Align(header.materials + materialRecords.size() * sizeof(MaterialRecord), 16);
+	uint64_t offset = header.strings + header.stringBytes;
+	auto place = [&offset](const void *_buffer, const uint64_t _bytes) -> uint64_t {
+		if (!_buffer) return 0;
+		offset = Align(offset, bufferAlignment);
+		const uint64_t at = offset;
+		offset += _bytes;
+		return at;
+	};
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		const TriangleMesh *mesh = meshes[i];
+		MeshRecord &record = meshRecords[i];
+		record.vertices = place(mesh->vertices, mesh->numVertices * sizeof(Vec3));
+		record.triangles = place(mesh->triangles, mesh->numTriangles * sizeof(Triangle));
+		record.normals = place(mesh->vertexNormals, mesh->numVertices * sizeof(Vec3));
+		record.tangents = place(mesh->vertexTangents, mesh->numVertices * sizeof(Vec3));
+		record.uvs = place(mesh->textureCoordinates, mesh->numVertices * sizeof(Vec2));
+	}
+	header.fileSize = Align(offset, 16);	//Embree reads vertex buffers 16 bytes at a time
+
+	CacheWriter writer(_path);
+	if (!writer.out) {
+		std::cout << std::endl << "Could not write scene cache: " << _path;
+		return false;
+	}
+	writer.Write(&header, sizeof(CacheHeader));
+	writer.PadTo(header.meshes);
+	if (!meshRecords.empty()) writer.Write(meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+	writer.PadTo(header.textures);
+	if (!textureRecords.empty()) writer.Write(textureRecords.data(), textureRecords.size() * sizeof(TextureRecord));
+	writer.PadTo(header.materials);
+	if (!materialRecords.empty()) writer.Write(materialRecords.data(), materialRecords.size() * sizeof(MaterialRecord));
+	writer.PadTo(header.strings);
+	writer.Write(strings.blob.data(), header.stringBytes);
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		const TriangleMesh *mesh = meshes[i];
+		const MeshRecord &record = meshRecords[i];
+		auto buffer = [&writer](const void *_data, const uint64_t _at, const uint64_t _bytes) {
+			if (!_at) return;
+			writer.PadTo(_at);
+			writer.Write(_data, _bytes);
+		};
+		buffer(mesh->vertices, record.vertices, mesh->numVertices * sizeof(Vec3));
+		buffer(mesh->triangles, record.triangles, mesh->numTriangles * sizeof(Triangle));
+		buffer(mesh->vertexNormals, record.normals, mesh->numVertices * sizeof(Vec3));
+		buffer(mesh->vertexTangents, record.tangents, mesh->numVertices * sizeof(Vec3));
+		buffer(mesh->textureCoordinates, record.uvs, mesh->numVertices * sizeof(Vec2));
+	}
+	writer.PadTo(header.fileSize);
+	if (!writer.out) {
+		std::cout << std::endl << "Could not write scene cache: " << _path;
+		return false;
+	}
+	return true;
+}
+
+LAMBDA_END
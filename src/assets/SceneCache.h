@@ -0,0 +1,68 @@
+/*
+	Lambda's own binary scene format, written after an asset is imported through Assimp so later
+	runs can skip it. The file is memory-mapped and mesh buffers are used where they lie, so they
+	go to Embree without being copied.
+
+	Layout, all offsets from the start of the file:
+		- Header
+		- Mesh, texture and material records
+		- String table
+		- Mesh buffers, each aligned to a cache line
+*/
+#pragma once
+#include <utility/MappedFile.h>
+#include <utility/FileStamp.h>
+#include "MaterialImport.h"
+
+LAMBDA_BEGIN
+
+class SceneCache {
+	using ImportMetrics = ImportUtilities::ImportMetrics;
+	using SharedTask = ImportUtilities::SharedTask;
+
+	public:
+		/*
+			Maps the cache at _path. Fails if it is missing, damaged, or was made from a source file
+			whose size or last write time differs from _source.
+		*/
+		bool Open(const std::string &_path, const FileStamp &_source);
+
+		void Close();
+
+		inline bool IsOpen() const { return (bool)file; }
+
+		/*
+			Pushes meshes pointing into the mapped file to _resources, with their transforms.
+				- If _device is set each mesh is committed to it. Add these with Scene::AttachObject.
+		*/
+		bool PushMeshes(ResourceManager *_resources, ImportMetrics *_metrics, const RTCDevice _device = nullptr) const;
+
+		/*
+			Pushes the texture files the asset uses and queues their decoding on _pool.
+		*/
+		bool EnqueueTextures(ResourceManager *_resources, ImportMetrics *_metrics, ThreadPool *_pool, std::vector<SharedTask> *_tasks) const;
+
+		/*
+			Rebuilds the asset's materials. Their textures must already be in _resources.
+		*/
+		bool PushMaterials(ResourceManager *_resources, ImportMetrics *_metrics) const;
+
+		/*
+			Returns the material in _resources the mesh _name was imported with.
+		*/
+		Material *GetMaterial(const ResourceManager *_resources, const std::string &_name) const;
+
+		/*
+			Writes the meshes of _aiScene as they were pushed into _resources, and the textures and
+			materials _aiScene references, to _path.
+				- Assets with embedded textures can't be cached.
+		*/
+		static bool Write(const std::string &_path, const aiScene *_aiScene, const ResourceManager *_resources, const std::string &_directory, const FileStamp &_source);
+
+	private:
+		std::shared_ptr<MappedFile> file;
+
+		const char *String(const uint32_t _offset) const;
+};
+
+LAMBDA_END
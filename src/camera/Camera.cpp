@@ -34,13 +34,59 @@ void Camera::SetFov(const Real _fov) {
 	tanFov2 = 2 * tanFov;
 }
 
+bool Camera::Project(const Vec3 &_w, Vec2 *_uv, Real *_cosTheta) const {
+	const Real cosTheta = maths::Dot(_w, zHat);
+	if (cosTheta <= 0) return false;
+	//xHat and yHat aren't always unit, so project onto them and divide by their squared lengths
+	const Real a = maths::Dot(_w, xHat) / (cosTheta * maths::Dot(xHat, xHat));
+	const Real b = maths::Dot(_w, yHat) / (cosTheta * maths::Dot(yHat, yHat));
+	_uv->x = (1 - a / tanFov) * (Real).5;
+	_uv->y = (1 - b / (tanFov * aspect)) * (Real).5;
+	*_cosTheta = cosTheta;
+	return _uv->x >= 0 && _uv->x < 1 && _uv->y >= 0 && _uv->y < 1;
+}
+
+Real Camera::PdfPinhole(const Vec3 &_w) const {
+	Vec2 uv;
+	Real cosTheta;
+	if (!Project(_w, &uv, &cosTheta)) return 0;
+	return 1 / (FilmArea() * cosTheta * cosTheta * cosTheta);
+}
+
+bool Camera::ConnectPinhole(const Vec3 &_p, Vec2 *_uv, Vec3 *_lensPoint, Real *_We) const {
+	const Vec3 diff = _p - origin;
+	const Real distSq = maths::Dot(diff, diff);
+	if (distSq == 0) return false;
+	Real cosTheta;
+	if (!Project(diff / std::sqrt(distSq), _uv, &cosTheta)) return false;
+	*_lensPoint = origin;
+	*_We = 1 / (FilmArea() * cosTheta * cosTheta * cosTheta * distSq);	//Importance 1 / (A cos^4), times the cos at the lens over distance squared
+	return true;
+}
+
 //---------------- Pinhole Camera ----------------
 
 PinholeCamera::PinholeCamera(const Vec3 &_origin, const Real _x, const Real _y) : Camera(_origin, _x, _y) {}
 
 Ray PinholeCamera::GenerateRay(const Real _u, const Real _v, Sampler &_sampler) const {
-	const Vec3 p = origin + xHat * (_u * -tanFov2 + tanFov) + yHat * (_v * -tanFov2 * aspect + tanFov * aspect) + zHat;
-	return Ray(origin, (p - origin).Normalised());
+	return Ray(origin, FilmPoint(_u, _v).Normalised());
+}
+
+Ray PinholeCamera::GenerateRayDifferential(const Real _u, const Real _v, const Real _du, const Real _dv, Sampler &_sampler) const {
+	Ray r(origin, FilmPoint(_u, _v).Normalised());
+	r.rxOrigin = r.ryOrigin = origin;
+	r.rxDirection = FilmPoint(_u + _du, _v).Normalised();
+	r.ryDirection = FilmPoint(_u, _v + _dv).Normalised();
+	r.hasDifferentials = true;
+	return r;
+}
+
+bool PinholeCamera::ConnectPoint(const Vec3 &_p, Vec2 *_uv, Vec3 *_lensPoint, Real *_We) const {
+	return ConnectPinhole(_p, _uv, _lensPoint, _We);
+}
+
+Real PinholeCamera::PdfDirection(const Vec3 &_w) const {
+	return PdfPinhole(_w);
 }
 
 //---------------- Thin Lens Camera ----------------
@@ -51,12 +97,35 @@ ThinLensCamera::ThinLensCamera(const Vec3 &_origin, const Real _x, const Real _y
 }
 
 Ray ThinLensCamera::GenerateRay(const Real _u, const Real _v, Sampler &_sampler) const {
-	const Vec3 fp = origin + (xHat * (_u * -tanFov2 + tanFov) + yHat * (_v * -tanFov2 * aspect + tanFov * aspect) + zHat) * focalLength;
+	const Vec3 fp = origin + FilmPoint(_u, _v) * focalLength;
 	const Vec2 ap = aperture ? aperture->Sample_p(_sampler) : Vec2(0, 0);
 	const Vec3 o = origin + xHat * ap.x + yHat * ap.y;
 	return Ray(o, (fp - o).Normalised());
 }
 
+Ray ThinLensCamera::GenerateRayDifferential(const Real _u, const Real _v, const Real _du, const Real _dv, Sampler &_sampler) const {
+	const Vec2 ap = aperture ? aperture->Sample_p(_sampler) : Vec2(0, 0);
+	const Vec3 o = origin + xHat * ap.x + yHat * ap.y;
+	Ray r(o, (origin + FilmPoint(_u, _v) * focalLength - o).Normalised());
+
+	//Offset rays share the lens sample and focus on their own points of the focal plane
+	r.rxOrigin = r.ryOrigin = o;
+	r.rxDirection = (origin + FilmPoint(_u + _du, _v) * focalLength - o).Normalised();
+	r.ryDirection = (origin + FilmPoint(_u, _v + _dv) * focalLength - o).Normalised();
+	r.hasDifferentials = true;
+	return r;
+}
+
+bool ThinLensCamera::ConnectPoint(const Vec3 &_p, Vec2 *_uv, Vec3 *_lensPoint, Real *_We) const {
+	if (aperture && aperture->size > 0) return false;
+	return ConnectPinhole(_p, _uv, _lensPoint, _We);
+}
+
+Real ThinLensCamera::PdfDirection(const Vec3 &_w) const {
+	if (aperture && aperture->size > 0) return 0;
+	return PdfPinhole(_w);
+}
+
 //---------------- Spherical Camera ----------------
 
 SphericalCamera::SphericalCamera(const Vec3 &_origin) : Camera(_origin) {
@@ -64,10 +133,23 @@ SphericalCamera::SphericalCamera(const Vec3 &_origin) : Camera(_origin) {
 }
 
 Ray SphericalCamera::GenerateRay(const Real _u, const Real _v, Sampler &_sampler) const {
+	return Ray(origin, Direction(_u, _v));
+}
+
+Ray SphericalCamera::GenerateRayDifferential(const Real _u, const Real _v, const Real _du, const Real _dv, Sampler &_sampler) const {
+	Ray r(origin, Direction(_u, _v));
+	r.rxOrigin = r.ryOrigin = origin;
+	r.rxDirection = Direction(_u + _du, _v);
+	r.ryDirection = Direction(_u, _v + _dv);
+	r.hasDifferentials = true;
+	return r;
+}
+
+Vec3 SphericalCamera::Direction(const Real _u, const Real _v) const {
 	const Real phi = PI2 * _u + offsetPhi;
 	const Real theta = PI * _v + offsetTheta;
 	const Vec3 d = maths::SphericalDirection(std::sin(theta), std::cos(theta), phi).Normalised();
-	return Ray(origin, xHat * d.x + yHat * d.y + zHat * d.z);
+	return xHat * d.x + yHat * d.y + zHat * d.z;
 }
 
 LAMBDA_END
\ No newline at end of file
@@ -39,9 +39,61 @@ class Camera {
 		*/
 		virtual Ray GenerateRay(const Real _u, const Real _v, Sampler &_sampler) const = 0;
 
+		/*
+			As GenerateRay, with differentials for the rays _du and _dv further across the film.
+			Cameras that can't offset their rays return one without differentials.
+		*/
+		virtual Ray GenerateRayDifferential(const Real _u, const Real _v, const Real _du, const Real _dv, Sampler &_sampler) const {
+			return GenerateRay(_u, _v, _sampler);
+		}
+
+		/*
+			Connects world point _p to the camera for light tracing. Returns false if _p is outside the
+			view or the camera can't be connected to, otherwise sets the film coordinates _uv that see
+			_p, the point _lensPoint the connection leaves from and _We, the importance arriving at _p
+			per unit area there, excluding the cosine at _p.
+		*/
+		virtual bool ConnectPoint(const Vec3 &_p, Vec2 *_uv, Vec3 *_lensPoint, Real *_We) const {
+			return false;
+		}
+
+		/*
+			Solid angle pdf of GenerateRay() producing direction _w over uniform film coordinates.
+			0 for cameras that ConnectPoint() can't connect to.
+		*/
+		virtual Real PdfDirection(const Vec3 &_w) const {
+			return 0;
+		}
+
 	protected:
 		Vec3 xHat, yHat, zHat;
 		Real aspect, tanFov, tanFov2;
+
+		/*
+			ConnectPoint() and PdfDirection() for rays leaving origin through FilmPoint().
+		*/
+		bool ConnectPinhole(const Vec3 &_p, Vec2 *_uv, Vec3 *_lensPoint, Real *_We) const;
+
+		Real PdfPinhole(const Vec3 &_w) const;
+
+		/*
+			Film coordinates of unit direction _w from origin, false if it misses the film.
+		*/
+		bool Project(const Vec3 &_w, Vec2 *_uv, Real *_cosTheta) const;
+
+		/*
+			Point on the film plane a unit in front of the camera.
+		*/
+		inline Vec3 FilmPoint(const Real _u, const Real _v) const {
+			return xHat * (_u * -tanFov2 + tanFov) + yHat * (_v * -tanFov2 * aspect + tanFov * aspect) + zHat;
+		}
+
+		/*
+			Area of the film plane a unit in front of the camera.
+		*/
+		inline Real FilmArea() const {
+			return tanFov2 * xHat.Magnitude() * tanFov2 * aspect * yHat.Magnitude();
+		}
 };
 
 
@@ -54,6 +106,12 @@ class PinholeCamera : public Camera {
 			Returns a ray for film-plane coordinates, _u and _v.
 		*/
 		Ray GenerateRay(const Real _u, const Real _v, Sampler &_sampler) const override;
+
+		Ray GenerateRayDifferential(const Real _u, const Real _v, const Real _du, const Real _dv, Sampler &_sampler) const override;
+
+		bool ConnectPoint(const Vec3 &_p, Vec2 *_uv, Vec3 *_lensPoint, Real *_We) const override;
+
+		Real PdfDirection(const Vec3 &_w) const override;
 };
 
 
@@ -69,6 +127,15 @@ class ThinLensCamera : public Camera {
 			Returns a ray for film-plane coordinates, _u and _v.
 		*/
 		Ray GenerateRay(const Real _u, const Real _v, Sampler &_sampler) const override;
+
+		Ray GenerateRayDifferential(const Real _u, const Real _v, const Real _du, const Real _dv, Sampler &_sampler) const override;
+
+		/*
+			Only connects without an aperture, a lens sample would need a pdf the apertures don't give.
+		*/
+		bool ConnectPoint(const Vec3 &_p, Vec2 *_uv, Vec3 *_lensPoint, Real *_We) const override;
+
+		Real PdfDirection(const Vec3 &_w) const override;
 };
 
 
@@ -83,6 +150,11 @@ class SphericalCamera : public Camera {
 			Returns a ray for film-plane coordinates, _u and _v.
 		*/
 		Ray GenerateRay(const Real _u, const Real _v, Sampler &_sampler) const override;
+
+		Ray GenerateRayDifferential(const Real _u, const Real _v, const Real _du, const Real _dv, Sampler &_sampler) const override;
+
+	private:
+		Vec3 Direction(const Real _u, const Real _v) const;
 };
 
 LAMBDA_END
\ No newline at end of file
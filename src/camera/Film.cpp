@@ -1,19 +1,105 @@
 #include <iostream>
+#include <atomic>
 #include "Film.h"
 
 LAMBDA_BEGIN
 
-Film::Film(const unsigned _width, const unsigned _height) {
+FilmTile::FilmTile() {
+	x = y = w = h = 0;
+	pixels = nullptr;
+	filterTable = nullptr;
+}
+
+FilmTile::FilmTile(const Film &_film, const unsigned _x, const unsigned _y, const unsigned _w, const unsigned _h) {
+	filterTable = &_film.filterTable;
+	const unsigned border = (unsigned)std::ceil(std::max((Real)0, filterTable->radius - (Real).5));
+	x = _x > border ? _x - border : 0;
+	y = _y > border ? _y - border : 0;
+	w = std::min(_x + _w + border, _film.filmData.GetWidth()) - x;
+	h = std::min(_y + _h + border, _film.filmData.GetHeight()) - y;
+	pixels = AllocAligned<FilmPixel>(w * h);
+	Clear();
+}
+
+FilmTile::~FilmTile() {
+	if (pixels) FreeAligned(pixels);
+}
+
+void FilmTile::Clear() {
+	for (unsigned i = 0; i < w * h; ++i) {
+		pixels[i] = { Spectrum(0), 0, 0, 0, 0 };
+	}
+}
+
+/*
+	Lock-free add via compare-exchange, std::atomic<Real> shares Real's layout.
+*/
+template<class T>
+static inline void AtomicAdd(T &_dst, const T _v) {
+	std::atomic<T> &dst = reinterpret_cast<std::atomic<T> &>(_dst);
+	T old = dst.load(std::memory_order_relaxed);
+	while (!dst.compare_exchange_weak(old, old + _v, std::memory_order_relaxed));
+}
+
+template<class T>
+static inline T AtomicLoad(const T &_src) {
+	return reinterpret_cast<const std::atomic<T> &>(_src).load(std::memory_order_relaxed);
+}
+
+Film::Film(const unsigned _width, const unsigned _height, const Filter &_filter) {
 	filmData.Resize(_width, _height);
+	SetFilter(_filter);
 	Clear();
 }
 
+void Film::SetFilter(const Filter &_filter) {
+	filterTable = FilterTable(_filter);
+}
+
+void Film::MergeTile(FilmTile &_tile) {
+	for (unsigned y = _tile.y; y < _tile.y + _tile.h; ++y) {
+		for (unsigned x = _tile.x; x < _tile.x + _tile.w; ++x) {
+			const FilmPixel &src = _tile.GetPixel(x, y);
+			if (src.nSamples == 0 && src.weightSum == 0) continue;
+			FilmPixel &dst = filmData.GetPixelCoord(x, y);
+			for (unsigned i = 0; i < Spectrum::nSamples; ++i) AtomicAdd(dst.spectrum[i], src.spectrum[i]);
+			AtomicAdd(dst.lumSum, src.lumSum);
+			AtomicAdd(dst.lumSumSq, src.lumSumSq);
+			AtomicAdd(dst.weightSum, src.weightSum);
+			reinterpret_cast<std::atomic<unsigned> &>(dst.nSamples).fetch_add(src.nSamples, std::memory_order_relaxed);
+		}
+	}
+	_tile.Clear();
+}
+
+FilmPixel Film::GetPixelStatistics(const unsigned _x, const unsigned _y) const {
+	const FilmPixel &src = filmData.GetPixelCoord(_x, _y);
+	FilmPixel pixel;
+	pixel.nSamples = AtomicLoad(src.nSamples);
+	pixel.lumSum = AtomicLoad(src.lumSum);
+	pixel.lumSumSq = AtomicLoad(src.lumSumSq);
+	return pixel;
+}
+
+void Film::AddSplat(const Spectrum &_s, const Real _u, const Real _v) {
+	const unsigned w = filmData.GetWidth(), h = filmData.GetHeight();
+	//Pixel x covers u * w in [x - .5, x + .5), matching the tile renderers' sample offsets
+	const int x = (int)std::floor(_u * w + (Real).5), y = (int)std::floor(_v * h + (Real).5);
+	if (x < 0 || y < 0 || x >= (int)w || y >= (int)h) return;
+	Spectrum &dst = splats[(size_t)y * w + x];
+	for (unsigned i = 0; i < Spectrum::nSamples; ++i) AtomicAdd(dst[i], _s[i]);
+}
+
 void Film::ToRGBTexture(Texture *_output) const {
 	if (filmData.GetWidth() == _output->GetWidth() && filmData.GetHeight() == _output->GetHeight()) {
 		const size_t size = filmData.GetWidth() * filmData.GetHeight();
+		size_t totalSamples = 0;
+		for (size_t i = 0; i < size; ++i) totalSamples += filmData[i].nSamples;
+		const Real splatScale = totalSamples ? (Real)size / (Real)totalSamples : 0;
 		for (size_t i = 0; i < size; ++i) {
 			float xyz[3];
-			const Spectrum out = (Spectrum)(filmData[i].spectrum / (Real)filmData[i].nSamples);
+			Spectrum out = filmData[i].weightSum != 0 ? (Spectrum)(filmData[i].spectrum / filmData[i].weightSum) : Spectrum(0);
+			if (i < splats.size()) out += splats[i] * splatScale;
 			out.ToRGB(xyz);
 			Colour c(&xyz[0]);
 			c.a = 1;
@@ -25,8 +111,9 @@ void Film::ToRGBTexture(Texture *_output) const {
 
 void Film::Clear() {
 	for (unsigned i = 0; i < filmData.GetWidth() * filmData.GetHeight(); ++i) {
-		filmData[i] = { Spectrum(0), 0 };
+		filmData[i] = { Spectrum(0), 0, 0, 0, 0 };
 	}
+	splats.assign((size_t)filmData.GetWidth() * filmData.GetHeight(), Spectrum(0));
 }
 
 LAMBDA_END
\ No newline at end of file
@@ -1,40 +1,164 @@
 #pragma once
+#include <vector>
 #include <image/Texture.h>
 #include <core/Spectrum.h>
+#include <utility/Memory.h>
+#include "Filter.h"
 
 LAMBDA_BEGIN
 
 struct FilmPixel {
 	Spectrum spectrum = Spectrum(0);
 	unsigned nSamples = 0;
+	Real lumSum = 0, lumSumSq = 0;	//Luminance moments for the adaptive sampling error estimate
+	Real weightSum = 0;	//Sum of reconstruction filter weights splatted to this pixel
 
 	inline void ToRGB(Colour *_rgb) const {
 		spectrum.ToRGB((Real*)_rgb);
-		*_rgb /= nSamples;
+		*_rgb /= weightSum;
+	}
+
+	/*
+		Records a sample taken inside this pixel for the error estimate.
+	*/
+	inline void AddStatistics(const Spectrum &_s) {
+		const Real lum = _s.y();
+		nSamples++;
+		lumSum += lum;
+		lumSumSq += lum * lum;
+	}
+
+	/*
+		Estimated relative standard error of the pixel's mean luminance.
+	*/
+	inline Real RelativeError() const {
+		if (nSamples < 2) return INFINITY;
+		const Real mean = lumSum / nSamples;
+		const Real variance = std::max((Real)0, (lumSumSq - lumSum * mean) / (nSamples - 1));
+		return std::sqrt(variance / nSamples) / (mean + (Real).001);	//Offset keeps near-black pixels from never converging
 	}
 };
 
 typedef texture_t<FilmPixel> FilmData;
 
+class Film;
+
+/*
+	Tile-local accumulation buffer, cache line aligned and in scanline order. Tile renderers
+	add samples here and merge into the Film once at the end, so neighbouring tiles never
+	write to the same cache lines and the film's texel indexing is paid once per pixel.
+	The buffer extends past the tile by the film's filter radius so that samples near the
+	edge can splat into neighbouring tiles' pixels; those are resolved by the merge.
+*/
+class FilmTile {
+	public:
+		unsigned x, y, w, h;
+
+		FilmTile();
+
+		/*
+			Buffer for the tile at _x, _y of size _w, _h on _film, padded by _film's filter radius.
+		*/
+		FilmTile(const Film &_film, const unsigned _x, const unsigned _y, const unsigned _w, const unsigned _h);
+
+		FilmTile(const FilmTile &) = delete;
+		FilmTile &operator=(const FilmTile &) = delete;
+
+		~FilmTile();
+
+		/*
+			Adds a spectral sample to the pixel at film coordinates _x and _y, which must lie within the tile.
+		*/
+		inline void AddSample(const Spectrum &_s, const unsigned _x, const unsigned _y) {
+			FilmPixel &pixel = pixels[(_y - y) * w + (_x - x)];
+			pixel.AddStatistics(_s);
+			pixel.spectrum += _s;
+			pixel.weightSum += 1;
+		}
+
+		/*
+			Splats a sample taken at offset (_dx, _dy) from the centre of pixel _x, _y (in pixels)
+			to every pixel under the filter. One table lookup per covered pixel.
+		*/
+		inline void AddSample(const Spectrum &_s, const unsigned _x, const unsigned _y, const Real _dx, const Real _dy) {
+			pixels[(_y - y) * w + (_x - x)].AddStatistics(_s);
+			const Real r = filterTable->radius;
+			const int x0 = std::max((int)x, (int)_x + (int)std::ceil(_dx - r));
+			const int x1 = std::min((int)(x + w) - 1, (int)_x + (int)std::floor(_dx + r));
+			const int y0 = std::max((int)y, (int)_y + (int)std::ceil(_dy - r));
+			const int y1 = std::min((int)(y + h) - 1, (int)_y + (int)std::floor(_dy + r));
+			for (int py = y0; py <= y1; ++py) {
+				const Real fy = _dy - (Real)(py - (int)_y);
+				for (int px = x0; px <= x1; ++px) {
+					const Real weight = filterTable->Lookup(_dx - (Real)(px - (int)_x), fy);
+					FilmPixel &pixel = pixels[(py - y) * w + (px - x)];
+					pixel.spectrum += _s * weight;
+					pixel.weightSum += weight;
+				}
+			}
+		}
+
+		inline const FilmPixel &GetPixel(const unsigned _x, const unsigned _y) const {
+			return pixels[(_y - y) * w + (_x - x)];
+		}
+
+		/*
+			Resets all pixels in the tile to black.
+		*/
+		void Clear();
+
+	private:
+		FilmPixel *pixels;
+		const FilterTable *filterTable;
+};
+
 class Film {
 	public:
 		FilmData filmData;
+		FilterTable filterTable;
 
 		Film() {}
 
-		Film(const unsigned _width, const unsigned _height);
+		Film(const unsigned _width, const unsigned _height, const Filter &_filter = BoxFilter());
+
+		/*
+			Sets the pixel reconstruction filter. Should be called before render tiles are created.
+		*/
+		void SetFilter(const Filter &_filter);
 
 		/*
 			Adds a spectral sample to pixel at coordinates _x and _y.
 		*/
 		inline void AddSample(const Spectrum &_s, const unsigned _x, const unsigned _y) {
-			filmData.GetPixelCoord(_x, _y).spectrum += _s;
-			filmData.GetPixelCoord(_x, _y).nSamples++;
+			FilmPixel &pixel = filmData.GetPixelCoord(_x, _y);
+			pixel.AddStatistics(_s);
+			pixel.spectrum += _s;
+			pixel.weightSum += 1;
 		}
 
+		/*
+			Adds the contents of _tile to the film and clears _tile. Pixels are added atomically,
+			so tiles whose pixels overlap can be merged from different threads.
+		*/
+		void MergeTile(FilmTile &_tile);
+
+		/*
+			Copy of pixel _x, _y's sample count and luminance moments, for its error estimate. Read
+			with atomics like MergeTile() writes them, so it is safe while other tiles merge.
+			The spectrum and filter weight aren't copied.
+		*/
+		FilmPixel GetPixelStatistics(const unsigned _x, const unsigned _y) const;
+
+		/*
+			Adds a light tracing contribution at film-plane coordinates _u and _v. Safe to call from
+			several threads. Splats aren't filtered and are divided by the film's mean samples per
+			pixel when resolved, since every camera sample may trace one light path.
+		*/
+		void AddSplat(const Spectrum &_s, const Real _u, const Real _v);
+
 		/*
 			Converts the accumulation of spetral samples on the film plane to
-			the corresponding RGB counterparts divided by the sample count.
+			the corresponding RGB counterparts divided by the filter weight, plus any splats.
 		*/
 		void ToRGBTexture(Texture *_output) const;
 
@@ -42,6 +166,9 @@ class Film {
 			Clear the film. Resets all pixels samples to black. E.g. so it can be used again.
 		*/
 		void Clear();
+
+	private:
+		std::vector<Spectrum> splats;	//Scanline order, sized by Clear()
 };
 
 LAMBDA_END
\ No newline at end of file
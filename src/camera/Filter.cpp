@@ -0,0 +1,74 @@
+#include "Filter.h"
+
+LAMBDA_BEGIN
+
+BoxFilter::BoxFilter(const Real _radius) : Filter(_radius) {}
+
+Real BoxFilter::Evaluate(const Real _x, const Real _y) const {
+	return 1;
+}
+
+
+
+GaussianFilter::GaussianFilter(const Real _radius, const Real _alpha) : Filter(_radius) {
+	alpha = _alpha;
+	expR = std::exp(-alpha * radius * radius);
+}
+
+Real GaussianFilter::Gaussian(const Real _d) const {
+	return std::max((Real)0, std::exp(-alpha * _d * _d) - expR);	//Shifted so the filter reaches 0 at its radius
+}
+
+Real GaussianFilter::Evaluate(const Real _x, const Real _y) const {
+	return Gaussian(_x) * Gaussian(_y);
+}
+
+
+
+MitchellFilter::MitchellFilter(const Real _radius, const Real _B, const Real _C) : Filter(_radius) {
+	B = _B;
+	C = _C;
+}
+
+Real MitchellFilter::Mitchell1D(Real _x) const {
+	_x = std::abs(2 * _x / radius);	//Cubic is defined over [-2, 2]
+	if (_x > 2) return 0;
+	if (_x > 1) return ((-B - 6 * C) * _x * _x * _x + (6 * B + 30 * C) * _x * _x + (-12 * B - 48 * C) * _x + (8 * B + 24 * C)) * ((Real)1 / 6);
+	return ((12 - 9 * B - 6 * C) * _x * _x * _x + (-18 + 12 * B + 6 * C) * _x * _x + (6 - 2 * B)) * ((Real)1 / 6);
+}
+
+Real MitchellFilter::Evaluate(const Real _x, const Real _y) const {
+	return Mitchell1D(_x) * Mitchell1D(_y);
+}
+
+
+
+BlackmanHarrisFilter::BlackmanHarrisFilter(const Real _radius) : Filter(_radius) {}
+
+Real BlackmanHarrisFilter::BlackmanHarris1D(const Real _x) const {
+	if (std::abs(_x) > radius) return 0;
+	const Real t = PI2 * (_x + radius) / (2 * radius);
+	return (Real).35875 - (Real).48829 * std::cos(t) + (Real).14128 * std::cos(2 * t) - (Real).01168 * std::cos(3 * t);
+}
+
+Real BlackmanHarrisFilter::Evaluate(const Real _x, const Real _y) const {
+	return BlackmanHarris1D(_x) * BlackmanHarris1D(_y);
+}
+
+
+
+FilterTable::FilterTable() : FilterTable(BoxFilter()) {}
+
+FilterTable::FilterTable(const Filter &_filter) {
+	radius = _filter.radius;
+	invRadius = (Real)1 / radius;
+	for (unsigned y = 0; y < FILTER_TABLE_SIZE; ++y) {
+		for (unsigned x = 0; x < FILTER_TABLE_SIZE; ++x) {
+			const Real fx = ((Real)x + (Real).5) * radius / FILTER_TABLE_SIZE;	//Sample at the centre of each table cell
+			const Real fy = ((Real)y + (Real).5) * radius / FILTER_TABLE_SIZE;
+			weights[y * FILTER_TABLE_SIZE + x] = _filter.Evaluate(fx, fy);
+		}
+	}
+}
+
+LAMBDA_END
@@ -0,0 +1,98 @@
+/*
+	Pixel reconstruction filters.
+
+	Filters are evaluated at offsets from a pixel centre, in pixels. The film never calls
+	Evaluate() while rendering; it bakes the filter into a FilterTable once and looks the
+	weight up from there.
+*/
+
+#pragma once
+#include <Lambda.h>
+#include <maths/maths.h>
+
+LAMBDA_BEGIN
+
+class Filter {
+	public:
+		Real radius;
+
+		Filter(const Real _radius) : radius(_radius) {}
+
+		/*
+			Filter weight at offset (_x, _y) from the pixel centre.
+		*/
+		virtual Real Evaluate(const Real _x, const Real _y) const = 0;
+};
+
+/*
+	Equivalent to the film's original behaviour when the radius is .5.
+*/
+class BoxFilter : public Filter {
+	public:
+		BoxFilter(const Real _radius = .5);
+
+		Real Evaluate(const Real _x, const Real _y) const override;
+};
+
+class GaussianFilter : public Filter {
+	public:
+		Real alpha;
+
+		GaussianFilter(const Real _radius = 1.5, const Real _alpha = 2);
+
+		Real Evaluate(const Real _x, const Real _y) const override;
+
+	private:
+		Real expR;
+
+		Real Gaussian(const Real _d) const;
+};
+
+/*
+	Mitchell-Netravali cubic. Has negative lobes, so pixel weights can be negative.
+*/
+class MitchellFilter : public Filter {
+	public:
+		Real B, C;
+
+		MitchellFilter(const Real _radius = 2, const Real _B = 1. / 3., const Real _C = 1. / 3.);
+
+		Real Evaluate(const Real _x, const Real _y) const override;
+
+	private:
+		Real Mitchell1D(Real _x) const;
+};
+
+class BlackmanHarrisFilter : public Filter {
+	public:
+		BlackmanHarrisFilter(const Real _radius = 2);
+
+		Real Evaluate(const Real _x, const Real _y) const override;
+
+	private:
+		Real BlackmanHarris1D(const Real _x) const;
+};
+
+constexpr unsigned FILTER_TABLE_SIZE = 16;
+
+/*
+	Filter weights over one quadrant of the filter's support. Filters are symmetric,
+	so a lookup only needs the absolute offset.
+*/
+struct FilterTable {
+	Real radius, invRadius;
+	Real weights[FILTER_TABLE_SIZE * FILTER_TABLE_SIZE];
+
+	FilterTable();
+
+	FilterTable(const Filter &_filter);
+
+	inline Real Lookup(const Real _x, const Real _y) const {
+		if (std::abs(_x) >= radius || std::abs(_y) >= radius) return 0;	//Support is open, a box of radius .5 mustn't reach the next pixel
+		const unsigned ix = std::min((unsigned)(std::abs(_x) * invRadius * FILTER_TABLE_SIZE), FILTER_TABLE_SIZE - 1);
+		const unsigned iy = std::min((unsigned)(std::abs(_y) * invRadius * FILTER_TABLE_SIZE), FILTER_TABLE_SIZE - 1);
+		return weights[iy * FILTER_TABLE_SIZE + ix];
+	}
+};
+
+LAMBDA_END
@@ -39,6 +39,8 @@ void Instance::ProcessHit(const RTCRayHit &_rtcHit, RayHit &_hit) const {
 		TransformNormal(&_hit.normalS);
 		TransformNormal(&_hit.tangent);
 		TransformNormal(&_hit.bitangent);
+		TransformVector(&_hit.dpdu);
+		TransformVector(&_hit.dpdv);
 	}
 }
 
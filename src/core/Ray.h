@@ -18,6 +18,13 @@ class Ray {
 		Real eta;
 		Vec3 o, d;
 
+		/*
+			Offset rays one pixel across and down the film, set for camera rays. They give the
+			footprint of the ray on whatever it hits, which textures use to pick a filter width.
+		*/
+		bool hasDifferentials = false;
+		Vec3 rxOrigin, ryOrigin, rxDirection, ryDirection;
+
 		Ray() {}
 
 		Ray(const Vec3 &_o, const Vec3 &_d) {
@@ -45,14 +52,58 @@ class Ray {
 		inline Vec3 operator()(const Real _t) const {
 			return o + d * _t;
 		}
+
+		/*
+			Scales the differentials by _s, e.g. 1 / sqrt(spp) so each sample covers its share of
+			the pixel.
+		*/
+		inline void ScaleDifferentials(const Real _s) {
+			rxOrigin = o + (rxOrigin - o) * _s;
+			ryOrigin = o + (ryOrigin - o) * _s;
+			rxDirection = d + (rxDirection - d) * _s;
+			ryDirection = d + (ryDirection - d) * _s;
+		}
 };
 
 struct RayHit {
 	Vec3 point, normalG, normalS, tangent, bitangent;
+	Vec3 dpdu, dpdv;	//Change in position along the texture coordinates, zero if there are none
+	Vec3 dpdx, dpdy;	//Change in position to the neighbouring pixels
+	Real dudx = 0, dvdx = 0, dudy = 0, dvdy = 0;
 	Vec2 uvCoords;
 	Object *object;
 	Real tFar = INFINITY;
 	unsigned primId;
+
+	/*
+		Finds the screen space derivatives by intersecting _ray's differentials with the tangent
+		plane at the hit. They are zero when _ray has no differentials.
+	*/
+	inline void ComputeDifferentials(const Ray &_ray) {
+		dudx = dvdx = dudy = dvdy = 0;
+		dpdx = dpdy = Vec3(0, 0, 0);
+		if (!_ray.hasDifferentials) return;
+		const Real d = maths::Dot(normalG, point);
+		const Real cx = maths::Dot(normalG, _ray.rxDirection);
+		const Real cy = maths::Dot(normalG, _ray.ryDirection);
+		if (cx == 0 || cy == 0) return;
+		const Real tx = (d - maths::Dot(normalG, _ray.rxOrigin)) / cx;
+		const Real ty = (d - maths::Dot(normalG, _ray.ryOrigin)) / cy;
+		if (!std::isfinite(tx) || !std::isfinite(ty)) return;
+		dpdx = _ray.rxOrigin + _ray.rxDirection * tx - point;
+		dpdy = _ray.ryOrigin + _ray.ryDirection * ty - point;
+
+		//Least squares solve of dp = dpdu * du + dpdv * dv
+		const Real ata00 = maths::Dot(dpdu, dpdu), ata01 = maths::Dot(dpdu, dpdv), ata11 = maths::Dot(dpdv, dpdv);
+		const Real invDet = 1 / (ata00 * ata11 - ata01 * ata01);
+		if (!std::isfinite(invDet)) return;
+		const Real atb0x = maths::Dot(dpdu, dpdx), atb1x = maths::Dot(dpdv, dpdx);
+		const Real atb0y = maths::Dot(dpdu, dpdy), atb1y = maths::Dot(dpdv, dpdy);
+		dudx = maths::Clamp((ata11 * atb0x - ata01 * atb1x) * invDet, (Real)-1e8, (Real)1e8);
+		dvdx = maths::Clamp((ata00 * atb1x - ata01 * atb0x) * invDet, (Real)-1e8, (Real)1e8);
+		dudy = maths::Clamp((ata11 * atb0y - ata01 * atb1y) * invDet, (Real)-1e8, (Real)1e8);
+		dvdy = maths::Clamp((ata00 * atb1y - ata01 * atb0y) * invDet, (Real)-1e8, (Real)1e8);
+	}
 };
 
 LAMBDA_END
\ No newline at end of file
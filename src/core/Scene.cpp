@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <lighting/EnvironmentLight.h>
 #include "Scene.h"
 
@@ -23,6 +24,14 @@ void Scene::Commit(const RTCBuildQuality _buildQuality) {
 		envLight->radius = envLight->bounds.MaxLength();
 	}
 	lightSampler->Commit();
+	CompileMaterials();
+}
+
+void Scene::CompileMaterials() {
+	++ShaderGraph::valueEpoch;	//Node values may have been edited since the last pass
+	for (Object *obj : objects) {
+		if (obj->material && !obj->material->IsCompiled()) obj->material->Compile();
+	}
 }
 
 bool Scene::Intersect(const Ray &_ray, RayHit &_hit) const {
@@ -32,16 +41,83 @@ bool Scene::Intersect(const Ray &_ray, RayHit &_hit) const {
 	rtcInitIntersectContext(&context);
 	context.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
 	rtcIntersect1(scene, &context, &rayHit);
-	if (rayHit.hit.geomID != RTC_INVALID_GEOMETRY_ID && rayHit.ray.tfar > 0 && rayHit.ray.tfar < INFINITY) {
-		objects[rayHit.hit.geomID]->Hit(rayHit, _hit);
-		if (rayHit.hit.instID[0] != RTC_INVALID_GEOMETRY_ID) _hit.object = objects[rayHit.hit.instID[0]];
-		else _hit.object = objects[rayHit.hit.geomID];
-		_hit.primId = rayHit.hit.primID;
+	if (!ResolveHit(rayHit, _hit)) return false;
+	_hit.ComputeDifferentials(_ray);
+	return true;
+}
+
+bool Scene::ResolveHit(const RTCRayHit &_rayHit, RayHit &_hit) const {
+	if (_rayHit.hit.geomID != RTC_INVALID_GEOMETRY_ID && _rayHit.ray.tfar > 0 && _rayHit.ray.tfar < INFINITY) {
+		objects[_rayHit.hit.geomID]->Hit(_rayHit, _hit);
+		if (_rayHit.hit.instID[0] != RTC_INVALID_GEOMETRY_ID) _hit.object = objects[_rayHit.hit.instID[0]];
+		else _hit.object = objects[_rayHit.hit.geomID];
+		_hit.primId = _rayHit.hit.primID;
 		return true;
 	}
 	return false;
 }
 
+/*
+	Packet helpers. Lanes past the end of the input are left invalid.
+*/
+static inline void SetPacketLane(RTCRay16 &_packet, const unsigned _lane, const Vec3 &_o, const Vec3 &_d, const Real _tfar) {
+	_packet.org_x[_lane] = _o.x;
+	_packet.org_y[_lane] = _o.y;
+	_packet.org_z[_lane] = _o.z;
+	_packet.dir_x[_lane] = _d.x;
+	_packet.dir_y[_lane] = _d.y;
+	_packet.dir_z[_lane] = _d.z;
+	_packet.tnear[_lane] = 0;
+	_packet.tfar[_lane] = _tfar;
+	_packet.mask[_lane] = 0xFFFFFFFF;
+	_packet.time[_lane] = 0;
+	_packet.id[_lane] = _lane;
+	_packet.flags[_lane] = 0;
+}
+
+static inline RTCRayHit GetPacketLane(const RTCRayHit16 &_packet, const unsigned _lane) {
+	RTCRayHit rayHit;
+	rayHit.ray.org_x = _packet.ray.org_x[_lane];
+	rayHit.ray.org_y = _packet.ray.org_y[_lane];
+	rayHit.ray.org_z = _packet.ray.org_z[_lane];
+	rayHit.ray.dir_x = _packet.ray.dir_x[_lane];
+	rayHit.ray.dir_y = _packet.ray.dir_y[_lane];
+	rayHit.ray.dir_z = _packet.ray.dir_z[_lane];
+	rayHit.ray.tnear = _packet.ray.tnear[_lane];
+	rayHit.ray.tfar = _packet.ray.tfar[_lane];
+	rayHit.hit.Ng_x = _packet.hit.Ng_x[_lane];
+	rayHit.hit.Ng_y = _packet.hit.Ng_y[_lane];
+	rayHit.hit.Ng_z = _packet.hit.Ng_z[_lane];
+	rayHit.hit.u = _packet.hit.u[_lane];
+	rayHit.hit.v = _packet.hit.v[_lane];
+	rayHit.hit.primID = _packet.hit.primID[_lane];
+	rayHit.hit.geomID = _packet.hit.geomID[_lane];
+	for (unsigned l = 0; l < RTC_MAX_INSTANCE_LEVEL_COUNT; ++l) rayHit.hit.instID[l] = _packet.hit.instID[l][_lane];
+	return rayHit;
+}
+
+void Scene::Intersect(const Ray *_rays, RayHit *_hits, bool *_intersected, const unsigned _n, const bool _coherent) const {
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	context.flags = _coherent ? RTC_INTERSECT_CONTEXT_FLAG_COHERENT : RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+	alignas(64) RTCRayHit16 packet;
+	alignas(64) int valid[16];
+	for (unsigned i = 0; i < _n; i += 16) {
+		const unsigned m = std::min(16u, _n - i);
+		for (unsigned j = 0; j < 16; ++j) {
+			valid[j] = j < m ? -1 : 0;
+			if (j < m) SetPacketLane(packet.ray, j, _rays[i + j].o, _rays[i + j].d, INFINITY);
+			packet.hit.geomID[j] = RTC_INVALID_GEOMETRY_ID;
+			packet.hit.instID[0][j] = RTC_INVALID_GEOMETRY_ID;
+		}
+		rtcIntersect16(valid, scene, &context, &packet);
+		for (unsigned j = 0; j < m; ++j) {
+			_intersected[i + j] = ResolveHit(GetPacketLane(packet, j), _hits[i + j]);
+			if (_intersected[i + j]) _hits[i + j].ComputeDifferentials(_rays[i + j]);
+		}
+	}
+}
+
 bool Scene::IntersectTr(Ray _r, RayHit &_hit, Sampler &_sampler, Medium *_med, Spectrum *_Tr) const {
 	Real tFar = 0;
 	while (Intersect(_r, _hit)) {
@@ -106,6 +182,43 @@ bool Scene::RayEscapes(const Ray &_ray) const {
 	return eRay.tfar != -INFINITY;
 }
 
+void Scene::MutualVisibility(const Vec3 *_p1, const Vec3 *_p2, bool *_visible, const unsigned _n) const {
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	context.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+	alignas(64) RTCRay16 packet;
+	alignas(64) int valid[16];
+	for (unsigned i = 0; i < _n; i += 16) {
+		const unsigned m = std::min(16u, _n - i);
+		for (unsigned j = 0; j < 16; ++j) {
+			valid[j] = j < m ? -1 : 0;
+			if (j < m) {
+				const Vec3 diff = _p2[i + j] - _p1[i + j];
+				const Real mag = diff.Magnitude();
+				SetPacketLane(packet, j, _p1[i + j], diff / mag, mag - .00001);
+			}
+		}
+		rtcOccluded16(valid, scene, &context, &packet);
+		for (unsigned j = 0; j < m; ++j) _visible[i + j] = packet.tfar[j] != -INFINITY;
+	}
+}
+
+void Scene::RayEscapes(const Ray *_rays, bool *_escapes, const unsigned _n) const {
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	alignas(64) RTCRay16 packet;
+	alignas(64) int valid[16];
+	for (unsigned i = 0; i < _n; i += 16) {
+		const unsigned m = std::min(16u, _n - i);
+		for (unsigned j = 0; j < 16; ++j) {
+			valid[j] = j < m ? -1 : 0;
+			if (j < m) SetPacketLane(packet, j, _rays[i + j].o, _rays[i + j].d, INFINITY);
+		}
+		rtcOccluded16(valid, scene, &context, &packet);
+		for (unsigned j = 0; j < m; ++j) _escapes[i + j] = packet.tfar[j] != -INFINITY;
+	}
+}
+
 void Scene::AddLight(Light *_light) {
 	if (EnvironmentLight *l = dynamic_cast<EnvironmentLight *>(_light)) envLight = l;
 	lights.push_back(_light);
@@ -113,6 +226,10 @@ void Scene::AddLight(Light *_light) {
 
 void Scene::AddObject(Object *_obj, const bool _addLight) {
 	_obj->Commit(device);
+	AttachObject(_obj, _addLight);
+}
+
+void Scene::AttachObject(Object *_obj, const bool _addLight) {
 	rtcAttachGeometryByID(scene, _obj->geometry, objects.size());
 	objects.push_back(_obj);
 	if (_addLight && _obj->material->light) {
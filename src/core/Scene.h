@@ -26,6 +26,11 @@ class Scene {
 	protected:
 		RTCScene scene;
 
+		/*
+			Converts an Embree hit to _hit, returns false if nothing was hit.
+		*/
+		bool ResolveHit(const RTCRayHit &_rayHit, RayHit &_hit) const;
+
 	public:
 		RTCDevice device;
 		std::vector<Object*> objects; //Root(s) of object tree.
@@ -54,6 +59,13 @@ class Scene {
 		*/
 		bool Intersect(const Ray &_ray, RayHit &_hit) const;
 
+		/*
+			Queries _n rays against scene geometry in packets of 16.
+				- _intersected[i] is set to whether _rays[i] hit anything, with hit information passed to _hits[i].
+				- _coherent should be set for ray sets with similar origins and directions (e.g. camera rays).
+		*/
+		void Intersect(const Ray *_rays, RayHit *_hits, bool *_intersected, const unsigned _n, const bool _coherent = false) const;
+
 		/*
 			Queries _ray against scene geometry, ignoring pure volumes and returning beam transmittance to _Tr.
 		*/
@@ -70,11 +82,28 @@ class Scene {
 		bool MutualVisibility(const Vec3 &_p1, const Vec3 &_p2, Vec3 *_w) const;
 		bool MutualVisibility(const Vec3 &_p1, const Vec3 &_p2) const;
 
+		/*
+			Mutual visibility of _n point pairs in packets of 16. Result written to _visible.
+		*/
+		void MutualVisibility(const Vec3 *_p1, const Vec3 *_p2, bool *_visible, const unsigned _n) const;
+
 		/*
 			Returns true if _ray intersects no geometry within the scene.
 		*/
 		bool RayEscapes(const Ray &_ray) const;
 
+		/*
+			RayEscapes for _n rays in packets of 16. Result written to _escapes.
+		*/
+		void RayEscapes(const Ray *_rays, bool *_escapes, const unsigned _n) const;
+
+		/*
+			Recompiles the shader graphs of any materials whose graphs have changed and starts a
+			new value epoch. Called by Commit() and between progressive passes, never while tiles
+			are rendering.
+		*/
+		void CompileMaterials();
+
 		/*
 			Explicitly adds _light to the lighting distribution without adding
 			intersectable geometry.
@@ -87,6 +116,12 @@ class Scene {
 		*/
 		void AddObject(Object *_obj, const bool _addLight = true);
 
+		/*
+			Adds _obj to scene geometry without committing it, for objects already committed to device
+			(e.g. by MeshImport::EnqueueMeshes).
+		*/
+		void AttachObject(Object *_obj, const bool _addLight = true);
+
 		/*
 			Removes object by index.
 		*/
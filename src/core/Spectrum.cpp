@@ -200,4 +200,55 @@ Real InterpolateSpectrumSamples(const Real *_lambda, const Real *_vals, const un
 	return maths::Lerp(_vals[offset], _vals[offset + 1], t);
 }
 
+/*
+	CIE matching functions at _lambda, the tables are at 1nm intervals.
+*/
+static inline void MatchingFunctions(const Real _lambda, Real _xyz[3]) {
+	using namespace CIEData;
+	const Real f = maths::Clamp(_lambda - CIE_lambda[0], (Real)0, (Real)(nCIESamples - 2));
+	const unsigned i = (unsigned)f;
+	const Real t = f - (Real)i;
+	_xyz[0] = maths::Lerp(CIE_X[i], CIE_X[i + 1], t);
+	_xyz[1] = maths::Lerp(CIE_Y[i], CIE_Y[i + 1], t);
+	_xyz[2] = maths::Lerp(CIE_Z[i], CIE_Z[i + 1], t);
+}
+
+/*
+	RGB of a constant 1 spectrum over the sampled range, used to keep white white.
+*/
+static const Real *WhiteRGB() {
+	static const struct White {
+		Real rgb[3];
+		White() {
+			Real xyz[3] = { 0, 0, 0 };
+			for (unsigned l = sampledLambdaStart; l < sampledLambdaEnd; ++l) {
+				Real cmf[3];
+				MatchingFunctions((Real)l + (Real).5, cmf);
+				for (unsigned j = 0; j < 3; ++j) xyz[j] += cmf[j] / CIEData::CIE_Y_integral;
+			}
+			SpectrumUtils::XYZToRGB(xyz, rgb);
+		}
+	} white;
+	return white.rgb;
+}
+
+SampledWavelength SampledWavelength::Sample(const Real _u) {
+	const Real range = (Real)(sampledLambdaEnd - sampledLambdaStart);
+	SampledWavelength wl;
+	wl.lambda = (Real)sampledLambdaStart + _u * range;
+	wl.pdf = (Real)1 / range;
+	return wl;
+}
+
+RGBSpectrum SampledWavelength::Weight() const {
+	Real xyz[3], rgb[3];
+	MatchingFunctions(lambda, xyz);
+	const Real scale = (Real)1 / (pdf * CIEData::CIE_Y_integral);
+	for (unsigned j = 0; j < 3; ++j) xyz[j] *= scale;
+	SpectrumUtils::XYZToRGB(xyz, rgb);
+	const Real *white = WhiteRGB();
+	for (unsigned j = 0; j < 3; ++j) rgb[j] /= white[j];
+	return RGBSpectrum::FromRGB(rgb);
+}
+
 LAMBDA_END
\ No newline at end of file
@@ -4,6 +4,8 @@
 #pragma once
 #include <vector>
 #include <omp.h>
+#include <type_traits>
+#include <maths/simd.h>
 #include "SPD_Data.h"
 
 LAMBDA_BEGIN
@@ -68,31 +70,19 @@ class CoefficientSpectrum {
 
 		CoefficientSpectrum operator+(const CoefficientSpectrum &_s) const {
 			CoefficientSpectrum tmp = *this;
-			#pragma omp simd
-			for (unsigned i = 0; i < spectrumSamples; ++i)
-				tmp[i] += _s[i];
-			return tmp;
+			return tmp += _s;
 		}
 		CoefficientSpectrum operator-(const CoefficientSpectrum &_s) const {
 			CoefficientSpectrum tmp = *this;
-			#pragma omp simd
-			for (unsigned i = 0; i < spectrumSamples; ++i)
-				tmp[i] -= _s[i];
-			return tmp;
+			return tmp -= _s;
 		}
 		CoefficientSpectrum operator*(const CoefficientSpectrum &_s) const {
 			CoefficientSpectrum tmp = *this;
-			#pragma omp simd
-			for (unsigned i = 0; i < spectrumSamples; ++i)
-				tmp[i] *= _s[i];
-			return tmp;
+			return tmp *= _s;
 		}
 		CoefficientSpectrum operator/(const CoefficientSpectrum &_s) const {
 			CoefficientSpectrum tmp = *this;
-			#pragma omp simd
-			for (unsigned i = 0; i < spectrumSamples; ++i)
-				tmp[i] /= _s[i];
-			return tmp;
+			return tmp /= _s;
 		}
 		CoefficientSpectrum operator+(const Real _s) const {
 			CoefficientSpectrum tmp = *this;
@@ -132,6 +122,7 @@ class CoefficientSpectrum {
 		}
 
 		bool IsBlack() const {
+			if (useKernels) return maths::simd::GetKernels().isBlack((const float *)c, spectrumSamples);
 			#pragma omp simd
 			for (unsigned i = 0; i < spectrumSamples; ++i)
 				if (c[i] != 0) return false;
@@ -151,6 +142,10 @@ class CoefficientSpectrum {
 
 		static CoefficientSpectrum Sqrt(const CoefficientSpectrum &_s) {
 			CoefficientSpectrum tmp;
+			if (useKernels) {
+				maths::simd::GetKernels().sqrt((const float *)_s.c, (float *)tmp.c, spectrumSamples);
+				return tmp;
+			}
 			#pragma omp simd
 			for (unsigned i = 0; i < spectrumSamples; ++i)
 				tmp.c[i] = std::sqrt(_s.c[i]);
@@ -164,6 +159,10 @@ class CoefficientSpectrum {
 		}
 		static CoefficientSpectrum Exp(const CoefficientSpectrum &_s) {
 			CoefficientSpectrum tmp;
+			if (useExpKernel) {
+				maths::simd::GetKernels().exp((const float *)_s.c, (float *)tmp.c, spectrumSamples);
+				return tmp;
+			}
 			#pragma omp simd
 			for (unsigned i = 0; i < spectrumSamples; ++i)
 				tmp.c[i] = std::exp(_s.c[i]);
@@ -179,6 +178,12 @@ class CoefficientSpectrum {
 
 	protected:
 		Real c[spectrumSamples];
+
+		//Measured by test/simd_bench: the compiler vectorises the fixed length arithmetic loops better
+		//than an out of line kernel call at any length, but not sqrt, early out IsBlack or dot, so
+		//long spectra use the kernels for those. Exp beats std::exp even for RGB, so always uses them.
+		static const bool useKernels = spectrumSamples >= 16 && std::is_same<Real, float>::value;
+		static const bool useExpKernel = std::is_same<Real, float>::value;
 };
 
 extern bool SpectrumSamplesSorted(const Real* _lambda, const Real* _vals, const unsigned _n);
@@ -217,19 +222,14 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
 
 		// Luminance measure of this SampledSpectrum
 		Real y() const {
-			Real yy = 0.;
-			for (unsigned i = 0; i < nSpectralSamples; ++i)
-				yy = Y[i] * c[i];
+			const Real yy = Dot(Y);
 			return yy * (Real)(sampledLambdaEnd - sampledLambdaStart) / (Real)(CIEData::CIE_Y_integral * nSpectralSamples);
 		}
 
 		void ToXYZ(Real _xyz[3]) const {
-			_xyz[0] = _xyz[1] = _xyz[2] = 0.;
-			for (unsigned i = 0; i < nSpectralSamples; ++i) {
-				_xyz[0] = X[i] * c[i];
-				_xyz[1] = Y[i] * c[i];
-				_xyz[2] = Z[i] * c[i];
-			}
+			_xyz[0] = Dot(X);
+			_xyz[1] = Dot(Y);
+			_xyz[2] = Dot(Z);
 			const Real scale = (Real)(sampledLambdaEnd - sampledLambdaStart) / (Real)(CIEData::CIE_Y_integral * nSpectralSamples);
 			_xyz[0] *= scale;
 			_xyz[1] *= scale;
@@ -298,6 +298,14 @@ class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
 		SampledSpectrum(const RGBSpectrum &_r, SpectrumType _type = SpectrumType::Reflectance);
 
 	private:
+		Real Dot(const SampledSpectrum &_s) const {
+			if (useKernels) return maths::simd::GetKernels().dot((const float *)c, (const float *)_s.c, nSpectralSamples);
+			Real r = 0.;
+			for (unsigned i = 0; i < nSpectralSamples; ++i)
+				r += _s[i] * c[i];
+			return r;
+		}
+
 		static SampledSpectrum X, Y, Z, rgbRefl2SpectWhite, rgbRefl2SpectCyan, rgbRefl2SpectMagenta, rgbRefl2SpectYellow,
 		rgbRefl2SpectRed, rgbRefl2SpectGreen, rgbRefl2SpectBlue, rgbIllum2SpectWhite, rgbIllum2SpectCyan,
 		rgbIllum2SpectMagenta, rgbIllum2SpectYellow, rgbIllum2SpectRed, rgbIllum2SpectGreen, rgbIllum2SpectBlue; 
@@ -373,4 +381,24 @@ class alignas(16) RGBSpectrum : public CoefficientSpectrum<3> {
 		}
 };
 
+/*
+	A wavelength sampled for a path that meets a dispersive surface. Transport stays RGB: the
+	first dispersive event weights the path by the wavelength's colour and every later one
+	refracts at the same wavelength.
+*/
+struct SampledWavelength {
+	Real lambda, pdf;
+	bool resolved = false;	//The path has been weighted by Weight()
+
+	/*
+		Samples a wavelength uniformly in the visible range with _u.
+	*/
+	static SampledWavelength Sample(const Real _u);
+
+	/*
+		RGB throughput weight of the wavelength, a white path stays white in expectation.
+	*/
+	RGBSpectrum Weight() const;
+};
+
 LAMBDA_END
\ No newline at end of file
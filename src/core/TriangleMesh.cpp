@@ -40,11 +40,14 @@ void TriangleMesh::AllocData(const size_t _numVertices, const size_t _numTriangl
 }
 
 void TriangleMesh::FreeData() {
-	if(vertices) delete[] vertices;
-	if(vertexNormals) delete[] vertexNormals;
-	if(vertexTangents) delete[] vertexTangents;
-	if(textureCoordinates) delete[] textureCoordinates;
-	if(triangles) delete[] triangles;
+	if (!externalData) {
+		if(vertices) delete[] vertices;
+		if(vertexNormals) delete[] vertexNormals;
+		if(vertexTangents) delete[] vertexTangents;
+		if(textureCoordinates) delete[] textureCoordinates;
+		if(triangles) delete[] triangles;
+	}
+	externalData.reset();
 	vertices = nullptr;
 	vertexNormals = nullptr;
 	vertexTangents = nullptr;
@@ -78,12 +81,25 @@ Real TriangleMesh::Area() const {
 }
 
 void TriangleMesh::ProcessHit(const RTCRayHit &_h, RayHit &_hit) const {
+	_hit.dpdu = _hit.dpdv = Vec3(0, 0, 0);
 	if (textureCoordinates) {
-		_hit.uvCoords = maths::BarycentricInterpolation(
-			textureCoordinates[triangles[_h.hit.primID].v0],
-			textureCoordinates[triangles[_h.hit.primID].v1],
-			textureCoordinates[triangles[_h.hit.primID].v2],
-			_h.hit.u, _h.hit.v);
+		const Triangle &tri = triangles[_h.hit.primID];
+		const Vec2 &uv0 = textureCoordinates[tri.v0];
+		const Vec2 &uv1 = textureCoordinates[tri.v1];
+		const Vec2 &uv2 = textureCoordinates[tri.v2];
+		_hit.uvCoords = maths::BarycentricInterpolation(uv0, uv1, uv2, _h.hit.u, _h.hit.v);
+
+		//Position derivatives for texture filtering, left at zero for degenerate uvs
+		const Real du02 = uv0.x - uv2.x, dv02 = uv0.y - uv2.y;
+		const Real du12 = uv1.x - uv2.x, dv12 = uv1.y - uv2.y;
+		const Real det = du02 * dv12 - dv02 * du12;
+		if (std::abs(det) > (Real)1e-12) {
+			const Real invDet = 1 / det;
+			const Vec3 dp02 = vertices[tri.v0] - vertices[tri.v2];
+			const Vec3 dp12 = vertices[tri.v1] - vertices[tri.v2];
+			_hit.dpdu = (dp02 * dv12 - dp12 * dv02) * invDet;
+			_hit.dpdv = (dp12 * du02 - dp02 * du12) * invDet;
+		}
 	}
 	if (smoothNormals) {
 		const Vec3 &n0 = vertexNormals[triangles[_h.hit.primID].v0];
@@ -3,6 +3,7 @@
 */
 
 #pragma once
+#include <memory>
 #include <vector>
 #include "Object.h"
 
@@ -20,6 +21,7 @@ class TriangleMesh : public Object {
 		size_t numTriangles;
 		size_t numVertices;
 		bool smoothNormals;
+		std::shared_ptr<const void> externalData;	//Owner of buffers the mesh only points into, e.g. a mapped scene cache
 
 		TriangleMesh();
 
@@ -38,7 +40,7 @@ class TriangleMesh : public Object {
 		void AllocData(const size_t _numVertices, const size_t _numTriangles);
 
 		/*
-			Free mesh data from memory.
+			Free mesh data from memory. Buffers held by externalData are only released.
 		*/
 		void FreeData();
 
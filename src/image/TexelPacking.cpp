@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <cmath>
+#include "TexelPacking.h"
+#include "Texture.h"
+
+
+LAMBDA_BEGIN
+
+namespace {
+
+	struct GammaTable {
+		float values[256];
+
+		GammaTable() {
+			for (unsigned i = 0; i < 256; ++i) values[i] = std::pow((float)i / 255.f, 1.f / GAMMA_POW);
+		}
+	};
+
+	const GammaTable gammaTable;
+}
+
+const float *const TexelPacking::gammaToLinear = gammaTable.values;
+
+uint16_t TexelPacking::FloatToHalf(const float _f) {
+	uint32_t x;
+	memcpy(&x, &_f, sizeof(float));
+	const uint16_t sign = (x >> 16) & 0x8000;
+	if ((x & 0x7FFFFFFF) > 0x7F800000) return sign | 0x7E00;	//NaN
+	const int exp = (int)((x >> 23) & 0xFF) - 127 + 15;
+	uint32_t mant = x & 0x7FFFFF;
+	if (exp >= 31) return sign | 0x7C00;	//Overflows to infinity
+	if (exp <= 0) {
+		if (exp < -10) return sign;
+		mant |= 0x800000;
+		const unsigned shift = 14 - exp;
+		uint16_t h = (uint16_t)(mant >> shift);
+		if ((mant >> (shift - 1)) & 1) ++h;
+		return sign | h;
+	}
+	uint16_t h = sign | (uint16_t)(exp << 10) | (uint16_t)(mant >> 13);
+	if (mant & 0x1000) ++h;	//Rounding may carry into the exponent, which is still correct
+	return h;
+}
+
+uint8_t TexelPacking::LinearToGamma8(const float _v) {
+	const float g = std::pow(std::min(std::max(_v, 0.f), 1.f), GAMMA_POW) * 255.f;
+	return (uint8_t)std::min(255.f, g + .5f);
+}
+
+uint32_t TexelPacking::EncodeRGB9E5(const float _r, const float _g, const float _b) {
+	const float maxValue = (float)0x1FF / 512 * 65536;
+	const float r = std::min(std::max(_r, 0.f), maxValue);
+	const float g = std::min(std::max(_g, 0.f), maxValue);
+	const float b = std::min(std::max(_b, 0.f), maxValue);
+	const float maxRGB = std::max(r, std::max(g, b));
+	int exp = std::max(-16, (int)std::floor(std::log2(std::max(maxRGB, 1e-30f)))) + 1 + 15;
+	float denom = std::ldexp(1.f, exp - 15 - 9);
+	if ((uint32_t)std::floor(maxRGB / denom + .5f) == 512) {
+		denom *= 2;
+		++exp;
+	}
+	const uint32_t rm = (uint32_t)std::floor(r / denom + .5f);
+	const uint32_t gm = (uint32_t)std::floor(g / denom + .5f);
+	const uint32_t bm = (uint32_t)std::floor(b / denom + .5f);
+	return rm | (gm << 9) | (bm << 18) | ((uint32_t)exp << 27);
+}
+
+LAMBDA_END
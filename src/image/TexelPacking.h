@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <Lambda.h>
+
+
+LAMBDA_BEGIN
+
+/*
+	Compact texel formats and the conversions to and from float. Decoding is cheap enough to run
+	on every fetch.
+*/
+enum class TexelFormat {
+	RGBA32F,	//Colour as loaded
+	RGBA8,	//Gamma encoded colour, linear alpha
+	RGBA16F,	//Half float colour and alpha
+	RGB9E5,	//Shared exponent, non-negative colour without alpha
+	R8,	//Gamma encoded grey
+	R16	//Linear grey in [0, 1]
+};
+
+namespace TexelPacking {
+
+	/*
+		Linear values of 8 bit gamma encoded channels, with the same curve images are loaded with.
+	*/
+	extern const float *const gammaToLinear;
+
+	inline unsigned TexelBytes(const TexelFormat _format) {
+		switch (_format) {
+		case TexelFormat::RGBA8: return 4;
+		case TexelFormat::RGBA16F: return 8;
+		case TexelFormat::RGB9E5: return 4;
+		case TexelFormat::R8: return 1;
+		case TexelFormat::R16: return 2;
+		default: return 16;
+		}
+	}
+
+	inline float HalfToFloat(const uint16_t _h) {
+		const uint32_t sign = (uint32_t)(_h & 0x8000) << 16;
+		uint32_t exp = (_h >> 10) & 0x1F;
+		uint32_t mant = _h & 0x3FF;
+		uint32_t bits;
+		if (exp == 0) {
+			if (mant == 0) bits = sign;
+			else {	//Subnormal, renormalise
+				exp = 1;
+				while (!(mant & 0x400)) {
+					mant <<= 1;
+					--exp;
+				}
+				bits = sign | ((exp + 112) << 23) | ((mant & 0x3FF) << 13);
+			}
+		}
+		else if (exp == 31) bits = sign | 0x7F800000 | (mant << 13);
+		else bits = sign | ((exp + 112) << 23) | (mant << 13);
+		float f;
+		memcpy(&f, &bits, sizeof(float));
+		return f;
+	}
+
+	uint16_t FloatToHalf(const float _f);
+
+	uint8_t LinearToGamma8(const float _v);
+
+	inline uint16_t LinearToUnorm16(const float _v) {
+		return (uint16_t)(std::min(std::max(_v, 0.f), 1.f) * 65535.f + .5f);
+	}
+
+	/*
+		Three 9 bit mantissas sharing a 5 bit exponent. Negative values clamp to zero.
+	*/
+	uint32_t EncodeRGB9E5(const float _r, const float _g, const float _b);
+
+	inline void DecodeRGB9E5(const uint32_t _v, float *_rgb) {
+		const int exp = (int)(_v >> 27) - 15 - 9;
+		const uint32_t scaleBits = (uint32_t)(exp + 127) << 23;	//2^exp, exp is always a normal float exponent
+		float scale;
+		memcpy(&scale, &scaleBits, sizeof(float));
+		_rgb[0] = (float)(_v & 0x1FF) * scale;
+		_rgb[1] = (float)((_v >> 9) & 0x1FF) * scale;
+		_rgb[2] = (float)((_v >> 18) & 0x1FF) * scale;
+	}
+}
+
+LAMBDA_END
@@ -49,9 +49,28 @@ Texture Texture::Copy(const Texture &_texture) {
 	Texture copy;
 	copy.width = _texture.width;
 	copy.height = _texture.height;
-	copy.encoding = _texture.encoding;
-	copy.data.reset(new Colour[_texture.width * _texture.height]);
+	copy.interpolation = _texture.interpolation;
+	copy.ldrSource = _texture.ldrSource;
+	if (_texture.tiled) {	//Texels live in the cache, so share them
+		copy.tiled = _texture.tiled;
+		copy.data.reset();
+		return copy;
+	}
+	if (_texture.IsPacked()) {
+		copy.format = _texture.format;
+		copy.data.reset();
+		copy.CopyMips(_texture);
+		const unsigned bytes = TexelPacking::TexelBytes(_texture.format);
+		for (unsigned l = 0; l < _texture.NumLevels(); ++l) {
+			const size_t size = PackedEncoding::Size(_texture.LevelWidth(l), _texture.LevelHeight(l)) * bytes;
+			copy.packed.emplace_back(new uint8_t[size]);
+			memcpy(copy.packed.back().get(), _texture.packed[l].get(), size);
+		}
+		return copy;
+	}
+	copy.data.reset(new Colour[(size_t)_texture.width * _texture.height]);
 	memcpy(&copy.data[0], &_texture.data[0], sizeof(Colour) * _texture.width * _texture.height);
+	copy.CopyMips(_texture);
 	return copy;
 }
 
@@ -83,11 +102,13 @@ void Texture::SaveToImageFile(const char *_path, const bool _gammaCorrect, const
 void Texture::ParseData(float *_data, const int _channels) {
 	for (unsigned y = 0; y < height; ++y) {
 		for (unsigned x = 0; x < width; ++x) {
-			const int r = width * y * _channels + x * _channels;
-			const int g = _channels > 1 ? r + 1 : 0;
-			const int b = _channels > 2 ? r + 2 : 0;
-			const int a = _channels > 3 ? r + 3 : 0;
-			SetPixelCoord(x, y, Colour(&_data[r], _channels > 3));
+			const float *t = &_data[width * y * _channels + x * _channels];
+			switch (_channels) {	//Grey images are spread over rgb and missing alpha is opaque
+			case 1: SetPixelCoord(x, y, Colour(t[0], t[0], t[0], 1)); break;
+			case 2: SetPixelCoord(x, y, Colour(t[0], t[0], t[0], t[1])); break;
+			case 3: SetPixelCoord(x, y, Colour(t[0], t[1], t[2], 1)); break;
+			default: SetPixelCoord(x, y, Colour(t[0], t[1], t[2], t[3])); break;
+			}
 		}
 	}
 }
@@ -96,6 +117,7 @@ void Texture::LoadImageFile(const char *_path, int _channels) {
 	int file_width, file_height;
 	if (stbi_info(_path, &file_width, &file_height, nullptr)) {
 		Resize(file_width, file_height);
+		ldrSource = !stbi_is_hdr(_path);
 		printf("\nLoading %s", _path);
 		int w = width, h = height;
 		float *data = stbi_loadf(_path, &w, &h, &_channels, 0);
@@ -111,11 +133,105 @@ void Texture::LoadImageFile(const char *_path, int _channels) {
 	else printf("\nImage file not found: %s", _path);
 }
 
+bool Texture::LoadTiled(const char *_path, TextureCache &_cache) {
+	std::shared_ptr<TiledImage> image = _cache.Open(_path);
+	if (!image) return false;
+	ClearStorage();
+	tiled = image;
+	width = image->width;
+	height = image->height;
+	data.reset();
+	mips.clear();
+	printf("\nOpened tiled texture: %s", image->path.c_str());
+	return true;
+}
+
+void Texture::Pack(const TexelFormat _format) {
+	if (tiled || IsPacked() || _format == TexelFormat::RGBA32F) return;
+	const unsigned bytes = TexelPacking::TexelBytes(_format);
+	packed.clear();
+	for (unsigned l = 0; l < NumLevels(); ++l) {
+		const unsigned w = LevelWidth(l), h = LevelHeight(l);
+		std::unique_ptr<uint8_t[]> level(new uint8_t[PackedEncoding::Size(w, h) * bytes]);
+		for (unsigned y = 0; y < h; ++y) {
+			for (unsigned x = 0; x < w; ++x) {
+				const Colour c = texture_t<Colour>::LevelTexel(l, x, y);
+				uint8_t *t = &level[PackedEncoding::Index(w, h, x, y) * bytes];
+				switch (_format) {
+				case TexelFormat::RGBA8:
+					t[0] = TexelPacking::LinearToGamma8(c.r);
+					t[1] = TexelPacking::LinearToGamma8(c.g);
+					t[2] = TexelPacking::LinearToGamma8(c.b);
+					t[3] = (uint8_t)(maths::Clamp(c.a, 0.f, 1.f) * 255.f + .5f);
+					break;
+				case TexelFormat::RGBA16F: {
+					const uint16_t half[4] = { TexelPacking::FloatToHalf(c.r), TexelPacking::FloatToHalf(c.g), TexelPacking::FloatToHalf(c.b), TexelPacking::FloatToHalf(c.a) };
+					memcpy(t, half, sizeof(half));
+					break;
+				}
+				case TexelFormat::RGB9E5: {
+					const uint32_t v = TexelPacking::EncodeRGB9E5(c.r, c.g, c.b);
+					memcpy(t, &v, sizeof(v));
+					break;
+				}
+				case TexelFormat::R8:
+					t[0] = TexelPacking::LinearToGamma8(c.r);
+					break;
+				default: {
+					const uint16_t v = TexelPacking::LinearToUnorm16(c.r);
+					memcpy(t, &v, sizeof(v));
+					break;
+				}
+				}
+			}
+		}
+		packed.push_back(std::move(level));
+	}
+	format = _format;
+	data.reset();
+	for (MipLevel &level : mips) level.data.reset();
+}
+
+TexelFormat Texture::ChooseFormat() const {
+	if (tiled) return TexelFormat::RGBA32F;
+	bool grey = true, opaque = true, unit = true, nonNegative = true;
+	for (unsigned y = 0; y < height; ++y) {
+		for (unsigned x = 0; x < width; ++x) {
+			const Colour c = GetPixelCoord(x, y);
+			grey &= c.r == c.g && c.g == c.b;
+			opaque &= c.a == 1;
+			nonNegative &= std::isfinite(c.r) && std::isfinite(c.g) && std::isfinite(c.b) && c.r >= 0 && c.g >= 0 && c.b >= 0;
+			unit &= nonNegative && c.r <= 1 && c.g <= 1 && c.b <= 1;
+		}
+	}
+	if (ldrSource) return grey && opaque ? TexelFormat::R8 : TexelFormat::RGBA8;
+	if (grey && opaque && unit) return TexelFormat::R16;
+	if (opaque && nonNegative) return TexelFormat::RGB9E5;
+	return TexelFormat::RGBA16F;
+}
+
+void Texture::Compact() {
+	if (tiled || IsPacked()) return;
+	Pack(ChooseFormat());
+}
+
+size_t Texture::TexelMemory() const {
+	if (tiled) return 0;
+	size_t bytes = 0;
+	for (unsigned l = 0; l < NumLevels(); ++l) {
+		if (IsPacked()) bytes += PackedEncoding::Size(LevelWidth(l), LevelHeight(l)) * TexelPacking::TexelBytes(format);
+		else bytes += (size_t)LevelWidth(l) * LevelHeight(l) * sizeof(Colour);
+	}
+	return bytes;
+}
+
 void Texture::LoadFromMemory(const void *_src, const int _size, const int _channels) {
 	int w, h;
 	printf("\nLoading texture: %p", _src);
+	ldrSource = !stbi_is_hdr_from_memory((const stbi_uc *)_src, _size);
 	float *data = stbi_loadf_from_memory((const stbi_uc *)_src, _size, &w, &h, nullptr, _channels);
 	if (data) {
+		Resize(w, h);
 		ParseData(data, _channels);
 		printf("\nLoaded texture.");
 	}
@@ -1,66 +1,48 @@
 // Sam Warren 2021
 #pragma once
 #include <algorithm>
+#include <cassert>
 #include <memory>
 #include <vector>
 #include <maths/maths.h>
 #include "Colour.h"
 #include "TextureEncoding.h"
-
-/* Use BMI instructions for Hilbert encoding (faster). */
-#define USE_BMI_INSTRUCTIONS
-
-#ifdef USE_BMI_INSTRUCTIONS
-#include <immintrin.h>
-#endif
-
+#include "TextureCache.h"
+#include "TextureFilter.h"
+#include "TexelPacking.h"
 
 LAMBDA_BEGIN
 
 constexpr float GAMMA_POW = 1 / 2.2;
 
+/*
+	Trilinear and EWA filter over the footprint passed to GetPixelUV and need mips to do better
+	than bilinear. Without a footprint they are bilinear.
+*/
 enum class InterpolationMode {
 	INTERP_NEAREST,
 	INTERP_BILINEAR,
-	INTERP_BICUBIC
-};
-
-enum class EncodingMode {
-	ENCODE_SCANLINEROW,
-	ENCODE_SCANLINECOL,
-	ENCODE_MORTON,
-	ENCODE_HILBERT,
+	INTERP_BICUBIC,
+	INTERP_TRILINEAR,
+	INTERP_EWA
 };
 
-template<class Type>
+/*
+	Texels are stored in the order given by Encoding, one of the layouts in TextureEncoding.
+	GetData() and operator[] expose that order directly, so only scanline textures can be
+	handed to code expecting rows.
+*/
+template<class Type, class Encoding = TextureEncoding::ScanlineRow>
 class texture_t {
 	protected:
+		struct MipLevel {
+			unsigned width, height;
+			std::unique_ptr<Type[]> data;	//Same encoding as the full-size image
+		};
+
 		unsigned width, height;
 		std::unique_ptr<Type[]> data;
-
-		/* width, height = 2^n */
-		static inline size_t MortonOrder(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
-			#ifdef USE_BMI_INSTRUCTIONS
-				static const uint64_t x2Mask = 0xAAAAAAAAAAAAAAAA;
-				static const uint64_t y2Mask = 0x5555555555555555;
-				return _pdep_u64(_y, y2Mask) | _pdep_u64(_x, x2Mask);
-			#else
-				return TextureEncoding::ShiftInterleave(_x) | (TextureEncoding::ShiftInterleave(_y) << 1);
-			#endif
-		}
-
-		/* width = height = 2^n */
-		static inline size_t HilbertOrder(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
-			return TextureEncoding::HilbertXYToIndex(_w, _x, _y);
-		}
-
-		static inline size_t ScanlineRowOrder(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
-			return _y * _w + _x;
-		}
-
-		static inline size_t ScanlineColOrder(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
-			return _x * _h + _y;
-		}
+		std::vector<MipLevel> mips;	//Levels after the full-size image, empty until GenerateMips()
 
 		inline Type GetPixelUVNearest(const float _u, const float _v) const {
 			const unsigned int x = std::min((float)(width - 1), maths::Clamp(_u, 0.f, 1.f) * (float)width);
@@ -80,16 +62,52 @@ class texture_t {
 			return maths::Lerp(ya, yb, fy - (float)y);
 		}
 
+		/*
+			Lookup on any mip source with texture space derivatives along the screen axes.
+		*/
+		template<class Source>
+		static inline Type Filtered(const Source &_src, const InterpolationMode _mode, const float _u, const float _v,
+			const float _dudx, const float _dvdx, const float _dudy, const float _dvdy) {
+			switch (_mode) {
+			case InterpolationMode::INTERP_NEAREST:
+				return TextureFilter::Nearest<Type>(_src, 0, _u, _v);
+			case InterpolationMode::INTERP_BILINEAR:
+				return TextureFilter::Bilinear<Type>(_src, 0, _u, _v);
+			case InterpolationMode::INTERP_BICUBIC:
+				return TextureFilter::Bicubic<Type>(_src, 0, _u, _v);
+			case InterpolationMode::INTERP_TRILINEAR: {
+				const float w = 2 * std::max(std::max(std::abs(_dudx), std::abs(_dudy)), std::max(std::abs(_dvdx), std::abs(_dvdy)));
+				return TextureFilter::Trilinear<Type>(_src, _u, _v, w);
+			}
+			default:
+				return TextureFilter::EWA<Type>(_src, _u, _v, _dudx, _dvdx, _dudy, _dvdy);
+			}
+		}
+
+		void CopyMips(const texture_t<Type, Encoding> &_texture) {
+			mips.clear();
+			for (const MipLevel &level : _texture.mips) {
+				MipLevel copy;
+				copy.width = level.width;
+				copy.height = level.height;
+				if (level.data) {	//Levels of packed textures only keep their size here
+					const size_t size = Encoding::Size(level.width, level.height);
+					copy.data.reset(new Type[size]);
+					std::copy_n(&level.data[0], size, &copy.data[0]);
+				}
+				mips.push_back(std::move(copy));
+			}
+		}
+
 	public:
 		InterpolationMode interpolation = InterpolationMode::INTERP_BILINEAR;
-		EncodingMode encoding = EncodingMode::ENCODE_SCANLINEROW;
 
-		texture_t<Type>(const unsigned _width = 1, const unsigned _height = 1, const Type & _c = Type()) {
+		texture_t(const unsigned _width = 1, const unsigned _height = 1, const Type & _c = Type()) {
 			Resize(_width, _height, _c);
 		}
 
 		template<class Type2>
-		texture_t<Type>(const texture_t<Type2> &_texture) {
+		texture_t(const texture_t<Type2> &_texture) {
 			if (width > _texture.width && height > _texture.height) {
 				for (unsigned y = 0; y < width; ++y) {
 					for (unsigned x = 0; x < width; ++x) {
@@ -99,13 +117,15 @@ class texture_t {
 			}
 		}
 
-		static texture_t<Type> Copy(const texture_t<Type> &_texture) {
-			texture_t<Type> copy;
+		static texture_t<Type, Encoding> Copy(const texture_t<Type, Encoding> &_texture) {
+			texture_t<Type, Encoding> copy;
 			copy.width = _texture.width;
 			copy.height = _texture.height;
-			copy.encoding = _texture.encoding;
-			copy.data.reset(new Type[_texture.width * _texture.height]);
-			memcpy(&copy.data[0], &_texture.data[0], sizeof(Type) * _texture.width * _texture.height);
+			copy.interpolation = _texture.interpolation;
+			const size_t size = Encoding::Size(_texture.width, _texture.height);
+			copy.data.reset(new Type[size]);
+			memcpy(&copy.data[0], &_texture.data[0], sizeof(Type) * size);
+			copy.CopyMips(_texture);
 			return copy;
 		}
 
@@ -119,34 +139,60 @@ class texture_t {
 		inline void Resize(const unsigned _width, const unsigned _height, const Type &_c = Type()) {
 			width = _width;
 			height = _height;
-			data.reset(new Type[width * height]);
-			std::fill_n(&data[0], width * height, _c);
+			data.reset(new Type[Encoding::Size(width, height)]);
+			std::fill_n(&data[0], Encoding::Size(width, height), _c);
+			mips.clear();
 		}
 
-		inline Type GetPixelCoord(const unsigned _x, const unsigned _y) const {
-			switch (encoding) {
-			case EncodingMode::ENCODE_SCANLINEROW:
-				return data[ScanlineRowOrder(width, height, _x, _y)];
-			case EncodingMode::ENCODE_SCANLINECOL:
-				return data[ScanlineColOrder(width, height, _x, _y)];
-			case EncodingMode::ENCODE_HILBERT:
-				return data[HilbertOrder(width, height, _x, _y)];
-			case EncodingMode::ENCODE_MORTON:
-				return data[MortonOrder(width, height, _x, _y)];
+		/*
+			Builds the mip pyramid by box filtering each level down from the last, halving (rounding
+			down) until 1x1. Must be called again if the texels change.
+		*/
+		void GenerateMips() {
+			mips.clear();
+			unsigned w = width, h = height;
+			while (w > 1 || h > 1) {
+				const unsigned l = NumLevels() - 1;
+				MipLevel down;
+				down.width = std::max(1u, w / 2);
+				down.height = std::max(1u, h / 2);
+				down.data.reset(new Type[Encoding::Size(down.width, down.height)]);
+				for (unsigned y = 0; y < down.height; ++y) {
+					const unsigned y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+					for (unsigned x = 0; x < down.width; ++x) {
+						const unsigned x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+						const Type sum = LevelTexel(l, x0, y0) + LevelTexel(l, x1, y0) + LevelTexel(l, x0, y1) + LevelTexel(l, x1, y1);
+						down.data[Encoding::Index(down.width, down.height, x, y)] = sum * .25f;
+					}
+				}
+				w = down.width;
+				h = down.height;
+				mips.push_back(std::move(down));
 			}
 		}
 
-		inline Type &GetPixelCoord(const unsigned _x, const unsigned _y) {
-			switch (encoding) {
-			case EncodingMode::ENCODE_SCANLINEROW:
-				return data[ScanlineRowOrder(width, height, _x, _y)];
-			case EncodingMode::ENCODE_SCANLINECOL:
-				return data[ScanlineColOrder(width, height, _x, _y)];
-			case EncodingMode::ENCODE_HILBERT:
-				return data[HilbertOrder(width, height, _x, _y)];
-			case EncodingMode::ENCODE_MORTON:
-				return data[MortonOrder(width, height, _x, _y)];
+		inline bool HasMips() const { return !mips.empty(); }
+
+		inline unsigned NumLevels() const { return 1 + (unsigned)mips.size(); }
+
+		inline unsigned LevelWidth(const unsigned _level) const { return _level ? mips[_level - 1].width : width; }
+
+		inline unsigned LevelHeight(const unsigned _level) const { return _level ? mips[_level - 1].height : height; }
+
+		inline Type LevelTexel(const unsigned _level, const unsigned _x, const unsigned _y) const {
+			if (_level) {
+				const MipLevel &level = mips[_level - 1];
+				return level.data[Encoding::Index(level.width, level.height, _x, _y)];
 			}
+			return GetPixelCoord(_x, _y);
+		}
+
+		inline Type GetPixelCoord(const unsigned _x, const unsigned _y) const {
+			return data[Encoding::Index(width, height, _x, _y)];
+		}
+
+		inline Type &GetPixelCoord(const unsigned _x, const unsigned _y) {
+			return data[Encoding::Index(width, height, _x, _y)];
 		}
 
 		inline void SetPixelCoord(const unsigned _x, const unsigned _y, const Type &_c) {
@@ -160,13 +206,22 @@ class texture_t {
 			switch (interpolation) {
 			case InterpolationMode::INTERP_NEAREST :
 				return GetPixelUVNearest(_u, _v);
-			case InterpolationMode::INTERP_BILINEAR :
-				return GetPixelUVBilinear(_u, _v);
+			case InterpolationMode::INTERP_BICUBIC :
+				return TextureFilter::Bicubic<Type>(*this, 0, _u, _v);
 			default:
-				return GetPixelUVNearest(_u, _v);
+				return GetPixelUVBilinear(_u, _v);
 			}
 		}
 
+		/*
+			Lookup filtered over the footprint given by the derivatives of _u and _v along the
+			screen axes, e.g. from RayHit.
+		*/
+		inline Type GetPixelUV(const float _u, const float _v, const float _dudx, const float _dvdx, const float _dudy, const float _dvdy) const {
+			if (interpolation == InterpolationMode::INTERP_NEAREST || interpolation == InterpolationMode::INTERP_BILINEAR) return GetPixelUV(_u, _v);
+			return Filtered(*this, interpolation, _u, _v, _dudx, _dvdx, _dudy, _dvdy);
+		}
+
 		inline void *GetData() {
 			return (void *)&data[0];
 		}
@@ -175,9 +230,78 @@ class texture_t {
 
 class Texture : public texture_t<Colour> {
 	private:
+		/*
+			Packed levels are stored in 4x4 blocks, so an RGBA8 bilinear footprint inside a block is one
+			cache line. Only edge blocks are padded, unlike Morton order which pads to a power of two
+			square (test/texture_layout_bench).
+		*/
+		typedef TextureEncoding::Block<4> PackedEncoding;
+
+		std::vector<std::unique_ptr<uint8_t[]>> packed;	//Level 0 then each mip, when format isn't RGBA32F
+
 		void ParseData(float *_data, const int _channels);
 
+		/*
+			Drops packed and tiled texels so the texture holds floats again.
+		*/
+		inline void ClearStorage() {
+			tiled.reset();
+			packed.clear();
+			format = TexelFormat::RGBA32F;
+		}
+
+		inline bool HasFloatTexels() const { return !tiled && !IsPacked(); }
+
+		inline Colour Unpack(const unsigned _level, const unsigned _x, const unsigned _y) const {
+			const uint8_t *p = packed[_level].get();
+			const size_t i = PackedEncoding::Index(LevelWidth(_level), LevelHeight(_level), _x, _y);
+			switch (format) {
+			case TexelFormat::RGBA8: {
+				const uint8_t *t = p + i * 4;
+				return Colour(TexelPacking::gammaToLinear[t[0]], TexelPacking::gammaToLinear[t[1]], TexelPacking::gammaToLinear[t[2]], t[3] * (1.f / 255));
+			}
+			case TexelFormat::RGBA16F: {
+				uint16_t h[4];
+				memcpy(h, p + i * 8, sizeof(h));
+				return Colour(TexelPacking::HalfToFloat(h[0]), TexelPacking::HalfToFloat(h[1]), TexelPacking::HalfToFloat(h[2]), TexelPacking::HalfToFloat(h[3]));
+			}
+			case TexelFormat::RGB9E5: {
+				uint32_t v;
+				memcpy(&v, p + i * 4, sizeof(v));
+				float rgb[3];
+				TexelPacking::DecodeRGB9E5(v, rgb);
+				return Colour(rgb[0], rgb[1], rgb[2]);
+			}
+			case TexelFormat::R8: {
+				const float v = TexelPacking::gammaToLinear[p[i]];
+				return Colour(v, v, v, 1);
+			}
+			default: {
+				uint16_t v;
+				memcpy(&v, p + i * 2, sizeof(v));
+				const float f = v * (1.f / 65535);
+				return Colour(f, f, f, 1);
+			}
+			}
+		}
+
 	public:
+		/*
+			Set when texels are paged in through a TextureCache rather than held in memory.
+		*/
+		std::shared_ptr<TiledImage> tiled;
+
+		/*
+			How texels are held. Anything but RGBA32F is decoded on fetch and is read only.
+		*/
+		TexelFormat format = TexelFormat::RGBA32F;
+
+		/*
+			Set when loaded from an 8 bit image, so texels sit exactly on the gamma table and
+			RGBA8 and R8 are lossless.
+		*/
+		bool ldrSource = false;
+
 		Texture(const unsigned _w = 1, const unsigned _h = 1, const Colour &_c = Colour());
 
 		static Texture Copy(const Texture &_texture);
@@ -191,6 +315,112 @@ class Texture : public texture_t<Colour> {
 		void LoadImageFile(const char *_path, int _channels = 4);
 
 		void LoadFromMemory(const void *_src, const int _size, const int _channels = 4);
+
+		/*
+			Opens _path through _cache instead of loading it, so only the tiles that get sampled
+			are ever read. Returns false if the image couldn't be opened.
+		*/
+		bool LoadTiled(const char *_path, TextureCache &_cache = TextureCache::Default());
+
+		inline bool IsTiled() const { return (bool)tiled; }
+
+		inline bool IsPacked() const { return format != TexelFormat::RGBA32F; }
+
+		/*
+			Re-encodes every level in _format and frees the float texels. Mips must be generated
+			first. Does nothing to tiled or already packed textures.
+				- Nothing packs textures implicitly, the owner opts in, e.g. with IMP_COMPACT_TEXTURES.
+				- Afterwards only lookups work, GetData(), writes and GenerateMips() assert.
+		*/
+		void Pack(const TexelFormat _format);
+
+		/*
+			Smallest format that holds the texels without visible loss: R8 or RGBA8 for 8 bit
+			images, R16 for other grey images in [0, 1], RGB9E5 for opaque non-negative colour
+			and RGBA16F for anything else.
+		*/
+		TexelFormat ChooseFormat() const;
+
+		/*
+			Packs in ChooseFormat(). Safe to call on textures that are already packed or tiled.
+		*/
+		void Compact();
+
+		/*
+			Bytes held in memory for texels, including mips.
+		*/
+		size_t TexelMemory() const;
+
+		/*
+			Resizes texture and clears all texels to _c, dropping any packed or tiled storage.
+		*/
+		inline void Resize(const unsigned _width, const unsigned _height, const Colour &_c = Colour()) {
+			ClearStorage();
+			texture_t<Colour>::Resize(_width, _height, _c);
+		}
+
+		inline void GenerateMips() {
+			assert(HasFloatTexels() && "Mips of packed or tiled textures can't be regenerated.");
+			texture_t<Colour>::GenerateMips();
+		}
+
+		inline void *GetData() {
+			assert(HasFloatTexels() && "Packed and tiled textures have no float texels.");
+			return texture_t<Colour>::GetData();
+		}
+
+		inline Colour &GetPixelCoord(const unsigned _x, const unsigned _y) {
+			assert(HasFloatTexels() && "Packed and tiled textures are read only.");
+			return texture_t<Colour>::GetPixelCoord(_x, _y);
+		}
+
+		inline void SetPixelCoord(const unsigned _x, const unsigned _y, const Colour &_c) {
+			GetPixelCoord(_x, _y) = _c;
+		}
+
+		inline Colour &operator[](const size_t _i) {
+			assert(HasFloatTexels() && "Packed and tiled textures are read only.");
+			return data[_i];
+		}
+
+		/*
+			Packed and tiled textures fall back to a lookup, _i is then in scanline order.
+		*/
+		inline Colour operator[](const size_t _i) const {
+			if (HasFloatTexels()) return data[_i];
+			return GetPixelCoord((unsigned)(_i % width), (unsigned)(_i / width));
+		}
+
+		inline Colour GetPixelCoord(const unsigned _x, const unsigned _y) const {
+			if (tiled) return tiled->cache->Texel(*tiled, 0, _x, _y);
+			if (IsPacked()) return Unpack(0, _x, _y);
+			return texture_t<Colour>::GetPixelCoord(_x, _y);
+		}
+
+		inline Colour LevelTexel(const unsigned _level, const unsigned _x, const unsigned _y) const {
+			if (tiled) return tiled->LevelTexel(_level, _x, _y);
+			if (IsPacked()) return Unpack(_level, _x, _y);
+			return texture_t<Colour>::LevelTexel(_level, _x, _y);
+		}
+
+		inline Colour GetPixelUV(const float _u, const float _v) const {
+			if (tiled) {
+				if (interpolation == InterpolationMode::INTERP_NEAREST) return tiled->cache->Nearest(*tiled, 0, _u, _v);
+				if (interpolation == InterpolationMode::INTERP_BICUBIC) return TextureFilter::Bicubic<Colour>(*tiled, 0, _u, _v);
+				return tiled->cache->Bilinear(*tiled, 0, _u, _v);
+			}
+			if (IsPacked()) return Filtered(*this, interpolation, _u, _v, 0, 0, 0, 0);
+			return texture_t<Colour>::GetPixelUV(_u, _v);
+		}
+
+		/*
+			Tiled textures always have their mips, which are paged in like any other tile.
+		*/
+		inline Colour GetPixelUV(const float _u, const float _v, const float _dudx, const float _dvdx, const float _dudy, const float _dvdy) const {
+			if (tiled) return Filtered(*tiled, interpolation, _u, _v, _dudx, _dvdx, _dudy, _dvdy);
+			if (IsPacked()) return Filtered(*this, interpolation, _u, _v, _dudx, _dvdx, _dudy, _dvdy);
+			return texture_t<Colour>::GetPixelUV(_u, _v, _dudx, _dvdx, _dudy, _dvdy);
+		}
 };
 
 
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include "TextureCache.h"
+#include "Texture.h"
+
+LAMBDA_BEGIN
+
+namespace {
+
+	struct TiledHeader {
+		char magic[4];
+		uint32_t width, height, tileSize, levels, hasAlpha;
+		uint64_t sourceSize, sourceModified;	//Stamp of the image the file was made from, to spot stale files
+	};
+
+	constexpr char tiledMagic[4] = { 'L', 'T', 'X', '2' };
+
+	std::atomic<uint32_t> nextImageId(0);	//Never reused, so keys in per-thread tables can't alias
+	std::atomic<uint32_t> nextTempId(0);
+
+	std::vector<TiledImage::Level> MakeLevels(unsigned _width, unsigned _height) {
+		std::vector<TiledImage::Level> levels;
+		uint64_t firstTile = 0;
+		while (true) {
+			TiledImage::Level level;
+			level.width = _width;
+			level.height = _height;
+			level.tilesX = (_width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+			level.tilesY = (_height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+			level.firstTile = firstTile;
+			levels.push_back(level);
+			firstTile += (uint64_t)level.tilesX * level.tilesY;
+			if (_width == 1 && _height == 1) break;
+			_width = std::max(1u, _width / 2);
+			_height = std::max(1u, _height / 2);
+		}
+		return levels;
+	}
+
+	bool HasAlpha(const Colour *_texels, const size_t _n) {
+		for (size_t i = 0; i < _n; ++i) {
+			const float a = _texels[i].a;
+			if (std::isnormal(a) && a < 1.f && a > 0.f) return true;
+		}
+		return false;
+	}
+
+}
+
+TiledImage::TiledImage(const std::string &_path, TextureCache *_cache) : path(_path), cache(_cache), id(nextImageId++) {
+	width = height = 0;
+	hasAlpha = false;
+	tileStart = 0;
+}
+
+
+
+TextureCache &TextureCache::Default() {
+	static TextureCache cache;
+	return cache;
+}
+
+TextureCache::TextureCache(const size_t _budgetBytes) {
+	budget = _budgetBytes;
+	bytesUsed = 0;
+}
+
+void TextureCache::SetBudget(const size_t _budgetBytes) {
+	budget = _budgetBytes;
+}
+
+std::shared_ptr<TiledImage> TextureCache::Open(const std::string &_path) {
+	FileStamp stamp;
+	stamp.Read(_path);
+	const std::string tiledPath = _path + ".ltx";
+	std::shared_ptr<TiledImage> image = std::make_shared<TiledImage>(tiledPath, this);
+	if (ReadHeader(*image, stamp)) return image;
+	int w, h;
+	if (!stamp.IsValid() || !Texture::GetFileInfo(_path.c_str(), &w, &h, nullptr)) {
+		std::cout << std::endl << "Image file not found: " << _path;
+		return nullptr;
+	}
+
+	//Missing or stale, so decode the image once and write it tiled. It's written under a name
+	//of its own and renamed into place, so imports of the same image on other threads or in
+	//other processes never read or interleave with a half written file.
+	std::cout << std::endl << "Making tiled texture: " << tiledPath;
+	Texture source;
+	source.LoadImageFile(_path.c_str());
+	const std::string tempPath = tiledPath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." + std::to_string(nextTempId++) + ".tmp";
+	if (!WriteTiled(tempPath, &source[0], source.GetWidth(), source.GetHeight(), stamp)) {
+		std::remove(tempPath.c_str());
+		std::cout << std::endl << "Could not write tiled texture: " << tiledPath;
+		return nullptr;
+	}
+	if (std::rename(tempPath.c_str(), tiledPath.c_str()) != 0) std::remove(tempPath.c_str());	//Where rename won't replace, another import got there first
+	image = std::make_shared<TiledImage>(tiledPath, this);
+	if (ReadHeader(*image, stamp)) return image;
+	return nullptr;
+}
+
+bool TextureCache::WriteTiled(const std::string &_path, const Colour *_texels, const unsigned _width, const unsigned _height, const FileStamp &_source) {
+	std::ofstream out(_path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+	const std::vector<TiledImage::Level> levels = MakeLevels(_width, _height);
+	TiledHeader header;
+	memcpy(header.magic, tiledMagic, sizeof(tiledMagic));
+	header.width = _width;
+	header.height = _height;
+	header.tileSize = TEXTURE_TILE_SIZE;
+	header.levels = (uint32_t)levels.size();
+	header.hasAlpha = HasAlpha(_texels, (size_t)_width * _height);
+	header.sourceSize = _source.size;
+	header.sourceModified = _source.modified;
+	out.write((const char *)&header, sizeof(TiledHeader));
+
+	std::unique_ptr<Colour[]> tile(new Colour[TEXTURE_TILE_TEXELS]);
+	std::vector<Colour> current, next;
+	const Colour *src = _texels;
+	for (unsigned l = 0; l < levels.size(); ++l) {
+		const TiledImage::Level &level = levels[l];
+		for (unsigned ty = 0; ty < level.tilesY; ++ty) {
+			for (unsigned tx = 0; tx < level.tilesX; ++tx) {
+				for (unsigned y = 0; y < TEXTURE_TILE_SIZE; ++y) {	//Edge tiles are padded by clamping
+					const unsigned sy = std::min(ty * TEXTURE_TILE_SIZE + y, level.height - 1);
+					for (unsigned x = 0; x < TEXTURE_TILE_SIZE; ++x) {
+						const unsigned sx = std::min(tx * TEXTURE_TILE_SIZE + x, level.width - 1);
+						tile[y * TEXTURE_TILE_SIZE + x] = src[(size_t)sy * level.width + sx];
+					}
+				}
+				out.write((const char *)tile.get(), tileBytes);
+			}
+		}
+		if (l + 1 == levels.size()) break;
+
+		//Box filter down to the next level
+		const TiledImage::Level &down = levels[l + 1];
+		next.resize((size_t)down.width * down.height);
+		for (unsigned y = 0; y < down.height; ++y) {
+			const unsigned y0 = std::min(y * 2, level.height - 1), y1 = std::min(y * 2 + 1, level.height - 1);
+			for (unsigned x = 0; x < down.width; ++x) {
+				const unsigned x0 = std::min(x * 2, level.width - 1), x1 = std::min(x * 2 + 1, level.width - 1);
+				const Colour sum = src[(size_t)y0 * level.width + x0] + src[(size_t)y0 * level.width + x1] + src[(size_t)y1 * level.width + x0] + src[(size_t)y1 * level.width + x1];
+				next[(size_t)y * down.width + x] = sum * .25f;
+			}
+		}
+		current.swap(next);
+		src = current.data();
+	}
+	return (bool)out;
+}
+
+bool TextureCache::ReadHeader(TiledImage &_image, const FileStamp &_source) {
+	_image.file.open(_image.path, std::ios::binary);
+	if (!_image.file) return false;
+	TiledHeader header;
+	if (!_image.file.read((char *)&header, sizeof(TiledHeader))) return false;
+	if (memcmp(header.magic, tiledMagic, sizeof(tiledMagic)) != 0 || header.tileSize != TEXTURE_TILE_SIZE) return false;
+	if (_source.IsValid() && (header.sourceSize != _source.size || header.sourceModified != _source.modified)) return false;
+	_image.width = header.width;
+	_image.height = header.height;
+	_image.hasAlpha = header.hasAlpha;
+	_image.levels = MakeLevels(header.width, header.height);
+	_image.tileStart = sizeof(TiledHeader);
+	return _image.levels.size() == header.levels;
+}
+
+Colour TextureCache::Texel(const TiledImage &_image, const unsigned _level, const unsigned _x, const unsigned _y) {
+	const std::shared_ptr<const Tile> tile = GetTile(_image, _level, _x / TEXTURE_TILE_SIZE, _y / TEXTURE_TILE_SIZE);
+	return tile->texels[(_y % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + _x % TEXTURE_TILE_SIZE];
+}
+
+Colour TextureCache::Nearest(const TiledImage &_image, const unsigned _level, const float _u, const float _v) {
+	const TiledImage::Level &level = _image.levels[_level];
+	const unsigned x = std::min((float)(level.width - 1), maths::Clamp(_u, 0.f, 1.f) * (float)level.width);
+	const unsigned y = std::min((float)(level.height - 1), maths::Clamp(_v, 0.f, 1.f) * (float)level.height);
+	return Texel(_image, _level, x, y);
+}
+
+Colour TextureCache::Bilinear(const TiledImage &_image, const unsigned _level, const float _u, const float _v) {
+	const TiledImage::Level &level = _image.levels[_level];
+	const float fx = std::min((float)(level.width - 1), maths::Clamp(_u, 0.f, 1.f) * (float)level.width);
+	const float fy = std::min((float)(level.height - 1), maths::Clamp(_v, 0.f, 1.f) * (float)level.height);
+	const unsigned x = (unsigned)fx;
+	const unsigned y = (unsigned)fy;
+	const unsigned x1 = std::min(x + 1, level.width - 1);
+	const unsigned y1 = std::min(y + 1, level.height - 1);
+	const Colour ya = maths::Lerp(Texel(_image, _level, x, y), Texel(_image, _level, x1, y), fx - (float)x);
+	const Colour yb = maths::Lerp(Texel(_image, _level, x, y1), Texel(_image, _level, x1, y1), fx - (float)x);
+	return maths::Lerp(ya, yb, fy - (float)y);
+}
+
+std::shared_ptr<const TextureCache::Tile> TextureCache::GetTile(const TiledImage &_image, const unsigned _level, const unsigned _tx, const unsigned _ty) {
+	static thread_local LocalTile localTiles[localTableSize];
+	const uint64_t key = TileKey(_image.id, _level, _tx, _ty);
+	LocalTile &local = localTiles[(_tx + _ty * 5 + _level * 17 + _image.id * 31) & (localTableSize - 1)];
+	if (local.key == key) {
+		std::shared_ptr<const Tile> tile = local.tile.lock();
+		if (tile) return tile;	//Otherwise evicted since this thread last used it
+	}
+	std::shared_ptr<const Tile> tile = FindOrLoad(_image, _level, _tx, _ty, key);
+	local.tile = tile;
+	local.key = key;
+	return tile;
+}
+
+std::shared_ptr<const TextureCache::Tile> TextureCache::FindOrLoad(const TiledImage &_image, const unsigned _level, const unsigned _tx, const unsigned _ty, const uint64_t _key) {
+	Shard &shard = shards[(_key ^ (_key >> 16) ^ (_key >> 32) ^ (_key >> 40)) % numShards];
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		const auto it = shard.tiles.find(_key);
+		if (it != shard.tiles.end()) {
+			shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+			return it->second.tile;
+		}
+	}
+
+	//Read without holding the shard, another thread may load the same tile meanwhile
+	const std::shared_ptr<const Tile> tile = ReadTile(_image, _level, _tx, _ty);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	const auto it = shard.tiles.find(_key);
+	if (it != shard.tiles.end()) return it->second.tile;
+	shard.lru.push_front(_key);
+	shard.tiles[_key] = { tile, shard.lru.begin() };
+	bytesUsed += tileBytes;
+	Evict(shard);
+	return tile;
+}
+
+std::shared_ptr<TextureCache::Tile> TextureCache::ReadTile(const TiledImage &_image, const unsigned _level, const unsigned _tx, const unsigned _ty) {
+	std::shared_ptr<Tile> tile = std::make_shared<Tile>();
+	tile->texels.reset(new Colour[TEXTURE_TILE_TEXELS]);
+	const TiledImage::Level &level = _image.levels[_level];
+	const uint64_t index = level.firstTile + (uint64_t)_ty * level.tilesX + _tx;
+	std::lock_guard<std::mutex> lock(_image.fileMutex);
+	_image.file.seekg(_image.tileStart + index * tileBytes);
+	if (!_image.file.read((char *)tile->texels.get(), tileBytes)) {
+		_image.file.clear();
+		std::fill_n(tile->texels.get(), TEXTURE_TILE_TEXELS, Colour(1, 0, 1));
+		std::cout << std::endl << "Could not read tile " << _tx << ", " << _ty << " of level " << _level << " from " << _image.path;
+	}
+	return tile;
+}
+
+void TextureCache::Evict(Shard &_shard) {
+	const size_t shardBudget = std::max(budget / numShards, tileBytes);
+	while (_shard.tiles.size() * tileBytes > shardBudget && _shard.lru.size() > 1) {
+		_shard.tiles.erase(_shard.lru.back());
+		_shard.lru.pop_back();
+		bytesUsed -= tileBytes;
+	}
+}
+
+LAMBDA_END
@@ -0,0 +1,163 @@
+/*
+	Demand paged, mip-mapped texture storage with a fixed memory budget.
+
+	Images are converted once into a tiled file next to the source (<image>.ltx) holding a box
+	filtered mip pyramid cut into TEXTURE_TILE_SIZE square tiles. Tiles are only read from disk
+	the first time they are sampled and are evicted least recently used once the cache goes over
+	budget. Each thread keeps a small table of the tiles it used last, so most lookups never touch
+	the shared lock. The table only holds weak references, so an evicted tile is freed as soon as
+	no lookup is reading it rather than lingering in every thread that once used it.
+*/
+
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <utility/FileStamp.h>
+#include "Colour.h"
+
+LAMBDA_BEGIN
+
+constexpr unsigned TEXTURE_TILE_SIZE = 64;
+constexpr unsigned TEXTURE_TILE_TEXELS = TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+
+class TextureCache;
+
+/*
+	An open tiled file. Only the header is held in memory.
+*/
+class TiledImage {
+	public:
+		struct Level {
+			unsigned width, height, tilesX, tilesY;
+			uint64_t firstTile;
+		};
+
+		const std::string path;
+		TextureCache *const cache;
+		const uint32_t id;
+		unsigned width, height;
+		bool hasAlpha;
+		std::vector<Level> levels;
+
+		TiledImage(const std::string &_path, TextureCache *_cache);
+
+		inline unsigned NumLevels() const { return (unsigned)levels.size(); }
+
+		inline unsigned LevelWidth(const unsigned _level) const { return levels[_level].width; }
+
+		inline unsigned LevelHeight(const unsigned _level) const { return levels[_level].height; }
+
+		/*
+			Texel through the cache the image was opened with, so TextureFilter can read tiled images.
+		*/
+		inline Colour LevelTexel(const unsigned _level, const unsigned _x, const unsigned _y) const;
+
+	private:
+		friend class TextureCache;
+
+		mutable std::ifstream file;
+		mutable std::mutex fileMutex;
+		uint64_t tileStart;
+};
+
+class TextureCache {
+	public:
+		/*
+			Cache shared by every texture that doesn't ask for its own.
+		*/
+		static TextureCache &Default();
+
+		TextureCache(const size_t _budgetBytes = (size_t)2 << 30);
+
+		/*
+			Changes the budget. Tiles over the new budget are evicted as they are next touched.
+		*/
+		void SetBudget(const size_t _budgetBytes);
+
+		inline size_t GetBudget() const { return budget; }
+
+		inline size_t BytesUsed() const { return bytesUsed.load(std::memory_order_relaxed); }
+
+		/*
+			Opens the tiled version of the image at _path, making it first if it is missing or was
+			made from a different version of the image. Returns nullptr if the image can't be read.
+		*/
+		std::shared_ptr<TiledImage> Open(const std::string &_path);
+
+		/*
+			Writes _texels (_width * _height, row major) as a tiled file at _path, stamped with the
+			source image it was made from.
+		*/
+		static bool WriteTiled(const std::string &_path, const Colour *_texels, const unsigned _width, const unsigned _height, const FileStamp &_source = FileStamp());
+
+		/*
+			Texel (_x, _y) of mip _level. Coordinates must be inside the level.
+		*/
+		Colour Texel(const TiledImage &_image, const unsigned _level, const unsigned _x, const unsigned _y);
+
+		/*
+			Nearest and bilinear lookups on mip _level, with _u and _v in [0, 1].
+		*/
+		Colour Nearest(const TiledImage &_image, const unsigned _level, const float _u, const float _v);
+
+		Colour Bilinear(const TiledImage &_image, const unsigned _level, const float _u, const float _v);
+
+	private:
+		struct Tile {
+			std::unique_ptr<Colour[]> texels;
+		};
+
+		struct LocalTile {
+			uint64_t key = ~(uint64_t)0;
+			std::weak_ptr<const Tile> tile;
+		};
+
+		struct Entry {
+			std::shared_ptr<const Tile> tile;
+			std::list<uint64_t>::iterator lru;
+		};
+
+		/*
+			Tiles are spread over shards by key so threads missing their local table rarely
+			wait on each other.
+		*/
+		struct Shard {
+			std::mutex mutex;
+			std::unordered_map<uint64_t, Entry> tiles;
+			std::list<uint64_t> lru;	//Most recently used at the front
+		};
+
+		static constexpr unsigned numShards = 16;
+		static constexpr unsigned localTableSize = 64;
+		static constexpr size_t tileBytes = sizeof(Colour) * TEXTURE_TILE_TEXELS;
+
+		Shard shards[numShards];
+		size_t budget;
+		std::atomic<size_t> bytesUsed;
+
+		static inline uint64_t TileKey(const uint32_t _id, const unsigned _level, const unsigned _tx, const unsigned _ty) {
+			return ((uint64_t)_id << 40) | ((uint64_t)_level << 32) | ((uint64_t)_ty << 16) | (uint64_t)_tx;
+		}
+
+		std::shared_ptr<const Tile> GetTile(const TiledImage &_image, const unsigned _level, const unsigned _tx, const unsigned _ty);
+
+		std::shared_ptr<const Tile> FindOrLoad(const TiledImage &_image, const unsigned _level, const unsigned _tx, const unsigned _ty, const uint64_t _key);
+
+		std::shared_ptr<Tile> ReadTile(const TiledImage &_image, const unsigned _level, const unsigned _tx, const unsigned _ty);
+
+		void Evict(Shard &_shard);
+
+		static bool ReadHeader(TiledImage &_image, const FileStamp &_source);
+};
+
+inline Colour TiledImage::LevelTexel(const unsigned _level, const unsigned _x, const unsigned _y) const {
+	return cache->Texel(*this, _level, _x, _y);
+}
+
+LAMBDA_END
@@ -1,7 +1,21 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <Lambda.h>
 
+/*
+	Use BMI2 instructions for Morton encoding (faster), only when the target is built with them.
+	Define LAMBDA_NO_BMI to use the portable shifts regardless.
+*/
+#if !defined(LAMBDA_NO_BMI) && (defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__)))
+#define USE_BMI_INSTRUCTIONS
+#endif
+
+#ifdef USE_BMI_INSTRUCTIONS
+#include <immintrin.h>
+#endif
+
 
 LAMBDA_BEGIN
 
@@ -18,6 +32,97 @@ namespace TextureEncoding {
 	}
 
 	uint32_t HilbertXYToIndex(uint32_t n, uint32_t x, uint32_t y);
+
+	/*
+		Smallest power of two >= _n.
+	*/
+	inline unsigned CeilPow2(unsigned _n) {
+		unsigned p = 1;
+		while (p < _n) p <<= 1;
+		return p;
+	}
+
+	inline unsigned Log2(unsigned _n) {
+		unsigned l = 0;
+		while (_n >>= 1) ++l;
+		return l;
+	}
+
+	/*
+		Texel layouts, passed to texture_t as a template parameter so fetches never switch on
+		them. Each gives the number of texels to allocate for a _w x _h image and the index of
+		texel (_x, _y).
+	*/
+
+	struct ScanlineRow {
+		static inline size_t Size(const unsigned _w, const unsigned _h) { return (size_t)_w * _h; }
+
+		static inline size_t Index(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
+			return (size_t)_y * _w + _x;
+		}
+	};
+
+	struct ScanlineCol {
+		static inline size_t Size(const unsigned _w, const unsigned _h) { return (size_t)_w * _h; }
+
+		static inline size_t Index(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
+			return (size_t)_x * _h + _y;
+		}
+	};
+
+	/*
+		Z-order over the power of two square holding the image, so sizes other than square
+		powers of two waste the padding.
+	*/
+	struct Morton {
+		static inline size_t Size(const unsigned _w, const unsigned _h) {
+			const size_t p = CeilPow2(std::max(_w, _h));
+			return p * p;
+		}
+
+		static inline size_t Index(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
+			#ifdef USE_BMI_INSTRUCTIONS
+				static const uint64_t x2Mask = 0x5555555555555555;
+				static const uint64_t y2Mask = 0xAAAAAAAAAAAAAAAA;
+				return _pdep_u64(_x, x2Mask) | _pdep_u64(_y, y2Mask);
+			#else
+				return ShiftInterleave(_x) | (ShiftInterleave(_y) << 1);
+			#endif
+		}
+	};
+
+	/*
+		Hilbert order over the power of two square holding the image, padded like Morton.
+	*/
+	struct Hilbert {
+		static inline unsigned Side(const unsigned _w, const unsigned _h) { return std::max(2u, CeilPow2(std::max(_w, _h))); }
+
+		static inline size_t Size(const unsigned _w, const unsigned _h) { return (size_t)Side(_w, _h) * Side(_w, _h); }
+
+		static inline size_t Index(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
+			return HilbertXYToIndex(Log2(Side(_w, _h)), _x, _y);
+		}
+	};
+
+	/*
+		Rows of _N x _N tiles, each stored in scanline order. Works at any resolution, edge tiles
+		are padded. A bilinear footprint inside a tile touches two adjacent rows of _N texels, so
+		with 4x4 tiles of 4 byte texels the whole tile is one 64 byte cache line.
+	*/
+	template<unsigned _N>
+	struct Block {
+		static_assert((_N & (_N - 1)) == 0, "Block size must be a power of two.");
+
+		static inline size_t Size(const unsigned _w, const unsigned _h) {
+			return (size_t)((_w + _N - 1) / _N) * ((_h + _N - 1) / _N) * _N * _N;
+		}
+
+		static inline size_t Index(const unsigned _w, const unsigned _h, const unsigned _x, const unsigned _y) {
+			const size_t tilesX = (_w + _N - 1) / _N;
+			const size_t tile = (size_t)(_y / _N) * tilesX + _x / _N;
+			return tile * _N * _N + (_y % _N) * _N + _x % _N;
+		}
+	};
 }
 
-LAMBDA_END
\ No newline at end of file
+LAMBDA_END
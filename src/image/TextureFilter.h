@@ -0,0 +1,197 @@
+/*
+	Filtered lookups over a mip pyramid.
+
+	Functions take any source with NumLevels(), LevelWidth(), LevelHeight() and LevelTexel(), so
+	in-memory textures and tiled textures paged through a TextureCache share the same filters.
+	Level 0 is the full-size image and each level after is half the size of the last. Texture
+	coordinates are in [0, 1] and clamp at the edges.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <maths/maths.h>
+#include "Colour.h"
+
+LAMBDA_BEGIN
+
+namespace TextureFilter {
+
+	constexpr unsigned EWA_LUT_SIZE = 128;
+	constexpr float EWA_ALPHA = 2;
+	constexpr float MAX_ANISOTROPY = 8;
+
+	/*
+		Starting value for weighted sums. Colour's scalar constructor leaves alpha at one.
+	*/
+	template<class Type>
+	inline Type Zero() { return Type(0); }
+
+	template<>
+	inline Colour Zero<Colour>() { return Colour(0, 0, 0, 0); }
+
+	/*
+		Gaussian falloff over the squared radius of the unit ellipse, shifted to reach zero at its edge.
+	*/
+	inline const float *EWAWeights() {
+		static const struct Table {
+			float w[EWA_LUT_SIZE];
+			Table() {
+				for (unsigned i = 0; i < EWA_LUT_SIZE; ++i) {
+					const float r2 = (float)i / (EWA_LUT_SIZE - 1);
+					w[i] = std::exp(-EWA_ALPHA * r2) - std::exp(-EWA_ALPHA);
+				}
+			}
+		} table;
+		return table.w;
+	}
+
+	template<class Type, class Source>
+	inline Type Nearest(const Source &_src, const unsigned _level, const float _u, const float _v) {
+		const unsigned w = _src.LevelWidth(_level), h = _src.LevelHeight(_level);
+		const unsigned x = std::min((float)(w - 1), maths::Clamp(_u, 0.f, 1.f) * (float)w);
+		const unsigned y = std::min((float)(h - 1), maths::Clamp(_v, 0.f, 1.f) * (float)h);
+		return _src.LevelTexel(_level, x, y);
+	}
+
+	template<class Type, class Source>
+	inline Type Bilinear(const Source &_src, const unsigned _level, const float _u, const float _v) {
+		const unsigned w = _src.LevelWidth(_level), h = _src.LevelHeight(_level);
+		const float fx = std::min((float)(w - 1), maths::Clamp(_u, 0.f, 1.f) * (float)w);
+		const float fy = std::min((float)(h - 1), maths::Clamp(_v, 0.f, 1.f) * (float)h);
+		const unsigned x = (unsigned)fx;
+		const unsigned y = (unsigned)fy;
+		const unsigned x1 = std::min(x + 1, w - 1);
+		const unsigned y1 = std::min(y + 1, h - 1);
+		const Type ya = maths::Lerp(_src.LevelTexel(_level, x, y), _src.LevelTexel(_level, x1, y), fx - (float)x);
+		const Type yb = maths::Lerp(_src.LevelTexel(_level, x, y1), _src.LevelTexel(_level, x1, y1), fx - (float)x);
+		return maths::Lerp(ya, yb, fy - (float)y);
+	}
+
+	/*
+		Catmull-Rom over the 4x4 texels around (_u, _v). Can overshoot near hard edges.
+	*/
+	template<class Type, class Source>
+	inline Type Bicubic(const Source &_src, const unsigned _level, const float _u, const float _v) {
+		const unsigned w = _src.LevelWidth(_level), h = _src.LevelHeight(_level);
+		const float fx = std::min((float)(w - 1), maths::Clamp(_u, 0.f, 1.f) * (float)w);
+		const float fy = std::min((float)(h - 1), maths::Clamp(_v, 0.f, 1.f) * (float)h);
+		const int x = (int)fx, y = (int)fy;
+		auto weights = [](const float _t, float *_w) {
+			const float t2 = _t * _t, t3 = t2 * _t;
+			_w[0] = -.5f * t3 + t2 - .5f * _t;
+			_w[1] = 1.5f * t3 - 2.5f * t2 + 1;
+			_w[2] = -1.5f * t3 + 2 * t2 + .5f * _t;
+			_w[3] = .5f * t3 - .5f * t2;
+		};
+		float wx[4], wy[4];
+		weights(fx - (float)x, wx);
+		weights(fy - (float)y, wy);
+		Type sum = Zero<Type>();
+		for (int j = 0; j < 4; ++j) {
+			const unsigned ty = maths::Clamp(y + j - 1, 0, (int)h - 1);
+			Type row = Zero<Type>();
+			for (int i = 0; i < 4; ++i) {
+				const unsigned tx = maths::Clamp(x + i - 1, 0, (int)w - 1);
+				row = row + _src.LevelTexel(_level, tx, ty) * wx[i];
+			}
+			sum = sum + row * wy[j];
+		}
+		return sum;
+	}
+
+	/*
+		Isotropic filter of _width in texture space, blending bilinear lookups on the two levels
+		either side of it.
+	*/
+	template<class Type, class Source>
+	inline Type Trilinear(const Source &_src, const float _u, const float _v, const float _width) {
+		const unsigned levels = _src.NumLevels();
+		const float texels = _width * (float)std::max(_src.LevelWidth(0), _src.LevelHeight(0));
+		const float level = std::log2(std::max(texels, 1e-8f));
+		if (level <= 0) return Bilinear<Type>(_src, 0, _u, _v);
+		if (level >= (float)(levels - 1)) return Bilinear<Type>(_src, levels - 1, _u, _v);
+		const unsigned l = (unsigned)level;
+		return maths::Lerp(Bilinear<Type>(_src, l, _u, _v), Bilinear<Type>(_src, l + 1, _u, _v), level - (float)l);
+	}
+
+	/*
+		Gaussian weighted sum over the ellipse with axes _du0, _dv0 and _du1, _dv1 on one level.
+	*/
+	template<class Type, class Source>
+	inline Type EWALevel(const Source &_src, const unsigned _level, float _u, float _v, float _du0, float _dv0, float _du1, float _dv1) {
+		const unsigned w = _src.LevelWidth(_level), h = _src.LevelHeight(_level);
+		_u = maths::Clamp(_u, 0.f, 1.f) * w - .5f;	//Texel centres, so the ellipse sits on the samples it covers
+		_v = maths::Clamp(_v, 0.f, 1.f) * h - .5f;
+		_du0 *= w;
+		_du1 *= w;
+		_dv0 *= h;
+		_dv1 *= h;
+
+		//Implicit ellipse A u^2 + B u v + C v^2 = 1, padded by a texel so it always covers one
+		float A = _dv0 * _dv0 + _dv1 * _dv1 + 1;
+		float B = -2 * (_du0 * _dv0 + _du1 * _dv1);
+		float C = _du0 * _du0 + _du1 * _du1 + 1;
+		const float invF = 1 / (A * C - B * B * .25f);
+		A *= invF;
+		B *= invF;
+		C *= invF;
+
+		const float det = -B * B + 4 * A * C;
+		const float invDet = 1 / det;
+		const float uSqrt = std::sqrt(det * C), vSqrt = std::sqrt(A * det);
+		const int u0 = (int)std::ceil(_u - 2 * invDet * uSqrt), u1 = (int)std::floor(_u + 2 * invDet * uSqrt);
+		const int v0 = (int)std::ceil(_v - 2 * invDet * vSqrt), v1 = (int)std::floor(_v + 2 * invDet * vSqrt);
+
+		const float *lut = EWAWeights();
+		Type sum = Zero<Type>();
+		float sumWeights = 0;
+		for (int y = v0; y <= v1; ++y) {
+			const float tt = (float)y - _v;
+			const unsigned ty = maths::Clamp(y, 0, (int)h - 1);
+			for (int x = u0; x <= u1; ++x) {
+				const float ss = (float)x - _u;
+				const float r2 = A * ss * ss + B * ss * tt + C * tt * tt;
+				if (r2 < 1) {
+					const float weight = lut[std::min((unsigned)(r2 * EWA_LUT_SIZE), EWA_LUT_SIZE - 1)];
+					sum = sum + _src.LevelTexel(_level, maths::Clamp(x, 0, (int)w - 1), ty) * weight;
+					sumWeights += weight;
+				}
+			}
+		}
+		if (sumWeights <= 0) return Bilinear<Type>(_src, _level, (_u + .5f) / w, (_v + .5f) / h);
+		return sum * (1 / sumWeights);
+	}
+
+	/*
+		Elliptically weighted average over the footprint given by the texture space derivatives
+		along the screen axes. Very thin ellipses are widened to MAX_ANISOTROPY so the number of
+		texels read stays bounded, and the level is picked from the minor axis.
+	*/
+	template<class Type, class Source>
+	inline Type EWA(const Source &_src, const float _u, const float _v, float _du0, float _dv0, float _du1, float _dv1) {
+		if (_du0 * _du0 + _dv0 * _dv0 < _du1 * _du1 + _dv1 * _dv1) {
+			std::swap(_du0, _du1);
+			std::swap(_dv0, _dv1);
+		}
+		const float major = std::sqrt(_du0 * _du0 + _dv0 * _dv0);
+		float minor = std::sqrt(_du1 * _du1 + _dv1 * _dv1);
+		if (minor * MAX_ANISOTROPY < major && minor > 0) {
+			const float scale = major / (minor * MAX_ANISOTROPY);
+			_du1 *= scale;
+			_dv1 *= scale;
+			minor *= scale;
+		}
+		if (minor == 0) return Bilinear<Type>(_src, 0, _u, _v);
+
+		const unsigned levels = _src.NumLevels();
+		const float texels = minor * (float)std::max(_src.LevelWidth(0), _src.LevelHeight(0));
+		const float level = std::max(0.f, std::log2(std::max(texels, 1e-8f)));
+		if (level >= (float)(levels - 1)) return Bilinear<Type>(_src, levels - 1, _u, _v);
+		const unsigned l = (unsigned)level;
+		const Type a = EWALevel<Type>(_src, l, _u, _v, _du0, _dv0, _du1, _dv1);
+		return maths::Lerp(a, EWALevel<Type>(_src, l + 1, _u, _v, _du0, _dv0, _du1, _dv1), level - (float)l);
+	}
+}
+
+LAMBDA_END
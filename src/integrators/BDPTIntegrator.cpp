@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <lighting/EnvironmentLight.h>
+#include <lighting/PointLight.h>
+#include <lighting/Spotlight.h>
+#include <lighting/Emission.h>
+#include "BDPTIntegrator.h"
+
+LAMBDA_BEGIN
+
+/*
+	Zero pdfs mark delta vertices, they cancel out of the ratios.
+*/
+static inline Real Remap0(const Real _pdf) {
+	return _pdf != 0 ? _pdf : 1;
+}
+
+BDPTIntegrator::BDPTIntegrator(Sampler *_sampler, const unsigned _maxDepth) {
+	sampler = _sampler;
+	maxDepth = _maxDepth;
+}
+
+Integrator *BDPTIntegrator::clone() const {
+	return new BDPTIntegrator(*this);
+}
+
+void BDPTIntegrator::Prepare(const Scene &_scene, const Camera *_camera, Film *_film) {
+	Integrator::Prepare(_scene, _camera, _film);
+	camera = _camera;
+	film = _film;
+	lightDistribution.reset(new PowerLightSampler(_scene));
+	if (!_scene.lights.empty()) lightDistribution->Commit();
+}
+
+Spectrum BDPTIntegrator::Li(Ray _ray, const Scene &_scene) const {
+	if (!lightDistribution) return Spectrum(0);	//Not prepared, RenderMosaic does this
+	ScatterEvent event;
+	SampledWavelength wavelength;
+	SampleWavelength(event, wavelength);
+	const Real cameraPdf = camera ? camera->PdfDirection(_ray.d) : 0;
+	const Context ctx = { &_scene, event.wavelength, film && cameraPdf > 0 };
+	const unsigned depth = std::min(maxDepth, maxPathDepth);
+
+	Vertex cameraPath[maxPathDepth + 2], lightPath[maxPathDepth + 1];
+	Vertex &c = cameraPath[0];
+	c.type = VertexType::CAMERA;
+	c.point = _ray.o;
+	c.beta = Spectrum(1);
+	const unsigned nCamera = 1 + RandomWalk(_ray, Spectrum(1), cameraPdf, ctx, depth + 1, true, cameraPath);
+	const unsigned nLight = _scene.lights.empty() ? 0 : LightSubpath(ctx, depth + 1, lightPath);
+
+	Spectrum L(0);
+	for (unsigned t = 1; t <= nCamera; ++t) {
+		for (unsigned s = 0; s <= nLight; ++s) {
+			const int d = (int)(s + t) - 2;
+			if ((s == 1 && t == 1) || d < 0 || d > (int)depth) continue;
+			if (t == 1 && !ctx.lightTracing) continue;
+			L += Connect(ctx, lightPath, s, cameraPath, t);
+		}
+	}
+	return L;
+}
+
+unsigned BDPTIntegrator::RandomWalk(Ray _ray, Spectrum _beta, Real _pdf, const Context &_ctx, const unsigned _maxVertices, const bool _fromCamera, Vertex *_path) const {
+	if (_maxVertices == 0) return 0;
+	const Scene &scene = *_ctx.scene;
+	Real pdfFwd = _pdf, pdfRev = 0;
+	unsigned n = 0;
+	for (;;) {
+		Vertex &prev = _path[n], &v = _path[n + 1];
+		v = Vertex();
+		if (!scene.Intersect(_ray, v.hit)) {
+			if (_fromCamera && scene.envLight) {	//Light subpaths have nothing to connect to out here
+				v.type = VertexType::ESCAPED;
+				v.point = _ray.d;
+				v.beta = _beta;
+				v.light = (Light*)scene.envLight;
+				v.pdfFwd = pdfFwd;
+				++n;
+			}
+			break;
+		}
+		const Material *material = v.hit.object->material;
+		const BxDF *bxdf = material ? material->bxdf : nullptr;
+		if (!bxdf && !(material && material->light)) {	//Pass through surfaces that neither scatter nor emit
+			_ray.o = v.hit.point + v.hit.normalG * (maths::Dot(_ray.d, v.hit.normalG) < 0 ? -SURFACE_EPSILON : SURFACE_EPSILON);
+			_ray.hasDifferentials = false;
+			continue;
+		}
+		v.type = VertexType::SURFACE;
+		v.point = v.hit.point;
+		v.normal = v.hit.normalG;
+		v.wo = -_ray.d;
+		v.beta = _beta;
+		v.light = material->light;
+		v.pdfFwd = ConvertDensity(pdfFwd, prev, v);
+		if (++n >= _maxVertices || !bxdf) break;	//Emitters without a bxdf end the subpath
+
+		ScatterEvent event = Event(_ctx, v, v.wo, v.wo);
+		const Spectrum f = bxdf->Sample_f(event, *sampler, pdfFwd) * std::abs(event.wiL.y);
+		v.hit.point = v.point;	//Sample_f() may have offset it
+		if (pdfFwd == 0 || f.IsBlack()) break;
+		_beta *= f / pdfFwd;
+		if (bxdf->type & BxDF::BxDF_SPECULAR) {
+			v.delta = true;
+			pdfFwd = pdfRev = 0;
+		}
+		else {
+			ScatterEvent reverse = Event(_ctx, v, event.wi, v.wo);
+			pdfRev = bxdf->Pdf(reverse.woL, reverse.wiL, reverse);
+		}
+		prev.pdfRev = ConvertDensity(pdfRev, v, prev);
+		_ray = Ray(v.point + v.normal * (maths::Dot(event.wi, v.normal) < 0 ? -SURFACE_EPSILON : SURFACE_EPSILON), event.wi);
+	}
+	return n;
+}
+
+unsigned BDPTIntegrator::LightSubpath(const Context &_ctx, const unsigned _maxVertices, Vertex *_path) const {
+	RayHit hit;
+	ScatterEvent event;
+	event.hit = &hit;
+	event.scene = _ctx.scene;
+	event.wavelength = _ctx.wavelength;
+	Real pickPdf = 0;
+	Light *light = lightDistribution->Sample(event, *sampler, &pickPdf);
+	if (!light || pickPdf == 0 || dynamic_cast<const EnvironmentLight*>(light)) return 0;
+
+	Vertex &v = _path[0];
+	v = Vertex();
+	v.type = VertexType::LIGHT;
+	v.light = light;
+	EmissionSample es;
+	const bool emits = Emission::Sample(*light, *sampler, event, &es);
+	if (es.pdfPos == 0) return 0;
+	v.Le = es.Le;
+	v.point = es.point;
+	v.normal = es.normal;
+	v.delta = es.deltaPosition;
+	v.pdfFwd = pickPdf * es.pdfPos;
+	v.beta = v.Le / v.pdfFwd;
+	if (!emits) return 1;
+
+	const Vec3 o = v.delta ? v.point : OffsetTowards(v, v.point + es.direction);
+	return 1 + RandomWalk(Ray(o, es.direction), es.Le * es.directional / (v.pdfFwd * es.pdfDir), es.pdfDir, _ctx, _maxVertices - 1, false, _path);
+}
+
+Spectrum BDPTIntegrator::Connect(const Context &_ctx, const Vertex *_light, const unsigned _s, const Vertex *_camera, const unsigned _t) const {
+	const Scene &scene = *_ctx.scene;
+	Vertex sampled;
+	Spectrum L(0);
+	if (_s == 0) {	//Camera subpath found a light by itself
+		const Vertex &pt = _camera[_t - 1];
+		if (!pt.light) return L;
+		L = pt.beta * Emitted(_ctx, pt, Direction(pt, _camera[_t - 2]));
+	}
+	else if (_t == 1) {	//Light tracing, splat where the camera sees the light subpath's end
+		const Vertex &qs = _light[_s - 1];
+		if (!Connectible(qs)) return L;
+		Vec2 uv;
+		Real We;
+		if (!camera->ConnectPoint(qs.point, &uv, &sampled.point, &We)) return L;
+		sampled.type = VertexType::CAMERA;
+		sampled.beta = Spectrum(1);
+		const Vec3 w = Direction(qs, sampled);
+		L = qs.beta * f(_ctx, qs, w, qs.wo) * AbsCos(qs, w) * We;
+		if (L.IsBlack() || !scene.MutualVisibility(OffsetTowards(qs, sampled.point), sampled.point)) return Spectrum(0);
+		L *= MISWeight(_ctx, _light, _s, _camera, _t, sampled);
+		if (!L.IsBlack()) film->AddSplat(L, uv.x, uv.y);
+		return Spectrum(0);
+	}
+	else if (_s == 1) {	//Next event estimation
+		const Vertex &pt = _camera[_t - 1];
+		if (!Connectible(pt)) return L;
+		RayHit hit;
+		ScatterEvent event;
+		event.hit = &hit;
+		event.scene = &scene;
+		event.wavelength = _ctx.wavelength;
+		Real pickPdf = 0;
+		Light *light = lightDistribution->Sample(event, *sampler, &pickPdf);
+		if (!light || pickPdf == 0) return L;
+		sampled.light = light;
+		if (const EnvironmentLight *env = dynamic_cast<const EnvironmentLight*>(light)) {
+			Real pdfDir;
+			const Vec3 w = env->SampleDirection(sampler->Get2D(), &pdfDir);
+			if (pdfDir == 0) return L;
+			sampled.type = VertexType::ESCAPED;
+			sampled.point = w;
+			sampled.pdfFwd = pickPdf * pdfDir;
+			sampled.beta = env->Le(w) / sampled.pdfFwd;
+			L = pt.beta * f(_ctx, pt, pt.wo, w) * AbsCos(pt, w) * sampled.beta;
+			if (L.IsBlack() || !scene.RayEscapes(Ray(OffsetTowards(pt, pt.point + w), w))) return Spectrum(0);
+		}
+		else {
+			PartialLightSample ls;
+			ls.light = light;
+			ls.pdf = 1;
+			sampled.type = VertexType::LIGHT;
+			sampled.Le = light->SamplePoint(*sampler, event, &ls);
+			sampled.point = ls.point;
+			sampled.normal = ls.normal;
+			sampled.delta = dynamic_cast<const PointLight*>(light) || dynamic_cast<const Spotlight*>(light);
+			sampled.pdfFwd = pickPdf * ls.pdf;
+			if (sampled.pdfFwd == 0) return L;
+			sampled.beta = sampled.Le / sampled.pdfFwd;
+			const Vec3 diff = sampled.point - pt.point;
+			const Real distSq = maths::Dot(diff, diff);
+			if (distSq == 0) return L;
+			const Vec3 w = diff / std::sqrt(distSq);
+			Spectrum Le = sampled.beta * AbsCos(sampled, -w);
+			if (const Spotlight *spot = dynamic_cast<const Spotlight*>(light)) Le *= spot->Falloff(-w);
+			L = pt.beta * f(_ctx, pt, pt.wo, w) * AbsCos(pt, w) * Le / distSq;
+			const Vec3 pS = OffsetTowards(pt, sampled.point);
+			if (L.IsBlack() || !scene.MutualVisibility(pS, sampled.delta ? sampled.point : OffsetTowards(sampled, pS))) return Spectrum(0);
+		}
+	}
+	else {	//Join two surface vertices
+		const Vertex &qs = _light[_s - 1], &pt = _camera[_t - 1];
+		if (!Connectible(qs) || !Connectible(pt)) return L;
+		const Vec3 diff = qs.point - pt.point;
+		const Real distSq = maths::Dot(diff, diff);
+		if (distSq == 0) return L;
+		const Vec3 w = diff / std::sqrt(distSq);
+		L = qs.beta * f(_ctx, qs, -w, qs.wo) * f(_ctx, pt, pt.wo, w) * pt.beta * (AbsCos(qs, w) * AbsCos(pt, w) / distSq);
+		if (L.IsBlack() || !scene.MutualVisibility(OffsetTowards(pt, qs.point), OffsetTowards(qs, pt.point))) return Spectrum(0);
+	}
+	if (L.IsBlack()) return L;
+	return L * MISWeight(_ctx, _light, _s, _camera, _t, sampled);
+}
+
+Real BDPTIntegrator::MISWeight(const Context &_ctx, const Vertex *_light, const unsigned _s, const Vertex *_camera, const unsigned _t, const Vertex &_sampled) const {
+	if (_s + _t == 2) return 1;
+	const Vertex *qs = _s == 1 ? &_sampled : _s > 1 ? &_light[_s - 1] : nullptr;
+	const Vertex *pt = _t == 1 ? &_sampled : &_camera[_t - 1];
+	const Vertex *qsMinus = _s > 1 ? &_light[_s - 2] : nullptr;
+	const Vertex *ptMinus = _t > 1 ? &_camera[_t - 2] : nullptr;
+
+	VertexPdfs lp[maxPathDepth + 1], cp[maxPathDepth + 2];
+	for (unsigned i = 0; i < _s; ++i) {
+		const Vertex &v = i == _s - 1 ? *qs : _light[i];
+		lp[i] = { v.pdfFwd, v.pdfRev, v.delta };
+	}
+	for (unsigned i = 0; i < _t; ++i) {
+		const Vertex &v = i == _t - 1 ? *pt : _camera[i];
+		cp[i] = { v.pdfFwd, v.pdfRev, v.delta };
+	}
+	const bool deltaLight = _s > 0 && (_s == 1 ? _sampled : _light[0]).delta;
+	//The environment never starts light subpaths, so only strategies with at most one light vertex could make these
+	const bool infinite = pt->type == VertexType::ESCAPED || (qs && qs->type == VertexType::ESCAPED);
+
+	//The connection's end points are joined by a shadow ray, so aren't delta whatever they are
+	cp[_t - 1].delta = false;
+	if (_s > 0) lp[_s - 1].delta = false;
+
+	//Reverse pdfs of the vertices around the connection, as if sampled from the other subpath
+	cp[_t - 1].pdfRev = qs ? Pdf(_ctx, qsMinus, *qs, *pt) : PdfLightOrigin(_ctx, *pt);
+	if (ptMinus) cp[_t - 2].pdfRev = qs ? Pdf(_ctx, qs, *pt, *ptMinus) : PdfLight(*pt, *ptMinus);
+	if (qs) lp[_s - 1].pdfRev = Pdf(_ctx, ptMinus, *pt, *qs);
+	if (qsMinus) lp[_s - 2].pdfRev = Pdf(_ctx, pt, *qs, *qsMinus);
+
+	Real sumRi = 0, ri = 1;
+	for (unsigned i = _t - 1; i > 0; --i) {	//Strategies with i camera vertices
+		ri *= Remap0(cp[i].pdfRev) / Remap0(cp[i].pdfFwd);
+		const unsigned s = _s + _t - i;
+		if (infinite && s > 1) break;
+		if (i == 1 && (s == 1 || !_ctx.lightTracing)) continue;	//Light tracing can't join a light's own vertex to the camera
+		if (!cp[i].delta && !cp[i - 1].delta) sumRi += ri * ri;
+	}
+	ri = 1;
+	for (int i = (int)_s - 1; i >= 0; --i) {	//Strategies with i light vertices
+		ri *= Remap0(lp[i].pdfRev) / Remap0(lp[i].pdfFwd);
+		const bool deltaBefore = i > 0 ? lp[i - 1].delta : deltaLight;
+		if (!lp[i].delta && !deltaBefore) sumRi += ri * ri;
+	}
+	return 1 / (1 + sumRi);
+}
+
+Real BDPTIntegrator::Pdf(const Context &_ctx, const Vertex *_prev, const Vertex &_v, const Vertex &_next) const {
+	switch (_v.type) {
+		case VertexType::CAMERA:
+			return camera ? ConvertDensity(camera->PdfDirection(Direction(_v, _next)), _v, _next) : 0;
+		case VertexType::LIGHT:
+			return PdfLight(_v, _next);
+		case VertexType::SURFACE: {
+			const BxDF *bxdf = _v.hit.object->material->bxdf;
+			if (!bxdf || !_prev) return 0;
+			const ScatterEvent event = Event(_ctx, _v, Direction(_v, *_prev), Direction(_v, _next));
+			return ConvertDensity(bxdf->Pdf(event.woL, event.wiL, event), _v, _next);
+		}
+		default:
+			return 0;
+	}
+}
+
+Real BDPTIntegrator::PdfLight(const Vertex &_v, const Vertex &_to) const {
+	if (_v.type == VertexType::ESCAPED || !_v.light) return 0;
+	return ConvertDensity(Emission::PdfDirection(*_v.light, _v.normal, Direction(_v, _to)), _v, _to);
+}
+
+Real BDPTIntegrator::PdfLightOrigin(const Context &_ctx, const Vertex &_v) const {
+	if (!_v.light) return 0;
+	ScatterEvent event;
+	event.hit = nullptr;
+	event.scene = _ctx.scene;
+	const Real pickPdf = lightDistribution->Pdf(event, _v.light);
+	if (_v.type == VertexType::ESCAPED) {
+		event.wi = _v.point;
+		return pickPdf * _v.light->PDF_Li(event);
+	}
+	return pickPdf / _v.light->Area();
+}
+
+Spectrum BDPTIntegrator::f(const Context &_ctx, const Vertex &_v, const Vec3 &_wo, const Vec3 &_wi) const {
+	const BxDF *bxdf = _v.hit.object->material->bxdf;
+	return bxdf ? bxdf->f(Event(_ctx, _v, _wo, _wi)) : Spectrum(0);
+}
+
+Spectrum BDPTIntegrator::Emitted(const Context &_ctx, const Vertex &_v, const Vec3 &_w) const {
+	if (_v.type == VertexType::ESCAPED) return ((const EnvironmentLight*)_v.light)->Le(_v.point);
+	if (_v.type != VertexType::SURFACE || !_v.light) return Spectrum(0);
+	return _v.light->L(Event(_ctx, _v, _w, _w));
+}
+
+ScatterEvent BDPTIntegrator::Event(const Context &_ctx, const Vertex &_v, const Vec3 &_wo, const Vec3 &_wi) {
+	ScatterEvent event;
+	event.hit = &_v.hit;
+	event.scene = _ctx.scene;
+	event.wavelength = _ctx.wavelength;
+	event.wo = _wo;
+	event.wi = _wi;
+	event.SurfaceLocalise();
+	return event;
+}
+
+bool BDPTIntegrator::Connectible(const Vertex &_v) {
+	switch (_v.type) {
+		case VertexType::SURFACE: {
+			const BxDF *bxdf = _v.hit.object->material->bxdf;
+			return bxdf && !(bxdf->type & BxDF::BxDF_SPECULAR);
+		}
+		case VertexType::ESCAPED:
+			return false;
+		default:
+			return true;
+	}
+}
+
+Real BDPTIntegrator::ConvertDensity(Real _pdf, const Vertex &_from, const Vertex &_to) {
+	if (_to.type == VertexType::ESCAPED) return _pdf;
+	const Vec3 diff = _to.point - _from.point;
+	const Real distSq = maths::Dot(diff, diff);
+	if (distSq == 0) return 0;
+	if (_to.type == VertexType::SURFACE || (_to.type == VertexType::LIGHT && !_to.delta)) _pdf *= std::abs(maths::Dot(_to.normal, diff)) / std::sqrt(distSq);
+	return _pdf / distSq;
+}
+
+Vec3 BDPTIntegrator::Direction(const Vertex &_from, const Vertex &_to) {
+	return _to.type == VertexType::ESCAPED ? _to.point : (_to.point - _from.point).Normalised();
+}
+
+Real BDPTIntegrator::AbsCos(const Vertex &_v, const Vec3 &_w) {
+	if (_v.type == VertexType::SURFACE) return std::abs(maths::Dot(_v.hit.normalS, _w));
+	if (_v.type == VertexType::LIGHT && !_v.delta) return std::abs(maths::Dot(_v.normal, _w));
+	return 1;
+}
+
+Vec3 BDPTIntegrator::OffsetTowards(const Vertex &_v, const Vec3 &_target) {
+	if (_v.type != VertexType::SURFACE && !(_v.type == VertexType::LIGHT && !_v.delta)) return _v.point;
+	return _v.point + _v.normal * (maths::Dot(_v.normal, _target - _v.point) < 0 ? -SURFACE_EPSILON : SURFACE_EPSILON);
+}
+
+LAMBDA_END
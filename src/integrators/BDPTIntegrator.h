@@ -0,0 +1,157 @@
+/*
+	Bidirectional path tracing, after:
+		Robust Monte Carlo Methods for Light Transport Simulation - Veach, chapter 10
+	- Traces a camera subpath and a light subpath per sample and connects every prefix of one to
+	every prefix of the other, weighting each strategy by the power heuristic over all strategies
+	that could have made the same path.
+	- Strategies with a single camera vertex (light tracing) splat into the film rather than
+	returning through Li(), so they need Prepare() and a camera ConnectPoint() supports.
+	- Lights are picked by power from a distribution independent of the shading point, so light
+	subpath pdfs can be evaluated from either end.
+	- Surfaces only, media are ignored. Environment lights are reached by escaping camera subpaths
+	and by next event estimation, but never start light subpaths.
+*/
+#pragma once
+#include <memory>
+#include <camera/Camera.h>
+#include <camera/Film.h>
+#include <lighting/LightSampler.h>
+#include "Integrator.h"
+
+LAMBDA_BEGIN
+
+class BDPTIntegrator : public Integrator {
+	public:
+		unsigned maxDepth;	//Most segments of a full path, capped at maxPathDepth
+
+		static constexpr unsigned maxPathDepth = 32;
+
+		BDPTIntegrator(Sampler *_sampler, const unsigned _maxDepth = 8);
+
+		Integrator *clone() const override;
+
+		/*
+			Sets the scene lights are picked from and the camera and film light tracing splats with.
+			Clones share the state.
+		*/
+		void Prepare(const Scene &_scene, const Camera *_camera, Film *_film) override;
+
+		Spectrum Li(Ray _ray, const Scene &_scene) const override;
+
+	private:
+		enum class VertexType {
+			CAMERA,
+			LIGHT,	//Start of a light subpath or a light sampled for next event estimation
+			SURFACE,
+			ESCAPED	//Ray left the scene towards the environment light, point holds its direction
+		};
+
+		struct Vertex {
+			VertexType type = VertexType::SURFACE;
+			Spectrum beta = Spectrum(0);	//Subpath throughput up to and including this vertex's pdf
+			Vec3 point, normal;	//Geometric normal, unused for cameras and point lights
+			Vec3 wo;	//Towards the previous vertex of the subpath, surfaces only
+			mutable RayHit hit;	//Surfaces only, mutable as shading reads it through ScatterEvent
+			const Light *light = nullptr;	//Light vertices and emissive surfaces
+			Spectrum Le = Spectrum(0);	//Light vertices, radiance for area lights and intensity for point lights
+			Real pdfFwd = 0, pdfRev = 0;	//Per unit area of sampling this vertex from the subpath's start and end, solid angle when escaped
+			bool delta = false;	//Specular surface or light with a delta position
+		};
+
+		/*
+			State shared by one sample's subpaths.
+		*/
+		struct Context {
+			const Scene *scene;
+			SampledWavelength *wavelength;
+			bool lightTracing;	//The camera can be connected to
+		};
+
+		/*
+			Per vertex values the MIS weight swaps out for each connection.
+		*/
+		struct VertexPdfs {
+			Real pdfFwd, pdfRev;
+			bool delta;
+		};
+
+		const Camera *camera = nullptr;
+		Film *film = nullptr;
+		std::shared_ptr<PowerLightSampler> lightDistribution;
+
+		/*
+			Extends the subpath starting at _path[0] along _ray, whose direction was sampled with solid
+			angle pdf _pdf, until _maxVertices vertices were added or it escapes. Returns the number added.
+		*/
+		unsigned RandomWalk(Ray _ray, Spectrum _beta, Real _pdf, const Context &_ctx, const unsigned _maxVertices, const bool _fromCamera, Vertex *_path) const;
+
+		/*
+			Picks a light, samples a point and direction from it and walks from there. Returns the number
+			of vertices, 0 if an environment light was picked.
+		*/
+		unsigned LightSubpath(const Context &_ctx, const unsigned _maxVertices, Vertex *_path) const;
+
+		/*
+			Contribution of connecting the first _s vertices of _light to the first _t of _camera, MIS
+			weighted. Light tracing strategies (_t == 1) splat to the film and return 0.
+		*/
+		Spectrum Connect(const Context &_ctx, const Vertex *_light, const unsigned _s, const Vertex *_camera, const unsigned _t) const;
+
+		/*
+			Power heuristic weight of the (_s, _t) strategy. _sampled stands in for the last light vertex
+			when _s == 1 and the last camera vertex when _t == 1.
+		*/
+		Real MISWeight(const Context &_ctx, const Vertex *_light, const unsigned _s, const Vertex *_camera, const unsigned _t, const Vertex &_sampled) const;
+
+		/*
+			Pdf per unit area at _next of _v sampling it, having been reached from _prev.
+		*/
+		Real Pdf(const Context &_ctx, const Vertex *_prev, const Vertex &_v, const Vertex &_next) const;
+
+		/*
+			Pdf per unit area at _to of light or emissive surface _v emitting towards it.
+		*/
+		Real PdfLight(const Vertex &_v, const Vertex &_to) const;
+
+		/*
+			Pdf per unit area of a light subpath starting at light or emissive surface _v, solid angle
+			for the environment.
+		*/
+		Real PdfLightOrigin(const Context &_ctx, const Vertex &_v) const;
+
+		/*
+			Bxdf of surface _v scattering from _wi towards _wo, without the cosine.
+		*/
+		Spectrum f(const Context &_ctx, const Vertex &_v, const Vec3 &_wo, const Vec3 &_wi) const;
+
+		/*
+			Radiance leaving emissive surface or escaped vertex _v towards _w.
+		*/
+		Spectrum Emitted(const Context &_ctx, const Vertex &_v, const Vec3 &_w) const;
+
+		static ScatterEvent Event(const Context &_ctx, const Vertex &_v, const Vec3 &_wo, const Vec3 &_wi);
+
+		/*
+			True if _v can be connected to with a shadow ray.
+		*/
+		static bool Connectible(const Vertex &_v);
+
+		/*
+			Converts solid angle pdf _pdf at _from to a pdf per unit area at _to.
+		*/
+		static Real ConvertDensity(Real _pdf, const Vertex &_from, const Vertex &_to);
+
+		static Vec3 Direction(const Vertex &_from, const Vertex &_to);
+
+		/*
+			Cosine factor of _v's emission or scattering along _w.
+		*/
+		static Real AbsCos(const Vertex &_v, const Vec3 &_w);
+
+		/*
+			Shadow ray origin at _v on the side facing _target.
+		*/
+		static Vec3 OffsetTowards(const Vertex &_v, const Vec3 &_target);
+};
+
+LAMBDA_END
@@ -18,8 +18,10 @@ Spectrum DirectLightingIntegrator::Li(Ray _ray, const Scene &_scene) const {
 			event.hit = &hit;
 			event.scene = &_scene;
 			event.wo = -_ray.d;
+			SampledWavelength wavelength;
+			SampleWavelength(event, wavelength);
 			event.SurfaceLocalise();
-			return SampleOneLight(event, _scene);
+			return SampleOneLight(event, _scene, true);
 		}
 		else {
 			return Li(Ray(hit.point + _ray.d * .0001, _ray.d), _scene);
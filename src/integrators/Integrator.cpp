@@ -1,9 +1,42 @@
+#include <lighting/ReservoirLightSampler.h>
+#include <render/Render.h>
 #include "Integrator.h"
 
 LAMBDA_BEGIN
 
-Spectrum Integrator::SampleOneLight(ScatterEvent &_event, const Scene &_scene) const {
+void Integrator::Prepare(const Scene &_scene, const Camera *_camera, Film *_film) {
+	if (guidingField) guidingField->Reset(_scene.GetBounds());
+}
+
+void Integrator::EndPass() {
+	if (guidingField) guidingField->EndPass();
+}
+
+void Integrator::RenderPixels(const RenderTile *_tile, const PixelSamples *_pixels, const unsigned _n) {
+	const unsigned w = _tile->film->filmData.GetWidth();
+	const unsigned h = _tile->film->filmData.GetHeight();
+	const Real xi = (Real)1 / w;
+	const Real yi = (Real)1 / h;
+	const Real diffScale = 1 / std::sqrt((Real)std::max(_tile->spp, 1u));	//Each sample's share of the pixel
+	for (unsigned p = 0; p < _n; ++p) {
+		const PixelSamples &pixel = _pixels[p];
+		if (sampler->sampleShifter) sampler->sampleShifter->SetPixelIndex(w, h, pixel.x, pixel.y);
+		sampler->SetSample(pixel.first);
+		pixelIndex = pixel.y * w + pixel.x;
+		for (unsigned i = 0; i < pixel.n; ++i) {
+			const Real dx = sampler->Get1D() - .5;
+			const Real dy = sampler->Get1D() - .5;
+			Ray r = _tile->camera->GenerateRayDifferential(xi * ((Real)pixel.x + dx), yi * ((Real)pixel.y + dy), xi, yi, *sampler);
+			r.ScaleDifferentials(diffScale);
+			_tile->filmTile->AddSample(Li(r, *_tile->scene), pixel.x, pixel.y, dx, dy);
+			sampler->NextSample();
+		}
+	}
+}
+
+Spectrum Integrator::SampleOneLight(ScatterEvent &_event, const Scene &_scene, const bool _cameraHit) const {
 	if (_event.hit->object->material->bxdf) {
+		if (const ReservoirLightSampler *rs = dynamic_cast<const ReservoirLightSampler*>(_scene.lightSampler)) return rs->SampleDirect(_event, *sampler, _cameraHit ? pixelIndex : ~0u);
 		Real lightPdf = 1;
 		Light *l = _scene.lightSampler->Sample(_event, *sampler, &lightPdf);
 		return EstimateDirect(_event, _scene, *l) / lightPdf;
@@ -11,6 +44,66 @@ Spectrum Integrator::SampleOneLight(ScatterEvent &_event, const Scene &_scene) c
 	return Spectrum(0);
 }
 
+Spectrum Integrator::GuidedSample_f(ScatterEvent &_event, Real &_pdf) const {
+	const BxDF *bxdf = _event.hit->object->material->bxdf;
+	const GuidingField::Leaf *leaf = (bxdf->type & BxDF::BxDF_SPECULAR) ? nullptr : GuideLeaf(_event.hit->point);
+	if (!leaf) return bxdf->Sample_f(_event, *sampler, _pdf) * std::abs(_event.wiL.y);
+	const Real alpha = guidingField->guideProbability;
+	Spectrum f;
+	Real bxdfPdf, guidePdf;
+	if (sampler->Get1D() < alpha) {
+		_event.wi = GuidingField::Sample(*leaf, sampler->Get2D(), &guidePdf);
+		_event.wiL = _event.ToLocal(_event.wi);
+		f = bxdf->f(_event);
+		bxdfPdf = bxdf->Pdf(_event.woL, _event.wiL, _event);
+	}
+	else {
+		f = bxdf->Sample_f(_event, *sampler, bxdfPdf);
+		if (bxdfPdf == 0) {
+			_pdf = 0;
+			return Spectrum(0);
+		}
+		guidePdf = GuidingField::Pdf(*leaf, _event.wi);
+	}
+	_pdf = alpha * guidePdf + (1 - alpha) * bxdfPdf;
+	return f * std::abs(_event.wiL.y);
+}
+
+Real Integrator::GuidedPdf_f(const ScatterEvent &_event) const {
+	const BxDF *bxdf = _event.hit->object->material->bxdf;
+	const Real bxdfPdf = bxdf->Pdf(_event.woL, _event.wiL, _event);
+	const GuidingField::Leaf *leaf = (bxdf->type & BxDF::BxDF_SPECULAR) ? nullptr : GuideLeaf(_event.hit->point);
+	if (!leaf) return bxdfPdf;
+	const Real alpha = guidingField->guideProbability;
+	return alpha * GuidingField::Pdf(*leaf, _event.wi) + (1 - alpha) * bxdfPdf;
+}
+
+Real Integrator::GuidedSample_p(ScatterEvent &_event, const Vec3 &_p, Real &_pdf) const {
+	const PhaseFunction *phase = _event.medium->phase;
+	const GuidingField::Leaf *leaf = GuideLeaf(_p);
+	if (!leaf) return _pdf = phase->Sample_p(_event.wo, &_event.wi, *sampler);
+	const Real alpha = guidingField->guideProbability;
+	Real p, guidePdf;
+	if (sampler->Get1D() < alpha) {
+		_event.wi = GuidingField::Sample(*leaf, sampler->Get2D(), &guidePdf);
+		p = phase->p(_event.wo, _event.wi);
+	}
+	else {
+		p = phase->Sample_p(_event.wo, &_event.wi, *sampler);
+		guidePdf = GuidingField::Pdf(*leaf, _event.wi);
+	}
+	_pdf = alpha * guidePdf + (1 - alpha) * p;
+	return p;
+}
+
+Real Integrator::GuidedPdf_p(const ScatterEvent &_event, const Vec3 &_p) const {
+	const Real p = _event.medium->phase->p(_event.wo, _event.wi);
+	const GuidingField::Leaf *leaf = GuideLeaf(_p);
+	if (!leaf) return p;
+	const Real alpha = guidingField->guideProbability;
+	return alpha * GuidingField::Pdf(*leaf, _event.wi) + (1 - alpha) * p;
+}
+
 Spectrum Integrator::EstimateDirect(ScatterEvent &_event, const Scene &_scene, const Light &_light) const {
 	Spectrum Ld(0);
 	Real scatteringPDF, lightPDF;
@@ -3,22 +3,98 @@
 #include <core/Scene.h>
 #include <shading/surface/BxDF.h>
 #include <shading/media/Media.h>
+#include <sampling/GuidingField.h>
 
 LAMBDA_BEGIN
 
+class Camera;
+class Film;
+struct RenderTile;
+struct PixelSamples;
+
 class Integrator {
 	public:
 		Sampler *sampler;
+		bool spectralDispersion = false;	//Each path samples a wavelength for dispersive BSDFs, transport stays RGB
+		unsigned pixelIndex = ~0u;	//Film pixel of the path being traced, set by the tile renderers for light samplers that reuse samples
+		GuidingField *guidingField = nullptr;	//Shared by all tiles' clones, trained by integrators that support guiding
 
 		virtual Integrator *clone() const = 0;
 
+		/*
+			Sets up state shared by every clone, RenderMosaic calls it once before cloning for the
+			tiles. The default resets the guiding field to the scene's bounds.
+		*/
+		virtual void Prepare(const Scene &_scene, const Camera *_camera, Film *_film);
+
+		/*
+			Called before every pass while no tiles are running, single pass renderers call it once
+			after Prepare().
+		*/
+		virtual void BeginPass(const Scene &_scene) {}
+
+		/*
+			Called after a progressive pass's tiles have all finished. The default lets the guiding
+			field refine itself.
+		*/
+		virtual void EndPass();
+
 		virtual Spectrum Li(Ray _ray, const Scene &_scene) const = 0;
 
-		Spectrum SampleOneLight(ScatterEvent &_event, const Scene &_scene) const;
+		/*
+			Adds the requested samples for each of the _n pixels of _tile to its film tile, every tile
+			renderer draws its samples through here. The default traces one Li() path at a time.
+		*/
+		virtual void RenderPixels(const RenderTile *_tile, const PixelSamples *_pixels, const unsigned _n);
+
+		/*
+			Direct light at _event from one light sample. _cameraHit marks the first non-specular
+			hit of a camera path, the only hit a reservoir light sampler may reuse samples at.
+		*/
+		Spectrum SampleOneLight(ScatterEvent &_event, const Scene &_scene, const bool _cameraHit = false) const;
 
 		Spectrum EstimateDirect(ScatterEvent &_event, const Scene &_scene, const Light &_light) const;
 
 	protected:
+		/*
+			Samples a new wavelength into _wavelength and attaches it to _event, if spectralDispersion is set.
+		*/
+		inline void SampleWavelength(ScatterEvent &_event, SampledWavelength &_wavelength) const {
+			if (!spectralDispersion) return;
+			_wavelength = SampledWavelength::Sample(sampler->Get1D());
+			_event.wavelength = &_wavelength;
+		}
+
+		/*
+			Samples the direction leaving a surface event like Sample_f(), returning f * |cos|. Once the
+			guiding field is trained, non-specular bxdfs pick between themselves and the field and
+			_pdf is the combined pdf.
+		*/
+		Spectrum GuidedSample_f(ScatterEvent &_event, Real &_pdf) const;
+
+		/*
+			Pdf of GuidedSample_f() producing _event's wi, for MIS against light sampling.
+		*/
+		Real GuidedPdf_f(const ScatterEvent &_event) const;
+
+		/*
+			Samples the direction leaving a medium event at _p, returning the phase function value.
+			Without guiding this equals _pdf.
+		*/
+		Real GuidedSample_p(ScatterEvent &_event, const Vec3 &_p, Real &_pdf) const;
+
+		/*
+			Pdf of GuidedSample_p() producing _event's wi at _p.
+		*/
+		Real GuidedPdf_p(const ScatterEvent &_event, const Vec3 &_p) const;
+
+		/*
+			Guiding field leaf to sample at _p, null while guiding doesn't apply.
+		*/
+		inline const GuidingField::Leaf *GuideLeaf(const Vec3 &_p) const {
+			return guidingField && guidingField->Trained() ? guidingField->Lookup(_p) : nullptr;
+		}
+
 		static inline Real PowerHeuristic(int nf, Real fPdf, int ng, Real gPdf) {
 			const Real f = nf * fPdf, g = ng * gPdf;
 			return (f * f) / (f * f + g * g);
@@ -33,17 +33,17 @@ Spectrum MISVolumetricPathIntegrator::LdMediumPoint(ScatterEvent &_event, const
 	Spectrum Ld(0);
 	
 	if (lightPDF > 0 && !Li.IsBlack()) {
-		scatteringPDF = _event.medium->phase->p(_event.wo, _event.wi);
-		if (scatteringPDF > 0) {
-			Spectrum p(scatteringPDF);
+		const Real p = _event.medium->phase->p(_event.wo, _event.wi);
+		scatteringPDF = GuidedPdf_p(_event, _p);
+		if (p > 0) {
 			const Real weight = PowerHeuristic(1, lightPDF, 1, scatteringPDF);
 			Ld += Li * p * weight / lightPDF;
 		}
 	}
 
-	scatteringPDF = _event.medium->phase->Sample_p(_event.wo, &_event.wi, *sampler);
+	const Real p = GuidedSample_p(_event, _p, scatteringPDF);
 	*_wi = _event.wi;
-	*_f = scatteringPDF;
+	*_f = scatteringPDF > 0 ? p / scatteringPDF : 0;
 
 	Ray r = { _p, _event.wi };
 	Spectrum Tr(1);
@@ -60,7 +60,7 @@ Spectrum MISVolumetricPathIntegrator::LdMediumPoint(ScatterEvent &_event, const
 			else Li = nl->Le(r);	//Special case for infinite lights
 			const Real weight = PowerHeuristic(scatteringPDF, lightPDF);
 			if (!Li.IsBlack() && lightPDF > 0) {
-				Ld += Li * Tr * weight / scatteringPDF;
+				Ld += Li * Tr * p * weight / scatteringPDF;
 			}
 		}
 	}
@@ -75,8 +75,11 @@ Spectrum MISVolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 	event.hit = &hit;
 	event.scene = &_scene;
 	event.wo = -r.d;
+	SampledWavelength wavelength;
+	SampleWavelength(event, wavelength);
 	bool scatterIntersect = false;
 	event.medium = InMedium(r.o, _scene);
+	GuidingPath guidePath(guidingField && guidingField->Training() ? guidingField : nullptr);
 	for (int bounces = 0; bounces < maxBounces; ++bounces) {
 		if (bounces == 0 ? _scene.Intersect(r, hit) : scatterIntersect) {
 
@@ -129,20 +132,22 @@ Spectrum MISVolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 					const Real equiangularW = PowerHeuristic(equiangularPDF, distancePDF2);
 
 					// Decide what path to continue (last function to make modifications)
-					Real phasePDF;
+					Real phaseWeight[2];
 					Vec3 wi[2];
-					const Spectrum liDistance = LdMediumPoint(event, mediumPoint[DISTANCE], &lSample, &wi[DISTANCE], &phasePDF);
+					const Spectrum liDistance = LdMediumPoint(event, mediumPoint[DISTANCE], &lSample, &wi[DISTANCE], &phaseWeight[DISTANCE]);
 					Ld += liDistance * mediumTr[DISTANCE] * distanceW;
-					const Spectrum liEquiangular = LdMediumPoint(event, mediumPoint[EQUIANGULAR], &lSample, &wi[EQUIANGULAR], &phasePDF);
+					const Spectrum liEquiangular = LdMediumPoint(event, mediumPoint[EQUIANGULAR], &lSample, &wi[EQUIANGULAR], &phaseWeight[EQUIANGULAR]);
 					Ld += liEquiangular * mediumTr[EQUIANGULAR] * equiangularW;
 
 					r.o = mediumPoint[pathChoice];
 					r.d = wi[pathChoice];
+					r.hasDifferentials = false;
 					scatterIntersect = _scene.Intersect(r, hit);	//Next path vertex (doesn't skip through media)
 
-					L += Ld;
-					beta *= mediumTr[pathChoice];	// throughput for rest of path
-					// phase function is perfectly proportional to pdf => beta *= p / p is redundant
+					guidePath.AddRadiance(beta * Ld);
+					guidePath.AddVertex(r.o, r.d, beta * mediumTr[pathChoice] * phaseWeight[pathChoice]);
+					L += beta * Ld;
+					beta *= mediumTr[pathChoice] * phaseWeight[pathChoice];	// throughput for rest of path, phase weight is 1 unless guided
 				}
 			}
 			else event.mediumInteraction = false;
@@ -160,17 +165,18 @@ Spectrum MISVolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 					lightPDF *= lightDistPdf;	//True pdf of light
 					if (lightPDF > 0 && !Li.IsBlack()) {	//Add light sample contribution
 						f = hit.object->material->bxdf->f(event) * std::abs(event.wiL.y);
-						scatteringPDF = hit.object->material->bxdf->Pdf(event.woL, event.wiL, event);
+						scatteringPDF = GuidedPdf_f(event);
 						if (!f.IsBlack() && scatteringPDF > 0) {
 							const Real weight = PowerHeuristic(lightPDF, scatteringPDF);
 							Ld += Li * f * weight / lightPDF;
 						}
 					}
-					f = hit.object->material->bxdf->Sample_f(event, *sampler, scatteringPDF);
-					f *= std::abs(event.wiL.y);	//This must follow previous line to allow computation of wiL.
+					const Spectrum Lnee = Ld;
+					f = GuidedSample_f(event, scatteringPDF);
 
 					r.o = hit.point;
 					r.d = event.wi;
+					r.hasDifferentials = false;
 					event.medium = hit.object->material->mediaBoundary.GetMedium(event.wi, hit.normalG);	//Evaluate any medium we are going into before we get new hit
 
 					scatterIntersect = _scene.Intersect(r, hit);	//Go to next path vertex and potential light contribution
@@ -186,8 +192,15 @@ Spectrum MISVolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 							if (!Li.IsBlack() && lightPDF > 0) Ld += Li * f * weight / scatteringPDF;
 						}
 					}
-					else break;	//Don't continue path if bsdf is 0 or if scattering pdf is 0
+					else {	//Don't continue path if bsdf is 0 or if scattering pdf is 0, but keep the light sampled here
+						guidePath.AddRadiance(beta * Ld);
+						L += beta * Ld;
+						break;
+					}
 
+					guidePath.AddRadiance(beta * Lnee);	//Sampled light arrived along the previous vertex's direction, not this one's
+					guidePath.AddVertex(r.o, r.d, beta * f / scatteringPDF);
+					guidePath.AddRadiance(beta * (Ld - Lnee));
 					L += beta * Ld;
 					beta *= f / scatteringPDF;
 				}
@@ -211,6 +224,7 @@ Spectrum MISVolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 			break;
 		}
 	}
+	guidePath.Commit();
 	return L;
 }
 
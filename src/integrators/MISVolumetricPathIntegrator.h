@@ -13,7 +13,8 @@ class MISVolumetricPathIntegrator : public Integrator {
 		Integrator *clone() const override;
 
 		/*
-			Evaluate direct lighting at point _p in medium.
+			Evaluate direct lighting at point _p in medium. Samples the next direction into _wi, with
+			the phase function over its pdf in _f.
 		*/
 		Spectrum LdMediumPoint(ScatterEvent &_event, const Vec3 &_p, PartialLightSample *_ls, Vec3 *_wi, Real *_f) const;
 
@@ -1,3 +1,4 @@
+#include <lighting/ReservoirLightSampler.h>
 #include "PathIntegrator.h"
 
 LAMBDA_BEGIN
@@ -19,7 +20,11 @@ Spectrum PathIntegrator::Li(Ray r, const Scene &_scene) const {
 	event.hit = &hit;
 	event.scene = &_scene;
 	event.wo = -r.d;
+	SampledWavelength wavelength;
+	SampleWavelength(event, wavelength);
 	bool scatterIntersect = false;
+	const ReservoirLightSampler *reservoirSampler = dynamic_cast<const ReservoirLightSampler*>(_scene.lightSampler);
+	GuidingPath guidePath(guidingField && guidingField->Training() ? guidingField : nullptr);
 	for (int bounces = 0; bounces < maxBounces; ++bounces) {
 		if (bounces == 0 ? _scene.Intersect(r, hit) : scatterIntersect) {
 			
@@ -30,24 +35,31 @@ Spectrum PathIntegrator::Li(Ray r, const Scene &_scene) const {
 				event.SurfaceLocalise();	//Calculate tangent space wo and wi
 
 				Real lightDistPdf = 1;	//Probability of choosing dicrete light (line below)
-				const Light *l = _scene.lightSampler->Sample(event, *sampler, &lightDistPdf);
+				const Light *l = nullptr;
 				Spectrum Ld(0);
-				Real scatteringPDF, lightPDF;
-				Spectrum f, Li = l->Sample_Li(event, sampler, lightPDF);
-				lightPDF *= lightDistPdf;	//The full light pdf
+				Real scatteringPDF, lightPDF = 0;
+				Spectrum f, Li;
+				if (reservoirSampler) Ld = reservoirSampler->SampleDirect(event, *sampler, bounces == 0 ? pixelIndex : ~0u);	//Resampled, so it isn't MIS weighted
+				else {
+					l = _scene.lightSampler->Sample(event, *sampler, &lightDistPdf);
+					Li = l->Sample_Li(event, sampler, lightPDF);
+					lightPDF *= lightDistPdf;	//The full light pdf
+				}
 				if (lightPDF > 0 && !Li.IsBlack()) {	//Add light sample contribution
 					f = hit.object->material->bxdf->f(event) * std::abs(event.wiL.y);
-					scatteringPDF = hit.object->material->bxdf->Pdf(event.woL, event.wiL, event);
+					scatteringPDF = GuidedPdf_f(event);
 					if (!f.IsBlack() && scatteringPDF > 0) {
 						const Real weight = PowerHeuristic(lightPDF, scatteringPDF);
 						Ld += Li * f * weight / lightPDF;
 					}
 				}
-				f = hit.object->material->bxdf->Sample_f(event, *sampler, scatteringPDF);
-				f *= std::abs(event.wiL.y);	//This must follow previous line to allow computation of wiL
+				const Spectrum Lnee = Ld;
+				f = GuidedSample_f(event, scatteringPDF);
+				const bool specular = reservoirSampler && (hit.object->material->bxdf->type & BxDF::BxDF_SPECULAR);
 
 				r.o = hit.point;
 				r.d = event.wi;
+				r.hasDifferentials = false;
 				scatterIntersect = _scene.Intersect(r, hit);	//Go to next path vertex (also the bxdf light sample)
 				if (scatteringPDF > 0 && !f.IsBlack()) {	//Add bsdf-scatter light contribution
 					if (const Light *nl = scatterIntersect ? hit.object->material->light : (Light*)_scene.envLight) {	//Check a light was hit or infinite light is present
@@ -56,13 +68,20 @@ Spectrum PathIntegrator::Li(Ray r, const Scene &_scene) const {
 						lightPDF = lightDistPdf * nl->PDF_Li(event);	//Full light pdf
 						if (scatterIntersect) Li = nl->L(event);
 						else Li = nl->Le(r);	//Special case for infinite lights
-						const Real weight = PowerHeuristic(scatteringPDF, lightPDF);
-						if (!Li.IsBlack() && lightPDF > 0) Ld += Li * f * weight / scatteringPDF;
+						const Real weight = reservoirSampler ? (specular ? 1 : 0) : PowerHeuristic(scatteringPDF, lightPDF);	//Resampled light samples already cover non-specular surfaces
+						if (!Li.IsBlack() && (specular || lightPDF > 0)) Ld += Li * f * weight / scatteringPDF;
 
 					}
 				}
-				else break;	//Don't continue path if bsdf is 0 or if scattering pdf is 0
+				else {	//Don't continue path if bsdf is 0 or if scattering pdf is 0, but keep the light sampled here
+					guidePath.AddRadiance(beta * Ld);
+					L += beta * Ld;
+					break;
+				}
 
+				guidePath.AddRadiance(beta * Lnee);	//Sampled light arrived along the previous vertex's direction, not this one's
+				guidePath.AddVertex(r.o, r.d, beta * f / scatteringPDF);
+				guidePath.AddRadiance(beta * (Ld - Lnee));
 				L += beta * Ld;
 				beta *= f / scatteringPDF;
 			}
@@ -84,6 +103,7 @@ Spectrum PathIntegrator::Li(Ray r, const Scene &_scene) const {
 			break;
 		}
 	}
+	guidePath.Commit();
 	return L;
 }
 
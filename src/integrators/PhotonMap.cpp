@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <lighting/Emission.h>
+#include <sampling/RandomSampler.h>
+#include <shading/surface/BxDF.h>
+#include "PhotonMap.h"
+
+LAMBDA_BEGIN
+
+PhotonMap::PhotonMap() : radius(0), invCellSize(0), pass(0), numEmitted(0), tableMask(0) {}
+
+void PhotonMap::Reset(const Scene &_scene) {
+	bounds = _scene.GetBounds();
+	radius = initialRadius > 0 ? initialRadius : (Real).01 * bounds.MaxLength();
+	if (!(radius > 0)) radius = (Real).01;	//Empty or flat scene bounds
+	pass = 0;
+	numEmitted = 0;
+	photons.clear();
+	cellStart.clear();
+	lightDistribution.reset(new PowerLightSampler(_scene));
+	if (!_scene.lights.empty()) lightDistribution->Commit();
+	if (!pool) pool.reset(new ThreadPool(numBuildThreads));
+}
+
+void PhotonMap::Build(const Scene &_scene) {
+	if (!lightDistribution) return;	//Not reset
+	if (pass > 0) radius *= std::sqrt((pass + alpha) / (pass + 1));
+	++pass;
+	invCellSize = 1 / (2 * radius);	//A sphere of the radius overlaps at most 2x2x2 cells
+	numEmitted = photonsPerPass;
+
+	const size_t numChunks = (photonsPerPass + traceChunkSize - 1) / traceChunkSize;
+	std::vector<std::vector<Photon>> chunks(numChunks);
+	if (!_scene.lights.empty()) {
+		ParallelChunks(*pool, photonsPerPass, traceChunkSize, [&](const size_t _chunk, const size_t _begin, const size_t _end) {
+			TracePhotons(_scene, _chunk, _end - _begin, &chunks[_chunk]);
+		});
+	}
+	size_t numPhotons = 0;
+	for (const auto &chunk : chunks) numPhotons += chunk.size();
+
+	uint32_t tableSize = 1;
+	while (tableSize < 2 * numPhotons && tableSize < (1u << 31)) tableSize <<= 1;
+	tableMask = tableSize - 1;
+
+	//Counting sort into cells, count then scatter with atomic cursors
+	std::vector<std::atomic<uint32_t>> cursors(tableSize);
+	for (auto &c : cursors) c.store(0, std::memory_order_relaxed);
+	ParallelChunks(*pool, numChunks, 1, [&](const size_t _chunk, const size_t, const size_t) {
+		for (const Photon &p : chunks[_chunk]) cursors[Cell(p.point)].fetch_add(1, std::memory_order_relaxed);
+	});
+	cellStart.resize((size_t)tableSize + 1);
+	cellStart[0] = 0;
+	for (uint32_t i = 0; i < tableSize; ++i) {
+		cellStart[i + 1] = cellStart[i] + cursors[i].load(std::memory_order_relaxed);
+		cursors[i].store(cellStart[i], std::memory_order_relaxed);
+	}
+	photons.resize(numPhotons);
+	ParallelChunks(*pool, numChunks, 1, [&](const size_t _chunk, const size_t, const size_t) {
+		for (const Photon &p : chunks[_chunk]) photons[cursors[Cell(p.point)].fetch_add(1, std::memory_order_relaxed)] = p;
+	});
+}
+
+void PhotonMap::TracePhotons(const Scene &_scene, const size_t _chunk, const size_t _count, std::vector<Photon> *_out) const {
+	RandomSampler rs(((uint64_t)pass << 32) ^ _chunk);
+	RayHit hit;
+	ScatterEvent event;
+	event.hit = &hit;
+	event.scene = &_scene;
+	_out->reserve(_count * 2);
+	for (size_t i = 0; i < _count; ++i) {
+		rs.SetSample((unsigned)i);
+		Real pickPdf = 0;
+		Light *light = lightDistribution->Sample(event, rs, &pickPdf);
+		EmissionSample es;
+		if (!light || pickPdf == 0 || !Emission::Sample(*light, rs, event, &es)) continue;
+		Spectrum beta = es.Le * es.directional / (pickPdf * es.pdfPos * es.pdfDir);
+		Ray ray(es.point, es.direction);
+		if (!es.deltaPosition) ray.o += es.normal * (maths::Dot(es.direction, es.normal) < 0 ? -SURFACE_EPSILON : SURFACE_EPSILON);
+
+		for (unsigned depth = 0; depth < maxDepth;) {
+			if (!_scene.Intersect(ray, hit)) break;
+			const Material *material = hit.object->material;
+			const BxDF *bxdf = material ? material->bxdf : nullptr;
+			if (!bxdf) {	//Pass through surfaces that don't scatter
+				ray.o = hit.point + hit.normalG * (maths::Dot(ray.d, hit.normalG) < 0 ? -SURFACE_EPSILON : SURFACE_EPSILON);
+				continue;
+			}
+			event.wo = -ray.d;
+			event.SurfaceLocalise();
+			if (depth > 0 && !(bxdf->type & BxDF::BxDF_SPECULAR)) _out->push_back({ hit.point, event.wo, beta });
+			if (++depth >= maxDepth) break;
+
+			Real pdf;
+			const Spectrum f = bxdf->Sample_f(event, rs, pdf) * std::abs(event.wiL.y);
+			if (pdf == 0 || f.IsBlack()) break;
+			const Spectrum betaNext = beta * f / pdf;
+			const Real q = std::max((Real)0, 1 - betaNext.y() / std::max(beta.y(), (Real)1e-20));	//Keep photon flux roughly constant
+			if (rs.Get1D() < q) break;
+			beta = betaNext / (1 - q);
+			ray = Ray(hit.point, event.wi);	//Sample_f() offset the point to the side wi leaves from
+		}
+	}
+}
+
+Spectrum PhotonMap::Estimate(ScatterEvent &_event) const {
+	if (photons.empty() || numEmitted == 0) return Spectrum(0);
+	const BxDF *bxdf = _event.hit->object->material->bxdf;
+	const Vec3 p = _event.hit->point;
+	const Vec3 g = (p - bounds.min - Vec3(radius, radius, radius)) * invCellSize;
+	const int x = (int)std::floor(g.x), y = (int)std::floor(g.y), z = (int)std::floor(g.z);
+	uint32_t visited[8];
+	unsigned numVisited = 0;
+	const Real r2 = radius * radius;
+	Spectrum sum(0);
+	for (unsigned i = 0; i < 8; ++i) {
+		const uint32_t cell = Hash(x + (i & 1), y + ((i >> 1) & 1), z + (i >> 2));
+		if (std::find(visited, visited + numVisited, cell) != visited + numVisited) continue;	//Cells can share a slot
+		visited[numVisited++] = cell;
+		for (uint32_t j = cellStart[cell], end = cellStart[cell + 1]; j < end; ++j) {
+			const Photon &photon = photons[j];
+			if (maths::DistSq(photon.point, p) > r2) continue;
+			_event.wi = photon.wi;
+			_event.wiL = _event.ToLocal(photon.wi);
+			sum += bxdf->f(_event) * photon.beta;
+		}
+	}
+	return sum / (PI * r2 * (Real)numEmitted);
+}
+
+LAMBDA_END
@@ -0,0 +1,93 @@
+/*
+	Photons traced from the lights and stored in a hash grid for density estimation, after:
+		Progressive Photon Mapping: A Probabilistic Approach - Knaus & Zwicker
+	- Build() traces a fresh set of photons each progressive pass and shrinks the gather radius,
+	so the average of the passes' estimates converges even though each pass is biased.
+	- Photons are traced in parallel chunks, each chunk with its own random stream, then sorted
+	into grid cells with a counting sort so every cell's photons are contiguous in memory.
+	- Only photons that scattered at least once are stored, direct lighting is left to next event
+	estimation. Photons aren't stored on specular surfaces, which can't gather them.
+	- Photons are traced in RGB. Environment lights don't emit photons.
+	- Build() must not overlap with rendering, Estimate() may be called from any number of threads.
+*/
+#pragma once
+#include <memory>
+#include <vector>
+#include <core/Scene.h>
+#include <lighting/LightSampler.h>
+#include <shading/ScatterEvent.h>
+#include <utility/Concurrency.h>
+
+LAMBDA_BEGIN
+
+class PhotonMap {
+	public:
+		unsigned photonsPerPass = 1 << 18;	//Photons emitted by each Build()
+		unsigned maxDepth = 16;	//Most surfaces a photon scatters off
+		Real initialRadius = 0;	//Gather radius of the first pass, 0 = 1% of the scene bounds' longest side
+		Real alpha = (Real)2 / 3;	//Fraction of photons kept per pass, lower shrinks the radius faster
+		unsigned numBuildThreads = 0;	//0 = hardware threads
+
+		struct Photon {
+			Vec3 point, wi;	//wi points back towards where the photon came from
+			Spectrum beta;	//Flux carried, before dividing by the number emitted
+		};
+
+		PhotonMap();
+
+		/*
+			Drops all photons and starts over for _scene, with the initial radius.
+		*/
+		void Reset(const Scene &_scene);
+
+		/*
+			Shrinks the radius if this isn't the first pass, then traces and stores a new set of photons.
+		*/
+		void Build(const Scene &_scene);
+
+		/*
+			Radiance reflected along _event's wo from the photons within the radius of its hit point.
+			Overwrites _event's wi.
+		*/
+		Spectrum Estimate(ScatterEvent &_event) const;
+
+		inline Real Radius() const {
+			return radius;
+		}
+
+		inline size_t NumPhotons() const {
+			return photons.size();
+		}
+
+	private:
+		Bounds bounds;
+		Real radius, invCellSize;
+		unsigned pass;
+		size_t numEmitted;
+		uint32_t tableMask;
+		std::vector<Photon> photons;	//Sorted by hash cell
+		std::vector<uint32_t> cellStart;	//Cell i's photons are [cellStart[i], cellStart[i + 1])
+		std::unique_ptr<PowerLightSampler> lightDistribution;
+		std::unique_ptr<ThreadPool> pool;
+
+		static constexpr size_t traceChunkSize = 1 << 12;
+
+		/*
+			Traces _count photons with the random stream of chunk _chunk, appending the stored ones to _out.
+		*/
+		void TracePhotons(const Scene &_scene, const size_t _chunk, const size_t _count, std::vector<Photon> *_out) const;
+
+		/*
+			Hash table slot of the grid cell holding _p.
+		*/
+		inline uint32_t Cell(const Vec3 &_p) const {
+			const Vec3 g = (_p - bounds.min) * invCellSize;
+			return Hash((int)std::floor(g.x), (int)std::floor(g.y), (int)std::floor(g.z));
+		}
+
+		inline uint32_t Hash(const int _x, const int _y, const int _z) const {
+			return (((uint32_t)_x * 73856093u) ^ ((uint32_t)_y * 19349663u) ^ ((uint32_t)_z * 83492791u)) & tableMask;
+		}
+};
+
+LAMBDA_END
@@ -0,0 +1,64 @@
+#include "PhotonMappingIntegrator.h"
+
+LAMBDA_BEGIN
+
+PhotonMappingIntegrator::PhotonMappingIntegrator(Sampler *_sampler, PhotonMap *_photonMap, const unsigned _maxSpecularDepth) {
+	sampler = _sampler;
+	photonMap = _photonMap;
+	maxSpecularDepth = _maxSpecularDepth;
+}
+
+Integrator *PhotonMappingIntegrator::clone() const {
+	return new PhotonMappingIntegrator(*this);
+}
+
+void PhotonMappingIntegrator::Prepare(const Scene &_scene, const Camera *_camera, Film *_film) {
+	Integrator::Prepare(_scene, _camera, _film);
+	if (photonMap) photonMap->Reset(_scene);
+}
+
+void PhotonMappingIntegrator::BeginPass(const Scene &_scene) {
+	if (photonMap) photonMap->Build(_scene);	//Tiles read it, so rebuild before they start
+}
+
+Spectrum PhotonMappingIntegrator::Li(Ray _ray, const Scene &_scene) const {
+	Spectrum L(0), beta(1);
+	RayHit hit;
+	ScatterEvent event;
+	event.hit = &hit;
+	event.scene = &_scene;
+	bool specularBounce = false;
+	for (int depth = 0; depth <= (int)maxSpecularDepth; ++depth) {
+		if (!_scene.Intersect(_ray, hit)) {	//Only reached from the camera or specular bounces, so nothing else accounts for it
+			if (_scene.envLight) L += beta * ((Light*)_scene.envLight)->Le(_ray);
+			break;
+		}
+		event.wo = -_ray.d;
+		const Material *material = hit.object->material;
+		if (material && material->light) L += beta * material->light->L(event);
+		if (!material || !material->bxdf) {
+			_ray.o = hit.point + hit.normalG * (maths::Dot(_ray.d, hit.normalG) < 0 ? -SURFACE_EPSILON : SURFACE_EPSILON);
+			_ray.hasDifferentials = false;
+			--depth;
+			continue;
+		}
+		const BxDF *bxdf = material->bxdf;
+		event.SurfaceLocalise();
+		if (!(bxdf->type & BxDF::BxDF_SPECULAR)) {
+			const Spectrum direct = SampleOneLight(event, _scene, !specularBounce);
+			L += beta * (direct + (photonMap ? photonMap->Estimate(event) : Spectrum(0)));
+			break;
+		}
+		Real pdf;
+		const Spectrum f = bxdf->Sample_f(event, *sampler, pdf) * std::abs(event.wiL.y);
+		if (pdf == 0 || f.IsBlack()) break;
+		beta *= f / pdf;
+		specularBounce = true;
+		_ray.o = hit.point;
+		_ray.d = event.wi;
+		_ray.hasDifferentials = false;
+	}
+	return L;
+}
+
+LAMBDA_END
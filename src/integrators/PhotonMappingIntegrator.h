@@ -0,0 +1,30 @@
+#pragma once
+#include "Integrator.h"
+#include "PhotonMap.h"
+
+LAMBDA_BEGIN
+
+/*
+	Follows camera paths through specular bounces to the first surface that isn't specular, then
+	adds next event estimation and the photon map's estimate of indirect light there.
+	- The photon map is shared by all clones. Prepare() resets it and BeginPass() traces a new set
+	of photons, so progressive renders rebuild it every pass.
+	- Always renders in RGB, as photons are traced in RGB.
+*/
+class PhotonMappingIntegrator : public Integrator {
+	public:
+		unsigned maxSpecularDepth;
+		PhotonMap *photonMap;
+
+		PhotonMappingIntegrator(Sampler *_sampler, PhotonMap *_photonMap, const unsigned _maxSpecularDepth = 16);
+
+		Integrator *clone() const override;
+
+		void Prepare(const Scene &_scene, const Camera *_camera, Film *_film) override;
+
+		void BeginPass(const Scene &_scene) override;
+
+		Spectrum Li(Ray _ray, const Scene &_scene) const override;
+};
+
+LAMBDA_END
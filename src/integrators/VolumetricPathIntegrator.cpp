@@ -24,6 +24,8 @@ Spectrum VolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 	event.hit = &hit;
 	event.scene = &_scene;
 	event.wo = -r.d;
+	SampledWavelength wavelength;
+	SampleWavelength(event, wavelength);
 	bool scatterIntersect = false;
 	event.medium = InMedium(r.o, _scene);
 	for (int bounces = 0; bounces < maxBounces; ++bounces) {
@@ -66,6 +68,7 @@ Spectrum VolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 
 					r.o = hit.point;
 					r.d = event.wi;
+					r.hasDifferentials = false;
 					event.medium = hit.object->material->mediaBoundary.GetMedium(event.wi, hit.normalG);	//Evaluate any medium we are going into before we get new hit
 
 					scatterIntersect = _scene.Intersect(r, hit);	//Go to next path vertex and potential light contribution
@@ -119,6 +122,7 @@ Spectrum VolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 
 				r.o = hit.point;
 				r.d = event.wi;
+				r.hasDifferentials = false;
 
 				Spectrum Tr(1);
 				Medium *med = event.medium;
@@ -141,6 +145,7 @@ Spectrum VolumetricPathIntegrator::Li(Ray r, const Scene &_scene) const {
 
 				r.o = scatterPoint;
 				r.d = event.wi;
+				r.hasDifferentials = false;
 				scatterIntersect = _scene.Intersect(r, hit);	//Next path vertex (doesn't skip through media)
 
 				L += beta * Ld;
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <lighting/ReservoirLightSampler.h>
+#include <render/Render.h>
+#include "WavefrontPathIntegrator.h"
+
+LAMBDA_BEGIN
+
+WavefrontPathIntegrator::WavefrontPathIntegrator(Sampler *_sampler, const unsigned _maxBounces, const unsigned _minBounces, const unsigned _queueSize) {
+	maxBounces = _maxBounces;
+	minBounces = _minBounces;
+	queueSize = std::max(_queueSize, 1u);
+	sampler = _sampler;
+}
+
+Integrator *WavefrontPathIntegrator::clone() const {
+	WavefrontPathIntegrator *integrator = new WavefrontPathIntegrator(sampler, maxBounces, minBounces, queueSize);	//Path queue is per-tile, so don't copy it
+	integrator->spectralDispersion = spectralDispersion;
+	return integrator;
+}
+
+Spectrum WavefrontPathIntegrator::Li(Ray _r, const Scene &_scene) const {
+	if (queue.empty()) queue.resize(1);
+	InitPath(queue[0], _r, _scene, sampler);
+	Trace(1, _scene);
+	return queue[0].L;
+}
+
+void WavefrontPathIntegrator::RenderPixels(const RenderTile *_tile, const PixelSamples *_pixels, const unsigned _n) {
+	const unsigned w = _tile->film->filmData.GetWidth();
+	const unsigned h = _tile->film->filmData.GetHeight();
+	const Real xi = (Real)1 / w;
+	const Real yi = (Real)1 / h;
+	const Real diffScale = 1 / std::sqrt((Real)std::max(_tile->spp, 1u));
+	size_t numSamples = 0;
+	for (unsigned p = 0; p < _n; ++p) numSamples += _pixels[p].n;
+	const unsigned capacity = (unsigned)std::min((size_t)queueSize, numSamples);
+	if (capacity == 0) return;
+
+	//Each queued path needs its own sampler state since paths of different pixels are interleaved
+	if (pathSamplers.size() < capacity) {
+		queue.resize(capacity);
+		pathSamplers.resize(capacity);
+		if (_tile->sampleShifter) pathShifters.assign(capacity, *_tile->sampleShifter);
+		for (unsigned i = 0; i < capacity; ++i) {
+			if (!pathSamplers[i]) pathSamplers[i].reset(_tile->sampler->clone());
+			pathSamplers[i]->sampleShifter = _tile->sampleShifter ? &pathShifters[i] : nullptr;
+		}
+	}
+
+	auto flush = [&](const unsigned _n) {
+		Trace(_n, *_tile->scene);
+		for (unsigned i = 0; i < _n; ++i) _tile->filmTile->AddSample(queue[i].L, queue[i].x, queue[i].y, queue[i].dx, queue[i].dy);
+	};
+
+	unsigned n = 0;
+	for (unsigned p = 0; p < _n; ++p) {
+		const unsigned x = _pixels[p].x, y = _pixels[p].y;
+		for (unsigned s = 0; s < _pixels[p].n; ++s) {
+			Sampler *pathSampler = pathSamplers[n].get();
+			if (pathSampler->sampleShifter) pathSampler->sampleShifter->SetPixelIndex(w, h, x, y);
+			pathSampler->SetSample(_pixels[p].first + s);
+			const Real dx = pathSampler->Get1D() - .5;
+			const Real dy = pathSampler->Get1D() - .5;
+			Ray r = _tile->camera->GenerateRayDifferential(xi * ((Real)x + dx), yi * ((Real)y + dy), xi, yi, *pathSampler);
+			r.ScaleDifferentials(diffScale);
+			InitPath(queue[n], r, *_tile->scene, pathSampler);
+			queue[n].x = x;
+			queue[n].y = y;
+			queue[n].pixel = y * w + x;
+			queue[n].dx = dx;
+			queue[n].dy = dy;
+			if (++n == capacity) {
+				flush(n);
+				n = 0;
+			}
+		}
+	}
+	if (n > 0) flush(n);
+}
+
+void WavefrontPathIntegrator::InitPath(PathState &_path, const Ray &_r, const Scene &_scene, Sampler *_sampler) const {
+	_path.r = _r;
+	_path.hit = RayHit();
+	_path.event = ScatterEvent();
+	_path.event.hit = &_path.hit;
+	_path.event.scene = &_scene;
+	_path.event.wo = -_r.d;
+	_path.L = Spectrum(0);
+	_path.beta = Spectrum(1);
+	_path.Ld = Spectrum(0);
+	_path.l = nullptr;
+	_path.sampler = _sampler;
+	if (spectralDispersion) {
+		_path.wavelength = SampledWavelength::Sample(_sampler->Get1D());
+		_path.event.wavelength = &_path.wavelength;
+	}
+	_path.bounces = 0;
+	_path.pixel = pixelIndex;
+	_path.active = true;
+	_path.intersected = false;
+	_path.scattered = false;
+	_path.specular = false;
+}
+
+void WavefrontPathIntegrator::Extend(const unsigned _n, const Scene &_scene) const {
+	if (extendRays.size() < _n) {
+		extendRays.resize(_n);
+		extendHits.resize(_n);
+		extendIntersected.reset(new bool[_n]);
+	}
+	extendIndices.clear();
+	bool coherent = true;
+	for (unsigned i = 0; i < _n; ++i) {
+		const PathState &p = queue[i];
+		if (!p.active) continue;
+		extendRays[extendIndices.size()] = p.r;
+		extendIndices.push_back(i);
+		coherent &= p.bounces == 0 && !p.scattered;
+	}
+	const unsigned m = extendIndices.size();
+	_scene.Intersect(extendRays.data(), extendHits.data(), extendIntersected.get(), m, coherent);
+	for (unsigned j = 0; j < m; ++j) {
+		PathState &p = queue[extendIndices[j]];
+		p.intersected = extendIntersected[j];
+		if (p.intersected) p.hit = extendHits[j];
+	}
+}
+
+unsigned WavefrontPathIntegrator::Accumulate(const unsigned _n, const Scene &_scene) const {
+	unsigned numActive = 0;
+	shadeIndices.clear();
+	const bool resampled = dynamic_cast<const ReservoirLightSampler*>(_scene.lightSampler) != nullptr;
+	for (unsigned i = 0; i < _n; ++i) {
+		PathState &p = queue[i];
+		if (!p.active) continue;
+		RayHit &hit = p.hit;
+		if (p.scattered) {	//Finish the previous vertex now that its bsdf-sampled ray has been traced
+			if (const Light *nl = p.intersected ? hit.object->material->light : (Light *)_scene.envLight) {
+				if (nl != p.l) p.lightDistPdf = _scene.lightSampler->Pdf(p.event, nl);	//Recalculate light distribution pdf if we don't already know it
+				const Real lightPDF = p.lightDistPdf * nl->PDF_Li(p.event);
+				const Spectrum Li = p.intersected ? nl->L(p.event) : nl->Le(p.r);
+				const bool specular = resampled && p.specular;
+				const Real weight = resampled ? (specular ? 1 : 0) : PowerHeuristic(p.scatteringPDF, lightPDF);	//Resampled light samples already cover non-specular surfaces
+				if (!Li.IsBlack() && (specular || lightPDF > 0)) p.Ld += Li * p.f * weight / p.scatteringPDF;
+			}
+			p.L += p.beta * p.Ld;
+			p.beta *= p.f / p.scatteringPDF;
+			p.scattered = false;
+			if (p.bounces > minBounces) {
+				const Real q = std::max((Real).05, 1 - p.beta.y());
+				if (p.sampler->Get1D() < q) {
+					p.active = false;
+					continue;
+				}
+				p.beta /= (Real)1 - q;
+			}
+			if (++p.bounces >= maxBounces || !p.intersected) {
+				p.active = false;
+				continue;
+			}
+		}
+		else if (!p.intersected) {
+			if (p.bounces == 0 && _scene.envLight) p.L += ((Light *)_scene.envLight)->Le(p.r);	//Beta is always 1 here
+			p.active = false;
+			continue;
+		}
+		else if (p.bounces == 0 && hit.object->material && hit.object->material->light) {
+			p.L += hit.object->material->light->L(p.event);	//Beta is always 1 here
+		}
+
+		if (hit.object->material && hit.object->material->bxdf) shadeIndices.push_back(i);
+		else p.r.o = hit.point + hit.normalG * (maths::Dot(p.r.d, hit.normalG) < 0 ? -SURFACE_EPSILON : SURFACE_EPSILON);	//Pass through without counting a bounce
+		++numActive;
+	}
+	return numActive;
+}
+
+void WavefrontPathIntegrator::SortByMaterial() const {
+	std::sort(shadeIndices.begin(), shadeIndices.end(), [this](const unsigned _a, const unsigned _b) {
+		return queue[_a].hit.object->material < queue[_b].hit.object->material;
+	});
+}
+
+void WavefrontPathIntegrator::Shadow(const Scene &_scene) const {
+	const ReservoirLightSampler *reservoirSampler = dynamic_cast<const ReservoirLightSampler*>(_scene.lightSampler);
+	for (const unsigned i : shadeIndices) {
+		PathState &p = queue[i];
+		ScatterEvent &event = p.event;
+		event.wo = -p.r.d;	//Compute wo before SurfaceLocalise()
+		event.SurfaceLocalise();
+
+		if (reservoirSampler) {	//Resampled, so it isn't MIS weighted and skips the batched bsdf evaluation
+			p.l = nullptr;
+			p.lightPDF = 0;
+			p.Ld = reservoirSampler->SampleDirect(event, *p.sampler, p.bounces == 0 ? p.pixel : ~0u);
+			continue;
+		}
+
+		p.lightDistPdf = 1;
+		p.l = _scene.lightSampler->Sample(event, *p.sampler, &p.lightDistPdf);
+		p.Ld = Spectrum(0);
+		p.Li = p.l->Sample_Li(event, p.sampler, p.lightPDF);
+		p.lightPDF *= p.lightDistPdf;
+	}
+
+	const ScatterEvent *events[ShaderGraph::SHADER_BATCH_SIZE];
+	PathState *paths[ShaderGraph::SHADER_BATCH_SIZE];
+	Spectrum f[ShaderGraph::SHADER_BATCH_SIZE];
+	const BxDF *bxdf = nullptr;
+	unsigned n = 0;
+	auto flush = [&]() {
+		bxdf->fBatch(events, n, f);
+		for (unsigned j = 0; j < n; ++j) {
+			PathState &p = *paths[j];
+			const Spectrum fCos = f[j] * std::abs(p.event.wiL.y);
+			const Real scatteringPDF = bxdf->Pdf(p.event.woL, p.event.wiL, p.event);
+			if (!fCos.IsBlack() && scatteringPDF > 0) {
+				const Real weight = PowerHeuristic(p.lightPDF, scatteringPDF);
+				p.Ld += p.Li * fCos * weight / p.lightPDF;
+			}
+		}
+		n = 0;
+	};
+	for (const unsigned i : shadeIndices) {	//Already sorted by material, so equal bxdfs are adjacent
+		PathState &p = queue[i];
+		if (p.lightPDF <= 0 || p.Li.IsBlack()) continue;
+		const BxDF *pathBxdf = p.hit.object->material->bxdf;
+		if (n > 0 && (pathBxdf != bxdf || n == ShaderGraph::SHADER_BATCH_SIZE)) flush();
+		bxdf = pathBxdf;
+		events[n] = &p.event;
+		paths[n++] = &p;
+	}
+	if (n > 0) flush();
+}
+
+void WavefrontPathIntegrator::Scatter() const {
+	for (const unsigned i : shadeIndices) {
+		PathState &p = queue[i];
+		const BxDF *bxdf = p.hit.object->material->bxdf;
+		p.f = bxdf->Sample_f(p.event, *p.sampler, p.scatteringPDF);
+		p.f *= std::abs(p.event.wiL.y);
+		p.specular = (bxdf->type & BxDF::BxDF_SPECULAR) != 0;
+		p.r.o = p.hit.point;
+		p.r.d = p.event.wi;
+		p.r.hasDifferentials = false;
+		if (p.scatteringPDF > 0 && !p.f.IsBlack()) p.scattered = true;
+		else p.active = false;	//Don't continue path if bsdf is 0 or if scattering pdf is 0
+	}
+}
+
+void WavefrontPathIntegrator::Trace(const unsigned _n, const Scene &_scene) const {
+	if (maxBounces == 0) return;
+	unsigned numActive = _n;
+	while (numActive > 0) {
+		Extend(_n, _scene);
+		numActive = Accumulate(_n, _scene);
+		if (shadeIndices.empty()) continue;
+		SortByMaterial();
+		Shadow(_scene);
+		Scatter();
+	}
+}
+
+LAMBDA_END
@@ -0,0 +1,104 @@
+/*
+	Breadth-first (wavefront) version of PathIntegrator.
+
+	Rather than tracing one path to completion at a time, a queue of path states is kept per
+	render tile and each stage of the path tracing loop is run over the whole queue before
+	moving on to the next:
+		- Extend: find the next path vertex of every active path.
+		- Accumulate: add emission (with MIS) and throughput from the previous vertex, terminate paths.
+		- Shadow: sample and test a light for each path that needs shading.
+		- Scatter: sample the BxDF for each shaded path to produce the next ray.
+	Paths are sorted by material before the shading stages so the same shader graph is
+	evaluated back-to-back. The estimator is identical to PathIntegrator.
+*/
+#pragma once
+#include <vector>
+#include <memory>
+#include <sampling/SampleShifter.h>
+#include "Integrator.h"
+
+LAMBDA_BEGIN
+
+class WavefrontPathIntegrator : public Integrator {
+	public:
+		unsigned maxBounces, minBounces, queueSize;
+
+		WavefrontPathIntegrator(Sampler *_sampler, const unsigned _maxBounces = 128, const unsigned _minBounces = 3, const unsigned _queueSize = 1024);
+
+		Integrator *clone() const override;
+
+		/*
+			Traces a single path through the wavefront stages (a queue of one).
+		*/
+		Spectrum Li(Ray _r, const Scene &_scene) const override;
+
+		/*
+			Queues the samples of all _n pixels together, processing up to queueSize paths at once.
+		*/
+		void RenderPixels(const RenderTile *_tile, const PixelSamples *_pixels, const unsigned _n) override;
+
+	private:
+		struct PathState {
+			Ray r;
+			RayHit hit;
+			ScatterEvent event;
+			SampledWavelength wavelength;
+			Spectrum L, beta, Ld, f, Li;
+			const Light *l;
+			Real lightDistPdf, lightPDF, scatteringPDF;
+			Real dx, dy;	//Film sample offset from the pixel centre
+			Sampler *sampler;
+			unsigned x, y, bounces;
+			unsigned pixel;	//Film pixel, for light samplers that reuse samples
+			bool active, intersected, scattered, specular;
+		};
+
+		mutable std::vector<PathState> queue;
+		mutable std::vector<unsigned> shadeIndices;
+		mutable std::vector<std::unique_ptr<Sampler>> pathSamplers;
+		mutable std::vector<SampleShifter> pathShifters;
+		mutable std::vector<unsigned> extendIndices;
+		mutable std::vector<Ray> extendRays;
+		mutable std::vector<RayHit> extendHits;
+		mutable std::unique_ptr<bool[]> extendIntersected;
+
+		/*
+			Resets _path to start at camera ray _r.
+		*/
+		void InitPath(PathState &_path, const Ray &_r, const Scene &_scene, Sampler *_sampler) const;
+
+		/*
+			Intersects the current ray of every active path as one batch. The batch is flagged
+			coherent while it only holds camera rays.
+		*/
+		void Extend(const unsigned _n, const Scene &_scene) const;
+
+		/*
+			Finishes the previous vertex of every active path (emission MIS, throughput, Russian roulette)
+			and decides which paths need shading. Returns the number of paths still active.
+		*/
+		unsigned Accumulate(const unsigned _n, const Scene &_scene) const;
+
+		/*
+			Orders paths to be shaded by material.
+		*/
+		void SortByMaterial() const;
+
+		/*
+			Next event estimation for each shaded path. Lights are sampled for every path first,
+			then BxDFs are evaluated in batches of consecutive paths sharing a material.
+		*/
+		void Shadow(const Scene &_scene) const;
+
+		/*
+			BxDF sampling for each shaded path; produces the next ray to extend.
+		*/
+		void Scatter() const;
+
+		/*
+			Runs all stages on the first _n paths of the queue until every one has terminated.
+		*/
+		void Trace(const unsigned _n, const Scene &_scene) const;
+};
+
+LAMBDA_END
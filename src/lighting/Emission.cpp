@@ -0,0 +1,59 @@
+#include <sampling/Sampling.h>
+#include "Emission.h"
+#include "EnvironmentLight.h"
+#include "PointLight.h"
+#include "Spotlight.h"
+
+LAMBDA_BEGIN
+
+namespace Emission {
+
+	bool Sample(const Light &_light, Sampler &_sampler, ScatterEvent &_event, EmissionSample *_es) {
+		if (dynamic_cast<const EnvironmentLight*>(&_light)) return false;
+		PartialLightSample ls;
+		ls.light = (Light*)&_light;
+		ls.pdf = 1;
+		_es->Le = _light.SamplePoint(_sampler, _event, &ls);
+		_es->point = ls.point;
+		_es->normal = Vec3(0, 0, 0);
+		_es->pdfPos = ls.pdf;
+		if (_es->pdfPos == 0) return false;
+
+		if (const Spotlight *spot = dynamic_cast<const Spotlight*>(&_light)) {
+			_es->deltaPosition = true;
+			_es->direction = AroundAxis(Sampling::SampleUniformCone(_sampler.Get2D(), spot->cosConeAngle), spot->axis);
+			_es->directional = spot->Falloff(_es->direction);
+		}
+		else if (dynamic_cast<const PointLight*>(&_light)) {
+			_es->deltaPosition = true;
+			_es->direction = Sampling::SampleUniformSphere(_sampler.Get2D());
+			_es->directional = 1;
+		}
+		else {	//Area lights emit from both sides
+			_es->deltaPosition = false;
+			_es->normal = ls.normal;
+			Vec3 local = Sampling::SampleCosineHemisphere(_sampler.Get2D());
+			if (_sampler.Get1D() < (Real).5) local.y = -local.y;
+			_es->direction = AroundAxis(local, _es->normal);
+			_es->directional = std::abs(local.y);
+		}
+		_es->pdfDir = PdfDirection(_light, _es->normal, _es->direction);
+		return _es->pdfDir > 0 && _es->directional > 0 && !_es->Le.IsBlack();
+	}
+
+	Real PdfDirection(const Light &_light, const Vec3 &_n, const Vec3 &_w) {
+		if (const Spotlight *spot = dynamic_cast<const Spotlight*>(&_light))
+			return maths::Dot(_w, spot->axis) >= spot->cosConeAngle ? (Real)1 / (PI2 * (1 - spot->cosConeAngle)) : 0;
+		if (dynamic_cast<const PointLight*>(&_light)) return INV_PI4;
+		return std::abs(maths::Dot(_n, _w)) * INV_PI * (Real).5;
+	}
+
+	Vec3 AroundAxis(const Vec3 &_local, const Vec3 &_n) {
+		const Vec3 c1 = maths::Cross(_n, Vec3(0, 0, 1));
+		const Vec3 c2 = maths::Cross(_n, Vec3(0, 1, 0));
+		const Vec3 t = (maths::Dot(c1, c1) > maths::Dot(c2, c2) ? c1 : c2).Normalised();
+		return maths::LocalToWorld(_local, t, _n, maths::Cross(t, _n));
+	}
+}
+
+LAMBDA_END
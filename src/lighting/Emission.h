@@ -0,0 +1,41 @@
+/*
+	Sampling light leaving a light, for methods that trace paths starting at the lights rather
+	than the camera (light subpaths, photons).
+	- Point lights emit uniformly over the sphere, spotlights uniformly over their cone and area
+	lights cosine weighted from both sides.
+	- Environment lights can't start a path, they have no finite area to sample a point on.
+*/
+#pragma once
+#include <shading/ScatterEvent.h>
+#include "Light.h"
+
+LAMBDA_BEGIN
+
+struct EmissionSample {
+	Vec3 point, normal, direction;	//Normal is only set for area lights
+	Spectrum Le;	//Radiance at the point for area lights, intensity for point lights
+	Real directional;	//|cos| at area lights and falloff for spotlights along direction
+	Real pdfPos, pdfDir;	//Per unit area (1 for delta positions) and per unit solid angle
+	bool deltaPosition;
+};
+
+namespace Emission {
+
+	/*
+		Samples a point on _light and a direction leaving it. _event's hit is used as scratch space.
+		Returns false if nothing could be sampled.
+	*/
+	bool Sample(const Light &_light, Sampler &_sampler, ScatterEvent &_event, EmissionSample *_es);
+
+	/*
+		Pdf per unit solid angle of Sample() picking _w, _n being the normal at the sampled point.
+	*/
+	Real PdfDirection(const Light &_light, const Vec3 &_n, const Vec3 &_w);
+
+	/*
+		World direction of _local, given in a frame whose y axis is _n.
+	*/
+	Vec3 AroundAxis(const Vec3 &_local, const Vec3 &_n);
+}
+
+LAMBDA_END
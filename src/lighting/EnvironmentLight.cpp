@@ -4,23 +4,50 @@ LAMBDA_BEGIN
 
 EnvironmentLight::EnvironmentLight() {}
 
+//Tiled maps wider than this build their sampling distribution from a smaller mip level.
+constexpr unsigned maxDistributionWidth = 4096;
+
 EnvironmentLight::EnvironmentLight(Texture *_texture, const Real _intesity) {
 	radianceMap.SetTexture(_texture);
 	radianceMap.type = SpectrumType::Illuminant;
-	const unsigned w = _texture->GetWidth(), h = _texture->GetHeight();
+	unsigned level = 0;
+	if (_texture->IsTiled()) {
+		const TiledImage &tiled = *_texture->tiled;
+		while (level + 1 < tiled.NumLevels() && tiled.levels[level].width > maxDistributionWidth) ++level;
+	}
+	const unsigned w = level ? _texture->tiled->levels[level].width : _texture->GetWidth();
+	const unsigned h = level ? _texture->tiled->levels[level].height : _texture->GetHeight();
 	std::unique_ptr<Real[]> img(new Real[w * h]);
 	for (unsigned y = 0; y < h; ++y) {
 		const Real vp = (Real)y / (Real)h;
 		const Real sinTheta = std::sin(PI * Real(y + .5) / Real(h));
 		for (unsigned x = 0; x < w; ++x) {
 			Real up = (Real)x / (Real)w;
-			img[x + y * w] = std::abs(radianceMap.GetUV(Vec2(up, vp)).y());
+			if (level) {
+				const Colour c = _texture->tiled->cache->Texel(*_texture->tiled, level, x, y);
+				img[x + y * w] = std::abs(Spectrum::FromRGB(&c.r, SpectrumType::Illuminant).y());
+			}
+			else img[x + y * w] = std::abs(radianceMap.GetUV(Vec2(up, vp)).y());
 			img[x + y * w] *= sinTheta;
 		}
 	}
 	distribution.reset(new Distribution::Piecewise2D(img.get(), w, h));
 }
 
+Vec3 EnvironmentLight::SampleDirection(const Vec2 &_u, Real *_pdf) const {
+	const Vec2 uv = distribution->SampleContinuous(_u, _pdf);
+	if (*_pdf == 0) return Vec3(0, 0, 0);
+	const Real theta = uv.y * PI + offset.y;
+	const Real phi = uv.x * PI2 + offset.x;
+	const Real cosTheta = std::cos(theta), sinTheta = std::sin(theta);
+	if (sinTheta == 0) {
+		*_pdf = 0;
+		return Vec3(0, 0, 0);
+	}
+	*_pdf /= 2 * PI * PI * sinTheta;
+	return maths::SphericalDirection(sinTheta, cosTheta, phi);
+}
+
 Spectrum EnvironmentLight::Sample_Li(ScatterEvent &_event, Sampler *_sampler, Real &_pdf) const {
 	const Vec2 uv = distribution->SampleContinuous(_sampler->Get2D(), &_pdf);
 	if (_pdf == 0) return Spectrum(0);
@@ -21,6 +21,12 @@ class EnvironmentLight : public Light {
 
 		Spectrum Sample_Li(ScatterEvent &_event, Sampler *_sampler, Real &_pdf) const override;
 
+		/*
+			Samples a direction from the radiance distribution, without testing visibility. _pdf is per
+			unit solid angle and 0 if the sample failed.
+		*/
+		Vec3 SampleDirection(const Vec2 &_u, Real *_pdf) const;
+
 		Real PDF_Li(const ScatterEvent &_event, Sampler &_sampler) const override;
 
 		Real PDF_Li(const ScatterEvent &_event) const override;
@@ -1,17 +1,127 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <unordered_map>
 #include <lighting/MeshLight.h>
 #include <lighting/EnvironmentLight.h>
+#include <utility/Concurrency.h>
 #include "ManyLightSampler.h"
 
 LAMBDA_BEGIN
 
+namespace {
+
+	constexpr char treeMagic[4] = { 'L', 'L', 'T', '1' };
+
+	struct TreeHeader {
+		char magic[4];
+		uint32_t numLights;
+		uint64_t hash;
+		uint32_t numNodes, pad;
+	};
+
+	/*
+		Nodes are stored in pre-order, each interior node followed by its left then right subtree.
+	*/
+	struct NodeRecord {
+		float bounds[6];
+		float axis[3];
+		float thetaO, thetaE, totalPower, powerVariance;
+		uint32_t firstLightIndex, numLights, leaf;
+	};
+
+	constexpr size_t buildChunkSize = 1 << 14;
+
+	constexpr float quantMax = 65535;
+
+	inline uint16_t QuantiseDown(const float _v) {
+		return (uint16_t)maths::Clamp(std::floor(_v * quantMax), 0.f, quantMax);
+	}
+
+	inline uint16_t QuantiseUp(const float _v) {
+		return (uint16_t)maths::Clamp(std::ceil(_v * quantMax), 0.f, quantMax);
+	}
+
+	/*
+		Octahedral mapping of a unit vector to two 16 bit values.
+	*/
+	inline void EncodeOctahedral(const Vec3 &_v, uint16_t *_out) {
+		const float l1 = std::max(std::abs(_v.x) + std::abs(_v.y) + std::abs(_v.z), 1e-20f);	//Degenerate axes come out as +z
+		float u = _v.x / l1, v = _v.y / l1;
+		if (_v.z < 0) {
+			const float pu = u;
+			u = (1 - std::abs(v)) * (pu >= 0 ? 1 : -1);
+			v = (1 - std::abs(pu)) * (v >= 0 ? 1 : -1);
+		}
+		_out[0] = (uint16_t)std::round(maths::Clamp(u * .5f + .5f, 0.f, 1.f) * quantMax);
+		_out[1] = (uint16_t)std::round(maths::Clamp(v * .5f + .5f, 0.f, 1.f) * quantMax);
+	}
+
+	inline Vec3 DecodeOctahedral(const uint16_t *_in) {
+		const float u = (float)_in[0] / quantMax * 2 - 1, v = (float)_in[1] / quantMax * 2 - 1;
+		Vec3 d(u, v, 1 - std::abs(u) - std::abs(v));
+		if (d.z < 0) {
+			d.x = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+			d.y = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+		}
+		return d.Normalised();
+	}
+
+	inline void HashBytes(uint64_t &_hash, const void *_data, const size_t _bytes) {	//FNV-1a
+		const unsigned char *bytes = (const unsigned char *)_data;
+		for (size_t i = 0; i < _bytes; ++i) {
+			_hash ^= bytes[i];
+			_hash *= 0x100000001B3ull;
+		}
+	}
+
+}
+
+struct ManyLightSampler::BuildContext {
+	ThreadPool *pool;
+	std::vector<BuildLight> lights, scratch;	//Scratch is only allocated when some node is partitioned in parallel
+	std::mutex mutex;
+	std::vector<std::shared_ptr<Task>> subtrees;
+
+	void Spawn(LightNode *_node) {
+		std::function<void()> func = [this, _node]() { BuildNode(*this, _node); };
+		std::shared_ptr<Task> task(Task::MakeTask<void>(func));
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			subtrees.push_back(task);	//Listed before it can finish, so waiting on the list in order sees every subtree
+		}
+		pool->Enqueue(task);
+	}
+
+	void WaitSubtrees() {
+		for (size_t i = 0;; ++i) {
+			std::shared_ptr<Task> task;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (i == subtrees.size()) return;
+				task = subtrees[i];
+			}
+			task->Wait();
+		}
+	}
+};
+
 ManyLightSampler::ManyLightSampler(const Real _splitThreshold, const bool _useSplits) :
-	splitThreshold(_splitThreshold), useSplits(_useSplits), root(nullptr) {}
+	splitThreshold(_splitThreshold), useSplits(_useSplits), numBuildThreads(0), root(nullptr) {
+	infiniteLight = nullptr;
+	treePower = infPower = 0;
+}
 
 ManyLightSampler::ManyLightSampler(const Scene &_scene, const Real _splitThreshold, const bool _useSplits) : LightSampler(&_scene) {
 	splitThreshold = _splitThreshold;
 	useSplits = _useSplits;
+	numBuildThreads = 0;
+	infiniteLight = nullptr;
+	treePower = infPower = 0;
 }
 
 Light *ManyLightSampler::Sample(const ScatterEvent &_event, Sampler &_sampler, Real *_pdf) const {
@@ -20,7 +130,7 @@ Light *ManyLightSampler::Sample(const ScatterEvent &_event, Sampler &_sampler, R
 	if (epsilon < pTree) {	//Sample tree
 		epsilon /= pTree;
 		*_pdf *= pTree;
-		return PickLight(_event, _sampler.Get1D(), root.get(), _pdf);
+		return PickLight(_event, _sampler.Get1D(), _pdf);
 	}
 	*_pdf *= 1 - pTree;	//Sample infinite light (replace *= with =) ?
 	return infiniteLight;
@@ -28,19 +138,257 @@ Light *ManyLightSampler::Sample(const ScatterEvent &_event, Sampler &_sampler, R
 
 Real ManyLightSampler::Pdf(const ScatterEvent &_event, const Light *_light) const {
 	if (_light == infiniteLight) return infPower / (infPower + treePower);
-	auto tl = triangleLights.find({ _light, _event.hit->primId });	//If is a mesh light, it will replace pointer with triangle light's
-	if (tl != triangleLights.end()) _light = &tl->second;
-	const std::pair<LightNode *, unsigned> &nodeRef = lightNodeDistributionMap.at(_light);
-	return leafDistributions.at(nodeRef.first->firstLightIndex).PDF(nodeRef.second) * RecursivePDF(_event, nodeRef.first);
+	const unsigned source = SourceIndex(_light, _event.hit->primId);	//Mesh lights resolve to the hit triangle's light
+	if (source == ~0u) return 0;
+	const LightRef &ref = lightRefs[source];
+	const unsigned index = ref.index;
+
+	//Walk down to the light's leaf, taking the same branch probabilities PickLight() would
+	Real pdf = treePower / (infPower + treePower);
+	unsigned n = 0;
+	for (unsigned depth = 0; nodes[n].rightChild; ++depth) {
+		const Real PL = LeftProbability(_event, n);
+		const bool right = depth < maxTrailDepth ? (ref.trail >> depth) & 1 : index >= nodes[n + 1].firstLightIndex + nodes[n + 1].numLights;	//Past the trail, compare with the left range
+		if (right) {
+			pdf *= 1 - PL;
+			n = nodes[n].rightChild;
+		}
+		else {
+			pdf *= PL;
+			n = n + 1;
+		}
+	}
+	const Real below = index > nodes[n].firstLightIndex ? leafCdf[index - 1] : 0;
+	return pdf * (leafCdf[index] - below);
 }
 
 void ManyLightSampler::Commit() {
-	std::cout << std::endl << "Building light tree...";
 	InitLights(scene->lights);
 	treePower = 0;
-	if(infiniteLight) infPower = infiniteLight->Power() * .1;
-	if(lights.size() > 0) RecursiveBuild(root.get());
-	std::cout << std::endl << "Done.";
+	infPower = infiniteLight ? infiniteLight->Power() * .1 : 0;
+	nodes.clear();
+	leafCdf.clear();
+	lightRefs.clear();
+	buildTime = 0;
+	if (lights.empty()) return;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::string cachePath;
+	uint64_t hash = 0;
+	if (!cacheDirectory.empty()) {
+		hash = HashLights();
+		char name[32];
+		snprintf(name, sizeof(name), "lighttree_%016llx.llt", (unsigned long long)hash);
+		cachePath = cacheDirectory + "/" + name;
+		if (LoadTree(cachePath, hash)) {
+			Flatten();
+			buildTime = std::chrono::duration<Real>(std::chrono::steady_clock::now() - start).count();
+			std::cout << std::endl << "Loaded light tree from " << cachePath << " in " << buildTime << "s.";
+			return;
+		}
+	}
+
+	std::cout << std::endl << "Building light tree...";
+	const std::vector<Light *> unbuilt = cachePath.empty() ? std::vector<Light *>() : lights;
+	BuildTree();
+	buildTime = std::chrono::duration<Real>(std::chrono::steady_clock::now() - start).count();
+	if (!cachePath.empty() && !SaveTree(cachePath, hash, unbuilt)) std::cout << std::endl << "Could not write light tree cache: " << cachePath;
+	const auto flattenStart = std::chrono::steady_clock::now();	//Saving reads the pointer tree, so it comes first but isn't timed
+	Flatten();
+	buildTime += std::chrono::duration<Real>(std::chrono::steady_clock::now() - flattenStart).count();
+	std::cout << std::endl << "Built light tree over " << lights.size() << " lights in " << buildTime << "s.";
+}
+
+void ManyLightSampler::Flatten() {
+	boundsOrigin = root->bounds.min;
+	const Vec3 extent = root->bounds.max - root->bounds.min;
+	boundsScale = extent / quantMax;
+	Vec3 invExtent;
+	for (unsigned a = 0; a < 3; ++a) invExtent[a] = extent[a] > 0 ? 1 / extent[a] : 0;
+
+	nodes.clear();
+	lightRefs.assign(lights.size(), { 0, 0 });
+	std::function<void(const LightNode *, uint64_t, unsigned)> flatten = [&](const LightNode *_node, const uint64_t _trail, const unsigned _depth) {
+		const unsigned index = nodes.size();
+		nodes.emplace_back();
+		FlatNode &flat = nodes[index];
+		const Vec3 lo = (_node->bounds.min - boundsOrigin) * invExtent;
+		const Vec3 hi = (_node->bounds.max - boundsOrigin) * invExtent;
+		for (unsigned a = 0; a < 3; ++a) {
+			flat.bounds[a] = QuantiseDown(lo[a]);
+			flat.bounds[a + 3] = QuantiseUp(hi[a]);
+		}
+		//Widen the cone by the axis' quantisation error so it still bounds the lights
+		const OrientationCone &cone = _node->orientationCone;
+		EncodeOctahedral(cone.axis, flat.axis);
+		const Real axisError = std::acos(maths::Clamp(maths::Dot(DecodeOctahedral(flat.axis), cone.axis.Normalised()), (Real)-1, (Real)1));
+		flat.thetaO = QuantiseUp(std::min(cone.thetaO + axisError, (Real)PI) / (Real)PI);
+		flat.thetaE = QuantiseUp(std::min(cone.thetaE, (Real)PI) / (Real)PI);
+		flat.totalPower = _node->totalPower;
+		flat.powerVariance = _node->powerVariance;
+		flat.firstLightIndex = _node->firstLightIndex;
+		flat.numLights = _node->numLights;
+		flat.rightChild = 0;
+		if (!_node->IsLeaf()) {
+			const uint64_t rightBit = _depth < maxTrailDepth ? (uint64_t)1 << _depth : 0;
+			flatten(_node->children[0], _trail, _depth + 1);
+			const unsigned right = nodes.size();
+			flatten(_node->children[1], _trail | rightBit, _depth + 1);
+			nodes[index].rightChild = right;	//nodes may have reallocated, flat is stale
+		}
+		else {
+			for (unsigned i = _node->firstLightIndex; i < _node->firstLightIndex + _node->numLights; ++i)
+				lightRefs[SourceIndex(lights[i], 0)] = { _trail, i };
+		}
+	};
+	flatten(root.get(), 0, 0);
+	root.reset();
+
+	//Leaf CDFs over light power, uniform where a leaf has none
+	leafCdf.resize(lights.size());
+	treePower = 0;
+	for (const FlatNode &node : nodes) {
+		if (node.rightChild) continue;
+		const unsigned first = node.firstLightIndex;
+		Real sum = 0;
+		for (unsigned i = 0; i < node.numLights; ++i) {
+			sum += lights[first + i]->Power();
+			leafCdf[first + i] = sum;
+		}
+		for (unsigned i = 0; i < node.numLights; ++i)
+			leafCdf[first + i] = sum > 0 ? leafCdf[first + i] / sum : (Real)(i + 1) / node.numLights;
+		leafCdf[first + node.numLights - 1] = 1;
+		treePower += sum;
+	}
+}
+
+unsigned ManyLightSampler::SourceIndex(const Light *_light, const unsigned _primId) const {
+	auto it = std::lower_bound(sourceLights.begin(), sourceLights.end(), _light, [](const SourceLight &_a, const Light *_b) {
+		return std::less<const Light *>()(_a.light, _b);
+	});
+	if (it != sourceLights.end() && it->light == _light) return it->mesh ? it->index + _primId : it->index;
+	const TriangleLight *triangle = dynamic_cast<const TriangleLight *>(_light);
+	if (triangle && !triangleLights.empty() && !std::less<const TriangleLight *>()(triangle, triangleLights.data()) && std::less<const TriangleLight *>()(triangle, triangleLights.data() + triangleLights.size()))
+		return triangle - triangleLights.data();
+	return ~0u;
+}
+
+Bounds ManyLightSampler::NodeBounds(const FlatNode &_node) const {
+	const Vec3 lo(_node.bounds[0], _node.bounds[1], _node.bounds[2]);
+	const Vec3 hi(_node.bounds[3], _node.bounds[4], _node.bounds[5]);
+	return { boundsOrigin + lo * boundsScale, boundsOrigin + hi * boundsScale };
+}
+
+ManyLightSampler::OrientationCone ManyLightSampler::NodeCone(const FlatNode &_node) {
+	return OrientationCone::MakeCone(DecodeOctahedral(_node.axis), (Real)_node.thetaO / quantMax * (Real)PI, (Real)_node.thetaE / quantMax * (Real)PI);
+}
+
+uint64_t ManyLightSampler::HashLights() const {
+	uint64_t hash = 0xCBF29CE484222325ull;
+	const uint64_t n = lights.size();
+	HashBytes(hash, &n, sizeof(n));
+	for (const Light *light : lights) {
+		const Bounds bounds = light->GetBounds();
+		const Vec3 dir = light->GetDirection();
+		const float values[10] = {
+			(float)bounds.min.x, (float)bounds.min.y, (float)bounds.min.z,
+			(float)bounds.max.x, (float)bounds.max.y, (float)bounds.max.z,
+			(float)dir.x, (float)dir.y, (float)dir.z, (float)light->Power()
+		};
+		HashBytes(hash, values, sizeof(values));
+	}
+	return hash;
+}
+
+bool ManyLightSampler::SaveTree(const std::string &_path, const uint64_t _hash, const std::vector<Light *> &_unbuilt) const {
+	std::unordered_map<const Light *, uint32_t> unbuiltIndex;
+	for (uint32_t i = 0; i < _unbuilt.size(); ++i) unbuiltIndex[_unbuilt[i]] = i;
+	std::vector<uint32_t> order(lights.size());
+	for (size_t i = 0; i < lights.size(); ++i) order[i] = unbuiltIndex.at(lights[i]);
+
+	std::vector<NodeRecord> nodes;
+	std::function<void(const LightNode *)> flatten = [&](const LightNode *_node) {
+		const Bounds &b = _node->bounds;
+		const OrientationCone &c = _node->orientationCone;
+		nodes.push_back({
+			{ b.min.x, b.min.y, b.min.z, b.max.x, b.max.y, b.max.z },
+			{ c.axis.x, c.axis.y, c.axis.z },
+			c.thetaO, c.thetaE, _node->totalPower, _node->powerVariance,
+			_node->firstLightIndex, _node->numLights, _node->IsLeaf()
+		});
+		if (!_node->IsLeaf()) {
+			flatten(_node->children[0]);
+			flatten(_node->children[1]);
+		}
+	};
+	flatten(root.get());
+
+	std::ofstream out(_path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+	TreeHeader header = {};
+	memcpy(header.magic, treeMagic, sizeof(treeMagic));
+	header.numLights = (uint32_t)lights.size();
+	header.hash = _hash;
+	header.numNodes = (uint32_t)nodes.size();
+	out.write((const char *)&header, sizeof(TreeHeader));
+	out.write((const char *)order.data(), order.size() * sizeof(uint32_t));
+	out.write((const char *)nodes.data(), nodes.size() * sizeof(NodeRecord));
+	return (bool)out;
+}
+
+bool ManyLightSampler::LoadTree(const std::string &_path, const uint64_t _hash) {
+	std::ifstream in(_path, std::ios::binary);
+	if (!in) return false;
+	TreeHeader header;
+	if (!in.read((char *)&header, sizeof(TreeHeader))) return false;
+	if (memcmp(header.magic, treeMagic, sizeof(treeMagic)) != 0 || header.hash != _hash || header.numLights != lights.size()) return false;
+	if (header.numNodes == 0 || header.numNodes > 2 * header.numLights) return false;
+	std::vector<uint32_t> order(header.numLights);
+	std::vector<NodeRecord> nodes(header.numNodes);
+	if (!in.read((char *)order.data(), order.size() * sizeof(uint32_t))) return false;
+	if (!in.read((char *)nodes.data(), nodes.size() * sizeof(NodeRecord))) return false;
+
+	//Check everything before touching the current tree
+	std::vector<bool> used(lights.size(), false);
+	for (const uint32_t i : order) {
+		if (i >= lights.size() || used[i]) return false;
+		used[i] = true;
+	}
+	size_t next = 0;
+	std::function<bool(uint32_t, uint32_t)> valid = [&](const uint32_t _first, const uint32_t _count) {
+		if (next >= nodes.size()) return false;
+		const NodeRecord &r = nodes[next++];
+		if (r.firstLightIndex != _first || r.numLights != _count) return false;
+		if (r.leaf) return true;
+		if (next >= nodes.size()) return false;
+		const uint32_t left = nodes[next].numLights;
+		if (left == 0 || left >= _count) return false;
+		return valid(_first, left) && valid(_first + left, _count - left);
+	};
+	if (!valid(0, header.numLights) || next != nodes.size()) return false;
+
+	const std::vector<Light *> unbuilt = lights;
+	for (size_t i = 0; i < lights.size(); ++i) lights[i] = unbuilt[order[i]];
+	next = 0;
+	std::function<void(LightNode *, LightNode *)> expand = [&](LightNode *_node, LightNode *_parent) {
+		const NodeRecord &r = nodes[next++];
+		_node->parent = _parent;
+		_node->firstLightIndex = r.firstLightIndex;
+		_node->numLights = r.numLights;
+		_node->bounds = { { r.bounds[0], r.bounds[1], r.bounds[2] }, { r.bounds[3], r.bounds[4], r.bounds[5] } };
+		_node->orientationCone = OrientationCone::MakeCone({ r.axis[0], r.axis[1], r.axis[2] }, r.thetaO, r.thetaE);
+		_node->totalPower = r.totalPower;
+		_node->powerVariance = r.powerVariance;
+		_node->children[0] = _node->children[1] = nullptr;
+		if (!r.leaf) {
+			_node->children[0] = new LightNode;
+			expand(_node->children[0], _node);
+			_node->children[1] = new LightNode;
+			expand(_node->children[1], _node);
+		}
+	};
+	expand(root.get(), nullptr);
+	return true;
 }
 
 ManyLightSampler::OrientationCone ManyLightSampler::OrientationCone::MakeCone(const Vec3 &_axis, const Real _thetaO, const Real _thetaE) {
@@ -48,17 +396,18 @@ ManyLightSampler::OrientationCone ManyLightSampler::OrientationCone::MakeCone(co
 }
 
 ManyLightSampler::OrientationCone ManyLightSampler::OrientationCone::Union(const OrientationCone &_a, const OrientationCone &_b) {
-	if (_b.thetaO > _a.thetaO) std::swap(*const_cast<OrientationCone *>(&_a), *const_cast<OrientationCone *>(&_b));
-	const Real thetaE = std::max(_a.thetaE, _b.thetaE);
-	const Real thetaD = std::acos(maths::Clamp(maths::Dot(_a.axis, _b.axis), (Real)0, (Real)1));	//Angle between two axes
-	if (std::min(thetaD + _b.thetaO, (Real)PI) <= _a.thetaO)
-		return { _a.axis, _a.thetaO, thetaE };	//_a already conatains _b
+	const bool wider = _b.thetaO > _a.thetaO;
+	const OrientationCone &a = wider ? _b : _a, &b = wider ? _a : _b;	//a is the wider cone, neither input is modified
+	const Real thetaE = std::max(a.thetaE, b.thetaE);
+	const Real thetaD = std::acos(maths::Clamp(maths::Dot(a.axis, b.axis), (Real)0, (Real)1));	//Angle between two axes
+	if (std::min(thetaD + b.thetaO, (Real)PI) <= a.thetaO)
+		return { a.axis, a.thetaO, thetaE };	//a already contains b
 	else {
-		const Real thetaO = (_a.thetaO + thetaD + _b.thetaO) * (Real).5;	//New cone over _a and _b; we divide by 2 because the axis sits in the middle of the arc
+		const Real thetaO = (a.thetaO + thetaD + b.thetaO) * (Real).5;	//New cone over a and b; we divide by 2 because the axis sits in the middle of the arc
 		if (thetaO >= PI)
-			return { _a.axis, PI, thetaE };	//We don't need a new axis since the bounds cover 180 (which is the maximum)
-		const Real thetaR = thetaO - _a.thetaO;	//Rotate _a towards _b by the difference in angle
-		const Vec3 axis = maths::Rotate(_a.axis, maths::Cross(_a.axis, _b.axis), thetaR);	//Rotate _a towards _b along orthogonal axis using Rodrigues' formula
+			return { a.axis, PI, thetaE };	//We don't need a new axis since the bounds cover 180 (which is the maximum)
+		const Real thetaR = thetaO - a.thetaO;	//Rotate a towards b by the difference in angle
+		const Vec3 axis = maths::Rotate(a.axis, maths::Cross(a.axis, b.axis), thetaR);	//Rotate a towards b along orthogonal axis using Rodrigues' formula
 		return { axis, thetaO, thetaE };
 	}
 }
@@ -80,7 +429,7 @@ Real ManyLightSampler::MOmega(const OrientationCone &_cone) {
 /*
 	Cost of proposed split into two sub-nodes based on surface area of AABB and the size of the orientation bounds.
 */
-Real ManyLightSampler::SAOH(LightNode &_P, const Bucket &_R, const Bucket &_L, const unsigned _axis) {
+Real ManyLightSampler::SAOH(const LightNode &_P, const Bucket &_R, const Bucket &_L, const unsigned _axis) {
 	const Vec3 box = _P.bounds.max - _P.bounds.min;
 	const Real lenMax = std::max(std::max(box.x, box.y), box.z);
 	const Real Kr = lenMax / box[_axis];	//Regularization factor
@@ -90,29 +439,43 @@ Real ManyLightSampler::SAOH(LightNode &_P, const Bucket &_R, const Bucket &_L, c
 	return Kr * (mL + mR) / m;
 }
 
-Real ManyLightSampler::PowerVariance(LightNode *_node) const {
-	return PowerVariance(_node->firstLightIndex, _node->numLights);
+void ManyLightSampler::Bucket::Add(const BuildLight &_light) {
+	if (numLights == 0) {
+		bounds = _light.bounds;
+		cone = OrientationCone::MakeCone(_light.direction);
+	}
+	else {
+		bounds = maths::Union(bounds, _light.bounds);
+		cone = OrientationCone::Union(cone, OrientationCone::MakeCone(_light.direction));
+	}
+	++numLights;
+	totalPower += _light.power;
+	powerSquared += (double)_light.power * _light.power;
 }
 
-Real ManyLightSampler::PowerVariance(const unsigned _firstLightIndex, const unsigned _numLights) const {
-	std::unique_ptr<Real[]> powers(new Real[_numLights]);
-	Real mean = 0;
-	for (unsigned i = 0; i < _numLights; ++i) {
-		powers[i] = lights[i + _firstLightIndex]->Power();
-		mean += powers[i];
-	}
-	mean /= (Real)_numLights;
-	Real sum = 0;
-	for (unsigned i = 0; i < _numLights; ++i) {
-		const Real term = powers[i] - mean;
-		sum += term * term;
+void ManyLightSampler::Bucket::Add(const Bucket &_bucket) {
+	if (_bucket.numLights == 0) return;
+	if (numLights == 0) {
+		*this = _bucket;
+		return;
 	}
-	return sum / (Real)(_numLights - 1);
+	bounds = maths::Union(bounds, _bucket.bounds);
+	cone = OrientationCone::Union(cone, _bucket.cone);
+	numLights += _bucket.numLights;
+	totalPower += _bucket.totalPower;
+	powerSquared += _bucket.powerSquared;
+}
+
+Real ManyLightSampler::Bucket::PowerVariance() const {
+	if (numLights < 2) return 0;
+	const double mean = (double)totalPower / numLights;
+	return (Real)std::max(0., (powerSquared - mean * mean * numLights) / (numLights - 1));
 }
 
-Real ManyLightSampler::GeometricVariance(LightNode *_node, const Vec3 &_point, Real *_mean) const {
-	const Real radius = std::sqrt(_node->bounds.DiagonalLength() * (Real).5);
-	const Real dist = (_node->bounds.Center() - _point).Magnitude();
+Real ManyLightSampler::GeometricVariance(const FlatNode &_node, const Vec3 &_point, Real *_mean) const {
+	const Bounds bounds = NodeBounds(_node);
+	const Real radius = std::sqrt(bounds.DiagonalLength() * (Real).5);
+	const Real dist = (bounds.Center() - _point).Magnitude();
 	const Real a = dist - radius;
 	const Real b = dist + radius;
 	*_mean = (Real)1 / (a * b);
@@ -122,132 +485,187 @@ Real ManyLightSampler::GeometricVariance(LightNode *_node, const Vec3 &_point, R
 	return (b3 - a3) / ((Real)3 * (b - a) * a3 * b3) - meanSquared;
 }
 
-void ManyLightSampler::InitLeaf(LightNode *_node) {
-	std::unique_ptr<Real[]> d(new Real[_node->numLights]);
-	for (unsigned i = 0; i < _node->numLights; ++i) {
-		d[i] = lights[_node->firstLightIndex + i]->Power();
-		lightNodeDistributionMap[lights[_node->firstLightIndex + i]] = { _node, i };	//Add it to light map
-		treePower += d[i];	//Accumulate tree power
-	}
-	leafDistributions[_node->firstLightIndex] = Distribution::Piecewise1D(&d[0], _node->numLights);
-	_node->children[0] = _node->children[1] = nullptr;
+unsigned ManyLightSampler::BucketIndex(const Bounds &_bounds, const Vec3 &_centre, const unsigned _axis) {
+	const unsigned b = (Real)numBuckets * _bounds.Offset(_centre)[_axis];
+	return std::min(b, numBuckets - 1);
 }
 
-bool ManyLightSampler::SplitAxis(LightNode *_node, const unsigned _axis, Real *_minCost, unsigned *_bucketIndex, Bucket *_leftBucket, Bucket *_rightBucket) {
-	constexpr unsigned numBuckets = 12;
-
-	std::unique_ptr<Bucket[]> buckets(new Bucket[numBuckets]);	//To self: Doesn't have to be on heap
-	std::unique_ptr<bool[]> bucketInits(new bool[numBuckets]);
-	std::fill(&bucketInits[0], &bucketInits[numBuckets], false);
-	for (unsigned i = _node->firstLightIndex; i < _node->firstLightIndex + _node->numLights; ++i) {
-		const Light *light = lights[i];
-		unsigned b = (Real)numBuckets * _node->bounds.Offset(light->GetBounds().Center())[_axis];
-		if (b == numBuckets) b = numBuckets - 1;
-		if (!bucketInits[b]) {
-			buckets[b].totalPower = light->Power();
-			buckets[b].bounds = light->GetBounds();
-			buckets[b].cone = OrientationCone::MakeCone(light->GetDirection());
-			bucketInits[b] = true;
-		}
-		else {
-			buckets[b].totalPower += light->Power();
-			buckets[b].bounds = maths::Union(buckets[b].bounds, light->GetBounds());
-			buckets[b].cone = OrientationCone::Union(buckets[b].cone, OrientationCone::MakeCone(light->GetDirection()));
+void ManyLightSampler::BinLights(BuildContext &_ctx, const LightNode *_node, Bucket _buckets[3][numBuckets]) {
+	const Vec3 extent = _node->bounds.max - _node->bounds.min;
+	bool axes[3];
+	for (unsigned a = 0; a < 3; ++a) axes[a] = extent[a] > 0;	//Flat axes can't be split along
+	auto bin = [&](const size_t _begin, const size_t _end, Bucket (*_out)[numBuckets]) {
+		for (size_t i = _begin; i < _end; ++i) {
+			const BuildLight &light = _ctx.lights[i];
+			for (unsigned a = 0; a < 3; ++a)
+				if (axes[a]) _out[a][BucketIndex(_node->bounds, light.centre, a)].Add(light);
 		}
+	};
+
+	const size_t first = _node->firstLightIndex;
+	if (_node->numLights < parallelBinThreshold) {
+		bin(first, first + _node->numLights, _buckets);
+		return;
 	}
+	struct Bins {
+		Bucket buckets[3][numBuckets];
+	};
+	std::vector<Bins> chunks((_node->numLights + buildChunkSize - 1) / buildChunkSize);
+	ParallelChunks(*_ctx.pool, _node->numLights, buildChunkSize, [&](const size_t _chunk, const size_t _begin, const size_t _end) {
+		bin(first + _begin, first + _end, chunks[_chunk].buckets);
+	});
+	for (const Bins &chunk : chunks)
+		for (unsigned a = 0; a < 3; ++a)
+			for (unsigned b = 0; b < numBuckets; ++b) _buckets[a][b].Add(chunk.buckets[a][b]);
+}
 
-	//Compute split costs and find minimum cost split
+bool ManyLightSampler::FindSplit(const LightNode *_node, const Bucket _buckets[3][numBuckets], Real *_minCost, unsigned *_axis, unsigned *_bucketIndex, Bucket *_leftBucket, Bucket *_rightBucket) {
 	constexpr unsigned numCosts = numBuckets - 1;
-	bool cheaper = false;
-	for (unsigned i = 0; i < numCosts; ++i) {
-		Bucket bL = { 0, buckets[0].bounds, buckets[0].cone };
-		Bucket bR = { 0, buckets[i + 1].bounds, buckets[i + 1].cone };
-		for (unsigned j = 0; j <= i; ++j) {	//Left bucket proposal
-			bL.bounds = maths::Union(bL.bounds, buckets[j].bounds);
-			bL.cone = OrientationCone::Union(bL.cone, buckets[j].cone);
-			bL.totalPower += buckets[j].totalPower;
+	bool found = false;
+	for (unsigned a = 0; a < 3; ++a) {
+		Bucket left[numCosts], right[numCosts];	//Split i puts buckets [0, i] left and the rest right
+		left[0] = _buckets[a][0];
+		for (unsigned i = 1; i < numCosts; ++i) {
+			left[i] = left[i - 1];
+			left[i].Add(_buckets[a][i]);
 		}
-		for (unsigned j = i + 1; j < numBuckets; ++j) {	//Right bucket proposal
-			bR.bounds = maths::Union(bR.bounds, buckets[j].bounds);
-			bR.cone = OrientationCone::Union(bR.cone, buckets[j].cone);
-			bR.totalPower += buckets[j].totalPower;
+		right[numCosts - 1] = _buckets[a][numBuckets - 1];
+		for (unsigned i = numCosts - 1; i > 0; --i) {
+			right[i - 1] = right[i];
+			right[i - 1].Add(_buckets[a][i]);
 		}
-		const Real cost = SAOH(*_node, bR, bL, _axis);
-		if (cost < *_minCost) {	//Check if split cost beats the best cost
-			*_minCost = cost;
-			*_leftBucket = bL;	//Store best buckets
-			*_rightBucket = bR;
-			*_bucketIndex = i;
-			cheaper = true;
+		for (unsigned i = 0; i < numCosts; ++i) {
+			if (left[i].numLights == 0 || right[i].numLights == 0) continue;
+			const Real cost = SAOH(*_node, right[i], left[i], a);
+			if (cost < *_minCost) {
+				*_minCost = cost;
+				*_axis = a;
+				*_bucketIndex = i;
+				*_leftBucket = left[i];
+				*_rightBucket = right[i];
+				found = true;
+			}
 		}
 	}
-	return cheaper;
+	return found;
 }
 
-void ManyLightSampler::RecursiveBuild(LightNode *_node) {
-
-	_node->bounds = lights[_node->firstLightIndex]->GetBounds();
-	_node->orientationCone = OrientationCone::MakeCone(lights[_node->firstLightIndex]->GetDirection());
-	for (unsigned i = 0; i < _node->numLights; ++i) {
-		_node->bounds = maths::Union(_node->bounds, lights[i + _node->firstLightIndex]->GetBounds());
-		_node->orientationCone = OrientationCone::Union(_node->orientationCone, OrientationCone::MakeCone(lights[i + _node->firstLightIndex]->GetDirection()));
+unsigned ManyLightSampler::PartitionLights(BuildContext &_ctx, const LightNode *_node, const unsigned _axis, const unsigned _bucketIndex) {
+	auto pred = [&](const BuildLight &_light) {
+		return BucketIndex(_node->bounds, _light.centre, _axis) <= _bucketIndex;
+	};
+	BuildLight *first = &_ctx.lights[_node->firstLightIndex];
+	if (_node->numLights < parallelBinThreshold)
+		return std::stable_partition(first, first + _node->numLights, pred) - first;
+
+	//Count each chunk's left lights, then scatter both sides through scratch at their prefix offsets
+	const size_t numChunks = (_node->numLights + buildChunkSize - 1) / buildChunkSize;
+	std::vector<size_t> leftCounts(numChunks);
+	ParallelChunks(*_ctx.pool, _node->numLights, buildChunkSize, [&](const size_t _chunk, const size_t _begin, const size_t _end) {
+		size_t count = 0;
+		for (size_t i = _begin; i < _end; ++i) count += pred(first[i]);
+		leftCounts[_chunk] = count;
+	});
+	std::vector<size_t> leftOffsets(numChunks);
+	size_t numLeft = 0;
+	for (size_t c = 0; c < numChunks; ++c) {
+		leftOffsets[c] = numLeft;
+		numLeft += leftCounts[c];
 	}
+	BuildLight *scratch = &_ctx.scratch[_node->firstLightIndex];
+	ParallelChunks(*_ctx.pool, _node->numLights, buildChunkSize, [&](const size_t _chunk, const size_t _begin, const size_t _end) {
+		size_t l = leftOffsets[_chunk];
+		size_t r = numLeft + (_begin - leftOffsets[_chunk]);	//Right lights before this chunk
+		for (size_t i = _begin; i < _end; ++i) {
+			if (pred(first[i])) scratch[l++] = first[i];
+			else scratch[r++] = first[i];
+		}
+	});
+	ParallelChunks(*_ctx.pool, _node->numLights, buildChunkSize, [&](const size_t _chunk, const size_t _begin, const size_t _end) {
+		std::copy(scratch + _begin, scratch + _end, first + _begin);
+	});
+	return (unsigned)numLeft;
+}
+
+void ManyLightSampler::BuildNode(BuildContext &_ctx, LightNode *_node) {
+	_node->children[0] = _node->children[1] = nullptr;
+	if (_node->numLights < 2) return;
 
+	Bucket buckets[3][numBuckets];
+	BinLights(_ctx, _node, buckets);
 	Bucket leftBucket, rightBucket;
 	Real minCost = INFINITY;
-	unsigned bucketIndex = 0;
-	int splitAxis = -1;
-
-	for (int i = 0; i < 3; ++i) {
-		if (SplitAxis(_node, i, &minCost, &bucketIndex, &leftBucket, &rightBucket))
-			splitAxis = i;
+	unsigned splitAxis = 0, bucketIndex = 0;
+	if (!FindSplit(_node, buckets, &minCost, &splitAxis, &bucketIndex, &leftBucket, &rightBucket) || minCost >= _node->totalPower) return;	//Leaf, initialised once the whole tree is built
+
+	const unsigned leftNumLights = PartitionLights(_ctx, _node, splitAxis, bucketIndex);
+	_node->children[0] = new LightNode{	//Left
+		{nullptr, nullptr},
+		_node,
+		_node->firstLightIndex,
+		leftNumLights,
+		leftBucket.bounds,
+		leftBucket.cone,
+		leftBucket.totalPower,
+		leftBucket.PowerVariance()
+	};
+	_node->children[1] = new LightNode{	//Right
+		{nullptr, nullptr},
+		_node,
+		_node->firstLightIndex + leftNumLights,
+		_node->numLights - leftNumLights,
+		rightBucket.bounds,
+		rightBucket.cone,
+		rightBucket.totalPower,
+		rightBucket.PowerVariance()
+	};
+	for (LightNode *child : _node->children) {
+		//Nodes over parallelBinThreshold block on the pool, they only occur above any subtree task
+		if (child->numLights >= parallelBinThreshold || child->numLights < subtreeTaskThreshold) BuildNode(_ctx, child);
+		else _ctx.Spawn(child);
 	}
+}
 
-	//Create leaf or split node
-	if (_node->numLights > 1 && minCost < _node->totalPower) {	//Split
-
-		auto pred = [&](const Light *l) {
-			unsigned b = _node->bounds.Offset(l->GetBounds().Center())[splitAxis] * (Real)numBuckets;
-			if (b == numBuckets) b--;
-			return b <= bucketIndex;
-		};
-
-		Light **it = std::partition(&lights[_node->firstLightIndex], &lights[_node->firstLightIndex + _node->numLights - 1] + 1, pred);	//Range not inclusive of last, hence +1
-		const unsigned pivot = it - &lights[0];
-		//Set the light primitive range
-		const unsigned leftNumLights = pivot - _node->firstLightIndex;
-		const unsigned rightNumLights = _node->numLights - leftNumLights;
-
-		if (leftNumLights != 0 && rightNumLights != 0) {
-			_node->children[0] = new LightNode{	//Left
-				{nullptr, nullptr},
-				_node,
-				_node->firstLightIndex,
-				leftNumLights,
-				leftBucket.bounds,
-				leftBucket.cone,
-				leftBucket.totalPower,
-				PowerVariance(_node->firstLightIndex, leftNumLights)
-			};
-			_node->children[1] = new LightNode{	//Right
-				{nullptr, nullptr},
-				_node,
-				pivot,
-				rightNumLights,
-				rightBucket.bounds,
-				rightBucket.cone,
-				rightBucket.totalPower,
-				PowerVariance(pivot, rightNumLights)
-			};
-			RecursiveBuild(_node->children[0]);
-			RecursiveBuild(_node->children[1]);
+void ManyLightSampler::BuildTree() {
+	ThreadPool pool(numBuildThreads);
+	BuildContext ctx;
+	ctx.pool = &pool;
+	ctx.lights.resize(lights.size());
+	if (lights.size() >= parallelBinThreshold) ctx.scratch.resize(lights.size());
+
+	//Read every light once, and bound the root from the same pass
+	std::vector<Bucket> chunks((lights.size() + buildChunkSize - 1) / buildChunkSize);
+	ParallelChunks(pool, lights.size(), buildChunkSize, [&](const size_t _chunk, const size_t _begin, const size_t _end) {
+		for (size_t i = _begin; i < _end; ++i) {
+			BuildLight &light = ctx.lights[i];
+			light.light = lights[i];
+			light.bounds = lights[i]->GetBounds();
+			light.centre = light.bounds.Center();
+			light.direction = lights[i]->GetDirection();
+			light.power = lights[i]->Power();
+			chunks[_chunk].Add(light);
 		}
-		else InitLeaf(_node);
-	}
-	else InitLeaf(_node);	//Leaf light distribution and terminate recursion (TODO add variance)
+	});
+	Bucket all;
+	for (const Bucket &chunk : chunks) all.Add(chunk);
+	root->bounds = all.bounds;
+	root->orientationCone = all.cone;
+	root->totalPower = all.totalPower;
+	root->powerVariance = all.PowerVariance();
+
+	BuildNode(ctx, root.get());
+	ctx.WaitSubtrees();
+
+	for (size_t i = 0; i < lights.size(); ++i) lights[i] = ctx.lights[i].light;
 }
 
 void ManyLightSampler::InitLights(const std::vector<Light *> &_lights) {
+	lights.clear();
+	triangleLights.clear();
+	sourceLights.clear();
+	infiniteLight = nullptr;
+	root.reset();
+
 	std::list<Light *> lightList;
 	std::copy(_lights.begin(), _lights.end(), std::back_inserter(lightList));
 
@@ -262,26 +680,36 @@ void ManyLightSampler::InitLights(const std::vector<Light *> &_lights) {
 		else ++l;
 	}
 
-	//Filter out mesh lights and represent as individual triangle lights
+	//Filter out mesh lights and represent as individual triangle lights, in scene order so builds are repeatable
+	size_t numTriangles = 0;
+	for (Light *light : lightList) {
+		MeshLight *meshLight = dynamic_cast<MeshLight *>(light);
+		if (meshLight) numTriangles += meshLight->GetMesh().numTriangles;
+	}
+	triangleLights.reserve(numTriangles);	//Never reallocates after this, lights points into it
 	l = lightList.begin();
 	while (l != lightList.end()) {
 		MeshLight *meshLight = dynamic_cast<MeshLight *>(*l);
 		if (meshLight) {
 			const TriangleMesh *mesh = &meshLight->GetMesh();
-			triangleLights.reserve(triangleLights.size() + mesh->numTriangles);
+			sourceLights.push_back({ meshLight, (unsigned)triangleLights.size(), true });
 			for (size_t i = 0; i < mesh->numTriangles; ++i) {
-				triangleLights.insert({ { meshLight, i }, TriangleLight(meshLight, i) });
+				triangleLights.emplace_back(meshLight, i);
+				lights.push_back(&triangleLights.back());
 			}
 			lightList.erase(l++);
 		}
 		else l++;
 	}
 
-	//Add the triangle lights ptrs to lights
-	for (auto &it : triangleLights) lights.push_back(&it.second);
-
 	//Add remaining from _lights to lights vector
-	for (auto l : lightList) lights.push_back(l);
+	for (auto l : lightList) {
+		sourceLights.push_back({ l, (unsigned)lights.size(), false });
+		lights.push_back(l);
+	}
+	std::sort(sourceLights.begin(), sourceLights.end(), [](const SourceLight &_a, const SourceLight &_b) {
+		return std::less<const Light *>()(_a.light, _b.light);
+	});
 
 	//Initialise root
 	if (lights.size() > 0) {
@@ -289,22 +717,17 @@ void ManyLightSampler::InitLights(const std::vector<Light *> &_lights) {
 		root->parent = nullptr;
 		root->numLights = lights.size();
 		root->firstLightIndex = 0;
-		root->bounds = lights[0]->GetBounds();
 		root->totalPower = 0;
 		root->powerVariance = 0;
-		root->orientationCone = OrientationCone::MakeCone(lights[0]->GetDirection());	//TO SELF: Will need to account for thetaE in future
-		root->children[0] = root->children[1] = nullptr;
-		for (unsigned i = 0; i < root->numLights; ++i) {
-			root->bounds = maths::Union(root->bounds, lights[i]->GetBounds());
-			root->orientationCone = OrientationCone::Union(root->orientationCone, OrientationCone::MakeCone(lights[i]->GetDirection()));
-			root->totalPower += lights[i]->Power();
-		}
+		root->children[0] = root->children[1] = nullptr;	//Bounds, cone and power are filled in by BuildTree() or LoadTree()
 	}
 }
 
-Real ManyLightSampler::ImportanceMeasure(const ScatterEvent &_event, LightNode *_node) const {	//TO SELF: Optimise
-	Vec3 delta = _node->bounds.Center() - _event.hit->point;
-	const Real clusterDiameter = _node->bounds.DiagonalLength();
+Real ManyLightSampler::ImportanceMeasure(const ScatterEvent &_event, const FlatNode &_node) const {	//TO SELF: Optimise
+	const Bounds bounds = NodeBounds(_node);
+	const OrientationCone cone = NodeCone(_node);
+	Vec3 delta = bounds.Center() - _event.hit->point;
+	const Real clusterDiameter = bounds.DiagonalLength();
 	Real d2 = maths::Dot(delta, delta);
 	Real d = std::sqrt(d2);
 	if (!useSplits) {	//Clamp distance to half the cluster radius to prevent inaccurate importance values when centroid is very close
@@ -314,82 +737,67 @@ Real ManyLightSampler::ImportanceMeasure(const ScatterEvent &_event, LightNode *
 	}
 	const Real invD = (Real)1 / d;
 	delta *= invD;
-	const Real theta = std::acos(maths::Dot(delta, _node->orientationCone.axis));
+	const Real theta = std::acos(maths::Dot(delta, cone.axis));
 	const Real thetaU = std::atan((clusterDiameter * (Real).5) * invD);
-	const Real thetaDash = std::max(theta - _node->orientationCone.thetaO - thetaU, (Real)0);
-	if (thetaDash < _node->orientationCone.thetaE) {
-		const Real E = _node->totalPower;
+	const Real thetaDash = std::max(theta - cone.thetaO - thetaU, (Real)0);
+	if (thetaDash < cone.thetaE) {
+		const Real E = _node.totalPower;
 		const Real thetaI = std::acos(maths::Dot(delta, _event.hit->normalS));
 		return (std::cos(std::max(thetaI - thetaU, (Real)0)) * E) / d2 * std::cos(thetaDash);
 	}
 	else return 0;
 }
 
-bool ManyLightSampler::Split(const ScatterEvent &_event, LightNode *_node) const {
-	const Real &powerVariance = _node->powerVariance;
+Real ManyLightSampler::LeftProbability(const ScatterEvent &_event, const unsigned _node) const {
+	const Real IL = ImportanceMeasure(_event, nodes[_node + 1]);
+	const Real IR = ImportanceMeasure(_event, nodes[nodes[_node].rightChild]);
+	return IL + IR > 0 ? IL / (IL + IR) : (Real).5;
+}
+
+bool ManyLightSampler::Split(const ScatterEvent &_event, const FlatNode &_node) const {
+	const Real &powerVariance = _node.powerVariance;
 	Real geometricMean;
 	const Real geometricVariance = GeometricVariance(_node, _event.hit->point, &geometricMean);
 	const Real geometricMean2 = geometricMean * geometricMean;
-	const Real powerMean = _node->totalPower / (Real)_node->numLights;
+	const Real powerMean = _node.totalPower / (Real)_node.numLights;
 	const Real powerMean2 = powerMean * powerMean;
-	const Real numLights2 = _node->numLights * _node->numLights;
+	const Real numLights2 = _node.numLights * _node.numLights;
 	const Real clusterVariance = (geometricVariance * powerVariance + powerVariance * geometricMean2 + powerMean2 * geometricVariance) * numLights2;
 	const Real normalisedVariance = std::sqrt(std::sqrt(	(Real)1 / ((Real)1 + std::sqrt(clusterVariance))	));	//Threshold can now be between [0, 1]
 	if (normalisedVariance < splitThreshold) return true;
 	else return false;
 }
 
-Light *ManyLightSampler::GetLights(const ScatterEvent &_event, Real _epsilon, LightNode *_node, Real *_pdf) const {
-	//if (_node->IsLeaf()) {
-	//	Real lpdf = 1;
-	//	const unsigned i = leafDistributions.at(_node->firstLightIndex).SampleDiscrete(_epsilon, &lpdf);	//Sample light distribution of cluster
-	//	*_pdf *= lpdf;
-	//	return lights[_node->firstLightIndex + i];
-	//}
-		if (Split(_event, _node)) {
+Light *ManyLightSampler::GetLights(const ScatterEvent &_event, Real _epsilon, const unsigned _node, Real *_pdf) const {
+	//if (!nodes[_node].rightChild) return PickLight(...);
+		if (Split(_event, nodes[_node])) {
 
 		}
 	return nullptr;
 }
 
-Light *ManyLightSampler::PickLight(const ScatterEvent &_event, Real _epsilon, LightNode *_node, Real *_pdf) const {
-	if (_node->IsLeaf()) {
-		Real lpdf = 1;
-		const unsigned i = leafDistributions.at(_node->firstLightIndex).SampleDiscrete(_epsilon, &lpdf);	//Sample light distribution of cluster
-		*_pdf *= lpdf;
-		return lights[_node->firstLightIndex + i];
-	}
-	else {
-		const Real IL = ImportanceMeasure(_event, _node->children[0]);
-		const Real IR = ImportanceMeasure(_event, _node->children[1]);
-		const Real PL = IL / (IL + IR);
+Light *ManyLightSampler::PickLight(const ScatterEvent &_event, Real _epsilon, Real *_pdf) const {
+	unsigned n = 0;
+	while (nodes[n].rightChild) {
+		const Real PL = LeftProbability(_event, n);
 		const Real PR = 1 - PL;
 		if (_epsilon < PL) {
 			_epsilon /= PL;
 			*_pdf *= PL;
-			return PickLight(_event, _epsilon, _node->children[0], _pdf);
+			n = n + 1;
 		}
 		else {
 			_epsilon = (_epsilon - PL) / PR;
 			*_pdf *= PR;
-			return PickLight(_event, _epsilon, _node->children[1], _pdf);
+			n = nodes[n].rightChild;
 		}
 	}
-}
-
-Real ManyLightSampler::RecursivePDF(const ScatterEvent &_event, const LightNode *_node, const LightNode *_child) const {
-	if (_child) {
-		const bool side = _child == _node->children[0] ? 0 : 1;
-		const Real IL = ImportanceMeasure(_event, _node->children[0]);
-		const Real IR = ImportanceMeasure(_event, _node->children[1]);
-		Real pdfs[2];
-		pdfs[0] = IL / (IL + IR);
-		pdfs[1] = 1 - IR;
-		if (_node->parent) pdfs[side] *= RecursivePDF(_event, _node->parent, _node);
-		return pdfs[side];
-	}
-	else if (_node->parent) return RecursivePDF(_event, _node->parent, _node);
-	return 1;	//Shouldn't happen
+	//Sample light distribution of cluster
+	const FlatNode &leaf = nodes[n];
+	const Real *cdf = &leafCdf[leaf.firstLightIndex];
+	const unsigned i = std::min((unsigned)(std::upper_bound(cdf, cdf + leaf.numLights, _epsilon) - cdf), leaf.numLights - 1);
+	*_pdf *= cdf[i] - (i > 0 ? cdf[i - 1] : 0);
+	return lights[leaf.firstLightIndex + i];
 }
 
 LAMBDA_END
\ No newline at end of file
@@ -4,12 +4,20 @@
 		Importance Sampling of Many Lights with Adaptive Tree Splitting - Estevez & Kulla
 	- For use in scenes with high-res mesh lights or many individual lights.
 	- Higher latency but more accurate importance sampling.
-	- Instead of procedurally evaulating the leaf node CDF of lights, they are stored
-	during tree construction and accessed using a hash table.
+	- The tree is built over pointer nodes, then flattened into a depth-first array of
+	compact nodes that sampling walks by index. Leaf CDFs are stored inline, one entry
+	per light.
+	- Builds bin and bound lights in fixed size chunks and merge the chunks in order. Cone
+	unions aren't associative, so node cones, and the splits chosen from them, can differ
+	slightly from merging one light at a time. They don't depend on the number of build
+	threads though, and Sample() and Pdf() read the same flattened nodes, so pdfs always
+	match the tree that was sampled.
 */
 #pragma once
-#include <deque>
-#include <unordered_map>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 #include "LightSampler.h"
 
 LAMBDA_BEGIN
@@ -17,9 +25,13 @@ LAMBDA_BEGIN
 class TriangleLight;
 
 class ManyLightSampler : public LightSampler {
+	friend class ManyLightSamplerTest;	//test/light_tree_test
+
 	public:
 		Real splitThreshold;
 		bool useSplits;
+		std::string cacheDirectory;	//If set, built trees are saved here and reloaded while the scene's lights hash the same
+		unsigned numBuildThreads;	//Threads used to build the tree. 0 = hardware threads
 
 		ManyLightSampler(const Real _splitThreshold = 0.1, const bool _useSplits = true);
 
@@ -31,15 +43,23 @@ class ManyLightSampler : public LightSampler {
 		Light *Sample(const ScatterEvent &_event, Sampler &_sampler, Real *_pdf) const override;
 
 		/*
-			Probability of choosing _light via traversal.
+			Probability of choosing _light via traversal. Follows the light's stored trail down from
+			the root, so it evaluates the same node pairs sampling would and nothing else.
 		*/
 		Real Pdf(const ScatterEvent &_event, const Light *_light) const override;
 
 		/*
-			Builds the light tree.
+			Builds the light tree, or loads it from cacheDirectory.
 		*/
 		void Commit() override;
 
+		/*
+			Seconds the last Commit() spent building or loading and flattening the tree.
+		*/
+		inline Real BuildTime() const {
+			return buildTime;
+		}
+
 	private:
 		/*
 			thetaO bounds the normals of lights; thetaE bounds the emission profiles of lights.
@@ -60,6 +80,9 @@ class ManyLightSampler : public LightSampler {
 			static OrientationCone Union(const OrientationCone &_a, const OrientationCone &_b);
 		};
 
+		/*
+			Pointer tree node, only alive while building or loading.
+		*/
 		struct LightNode {
 			LightNode *children[2];	//If both nullptr, it is a leaf
 			LightNode *parent;
@@ -75,32 +98,103 @@ class ManyLightSampler : public LightSampler {
 			}
 		};
 
+		/*
+			What the build needs from a light, read once up front rather than through the light's
+			virtuals on every pass.
+		*/
+		struct BuildLight {
+			Bounds bounds;
+			Vec3 centre, direction;
+			Real power;
+			Light *light;
+		};
+
 		/*
 			Lightweight representation of a node for tree construction (PBRT-style).
+			Also sums squared power so a split's power variance needs no extra pass over its lights.
 		*/
 		struct Bucket {
+			unsigned numLights = 0;
 			Real totalPower = 0;
+			double powerSquared = 0;
 			Bounds bounds;
 			OrientationCone cone;
+
+			void Add(const BuildLight &_light);
+
+			void Add(const Bucket &_bucket);
+
+			Real PowerVariance() const;
 		};
 
-		struct pair_hash {	//Silly stuff for being able to hash the pair
-			template<class A, class B>
-			inline size_t operator() (const std::pair<A, B> &_pair) const {
-				return std::hash<A>()(_pair.first) ^ std::hash<B>()(_pair.second);
-			}
+		struct BuildContext;
+
+		/*
+			Node of the flattened tree. The left child follows its parent, the right child is at
+			rightChild. Bounds are quantised over the root's bounds and the cone to 16 bits, both
+			rounded outwards so the decoded node still contains its lights.
+		*/
+		struct FlatNode {
+			uint16_t bounds[6];	//Min then max
+			uint16_t axis[2];	//Octahedral
+			uint16_t thetaO, thetaE;
+			float totalPower, powerVariance;
+			uint32_t firstLightIndex, numLights;
+			uint32_t rightChild;	//0 for leaves
+		};
+
+		/*
+			Scene light and where its lights start in source order. Mesh lights are followed
+			by one entry per triangle.
+		*/
+		struct SourceLight {
+			const Light *light;
+			unsigned index;
+			bool mesh;
 		};
 
-		typedef std::pair<const Light *, unsigned> TriangleLightKey;
+		/*
+			Where a light ended up in the tree. Bit d of trail is set if the path from the root to
+			the light's leaf goes right at depth d.
+		*/
+		struct LightRef {
+			uint64_t trail;
+			unsigned index;	//In lights
+		};
+
+		static constexpr unsigned maxTrailDepth = 64;
 
 		static constexpr unsigned numBuckets = 12;
-		std::unordered_map<TriangleLightKey, TriangleLight, pair_hash> triangleLights;	//Edge case to triangle light from Light ptr and primitive index
+		static constexpr unsigned parallelBinThreshold = 1 << 16;	//Nodes this large are binned and partitioned in parallel chunks
+		static constexpr unsigned subtreeTaskThreshold = 1 << 10;	//Subtrees this large are built as their own tasks
+		std::vector<TriangleLight> triangleLights;	//Mesh lights split into triangles, in scene order
+		std::vector<SourceLight> sourceLights;	//Sorted by light pointer
 		std::vector<Light *> lights;	//Keep infinite lights separate from finite lights for convenience when sampling
 		Light *infiniteLight;
 		Real treePower, infPower;
-		std::unordered_map<unsigned, Distribution::Piecewise1D> leafDistributions;	//First light index of leaf node 
-		std::unordered_map<const Light *, std::pair<LightNode *, unsigned>> lightNodeDistributionMap;	//Required to quickly find *any* light's leaf node and position in leaf distribution.
-		std::unique_ptr<LightNode> root;	//Root node of light tree
+		std::unique_ptr<LightNode> root;	//Root node of light tree while it is built, freed by Flatten()
+		std::vector<FlatNode> nodes;	//Depth-first, root first
+		std::vector<Real> leafCdf;	//Per light, the CDF of its leaf up to and including it
+		std::vector<LightRef> lightRefs;	//Per light in source order
+		Vec3 boundsOrigin, boundsScale;	//Dequantises node bounds
+		Real buildTime = 0;
+
+		/*
+			Content hash of the lights in build order: their count, bounds, directions and power.
+			Anything that would change the tree changes one of these.
+		*/
+		uint64_t HashLights() const;
+
+		/*
+			Writes the built tree to _path. _unbuilt is the light order before building, lights are
+			stored as indices into it.
+		*/
+		bool SaveTree(const std::string &_path, const uint64_t _hash, const std::vector<Light *> &_unbuilt) const;
+
+		/*
+			Replaces the unbuilt tree with the one at _path if it was saved for _hash.
+		*/
+		bool LoadTree(const std::string &_path, const uint64_t _hash);
 
 		/*
 			Filters lights in _lights into respective containers.
@@ -110,9 +204,20 @@ class ManyLightSampler : public LightSampler {
 		void InitLights(const std::vector<Light *> &_lights);
 
 		/*
-			Converts _node into a leaf over range of lights and builds respective distribution.
+			Copies the pointer tree into nodes, fills in leafCdf, lightRefs and treePower and frees
+			the pointer tree.
 		*/
-		void InitLeaf(LightNode *_node);
+		void Flatten();
+
+		/*
+			Index of _light in source order, looking up the triangle _primId of mesh lights. ~0u if
+			it isn't one of the tree's lights.
+		*/
+		unsigned SourceIndex(const Light *_light, const unsigned _primId) const;
+
+		Bounds NodeBounds(const FlatNode &_node) const;
+
+		static OrientationCone NodeCone(const FlatNode &_node);
 
 		/*
 			Orientation cone measure function - analagous to bounding box surface area (MArea)
@@ -122,64 +227,75 @@ class ManyLightSampler : public LightSampler {
 		/*
 			Surface area orientation heuristic
 		*/
-		static Real SAOH(LightNode &_P, const Bucket &_R, const Bucket &_L, const unsigned _axis);
+		static Real SAOH(const LightNode &_P, const Bucket &_R, const Bucket &_L, const unsigned _axis);
 
 		/*
-			Returns power variance (termed energy variance in paper) of cluster
+			Returns geometric variance of cluster:
+				We consider a bounding sphere around the node's bounding box and take the smallest
+				and largest distance to the sphere from the shading point.
 		*/
-		Real PowerVariance(LightNode *_node) const;
+		Real GeometricVariance(const FlatNode &_node, const Vec3 &_point, Real *_mean) const;
 
 		/*
-			Compute power variance from light interval
-			TO SELF: Could make compute all powers before for faster build.
+			Bucket of _centre along _axis of _bounds.
 		*/
-		Real PowerVariance(const unsigned _firstLightIndex, const unsigned _numLights) const;
+		static unsigned BucketIndex(const Bounds &_bounds, const Vec3 &_centre, const unsigned _axis);
 
 		/*
-			Returns geometric variance of cluster:
-				We consider a bounding sphere around the node's bounding box and take the smallest
-				and largest distance to the sphere from the shading point.
+			Bins the lights of _node on all three axes in one pass. Large nodes are binned in chunks
+			on the build pool and the chunks merged in order, so the result does not depend on timing.
+		*/
+		static void BinLights(BuildContext &_ctx, const LightNode *_node, Bucket _buckets[3][numBuckets]);
+
+		/*
+			Finds the lowest SAOH cost split over all axes from prefix and suffix sweeps of the buckets.
+			Returns false if no split has lights on both sides.
+		*/
+		static bool FindSplit(const LightNode *_node, const Bucket _buckets[3][numBuckets], Real *_minCost, unsigned *_axis, unsigned *_bucketIndex, Bucket *_leftBucket, Bucket *_rightBucket);
+
+		/*
+			Stable partition of _node's lights into those in buckets up to _bucketIndex and the rest.
+			Returns the number on the left.
 		*/
-		Real GeometricVariance(LightNode *_node, const Vec3 &_point, Real *_mean) const;
+		static unsigned PartitionLights(BuildContext &_ctx, const LightNode *_node, const unsigned _axis, const unsigned _bucketIndex);
 
 		/*
-			Makes the best split cost along _axis of _node and stores the split in _leftBucket and _rightBucket if it beats _minCost.
-			Returns true if it beat _minCost.
+			Splits _node with the lowest SAOH cost split and continues into its children. Children large
+			enough are handed to the pool as separate subtree tasks.
 		*/
-		bool SplitAxis(LightNode *_node, const unsigned _axis, Real *_minCost, unsigned *_bucketIndex, Bucket *_leftBucket, Bucket *_rightBucket);
+		static void BuildNode(BuildContext &_ctx, LightNode *_node);
 
 		/*
-			Recursively splits nodes with lowest SAOH cost split.
-			Considers all axes.
+			Builds the tree over lights in parallel, reorders lights to match and initialises the leaves.
 		*/
-		void RecursiveBuild(LightNode *_P);
+		void BuildTree();
 
 		/*
 			Returns the importance of node relative to scatter event. Will fail on leaf nodes.
 		*/
-		Real ImportanceMeasure(const ScatterEvent &_event, LightNode *_node) const;
+		Real ImportanceMeasure(const ScatterEvent &_event, const FlatNode &_node) const;
+
+		/*
+			Probability of traversing to the left child of interior node _node.
+		*/
+		Real LeftProbability(const ScatterEvent &_event, const unsigned _node) const;
 
 		/*
 			Decides whether to traverse multiple branches or stochastic traverse if
 			the split threshold is satisfied
 		*/
-		bool Split(const ScatterEvent &_event, LightNode *_node) const;
+		bool Split(const ScatterEvent &_event, const FlatNode &_node) const;
 
 		/*
 			Begins the tree sampling traversal, splitting if the split threshold is not satisfied, otherwise
 			recursively traversing a single branch.
 		*/
-		Light *GetLights(const ScatterEvent &_event, Real _epsilon, LightNode *_node, Real *_pdf) const;
+		Light *GetLights(const ScatterEvent &_event, Real _epsilon, const unsigned _node, Real *_pdf) const;
 
 		/*
 			Stochastically traverses a single branch and pulls light from leaf.
 		*/
-		Light *PickLight(const ScatterEvent &_event, Real _epsilon, LightNode *_node, Real *_pdf) const;
-
-		/*
-			Returns probability of choosing _node via backwards traversal.
-		*/
-		Real RecursivePDF(const ScatterEvent &_event, const LightNode *_node, const LightNode *_child = nullptr) const;
+		Light *PickLight(const ScatterEvent &_event, Real _epsilon, Real *_pdf) const;
 };
 
 LAMBDA_END
\ No newline at end of file
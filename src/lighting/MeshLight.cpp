@@ -167,7 +167,7 @@ Spectrum TriangleLight::SamplePoint(Sampler &_sampler, ScatterEvent &_event, Par
 	const TriangleMesh &mesh = *meshLight->mesh;
 	const Triangle &t = mesh.triangles[triIndex];
 	Real area;
-	mesh.GetTriangleAreaAndNormal(&t, &area);
+	mesh.GetTriangleAreaAndNormal(&t, &area, &_ls->normal);
 	_ls->pdf /= area;
 	const Vec2 u = _sampler.Get2D();
 	_event.hit->uvCoords = maths::BarycentricInterpolation(
@@ -182,7 +182,7 @@ Spectrum TriangleLight::SamplePoint(Sampler &_sampler, ScatterEvent &_event, Par
 Spectrum TriangleLight::Visibility(const Vec3 &_shadingPoint, ScatterEvent &_event, Sampler &_sampler, PartialLightSample *_ls) const {
 	Spectrum Tr(1);
 	if (MutualVisibility(_shadingPoint, _ls->point, _event, *_event.scene, _sampler, &Tr)) {
-		const Real cosTheta = std::abs(maths::Dot(_event.hit->normalG, -_event.wi));
+		const Real cosTheta = std::abs(maths::Dot(_ls->normal, -_event.wi));
 		_ls->pdf *= maths::DistSq(_shadingPoint, _ls->point) / cosTheta;
 		return Tr;
 	}
@@ -0,0 +1,161 @@
+#include <cmath>
+#include <core/Scene.h>
+#include <shading/surface/BxDF.h>
+#include "ReservoirLightSampler.h"
+#include "EnvironmentLight.h"
+#include "PointLight.h"
+#include "Spotlight.h"
+
+LAMBDA_BEGIN
+
+void ReservoirLightSampler::Reservoir::Update(const Candidate &_candidate, const Real _weight, const Real _targetPdf, const unsigned _M, const Real _u) {
+	weightSum += _weight;
+	M += _M;
+	if (_weight > 0 && _u * weightSum < _weight) {
+		sample = _candidate;
+		targetPdf = _targetPdf;
+	}
+}
+
+ReservoirLightSampler::ReservoirLightSampler(const Scene &_scene, LightSampler *_base, const unsigned _numCandidates) : LightSampler(&_scene), numCandidates(_numCandidates), base(_base), width(0), height(0) {}
+
+Light *ReservoirLightSampler::Sample(const ScatterEvent &_event, Sampler &_sampler, Real *_pdf) const {
+	return base->Sample(_event, _sampler, _pdf);
+}
+
+Real ReservoirLightSampler::Pdf(const ScatterEvent &_event, const Light *_light) const {
+	return base->Pdf(_event, _light);
+}
+
+void ReservoirLightSampler::Commit() {
+	base->Commit();
+	pixels.assign(pixels.size(), PixelReservoir());
+}
+
+void ReservoirLightSampler::SetResolution(const unsigned _width, const unsigned _height) {
+	width = _width;
+	height = _height;
+	pixels.assign((size_t)_width * _height, PixelReservoir());
+}
+
+Real ReservoirLightSampler::SampleCandidate(ScatterEvent &_event, Sampler &_sampler, Candidate *_candidate) const {
+	Real pdf = 0;
+	Light *l = base->Sample(_event, _sampler, &pdf);
+	if (!l || pdf == 0) return 0;
+	_candidate->light = l;
+	if (const EnvironmentLight *env = dynamic_cast<const EnvironmentLight*>(l)) {
+		Real dirPdf;
+		_candidate->point = env->SampleDirection(_sampler.Get2D(), &dirPdf);
+		if (dirPdf == 0) return 0;
+		_candidate->Le = env->Le(_candidate->point);
+		_candidate->type = CandidateType::DIRECTION;
+		return pdf * dirPdf;
+	}
+	PartialLightSample ls;
+	ls.light = l;
+	ls.pdf = 1;
+	const Vec2 uv = _event.hit->uvCoords;	//SamplePoint() evaluates emission at the light's uvs
+	_candidate->Le = l->SamplePoint(_sampler, _event, &ls);
+	_event.hit->uvCoords = uv;
+	_candidate->point = ls.point;
+	_candidate->normal = ls.normal;
+	_candidate->type = (dynamic_cast<const PointLight*>(l) || dynamic_cast<const Spotlight*>(l)) ? CandidateType::DELTA : CandidateType::AREA;
+	return pdf * ls.pdf;
+}
+
+Spectrum ReservoirLightSampler::Unshadowed(ScatterEvent &_event, const Candidate &_candidate) const {
+	Real G = 1;
+	if (_candidate.type == CandidateType::DIRECTION) _event.wi = _candidate.point;
+	else {
+		const Vec3 diff = _candidate.point - _event.hit->point;
+		const Real distSq = maths::Dot(diff, diff);
+		if (distSq == 0) return Spectrum(0);
+		_event.wi = diff / std::sqrt(distSq);
+		G = 1 / distSq;
+		if (_candidate.type == CandidateType::AREA) G *= std::abs(maths::Dot(_candidate.normal, -_event.wi));	//abs for double sided
+		else if (const Spotlight *spot = dynamic_cast<const Spotlight*>(_candidate.light)) G *= spot->Falloff(-_event.wi);
+	}
+	if (G == 0) return Spectrum(0);
+	_event.wiL = _event.ToLocal(_event.wi);
+	const Spectrum f = _event.hit->object->material->bxdf->f(_event) * std::abs(_event.wiL.y);
+	return f * _candidate.Le * G;
+}
+
+void ReservoirLightSampler::Reuse(ScatterEvent &_event, Sampler &_sampler, const unsigned _pixel, Reservoir *_r) const {
+	PixelReservoir other;
+	{
+		std::lock_guard<std::mutex> lock(pixelLocks[_pixel % numPixelLocks]);
+		other = pixels[_pixel];
+	}
+	if (other.reservoir.M == 0 || !other.reservoir.sample.light) return;
+	if (maths::Dot(other.normal, _event.hit->normalG) < (Real).9) return;
+	const Real maxDist = (Real).1 * std::max(_event.hit->tFar, other.depth);
+	if (maths::DistSq(other.point, _event.hit->point) > maxDist * maxDist) return;
+	const unsigned M = std::min(other.reservoir.M, maxHistory * numCandidates);
+	const Real targetPdf = TargetPdf(Unshadowed(_event, other.reservoir.sample));
+	_r->Update(other.reservoir.sample, targetPdf * other.reservoir.W() * M, targetPdf, M, _sampler.Get1D());
+}
+
+Spectrum ReservoirLightSampler::SampleDirect(ScatterEvent &_event, Sampler &_sampler, const unsigned _pixel) const {
+	if (!_event.hit->object->material->bxdf) return Spectrum(0);
+
+	Reservoir r;
+	Candidate c;
+	for (unsigned i = 0; i < numCandidates; ++i) {
+		const Real pdf = SampleCandidate(_event, _sampler, &c);
+		if (pdf == 0) {
+			++r.M;	//A failed candidate still counts towards M
+			continue;
+		}
+		const Real targetPdf = TargetPdf(Unshadowed(_event, c));
+		r.Update(c, targetPdf / pdf, targetPdf, 1, _sampler.Get1D());
+	}
+
+	//Stored samples are unweighted by the path's wavelength, so reuse is skipped for dispersive paths
+	const bool reuse = _pixel < pixels.size() && !_event.wavelength && (temporalReuse || spatialReuse);
+	if (reuse) {
+		if (temporalReuse) Reuse(_event, _sampler, _pixel, &r);
+		if (spatialReuse) {
+			const int x = _pixel % width, y = _pixel / width;
+			for (unsigned i = 0; i < numNeighbours; ++i) {
+				const Vec2 u = _sampler.Get2D();
+				const Real radius = neighbourRadius * std::sqrt(u.x), phi = u.y * PI2;
+				const int nx = x + (int)std::round(radius * std::cos(phi));
+				const int ny = y + (int)std::round(radius * std::sin(phi));
+				if (nx < 0 || ny < 0 || nx >= (int)width || ny >= (int)height || (nx == x && ny == y)) continue;
+				Reuse(_event, _sampler, ny * width + nx, &r);
+			}
+		}
+	}
+
+	Spectrum L(0);
+	if (r.sample.light && r.targetPdf > 0) {
+		const Spectrum contribution = Unshadowed(_event, r.sample);	//Also leaves wi pointing at the sample
+		const Vec3 pS = _event.hit->point + _event.hit->normalG * SURFACE_EPSILON * _event.sidedness;
+		const Scene &scene = *_event.scene;
+		Spectrum Tr(1);
+		bool visible;
+		switch (r.sample.type) {
+			case CandidateType::AREA: visible = Light::MutualVisibility(pS, r.sample.point, _event, scene, _sampler, &Tr); break;
+			case CandidateType::DELTA: visible = Light::PointMutualVisibility(pS, r.sample.point, _event, scene, _sampler, &Tr); break;
+			default: visible = Light::RayEscapes(Ray(pS, r.sample.point), _event, _sampler, &Tr); break;
+		}
+		if (visible) L = contribution * Tr * r.W();
+		else r.weightSum = 0;	//Occluded samples aren't worth passing on
+	}
+
+	if (reuse) {
+		PixelReservoir stored;
+		stored.reservoir = r;
+		stored.reservoir.M = std::min(r.M, maxHistory * numCandidates);
+		stored.reservoir.weightSum *= (Real)stored.reservoir.M / std::max(r.M, 1u);	//Keep W() as it was
+		stored.point = _event.hit->point;
+		stored.normal = _event.hit->normalG;
+		stored.depth = _event.hit->tFar;
+		std::lock_guard<std::mutex> lock(pixelLocks[_pixel % numPixelLocks]);
+		pixels[_pixel] = stored;
+	}
+	return L;
+}
+
+LAMBDA_END
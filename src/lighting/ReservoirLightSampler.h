@@ -0,0 +1,126 @@
+/*
+	Resampled importance sampling of direct light, after:
+		Spatiotemporal Reservoir Resampling for Real-Time Ray Tracing with Dynamic Direct Lighting - Bitterli et al.
+	- Draws cheap candidate light samples from a base sampler, weights them by their unshadowed
+	contribution and traces a single shadow ray for the one that is kept.
+	- Optionally reuses the kept samples of the previous pass at the same pixel (temporal) and of
+	nearby pixels (spatial). Neighbours are accepted on similar position and normal rather than by
+	evaluating their target function, so reuse is slightly biased.
+	- Sample() and Pdf() are the base sampler's, so integrators that don't resample are unchanged.
+*/
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "LightSampler.h"
+
+LAMBDA_BEGIN
+
+class ReservoirLightSampler : public LightSampler {
+	public:
+		unsigned numCandidates;
+		bool temporalReuse = false, spatialReuse = false;
+		unsigned numNeighbours = 4;	//Spatial reuse
+		Real neighbourRadius = 16;	//In pixels
+		unsigned maxHistory = 20;	//Reused candidates are capped at this many times numCandidates
+
+		ReservoirLightSampler(const Scene &_scene, LightSampler *_base, const unsigned _numCandidates = 8);
+
+		/*
+			Samples a light from the base sampler.
+		*/
+		Light *Sample(const ScatterEvent &_event, Sampler &_sampler, Real *_pdf) const override;
+
+		/*
+			Probability of the base sampler choosing _light.
+		*/
+		Real Pdf(const ScatterEvent &_event, const Light *_light) const override;
+
+		/*
+			Commits the base sampler and drops stored reservoirs.
+		*/
+		void Commit() override;
+
+		/*
+			Sets the film size reservoirs are stored for. Reuse is off while it is 0.
+		*/
+		void SetResolution(const unsigned _width, const unsigned _height);
+
+		/*
+			Direct light at _event from one resampled light sample and one shadow ray. _pixel is the
+			film pixel of a camera path's first hit, ~0u skips reuse. The estimate stands in for all
+			light sampling, so it must not be MIS weighted against BSDF sampled hits on lights.
+		*/
+		Spectrum SampleDirect(ScatterEvent &_event, Sampler &_sampler, const unsigned _pixel = ~0u) const;
+
+	private:
+		enum class CandidateType {
+			AREA,	//Point on a light, pdf per unit area
+			DELTA,	//Point light, pdf of picking the light
+			DIRECTION	//Infinite light, point is a direction and pdf is per unit solid angle
+		};
+
+		struct Candidate {
+			const Light *light = nullptr;
+			Vec3 point, normal;
+			Spectrum Le;
+			CandidateType type = CandidateType::AREA;
+		};
+
+		struct Reservoir {
+			Candidate sample;
+			Real weightSum = 0;
+			Real targetPdf = 0;	//Of sample, at the shading point the reservoir is for
+			unsigned M = 0;
+
+			/*
+				Streams in a candidate with resampling weight _weight standing for _M candidates.
+			*/
+			void Update(const Candidate &_candidate, const Real _weight, const Real _targetPdf, const unsigned _M, const Real _u);
+
+			/*
+				Unbiased contribution weight of sample.
+			*/
+			inline Real W() const {
+				return targetPdf > 0 && M > 0 ? weightSum / ((Real)M * targetPdf) : 0;
+			}
+		};
+
+		struct PixelReservoir {
+			Reservoir reservoir;
+			Vec3 point, normal;	//Shading point it was made at
+			Real depth = 0;
+		};
+
+		static constexpr unsigned numPixelLocks = 64;
+
+		std::unique_ptr<LightSampler> base;
+		unsigned width, height;
+		mutable std::vector<PixelReservoir> pixels;
+		mutable std::mutex pixelLocks[numPixelLocks];
+
+		/*
+			Draws a light from base and a point on it. Returns the candidate's source pdf, 0 if it failed.
+		*/
+		Real SampleCandidate(ScatterEvent &_event, Sampler &_sampler, Candidate *_candidate) const;
+
+		/*
+			Contribution of _candidate at _event ignoring visibility, in the measure of its source pdf.
+			Leaves the direction to it in _event.
+		*/
+		Spectrum Unshadowed(ScatterEvent &_event, const Candidate &_candidate) const;
+
+		/*
+			Target function the candidates are resampled by.
+		*/
+		static inline Real TargetPdf(const Spectrum &_contribution) {
+			return std::max(_contribution.y(), (Real)0);
+		}
+
+		/*
+			Merges the stored reservoir of _pixel into _r if it was made at a similar shading point.
+		*/
+		void Reuse(ScatterEvent &_event, Sampler &_sampler, const unsigned _pixel, Reservoir *_r) const;
+};
+
+LAMBDA_END
@@ -0,0 +1,414 @@
+#include <cmath>
+#include <algorithm>
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LAMBDA_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#endif
+#endif
+
+//Per-function instruction set targets, MSVC allows intrinsics without them
+#if defined(__GNUC__) || defined(__clang__)
+#define LAMBDA_TARGET(_isa) __attribute__((target(_isa)))
+#else
+#define LAMBDA_TARGET(_isa)
+#endif
+
+namespace maths {
+
+	namespace simd {
+
+		/*
+			---------- Detection ----------
+		*/
+
+		#ifdef LAMBDA_SIMD_X86
+
+		static void CPUID(int _info[4], const int _leaf, const int _subleaf) {
+			#if defined(_MSC_VER)
+			__cpuidex(_info, _leaf, _subleaf);
+			#elif defined(__GNUC__) || defined(__clang__)
+			unsigned a, b, c, d;
+			__cpuid_count(_leaf, _subleaf, a, b, c, d);
+			_info[0] = a; _info[1] = b; _info[2] = c; _info[3] = d;
+			#else
+			_info[0] = _info[1] = _info[2] = _info[3] = 0;
+			#endif
+		}
+
+		LAMBDA_TARGET("xsave")
+		static unsigned long long XCR0() {
+			#if defined(_MSC_VER)
+			return _xgetbv(0);
+			#elif defined(__GNUC__) || defined(__clang__)
+			unsigned a, d;
+			__asm__ volatile("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+			return ((unsigned long long)d << 32) | a;
+			#else
+			return 0;
+			#endif
+		}
+
+		ISA DetectISA() {
+			int info[4];
+			CPUID(info, 0, 0);
+			const int maxLeaf = info[0];
+			CPUID(info, 1, 0);
+			const bool sse41 = info[2] & (1 << 19);
+			const bool fma = info[2] & (1 << 12);
+			const bool osxsave = info[2] & (1 << 27);
+			const bool avx = info[2] & (1 << 28);
+			if (!sse41) return ISA::SCALAR;
+			if (!osxsave || !avx || maxLeaf < 7) return ISA::SSE4;
+			const unsigned long long xcr0 = XCR0();
+			if ((xcr0 & 0x6) != 0x6) return ISA::SSE4;	//OS doesn't save YMM state
+			CPUID(info, 7, 0);
+			const bool avx2 = info[1] & (1 << 5);
+			const bool avx512f = info[1] & (1 << 16);
+			if (avx512f && fma && (xcr0 & 0xE6) == 0xE6) return ISA::AVX512;
+			if (avx2 && fma) return ISA::AVX2;
+			return ISA::SSE4;
+		}
+		#else
+		ISA DetectISA() {
+			return ISA::SCALAR;
+		}
+		#endif
+
+		const char *ISAName(const ISA _isa) {
+			switch (_isa) {
+			case ISA::SSE4: return "SSE4";
+			case ISA::AVX2: return "AVX2";
+			case ISA::AVX512: return "AVX-512";
+			default: return "Scalar";
+			}
+		}
+
+		//Cephes expf constants
+		static const float EXP_HI = 88.3762626647949f, EXP_LO = -88.3762626647949f;
+		static const float LOG2E = 1.44269504088896341f, EXP_C1 = 0.693359375f, EXP_C2 = -2.12194440e-4f;
+		static const float EXP_P0 = 1.9875691500e-4f, EXP_P1 = 1.3981999507e-3f, EXP_P2 = 8.3334519073e-3f;
+		static const float EXP_P3 = 4.1665795894e-2f, EXP_P4 = 1.6666665459e-1f, EXP_P5 = 5.0000001201e-1f;
+
+		/*
+			---------- Scalar ----------
+		*/
+
+		static void AddScalar(const float *_a, const float *_b, float *_out, const unsigned _n) { for (unsigned i = 0; i < _n; ++i) _out[i] = _a[i] + _b[i]; }
+		static void SubScalar(const float *_a, const float *_b, float *_out, const unsigned _n) { for (unsigned i = 0; i < _n; ++i) _out[i] = _a[i] - _b[i]; }
+		static void MulScalar(const float *_a, const float *_b, float *_out, const unsigned _n) { for (unsigned i = 0; i < _n; ++i) _out[i] = _a[i] * _b[i]; }
+		static void DivScalar(const float *_a, const float *_b, float *_out, const unsigned _n) { for (unsigned i = 0; i < _n; ++i) _out[i] = _a[i] / _b[i]; }
+		static void MulScalarScalar(const float *_a, const float _s, float *_out, const unsigned _n) { for (unsigned i = 0; i < _n; ++i) _out[i] = _a[i] * _s; }
+		static void ExpScalar(const float *_a, float *_out, const unsigned _n) { for (unsigned i = 0; i < _n; ++i) _out[i] = std::exp(_a[i]); }
+		static void SqrtScalar(const float *_a, float *_out, const unsigned _n) { for (unsigned i = 0; i < _n; ++i) _out[i] = std::sqrt(_a[i]); }
+
+		static bool IsBlackScalar(const float *_a, const unsigned _n) {
+			for (unsigned i = 0; i < _n; ++i) if (_a[i] != 0) return false;
+			return true;
+		}
+
+		static float DotScalar(const float *_a, const float *_b, const unsigned _n) {
+			float r = 0;
+			for (unsigned i = 0; i < _n; ++i) r += _a[i] * _b[i];
+			return r;
+		}
+
+		#ifdef LAMBDA_SIMD_X86
+
+		/*
+			---------- SSE4 ----------
+		*/
+
+		#define LAMBDA_SIMD_BINARY(_name, _target, _width, _load, _store, _op, _scalarOp) \
+		LAMBDA_TARGET(_target) \
+		static void _name(const float *_a, const float *_b, float *_out, const unsigned _n) { \
+			unsigned i = 0; \
+			for (; i + _width <= _n; i += _width) _store(_out + i, _op(_load(_a + i), _load(_b + i))); \
+			for (; i < _n; ++i) _out[i] = _a[i] _scalarOp _b[i]; \
+		}
+
+		LAMBDA_SIMD_BINARY(AddSSE4, "sse4.1", 4, _mm_loadu_ps, _mm_storeu_ps, _mm_add_ps, +)
+		LAMBDA_SIMD_BINARY(SubSSE4, "sse4.1", 4, _mm_loadu_ps, _mm_storeu_ps, _mm_sub_ps, -)
+		LAMBDA_SIMD_BINARY(MulSSE4, "sse4.1", 4, _mm_loadu_ps, _mm_storeu_ps, _mm_mul_ps, *)
+		LAMBDA_SIMD_BINARY(DivSSE4, "sse4.1", 4, _mm_loadu_ps, _mm_storeu_ps, _mm_div_ps, /)
+
+		LAMBDA_TARGET("sse4.1")
+		static void MulScalarSSE4(const float *_a, const float _s, float *_out, const unsigned _n) {
+			const __m128 s = _mm_set1_ps(_s);
+			unsigned i = 0;
+			for (; i + 4 <= _n; i += 4) _mm_storeu_ps(_out + i, _mm_mul_ps(_mm_loadu_ps(_a + i), s));
+			for (; i < _n; ++i) _out[i] = _a[i] * _s;
+		}
+
+		/*
+			The input is clamped to the range exp is finite in, NaNs are blended back in afterwards since
+			min and max would turn them into a bound.
+		*/
+		LAMBDA_TARGET("sse4.1")
+		static inline __m128 Exp4(__m128 _x) {
+			const __m128 nan = _mm_cmpunord_ps(_x, _x), in = _x;
+			_x = _mm_min_ps(_mm_max_ps(_x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+			const __m128 fx = _mm_floor_ps(_mm_add_ps(_mm_mul_ps(_x, _mm_set1_ps(LOG2E)), _mm_set1_ps(.5f)));
+			_x = _mm_sub_ps(_x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+			_x = _mm_sub_ps(_x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+			const __m128 x2 = _mm_mul_ps(_x, _x);
+			__m128 y = _mm_set1_ps(EXP_P0);
+			y = _mm_add_ps(_mm_mul_ps(y, _x), _mm_set1_ps(EXP_P1));
+			y = _mm_add_ps(_mm_mul_ps(y, _x), _mm_set1_ps(EXP_P2));
+			y = _mm_add_ps(_mm_mul_ps(y, _x), _mm_set1_ps(EXP_P3));
+			y = _mm_add_ps(_mm_mul_ps(y, _x), _mm_set1_ps(EXP_P4));
+			y = _mm_add_ps(_mm_mul_ps(y, _x), _mm_set1_ps(EXP_P5));
+			y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, x2), _x), _mm_set1_ps(1.f));
+			const __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+			return _mm_blendv_ps(_mm_mul_ps(y, _mm_castsi128_ps(e)), in, nan);
+		}
+
+		/*
+			Exp of the last _n < 4 floats in one vector, so short arrays such as RGB spectra don't
+			fall back to std::exp per element.
+		*/
+		LAMBDA_TARGET("sse4.1")
+		static inline void ExpTail4(const float *_a, float *_out, const unsigned _n) {
+			__m128 x = _mm_load_ss(_a + _n - 1);	//Gathered in registers, a store and reload would stall the load
+			if (_n >= 2) x = _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double *)_a)), x);
+			x = Exp4(x);
+			if (_n >= 2) {
+				_mm_store_sd((double *)_out, _mm_castps_pd(x));
+				x = _mm_movehl_ps(x, x);
+			}
+			_mm_store_ss(_out + _n - 1, x);
+		}
+
+		LAMBDA_TARGET("sse4.1")
+		static void ExpSSE4(const float *_a, float *_out, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 4 <= _n; i += 4) _mm_storeu_ps(_out + i, Exp4(_mm_loadu_ps(_a + i)));
+			if (i < _n) ExpTail4(_a + i, _out + i, _n - i);
+		}
+
+		LAMBDA_TARGET("sse4.1")
+		static void SqrtSSE4(const float *_a, float *_out, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 4 <= _n; i += 4) _mm_storeu_ps(_out + i, _mm_sqrt_ps(_mm_loadu_ps(_a + i)));
+			for (; i < _n; ++i) _out[i] = std::sqrt(_a[i]);
+		}
+
+		LAMBDA_TARGET("sse4.1")
+		static bool IsBlackSSE4(const float *_a, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 4 <= _n; i += 4) if (_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(_a + i), _mm_setzero_ps()))) return false;
+			for (; i < _n; ++i) if (_a[i] != 0) return false;
+			return true;
+		}
+
+		LAMBDA_TARGET("sse4.1")
+		static float DotSSE4(const float *_a, const float *_b, const unsigned _n) {
+			__m128 acc = _mm_setzero_ps();
+			unsigned i = 0;
+			for (; i + 4 <= _n; i += 4) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(_a + i), _mm_loadu_ps(_b + i)));
+			acc = _mm_hadd_ps(acc, acc);
+			acc = _mm_hadd_ps(acc, acc);
+			float r = _mm_cvtss_f32(acc);
+			for (; i < _n; ++i) r += _a[i] * _b[i];
+			return r;
+		}
+
+		/*
+			---------- AVX2 ----------
+		*/
+
+		LAMBDA_SIMD_BINARY(AddAVX2, "avx2,fma", 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, +)
+		LAMBDA_SIMD_BINARY(SubAVX2, "avx2,fma", 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_sub_ps, -)
+		LAMBDA_SIMD_BINARY(MulAVX2, "avx2,fma", 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_mul_ps, *)
+		LAMBDA_SIMD_BINARY(DivAVX2, "avx2,fma", 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_div_ps, /)
+
+		LAMBDA_TARGET("avx2,fma")
+		static void MulScalarAVX2(const float *_a, const float _s, float *_out, const unsigned _n) {
+			const __m256 s = _mm256_set1_ps(_s);
+			unsigned i = 0;
+			for (; i + 8 <= _n; i += 8) _mm256_storeu_ps(_out + i, _mm256_mul_ps(_mm256_loadu_ps(_a + i), s));
+			for (; i < _n; ++i) _out[i] = _a[i] * _s;
+		}
+
+		LAMBDA_TARGET("avx2,fma")
+		static inline __m256 Exp8(__m256 _x) {
+			const __m256 nan = _mm256_cmp_ps(_x, _x, _CMP_UNORD_Q), in = _x;
+			_x = _mm256_min_ps(_mm256_max_ps(_x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+			const __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(_x, _mm256_set1_ps(LOG2E), _mm256_set1_ps(.5f)));
+			_x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), _x);
+			_x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), _x);
+			const __m256 x2 = _mm256_mul_ps(_x, _x);
+			__m256 y = _mm256_set1_ps(EXP_P0);
+			y = _mm256_fmadd_ps(y, _x, _mm256_set1_ps(EXP_P1));
+			y = _mm256_fmadd_ps(y, _x, _mm256_set1_ps(EXP_P2));
+			y = _mm256_fmadd_ps(y, _x, _mm256_set1_ps(EXP_P3));
+			y = _mm256_fmadd_ps(y, _x, _mm256_set1_ps(EXP_P4));
+			y = _mm256_fmadd_ps(y, _x, _mm256_set1_ps(EXP_P5));
+			y = _mm256_add_ps(_mm256_fmadd_ps(y, x2, _x), _mm256_set1_ps(1.f));
+			const __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127)), 23);
+			return _mm256_blendv_ps(_mm256_mul_ps(y, _mm256_castsi256_ps(e)), in, nan);
+		}
+
+		LAMBDA_TARGET("avx2,fma")
+		static void ExpAVX2(const float *_a, float *_out, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 8 <= _n; i += 8) _mm256_storeu_ps(_out + i, Exp8(_mm256_loadu_ps(_a + i)));
+			for (; i + 4 <= _n; i += 4) _mm_storeu_ps(_out + i, Exp4(_mm_loadu_ps(_a + i)));
+			if (i < _n) ExpTail4(_a + i, _out + i, _n - i);
+		}
+
+		LAMBDA_TARGET("avx2,fma")
+		static void SqrtAVX2(const float *_a, float *_out, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 8 <= _n; i += 8) _mm256_storeu_ps(_out + i, _mm256_sqrt_ps(_mm256_loadu_ps(_a + i)));
+			for (; i < _n; ++i) _out[i] = std::sqrt(_a[i]);
+		}
+
+		LAMBDA_TARGET("avx2,fma")
+		static bool IsBlackAVX2(const float *_a, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 8 <= _n; i += 8) if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(_a + i), _mm256_setzero_ps(), _CMP_NEQ_UQ))) return false;
+			for (; i < _n; ++i) if (_a[i] != 0) return false;
+			return true;
+		}
+
+		LAMBDA_TARGET("avx2,fma")
+		static float DotAVX2(const float *_a, const float *_b, const unsigned _n) {
+			__m256 acc = _mm256_setzero_ps();
+			unsigned i = 0;
+			for (; i + 8 <= _n; i += 8) acc = _mm256_fmadd_ps(_mm256_loadu_ps(_a + i), _mm256_loadu_ps(_b + i), acc);
+			__m128 h = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+			h = _mm_hadd_ps(h, h);
+			h = _mm_hadd_ps(h, h);
+			float r = _mm_cvtss_f32(h);
+			for (; i < _n; ++i) r += _a[i] * _b[i];
+			return r;
+		}
+
+		/*
+			---------- AVX-512 ----------
+		*/
+
+		//GCC 12's AVX-512 headers pass _mm512_undefined_ps() as the merge source of unmasked intrinsics,
+		//which -Wmaybe-uninitialized reports wherever they are inlined
+		#if defined(__GNUC__) && !defined(__clang__)
+		#pragma GCC diagnostic push
+		#pragma GCC diagnostic ignored "-Wuninitialized"
+		#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+		#endif
+
+		LAMBDA_SIMD_BINARY(AddAVX512, "avx512f", 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, +)
+		LAMBDA_SIMD_BINARY(SubAVX512, "avx512f", 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_sub_ps, -)
+		LAMBDA_SIMD_BINARY(MulAVX512, "avx512f", 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_mul_ps, *)
+		LAMBDA_SIMD_BINARY(DivAVX512, "avx512f", 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_div_ps, /)
+
+		#undef LAMBDA_SIMD_BINARY
+
+		LAMBDA_TARGET("avx512f")
+		static void MulScalarAVX512(const float *_a, const float _s, float *_out, const unsigned _n) {
+			const __m512 s = _mm512_set1_ps(_s);
+			unsigned i = 0;
+			for (; i + 16 <= _n; i += 16) _mm512_storeu_ps(_out + i, _mm512_mul_ps(_mm512_loadu_ps(_a + i), s));
+			for (; i < _n; ++i) _out[i] = _a[i] * _s;
+		}
+
+		LAMBDA_TARGET("avx512f")
+		static inline __m512 Exp16(__m512 _x) {
+			const __mmask16 nan = _mm512_cmp_ps_mask(_x, _x, _CMP_UNORD_Q);
+			const __m512 in = _x;
+			_x = _mm512_min_ps(_mm512_max_ps(_x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+			const __m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(_x, _mm512_set1_ps(LOG2E), _mm512_set1_ps(.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+			_x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C1), _x);
+			_x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C2), _x);
+			const __m512 x2 = _mm512_mul_ps(_x, _x);
+			__m512 y = _mm512_set1_ps(EXP_P0);
+			y = _mm512_fmadd_ps(y, _x, _mm512_set1_ps(EXP_P1));
+			y = _mm512_fmadd_ps(y, _x, _mm512_set1_ps(EXP_P2));
+			y = _mm512_fmadd_ps(y, _x, _mm512_set1_ps(EXP_P3));
+			y = _mm512_fmadd_ps(y, _x, _mm512_set1_ps(EXP_P4));
+			y = _mm512_fmadd_ps(y, _x, _mm512_set1_ps(EXP_P5));
+			y = _mm512_add_ps(_mm512_fmadd_ps(y, x2, _x), _mm512_set1_ps(1.f));
+			const __m512i e = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(127)), 23);
+			return _mm512_mask_blend_ps(nan, _mm512_mul_ps(y, _mm512_castsi512_ps(e)), in);
+		}
+
+		LAMBDA_TARGET("avx512f")
+		static void ExpAVX512(const float *_a, float *_out, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 16 <= _n; i += 16) _mm512_storeu_ps(_out + i, Exp16(_mm512_loadu_ps(_a + i)));
+			if (i < _n) {
+				const __mmask16 tail = (__mmask16)((1u << (_n - i)) - 1);
+				_mm512_mask_storeu_ps(_out + i, tail, Exp16(_mm512_maskz_loadu_ps(tail, _a + i)));
+			}
+		}
+
+		LAMBDA_TARGET("avx512f")
+		static void SqrtAVX512(const float *_a, float *_out, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 16 <= _n; i += 16) _mm512_storeu_ps(_out + i, _mm512_sqrt_ps(_mm512_loadu_ps(_a + i)));
+			for (; i < _n; ++i) _out[i] = std::sqrt(_a[i]);
+		}
+
+		LAMBDA_TARGET("avx512f")
+		static bool IsBlackAVX512(const float *_a, const unsigned _n) {
+			unsigned i = 0;
+			for (; i + 16 <= _n; i += 16) if (_mm512_cmp_ps_mask(_mm512_loadu_ps(_a + i), _mm512_setzero_ps(), _CMP_NEQ_UQ)) return false;
+			for (; i < _n; ++i) if (_a[i] != 0) return false;
+			return true;
+		}
+
+		LAMBDA_TARGET("avx512f")
+		static float DotAVX512(const float *_a, const float *_b, const unsigned _n) {
+			__m512 acc = _mm512_setzero_ps();
+			unsigned i = 0;
+			for (; i + 16 <= _n; i += 16) acc = _mm512_fmadd_ps(_mm512_loadu_ps(_a + i), _mm512_loadu_ps(_b + i), acc);
+			//Reduced through memory, GCC's _mm512_reduce_add_ps, extracts and casts all read undefined registers
+			alignas(64) float lanes[16];
+			_mm512_store_ps(lanes, acc);
+			__m128 q = _mm_add_ps(_mm_add_ps(_mm_load_ps(lanes), _mm_load_ps(lanes + 4)), _mm_add_ps(_mm_load_ps(lanes + 8), _mm_load_ps(lanes + 12)));
+			q = _mm_hadd_ps(q, q);
+			q = _mm_hadd_ps(q, q);
+			float r = _mm_cvtss_f32(q);
+			for (; i < _n; ++i) r += _a[i] * _b[i];
+			return r;
+		}
+
+		#if defined(__GNUC__) && !defined(__clang__)
+		#pragma GCC diagnostic pop
+		#endif
+
+		/*
+			---------- Dispatch ----------
+		*/
+
+		static const Kernels kernelTables[4] = {
+			{ ISA::SCALAR, &AddScalar, &SubScalar, &MulScalar, &DivScalar, &MulScalarScalar, &ExpScalar, &SqrtScalar, &IsBlackScalar, &DotScalar },
+			{ ISA::SSE4, &AddSSE4, &SubSSE4, &MulSSE4, &DivSSE4, &MulScalarSSE4, &ExpSSE4, &SqrtSSE4, &IsBlackSSE4, &DotSSE4 },
+			{ ISA::AVX2, &AddAVX2, &SubAVX2, &MulAVX2, &DivAVX2, &MulScalarAVX2, &ExpAVX2, &SqrtAVX2, &IsBlackAVX2, &DotAVX2 },
+			{ ISA::AVX512, &AddAVX512, &SubAVX512, &MulAVX512, &DivAVX512, &MulScalarAVX512, &ExpAVX512, &SqrtAVX512, &IsBlackAVX512, &DotAVX512 }
+		};
+
+		#else
+
+		static const Kernels kernelTables[1] = {
+			{ ISA::SCALAR, &AddScalar, &SubScalar, &MulScalar, &DivScalar, &MulScalarScalar, &ExpScalar, &SqrtScalar, &IsBlackScalar, &DotScalar }
+		};
+
+		#endif
+
+		const Kernels &GetKernels() {
+			static const ISA isa = DetectISA();
+			return kernelTables[(unsigned)isa];
+		}
+
+		const Kernels &GetKernels(const ISA _isa) {
+			static const ISA isa = DetectISA();
+			return kernelTables[std::min((unsigned)_isa, (unsigned)isa)];
+		}
+	}
+}
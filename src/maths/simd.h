@@ -0,0 +1,58 @@
+/*
+----	Runtime dispatched SIMD kernels	----
+	Array kernels for spectral arithmetic with SSE4, AVX2 and AVX-512 implementations.
+	The best instruction set supported by the CPU is detected once on first use, so a
+	single binary runs well on any x86-64 machine. Falls back to scalar code elsewhere.
+
+	These are out of line, so they only pay off on long arrays (e.g. 32 sample spectra) or
+	costly functions such as exp; short fixed size arithmetic should keep using the inlined
+	operators. Intrinsics are only included by simd.cpp, so this header builds on any target.
+*/
+
+#pragma once
+
+namespace maths {
+
+	namespace simd {
+
+		enum class ISA {
+			SCALAR,
+			SSE4,
+			AVX2,
+			AVX512
+		};
+
+		/*
+			Highest instruction set supported by both the CPU and the OS.
+		*/
+		ISA DetectISA();
+
+		const char *ISAName(const ISA _isa);
+
+		/*
+			Kernel table for one instruction set. Arrays need no alignment. _n is the element count.
+		*/
+		struct Kernels {
+			ISA isa;
+			void (*add)(const float *_a, const float *_b, float *_out, const unsigned _n);
+			void (*sub)(const float *_a, const float *_b, float *_out, const unsigned _n);
+			void (*mul)(const float *_a, const float *_b, float *_out, const unsigned _n);
+			void (*div)(const float *_a, const float *_b, float *_out, const unsigned _n);
+			void (*mulScalar)(const float *_a, const float _s, float *_out, const unsigned _n);
+			void (*exp)(const float *_a, float *_out, const unsigned _n);
+			void (*sqrt)(const float *_a, float *_out, const unsigned _n);
+			bool (*isBlack)(const float *_a, const unsigned _n);
+			float (*dot)(const float *_a, const float *_b, const unsigned _n);
+		};
+
+		/*
+			Kernels for the detected instruction set.
+		*/
+		const Kernels &GetKernels();
+
+		/*
+			Kernels for a specific instruction set, e.g. for comparison. Falls back to the best supported set below _isa.
+		*/
+		const Kernels &GetKernels(const ISA _isa);
+	}
+}
@@ -241,10 +241,26 @@ namespace maths {
 	}
 
 	#ifdef LAMBDA_VEC3_USE_SSE
+	/*
+		Summed in registers, in the same order as the scalar version so results don't change.
+	*/
 	template<>
 	inline float Dot(const vec3<float> &_a, const vec3<float> &_b) {
-		const vec3<float> sq = _a * _b;
-		return sq.x + sq.y + sq.z;
+		const __m128 m = _mm_mul_ps(_mm_load_ps(&_a.x), _mm_load_ps(&_b.x));
+		const __m128 xy = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+		return _mm_cvtss_f32(_mm_add_ss(xy, _mm_movehl_ps(m, m)));
+	}
+
+	/*
+		a * b.yzx - a.yzx * b is the cross product in zxy order, so one more shuffle puts it back.
+	*/
+	template<>
+	inline vec3<float> Cross(const vec3<float> &_a, const vec3<float> &_b) {
+		const __m128 a = _mm_load_ps(&_a.x), b = _mm_load_ps(&_b.x);
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1))), _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)), b));
+		vec3<float> r;
+		_mm_store_ps(&r.x, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+		return r;
 	}
 	#endif
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ LAMBDA_BEGIN
 MosaicRenderer::MosaicRenderer(const RenderDirective &_directive, TileRenderer _tileRenderer) {
 	mosaic = RenderMosaic(_directive);
 	tileRenderer = _tileRenderer;
+	_directive.integrator->BeginPass(*_directive.scene);	//One pass, RenderMosaic has already prepared the integrator
 }
 
 
@@ -8,19 +8,20 @@ ProgressiveRender::ProgressiveRender(const RenderDirective &_renderDirective) {
 	renderDirective = _renderDirective;
 	outputTexture = Texture(renderDirective.film->filmData.GetWidth(), renderDirective.film->filmData.GetHeight());
 	updateCallback = nullptr;
+	tileRenderer = &TileRenderers::UniformIncrement;
 }
 
 void ProgressiveRender::Init() {
 	if (!isRunning) { // prevent multiple initialisation
 		isRunning = true;
 
-		renderMosaic = RenderMosaic(renderDirective);
+		renderMosaic = RenderMosaic(renderDirective);	//Prepares the integrator
 
 		tileTaskPackages.clear();
 		const unsigned numTiles = renderMosaic.tiles.size();
 		tileTaskPackages.reserve(numTiles);
 		for (unsigned i = 0; i < numTiles; ++i) {
-			tileTaskPackages.push_back({ &renderMosaic.tiles[i] });
+			tileTaskPackages.push_back({ &renderMosaic.tiles[i], tileRenderer });
 		}
 
 		std::function<void()> func = std::bind(&ProgressiveRender::RunPass, this);
@@ -38,8 +39,11 @@ void ProgressiveRender::Clear() {
 }
 
 void ProgressiveRender::RunPass() {
+	if (!tileTasks.empty()) renderDirective.integrator->EndPass();	//No tiles are running, so shared state can be refined
 	tileTasks.clear();
 	UpdateOutputTexture();
+	renderDirective.scene->CompileMaterials();	//No tiles are running, so pick up shader graph edits here
+	renderDirective.integrator->BeginPass(*renderDirective.scene);
 	std::function<void()> runPassFunc = std::bind(&ProgressiveRender::RunPass, this);
 	SharedTask runTask(Task::MakeTask<void>(runPassFunc));
 	
@@ -6,15 +6,16 @@ LAMBDA_BEGIN
 
 struct TileTaskPackage {
 	RenderTile *tile;
+	TileRenderer tileRenderer;
 
 	void Work() {
-		TileRenderers::UniformIncrement(tile);
+		tileRenderer(tile);
 	}
 };
 
 class ProgressiveRender {
 	public:
-		TileRenderer tileRenderer;
+		TileRenderer tileRenderer;	//Called once per tile per pass, UniformIncrement by default
 		Texture outputTexture;
 		void(*updateCallback)();
 
@@ -15,6 +15,7 @@ RenderMosaic::RenderMosaic(const RenderDirective &_directive) {
 	nX = (w / _directive.tileSizeX) + (rX > 0 ? 1 : 0);
 	nY = (h / _directive.tileSizeY) + (rY > 0 ? 1 : 0);
 	const bool padX = rX > 0, padY = rY > 0;
+	_directive.integrator->Prepare(*_directive.scene, _directive.camera, _directive.film);	//Before cloning, so the tiles share its state
 	tiles.resize(nX * nY);
 	for (unsigned y = 0; y < nY; ++y) {
 		for (unsigned x = 0; x < nX; ++x) {
@@ -28,12 +29,15 @@ RenderMosaic::RenderMosaic(const RenderDirective &_directive) {
 			t.integrator->sampler = t.sampler.get();
 			t.scene = _directive.scene;
 			t.spp = _directive.spp;
+			t.errorThreshold = _directive.errorThreshold;
+			t.minSpp = _directive.minSpp;
 			if (padX && x == nX - 1) t.w = rX;
 			else t.w = _directive.tileSizeX;
 			if (padY && y == nY - 1) t.h = rY;
 			else t.h = _directive.tileSizeY;
 			t.x = x * _directive.tileSizeX;
 			t.y = y * _directive.tileSizeY;
+			t.filmTile.reset(new FilmTile(*_directive.film, t.x, t.y, t.w, t.h));
 		}
 	}
 }
@@ -41,49 +45,73 @@ RenderMosaic::RenderMosaic(const RenderDirective &_directive) {
 
 
 void TileRenderers::UniformSpp(const RenderTile *_tile) {
-	const unsigned w = _tile->film->filmData.GetWidth();
-	const unsigned h = _tile->film->filmData.GetHeight();
-	const Real xi = (Real)1 / w;
-	const Real yi = (Real)1 / h;
+	std::vector<PixelSamples> pixels;
+	pixels.reserve(_tile->w * _tile->h);
 	for (unsigned y = _tile->y; y < _tile->y + _tile->h; ++y) {
 		for (unsigned x = _tile->x; x < _tile->x + _tile->w; ++x) {
-			if (_tile->integrator->sampler->sampleShifter) {
-				_tile->integrator->sampler->sampleShifter->SetPixelIndex(w, h, x, y);
-			}
-			_tile->integrator->sampler->SetSample(0);
-			for (unsigned i = 0; i < _tile->spp; ++i) {
-				const Real u = xi * ((Real)x + _tile->integrator->sampler->Get1D() - .5);
-				const Real v = yi * ((Real)y + _tile->integrator->sampler->Get1D() - .5);
-				const Ray r = _tile->camera->GenerateRay(u, v, *_tile->sampler);
-				const Spectrum sample = _tile->integrator->Li(r, *_tile->scene);
-				_tile->film->AddSample(sample, x, y);
-				_tile->integrator->sampler->NextSample();
-			}
+			pixels.push_back({ x, y, 0, _tile->spp });
 		}
 	}
+	_tile->integrator->RenderPixels(_tile, pixels.data(), pixels.size());
+	_tile->film->MergeTile(*_tile->filmTile);
 }
 
 
 
 void TileRenderers::UniformIncrement(const RenderTile *_tile) {
-	const unsigned w = _tile->film->filmData.GetWidth();
-	const unsigned h = _tile->film->filmData.GetHeight();
-	const Real xi = (Real)1 / w;
-	const Real yi = (Real)1 / h;
+	std::vector<PixelSamples> pixels;
+	pixels.reserve(_tile->w * _tile->h);
 	for (unsigned y = _tile->y; y < _tile->y + _tile->h; ++y) {
 		for (unsigned x = _tile->x; x < _tile->x + _tile->w; ++x) {
-			if (_tile->integrator->sampler->sampleShifter) {
-				_tile->integrator->sampler->sampleShifter->SetPixelIndex(w, h, x, y);
+			pixels.push_back({ x, y, _tile->film->GetPixelStatistics(x, y).nSamples, 1 });	//One sample per pass, so the count is the pass
+		}
+	}
+	_tile->integrator->RenderPixels(_tile, pixels.data(), pixels.size());
+	_tile->film->MergeTile(*_tile->filmTile);
+}
+
+
+
+void TileRenderers::Adaptive(const RenderTile *_tile) {
+	const unsigned minSpp = std::min(std::max(_tile->minSpp, 2u), _tile->spp);
+	const unsigned batch = std::max(minSpp / 2, 1u);
+	std::vector<PixelSamples> pixels;
+	pixels.reserve(_tile->w * _tile->h);
+	for (unsigned y = _tile->y; y < _tile->y + _tile->h; ++y) {
+		for (unsigned x = _tile->x; x < _tile->x + _tile->w; ++x) {
+			pixels.push_back({ x, y, 0, minSpp });
+		}
+	}
+	_tile->integrator->RenderPixels(_tile, pixels.data(), pixels.size());
+	_tile->film->MergeTile(*_tile->filmTile);
+	//Rounds over the unconverged pixels so the error estimate is refreshed between batches
+	for (unsigned spp = minSpp; spp < _tile->spp; spp += batch) {
+		const unsigned n = std::min(batch, _tile->spp - spp);
+		pixels.clear();
+		for (unsigned y = _tile->y; y < _tile->y + _tile->h; ++y) {
+			for (unsigned x = _tile->x; x < _tile->x + _tile->w; ++x) {
+				if (_tile->film->GetPixelStatistics(x, y).RelativeError() <= _tile->errorThreshold) continue;
+				pixels.push_back({ x, y, spp, n });
 			}
-			const Real u = xi * ((Real)x + _tile->integrator->sampler->Get1D() - .5);
-			const Real v = yi * ((Real)y + _tile->integrator->sampler->Get1D() - .5);
-			const Ray r = _tile->camera->GenerateRay(u, v, *_tile->sampler);
-			const Spectrum sample = _tile->integrator->Li(r, *_tile->scene);
-			_tile->film->AddSample(sample, x, y);
-			_tile->integrator->sampler->NextSample();
 		}
+		if (pixels.empty()) break;
+		_tile->integrator->RenderPixels(_tile, pixels.data(), pixels.size());
+		_tile->film->MergeTile(*_tile->filmTile);
 	}
 }
 
+void TileRenderers::AdaptiveIncrement(const RenderTile *_tile) {
+	std::vector<PixelSamples> pixels;
+	pixels.reserve(_tile->w * _tile->h);
+	for (unsigned y = _tile->y; y < _tile->y + _tile->h; ++y) {
+		for (unsigned x = _tile->x; x < _tile->x + _tile->w; ++x) {
+			const FilmPixel pixel = _tile->film->GetPixelStatistics(x, y);
+			if (pixel.nSamples >= _tile->minSpp && pixel.RelativeError() <= _tile->errorThreshold) continue;
+			pixels.push_back({ x, y, pixel.nSamples, 1 });
+		}
+	}
+	_tile->integrator->RenderPixels(_tile, pixels.data(), pixels.size());
+	_tile->film->MergeTile(*_tile->filmTile);
+}
 
 LAMBDA_END
\ No newline at end of file
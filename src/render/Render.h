@@ -17,16 +17,28 @@ struct RenderDirective {
 	Sampler *sampler;
 	SampleShifter *sampleShifter;
 	unsigned tileSizeX, tileSizeY, spp;
+	Real errorThreshold;	//Relative error below which adaptive tile renderers consider a pixel converged
+	unsigned minSpp;	//Samples every pixel gets before adaptive tile renderers estimate error
 };
 
 struct RenderTile {
 	Film *film;
+	std::unique_ptr<FilmTile> filmTile;	//Local accumulation buffer, merged into film at the end of each tile render
 	std::unique_ptr<Integrator> integrator;
 	std::unique_ptr<Sampler> sampler;
 	std::unique_ptr<SampleShifter> sampleShifter;
 	Camera *camera;
 	Scene *scene;
 	unsigned x, y, w, h, spp;
+	Real errorThreshold;
+	unsigned minSpp;
+};
+
+/*
+	Asks Integrator::RenderPixels() for n samples of pixel x, y, continuing its sample sequence from first.
+*/
+struct PixelSamples {
+	unsigned x, y, first, n;
 };
 
 //class TileRenderer {
@@ -61,28 +73,16 @@ namespace TileRenderers {
 	*/
 	void UniformIncrement(const RenderTile *_tile);
 
-	//class UniformTileRenderer : public TileRenderer {
-	//	public:
-	//
-	//		void Render(const RenderTile &_tile) override;
-	//};
-	//
-	//class AdaptiveTileRenderer : public TileRenderer {
-	//	public:
-	//		AdaptiveTileRenderer(const RenderDirective &_directive);
-	//
-	//		void Render(const RenderTile &_tile) override;
-	//
-	//	private:
-	//		Film film2;
-	//		TextureR32 varianceBuffer;
-	//		unsigned rate;
-	//
-	//		/*
-	//			Calculates variance estimate by comparing films.
-	//		*/
-	//		Real PixelVariance(const unsigned _x, const unsigned _y) const;
-	//};
+	/*
+		Samples each pixel of the tile until its relative error falls below the tile's
+		errorThreshold or it reaches the tile's spp. Every pixel gets at least minSpp.
+	*/
+	void Adaptive(const RenderTile *_tile);
+
+	/*
+		Adds single sample contribution to pixels of the tile that haven't yet converged.
+	*/
+	void AdaptiveIncrement(const RenderTile *_tile);
 }
 
 LAMBDA_END
\ No newline at end of file
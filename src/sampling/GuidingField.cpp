@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include "GuidingField.h"
+
+LAMBDA_BEGIN
+
+namespace {
+
+	constexpr Real oneMinusEpsilon = (Real)0x1.fffffep-1;
+
+	inline void AtomicAdd(std::atomic<float> &_a, const float _v) {
+		float current = _a.load(std::memory_order_relaxed);
+		while (!_a.compare_exchange_weak(current, current + _v, std::memory_order_relaxed));
+	}
+
+	/*
+		Picks one of two halves with weights _a and _b, rescaling _u back into [0, 1).
+	*/
+	inline unsigned PickHalf(const Real _a, const Real _b, Real *_u) {
+		const Real pA = _a / (_a + _b);
+		if (*_u < pA) {
+			*_u = std::min(*_u / pA, oneMinusEpsilon);
+			return 0;
+		}
+		*_u = std::min((*_u - pA) / (1 - pA), oneMinusEpsilon);
+		return 1;
+	}
+}
+
+GuidingField::DirectionalTree::Node::Node() {
+	for (unsigned i = 0; i < 4; ++i) {
+		sum[i].store(0, std::memory_order_relaxed);
+		children[i] = 0;
+	}
+}
+
+GuidingField::DirectionalTree::Node::Node(const Node &_node) {
+	*this = _node;
+}
+
+GuidingField::DirectionalTree::Node &GuidingField::DirectionalTree::Node::operator=(const Node &_node) {
+	for (unsigned i = 0; i < 4; ++i) {
+		sum[i].store(_node.sum[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		children[i] = _node.children[i];
+	}
+	return *this;
+}
+
+GuidingField::DirectionalTree::DirectionalTree() : nodes(1) {}
+
+void GuidingField::DirectionalTree::Add(Vec2 _p, const Real _radiance) {
+	unsigned node = 0;
+	for (;;) {
+		const unsigned x = _p.x >= (Real).5, y = _p.y >= (Real).5;
+		const unsigned q = x + 2 * y;
+		AtomicAdd(nodes[node].sum[q], _radiance);
+		if (!nodes[node].children[q]) return;
+		_p = Vec2(_p.x * 2 - x, _p.y * 2 - y);
+		node = nodes[node].children[q];
+	}
+}
+
+Vec2 GuidingField::DirectionalTree::Sample(Vec2 _u, Real *_pdf) const {
+	Vec2 origin(0, 0);
+	Real size = 1;
+	*_pdf = 1;
+	unsigned node = 0;
+	for (;;) {
+		Real s[4];
+		for (unsigned i = 0; i < 4; ++i) s[i] = nodes[node].sum[i].load(std::memory_order_relaxed);
+		const Real total = s[0] + s[1] + s[2] + s[3];
+		if (total <= 0) break;	//Nothing learned below here, sample the cell uniformly
+		const unsigned x = PickHalf(s[0] + s[2], s[1] + s[3], &_u.x);
+		const unsigned y = PickHalf(s[x], s[x + 2], &_u.y);
+		const unsigned q = x + 2 * y;
+		*_pdf *= 4 * s[q] / total;
+		size *= (Real).5;
+		origin = Vec2(origin.x + x * size, origin.y + y * size);
+		if (!nodes[node].children[q]) break;
+		node = nodes[node].children[q];
+	}
+	return Vec2(origin.x + _u.x * size, origin.y + _u.y * size);
+}
+
+Real GuidingField::DirectionalTree::Pdf(Vec2 _p) const {
+	Real pdf = 1;
+	unsigned node = 0;
+	for (;;) {
+		Real s[4];
+		for (unsigned i = 0; i < 4; ++i) s[i] = nodes[node].sum[i].load(std::memory_order_relaxed);
+		const Real total = s[0] + s[1] + s[2] + s[3];
+		if (total <= 0) return pdf;
+		const unsigned x = _p.x >= (Real).5, y = _p.y >= (Real).5;
+		const unsigned q = x + 2 * y;
+		pdf *= 4 * s[q] / total;
+		if (pdf == 0 || !nodes[node].children[q]) return pdf;
+		_p = Vec2(_p.x * 2 - x, _p.y * 2 - y);
+		node = nodes[node].children[q];
+	}
+}
+
+void GuidingField::DirectionalTree::Refine(const int _node, const Real _energy, const unsigned _depth, const Real _total, const Real _threshold, DirectionalTree *_out, const unsigned _outNode) const {
+	for (unsigned q = 0; q < 4; ++q) {
+		const Real energy = _node >= 0 ? nodes[_node].sum[q].load(std::memory_order_relaxed) : _energy * (Real).25;
+		if (_depth >= maxDepth || energy <= _total * _threshold) continue;
+		const int child = _node >= 0 && nodes[_node].children[q] ? (int)nodes[_node].children[q] : -1;
+		const unsigned outChild = _out->nodes.size();
+		_out->nodes.emplace_back();
+		_out->nodes[_outNode].children[q] = outChild;
+		Refine(child, energy, _depth + 1, _total, _threshold, _out, outChild);
+	}
+}
+
+GuidingField::DirectionalTree GuidingField::DirectionalTree::Refined(const Real _threshold) const {
+	DirectionalTree tree;
+	const Real total = Energy();
+	if (total > 0) Refine(0, total, 1, total, _threshold, &tree, 0);
+	return tree;
+}
+
+
+
+GuidingField::Leaf::Leaf() {
+	numSamples.store(0, std::memory_order_relaxed);
+}
+
+GuidingField::Leaf::Leaf(const Leaf &_leaf) : sampling(_leaf.sampling), training(_leaf.training) {
+	numSamples.store(_leaf.numSamples.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+GuidingField::GuidingField() : iteration(0), pass(0), nextRefinement(1) {}
+
+void GuidingField::Reset(const Bounds &_bounds) {
+	const Vec3 pad = (_bounds.max - _bounds.min) * (Real).001 + Vec3((Real)1e-4, (Real)1e-4, (Real)1e-4);	//Keeps flat scenes from having an empty axis
+	bounds = Bounds(_bounds.min - pad, _bounds.max + pad);
+	nodes.assign(1, SpatialNode{ { 0, 0 }, 0, 0, 0 });
+	leaves.clear();
+	leaves.emplace_back();
+	iteration = 0;
+	pass = 0;
+	nextRefinement = 1;
+}
+
+unsigned GuidingField::FindLeaf(Vec3 _p) const {
+	Vec3 lo = bounds.min, hi = bounds.max;
+	unsigned node = 0;
+	while (nodes[node].children[0]) {
+		const unsigned a = nodes[node].axis;
+		const Real mid = (lo[a] + hi[a]) * (Real).5;
+		if (_p[a] < mid) {
+			hi[a] = mid;
+			node = nodes[node].children[0];
+		}
+		else {
+			lo[a] = mid;
+			node = nodes[node].children[1];
+		}
+	}
+	return nodes[node].leaf;
+}
+
+GuidingField::Leaf *GuidingField::Lookup(const Vec3 &_p) {
+	return nodes.empty() ? nullptr : &leaves[FindLeaf(_p)];
+}
+
+const GuidingField::Leaf *GuidingField::Lookup(const Vec3 &_p) const {
+	return nodes.empty() ? nullptr : &leaves[FindLeaf(_p)];
+}
+
+void GuidingField::Split(const unsigned _node, const Real _threshold) {
+	const unsigned leaf = nodes[_node].leaf;
+	const unsigned samples = leaves[leaf].numSamples.load(std::memory_order_relaxed);
+	if (samples <= _threshold || nodes[_node].depth >= maxSpatialDepth) return;
+	const uint8_t axis = (nodes[_node].axis + 1) % 3, depth = nodes[_node].depth + 1;
+	const unsigned left = nodes.size();
+	nodes.push_back(SpatialNode{ { 0, 0 }, leaf, axis, depth });
+	nodes.push_back(SpatialNode{ { 0, 0 }, (uint32_t)leaves.size(), axis, depth });
+	nodes[_node].children[0] = left;
+	nodes[_node].children[1] = left + 1;
+	leaves.push_back(leaves[leaf]);
+	leaves[leaf].numSamples.store(samples / 2, std::memory_order_relaxed);
+	leaves.back().numSamples.store(samples / 2, std::memory_order_relaxed);
+	Split(left, _threshold);
+	Split(left + 1, _threshold);
+}
+
+void GuidingField::Refine() {
+	const Real threshold = spatialThreshold * std::sqrt(std::pow((Real)2, (Real)iteration));
+	const unsigned numNodes = nodes.size();
+	for (unsigned i = 0; i < numNodes; ++i) {
+		if (!nodes[i].children[0]) Split(i, threshold);
+	}
+	for (Leaf &l : leaves) {
+		l.sampling = l.training;
+		l.training = l.training.Refined(directionalThreshold);
+		l.numSamples.store(0, std::memory_order_relaxed);
+	}
+	++iteration;
+}
+
+void GuidingField::EndPass() {
+	if (nodes.empty() || !Training()) return;
+	if (++pass < nextRefinement) return;
+	Refine();
+	nextRefinement = pass + (1u << std::min(iteration, 30u));
+}
+
+Vec3 GuidingField::Sample(const Leaf &_leaf, const Vec2 &_u, Real *_pdf) {
+	const Vec3 w = SquareToDirection(_leaf.sampling.Sample(_u, _pdf));
+	*_pdf *= INV_PI4;
+	return w;
+}
+
+Real GuidingField::Pdf(const Leaf &_leaf, const Vec3 &_w) {
+	return _leaf.sampling.Pdf(DirectionToSquare(_w)) * INV_PI4;
+}
+
+void GuidingField::Add(const Vec3 &_p, const Vec3 &_w, const Real _L) {
+	if (Leaf *l = Lookup(_p)) {
+		l->training.Add(DirectionToSquare(_w), _L);
+		l->numSamples.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+Vec2 GuidingField::DirectionToSquare(const Vec3 &_w) {
+	const Real cosTheta = std::min(std::max(_w.y, (Real)-1), (Real)1);
+	return Vec2(std::min((cosTheta + 1) * (Real).5, oneMinusEpsilon), std::min(maths::SphericalPhi(_w) * INV_PI2, oneMinusEpsilon));
+}
+
+Vec3 GuidingField::SquareToDirection(const Vec2 &_p) {
+	const Real cosTheta = 2 * _p.x - 1;
+	const Real sinTheta = std::sqrt(std::max((Real)0, 1 - cosTheta * cosTheta));
+	return maths::SphericalDirection(sinTheta, cosTheta, _p.y * PI2);
+}
+
+
+
+GuidingPath::GuidingPath(GuidingField *_field) : field(_field) {}
+
+void GuidingPath::AddVertex(const Vec3 &_p, const Vec3 &_w, const Spectrum &_beta) {
+	if (numVertices < maxVertices) vertices[numVertices++] = { _p, _w, _beta, Spectrum(0) };
+}
+
+void GuidingPath::AddRadiance(const Spectrum &_L) {
+	for (unsigned i = 0; i < numVertices; ++i) vertices[i].radiance += _L;
+}
+
+void GuidingPath::Commit() {
+	if (!field || !field->Training()) return;
+	for (unsigned i = 0; i < numVertices; ++i) {
+		const Vertex &v = vertices[i];
+		Spectrum Li(0);	//Radiance arriving along the vertex's direction, the throughput up to it divided out
+		for (unsigned c = 0; c < Spectrum::nSamples; ++c) {
+			if (v.beta[c] > 0) Li[c] = v.radiance[c] / v.beta[c];
+		}
+		field->Add(v.point, v.direction, std::max(Li.y(), (Real)0));
+	}
+}
+
+LAMBDA_END
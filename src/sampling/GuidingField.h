@@ -0,0 +1,214 @@
+#pragma once
+#include <atomic>
+#include <vector>
+/*
+	Online learned incident radiance for guiding path directions, after:
+		Practical Path Guiding for Efficient Light-Transport Simulation - Müller et al.
+	- A binary spatial tree over the scene bounds whose leaves each hold a directional quadtree
+	over the sphere (cylindrical mapping, so area in the square is proportional to solid angle).
+	- Every leaf keeps two quadtrees: a sampling tree that is read only while tiles render, and a
+	training tree that paths splat their radiance estimates into with atomic adds. Neither takes
+	a lock on the render threads.
+	- EndPass() must be called while no tiles are rendering. Iteration k trains for 2^k passes
+	before the trees are refined, so each iteration has twice the samples of the one before.
+*/
+
+#include <Lambda.h>
+#include <maths/maths.h>
+#include <core/Spectrum.h>
+
+LAMBDA_BEGIN
+
+class GuidingField {
+	public:
+		Real guideProbability = (Real).5;	//Chance a guided vertex samples the field instead of its BSDF/phase function
+		unsigned spatialThreshold = 12000;	//Training samples before a spatial leaf splits, scaled by sqrt(2^iteration)
+		Real directionalThreshold = (Real).01;	//Fraction of a quadtree's energy before one of its cells splits
+		unsigned maxIterations = 12;	//Refinements after which training stops
+
+		class DirectionalTree {
+			public:
+				DirectionalTree();
+
+				/*
+					Splats _radiance at square position _p. Safe to call from several threads.
+				*/
+				void Add(Vec2 _p, const Real _radiance);
+
+				/*
+					Samples a square position proportionally to energy, pdf is per unit square area.
+				*/
+				Vec2 Sample(Vec2 _u, Real *_pdf) const;
+
+				/*
+					Pdf per unit square area of sampling _p.
+				*/
+				Real Pdf(Vec2 _p) const;
+
+				/*
+					Total energy splatted into the tree.
+				*/
+				inline Real Energy() const {
+					const Node &root = nodes[0];
+					return root.sum[0].load(std::memory_order_relaxed) + root.sum[1].load(std::memory_order_relaxed) +
+						root.sum[2].load(std::memory_order_relaxed) + root.sum[3].load(std::memory_order_relaxed);
+				}
+
+				/*
+					Structure of this tree with cells holding more than _threshold of its energy split and
+					cells holding less merged, with all energies zeroed.
+				*/
+				DirectionalTree Refined(const Real _threshold) const;
+
+			private:
+				struct Node {
+					std::atomic<float> sum[4];
+					uint32_t children[4];	//0 = leaf quadrant, the root is never a child
+
+					Node();
+
+					Node(const Node &_node);
+
+					Node &operator=(const Node &_node);
+				};
+
+				std::vector<Node> nodes;
+
+				static constexpr unsigned maxDepth = 20;
+
+				/*
+					Fills _out's node _outNode, covering a cell of energy _energy. _node is the matching
+					node of this tree, or -1 if this tree stops above it and the energy is spread evenly.
+				*/
+				void Refine(const int _node, const Real _energy, const unsigned _depth, const Real _total, const Real _threshold, DirectionalTree *_out, const unsigned _outNode) const;
+		};
+
+		struct Leaf {
+			DirectionalTree sampling, training;
+			std::atomic<unsigned> numSamples;
+
+			Leaf();
+
+			Leaf(const Leaf &_leaf);
+		};
+
+		GuidingField();
+
+		/*
+			Drops everything learned and starts over over _bounds.
+		*/
+		void Reset(const Bounds &_bounds);
+
+		/*
+			Leaf whose region holds _p. Never null once Reset() has been called.
+		*/
+		Leaf *Lookup(const Vec3 &_p);
+
+		const Leaf *Lookup(const Vec3 &_p) const;
+
+		/*
+			True once a refinement has given the sampling trees something to sample.
+		*/
+		inline bool Trained() const {
+			return iteration > 0;
+		}
+
+		/*
+			True while paths should splat radiance into the training trees.
+		*/
+		inline bool Training() const {
+			return iteration < maxIterations;
+		}
+
+		/*
+			Marks the end of a progressive pass, refining the field when the iteration's budget is met.
+			Must not overlap with rendering.
+		*/
+		void EndPass();
+
+		/*
+			Samples a world direction from _leaf's sampling tree, pdf per unit solid angle.
+		*/
+		static Vec3 Sample(const Leaf &_leaf, const Vec2 &_u, Real *_pdf);
+
+		/*
+			Pdf per unit solid angle of _leaf's sampling tree producing _w.
+		*/
+		static Real Pdf(const Leaf &_leaf, const Vec3 &_w);
+
+		/*
+			Splats radiance _L arriving at _p from _w into the training trees.
+		*/
+		void Add(const Vec3 &_p, const Vec3 &_w, const Real _L);
+
+		/*
+			Square position of world direction _w and back.
+		*/
+		static Vec2 DirectionToSquare(const Vec3 &_w);
+
+		static Vec3 SquareToDirection(const Vec2 &_p);
+
+	private:
+		struct SpatialNode {
+			uint32_t children[2];	//0 = leaf, the root is never a child
+			uint32_t leaf;	//Index into leaves if a leaf
+			uint8_t axis, depth;	//Axis the node splits along
+		};
+
+		Bounds bounds;
+		std::vector<SpatialNode> nodes;
+		std::vector<Leaf> leaves;
+		unsigned iteration, pass, nextRefinement;
+
+		static constexpr unsigned maxSpatialDepth = 48;
+
+		unsigned FindLeaf(Vec3 _p) const;
+
+		/*
+			Splits _node while its leaf has more than _threshold samples, assuming they halve each time.
+		*/
+		void Split(const unsigned _node, const Real _threshold);
+
+		void Refine();
+};
+
+/*
+	Vertices of one path for splatting into a GuidingField. Lives on the stack of an integrator's
+	Li(), contributions are credited to the vertices whose sampled directions they arrived along.
+*/
+class GuidingPath {
+	public:
+		GuidingPath(GuidingField *_field);
+
+		/*
+			Adds a vertex at _p that continued along _w with throughput _beta from the camera,
+			including this vertex's scattering weight.
+		*/
+		void AddVertex(const Vec3 &_p, const Vec3 &_w, const Spectrum &_beta);
+
+		/*
+			Credits contribution _L, already multiplied by the path throughput, to every vertex so
+			far. Light sampled at a vertex must be added before that vertex, since it didn't arrive
+			along the vertex's sampled direction.
+		*/
+		void AddRadiance(const Spectrum &_L);
+
+		/*
+			Splats the path into the field's training trees.
+		*/
+		void Commit();
+
+	private:
+		struct Vertex {
+			Vec3 point, direction;
+			Spectrum beta, radiance;
+		};
+
+		static constexpr unsigned maxVertices = 16;
+
+		GuidingField *field;
+		Vertex vertices[maxVertices];
+		unsigned numVertices = 0;
+};
+
+LAMBDA_END
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include "RandomSampler.h"
+
+LAMBDA_BEGIN
+
+namespace {
+
+	constexpr Real oneMinusEpsilon = (Real)0x1.fffffep-1;
+
+	/*
+		SplitMix64 finaliser, spreads nearby seeds over the whole state space.
+	*/
+	inline uint64_t MixBits(uint64_t _v) {
+		_v = (_v ^ (_v >> 30)) * 0xbf58476d1ce4e5b9ull;
+		_v = (_v ^ (_v >> 27)) * 0x94d049bb133111ebull;
+		return _v ^ (_v >> 31);
+	}
+}
+
+RandomSampler::RandomSampler(const uint64_t _seed, const unsigned _sampleIndex) : seed(_seed) {
+	SetSample(_sampleIndex);
+}
+
+Sampler *RandomSampler::clone() const {
+	return new RandomSampler(*this);
+}
+
+void RandomSampler::NextSample() {
+	SetSample(sampleIndex + 1);
+}
+
+void RandomSampler::SetSample(const unsigned _sampleIndex) {
+	sampleIndex = _sampleIndex;
+	dimensionIndex = 0;
+	state = 0;
+	inc = (MixBits(seed) << 1) | 1;	//Streams differ per seed, states per sample index
+	NextUInt();
+	state += MixBits(((uint64_t)_sampleIndex << 32) ^ seed);
+	NextUInt();
+}
+
+void RandomSampler::SetSeed(const uint64_t _seed) {
+	seed = _seed;
+	SetSample(sampleIndex);
+}
+
+Real RandomSampler::Get1D() {
+	++dimensionIndex;
+	return std::min((Real)(NextUInt() * 0x1p-32), oneMinusEpsilon);
+}
+
+Vec2 RandomSampler::Get2D() {
+	const Real x = Get1D();
+	return Vec2(x, Get1D());
+}
+
+uint32_t RandomSampler::NextUInt() {
+	const uint64_t old = state;
+	state = old * 0x5851f42d4c957f2dull + inc;
+	const uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	const uint32_t rot = (uint32_t)(old >> 59);
+	return (xorShifted >> rot) | (xorShifted << ((~rot + 1) & 31));
+}
+
+LAMBDA_END
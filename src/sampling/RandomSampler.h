@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include "Sampler.h"
+
+LAMBDA_BEGIN
+
+/*
+	Independent uniform samples from a PCG32 generator. Every sample index seeds its own stream,
+	so paths with any number of dimensions stay uncorrelated, unlike the Halton sampler's which
+	wrap after a few dimensions.
+*/
+class RandomSampler : public Sampler {
+	public:
+		RandomSampler(const uint64_t _seed = 0, const unsigned _sampleIndex = 0);
+
+		Sampler *clone() const override;
+
+		/*
+			Moves on to the stream of the next sample index.
+		*/
+		void NextSample() override;
+
+		/*
+			Restarts the stream of sample _sampleIndex under the current seed.
+		*/
+		void SetSample(const unsigned _sampleIndex) override;
+
+		/*
+			Changes the seed, keeping the sample index.
+		*/
+		void SetSeed(const uint64_t _seed);
+
+		Real Get1D() override;
+
+		Vec2 Get2D() override;
+
+	private:
+		uint64_t seed, state, inc;
+
+		uint32_t NextUInt();
+};
+
+LAMBDA_END
@@ -18,6 +18,24 @@ namespace Sampling {
 		return Vec3(d.x, up, d.y);
 	}
 
+	/*
+		Uniform direction on the unit sphere, pdf INV_PI4.
+	*/
+	inline Vec3 SampleUniformSphere(const Vec2 &_u) {
+		const Real cosTheta = 1 - 2 * _u.x;
+		const Real sinTheta = std::sqrt(std::max((Real)0, 1 - cosTheta * cosTheta));
+		return maths::SphericalDirection(sinTheta, cosTheta, _u.y * PI2);
+	}
+
+	/*
+		Uniform direction in the cone of half angle acos(_cosMax) around +y, pdf 1 / (2pi * (1 - _cosMax)).
+	*/
+	inline Vec3 SampleUniformCone(const Vec2 &_u, const Real _cosMax) {
+		const Real cosTheta = 1 - _u.x * (1 - _cosMax);
+		const Real sinTheta = std::sqrt(std::max((Real)0, 1 - cosTheta * cosTheta));
+		return maths::SphericalDirection(sinTheta, cosTheta, _u.y * PI2);
+	}
+
 }
 
 LAMBDA_END
\ No newline at end of file
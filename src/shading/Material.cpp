@@ -1,8 +1,11 @@
 #pragma once
 #include <iostream>
+#include <vector>
+#include <unordered_set>
 #include "Material.h"
 #include "surface/BxDF.h"
 #include "graph/ShaderGraph.h"
+#include "graph/GraphCompiler.h"
 
 LAMBDA_BEGIN
 
@@ -26,7 +29,38 @@ LAMBDA_BEGIN
 Material::Material() {
 	bxdf = nullptr;
 	light = nullptr;
+	compiledRevision = ShaderGraph::graphRevision.load() - 1;
 	//aovMap.reserve(4);
 }
 
+void Material::Compile() {
+	compiledRevision = ShaderGraph::graphRevision.load();
+	if (!bxdf) return;
+	ShaderGraph::Node *root = dynamic_cast<ShaderGraph::Node *>(bxdf);
+	if (!root) {
+		std::cout << std::endl << "Could not compile material as BxDF is not a Node.";
+		return;
+	}
+	std::vector<ShaderGraph::Node *> stack(1, root);
+	std::unordered_set<ShaderGraph::Node *> visited;
+	ShaderGraph::Compiler compiler;
+	while (!stack.empty()) {
+		ShaderGraph::Node *node = stack.back();
+		stack.pop_back();
+		if (!visited.insert(node).second) continue;
+		const std::shared_ptr<const ShaderGraph::ShaderProgram> program(compiler.Compile(*node));
+		for (unsigned i = 0; i < node->numIn; ++i) {
+			ShaderGraph::SocketRef &input = node->inputSockets[i];
+			input.program.reset();
+			input.output = i;
+			if (!input.socket) continue;
+			if (input.socket->socketType == ShaderGraph::SocketType::TYPE_BXDF) {	//Mixed BxDFs have programs of their own
+				stack.push_back(input.socket->node);
+				continue;
+			}
+			input.program = program;
+		}
+	}
+}
+
 LAMBDA_END
\ No newline at end of file
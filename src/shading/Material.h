@@ -26,9 +26,25 @@ class Material {
 
 		Material();
 
+		/*
+			Compiles every BxDF node in the bxdf graph into a bytecode program shared by its inputs.
+			Must not be called while the material is being rendered.
+		*/
+		void Compile();
+
+		/*
+			False when a shader graph link has changed since Compile().
+		*/
+		inline bool IsCompiled() const {
+			return compiledRevision == ShaderGraph::graphRevision.load(std::memory_order_relaxed);
+		}
+
 		//void BuildAOVMap();
 
 		//ShaderGraph::AOVOutput *GetAOV(const std::string &_key) const;
+
+	private:
+		unsigned compiledRevision;
  };
 
 LAMBDA_END
\ No newline at end of file
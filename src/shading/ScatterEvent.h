@@ -14,6 +14,7 @@ constexpr Real SURFACE_EPSILON = 1e-5;
 class BxDF;
 class Scene;
 class Medium;
+struct SampledWavelength;
 
 struct ScatterEvent {
 	Vec3 wo, wi, woL, wiL;
@@ -23,6 +24,7 @@ struct ScatterEvent {
 	const Scene *scene;
 	Real eta = 1.001;
 	bool mediumInteraction = false;
+	SampledWavelength *wavelength = nullptr;	//Wavelength of the path for dispersion, nullptr unless spectralDispersion is set
 
 	inline Vec3 ToLocal(const Vec3 &_v) const {
 		return maths::WorldToLocal(_v, hit->tangent, hit->normalS, hit->bitangent);
@@ -0,0 +1,235 @@
+#include <iostream>
+#include "GraphCompiler.h"
+#include "GraphInputs.h"
+#include "GraphMaths.h"
+#include "GraphConverters.h"
+#include "GraphTexture.h"
+
+LAMBDA_BEGIN
+
+SG_BEGIN
+
+/*
+	Values Socket::GetAs() falls back to for conversions it doesn't support.
+*/
+static const Real zeroScalar = 0;
+static const Vec2 zeroVec2(0, 0);
+static const Vec3 zeroVec3(0, 0, 0);
+static const Colour missingColour(1, 0, 1);
+
+ShaderProgram *Compiler::Compile(const Node &_node) {
+	std::unique_ptr<ShaderProgram> p(new ShaderProgram());
+	p->revision = graphRevision.load();
+	p->outputs.resize(_node.numIn);
+	program = p.get();
+	values.clear();
+	instructions.clear();
+	visiting.clear();
+	failed = false;
+	bool linked = false;
+	for (unsigned i = 0; i < _node.numIn; ++i) {
+		const Socket *socket = _node.inputSockets[i].socket;
+		if (!socket || socket->socketType == SocketType::TYPE_BXDF) continue;	//Defaults and mixed BxDFs are read directly
+		program->outputs[i].reg = Native(socket);
+		program->outputs[i].type = socket->socketType;
+		linked = true;
+	}
+	if (failed || !linked) return nullptr;
+	return p.release();
+}
+
+uint16_t Compiler::Allocate(const SocketType _type) {
+	unsigned size;
+	switch (_type) {
+	case SocketType::TYPE_SCALAR: size = 1; break;
+	case SocketType::TYPE_VEC2: size = 2; break;
+	case SocketType::TYPE_VEC3: size = sizeof(Vec3) / sizeof(Real); break;
+	case SocketType::TYPE_COLOUR: size = sizeof(Colour) / sizeof(Real); break;
+	case SocketType::TYPE_SPECTRUM: size = sizeof(Spectrum) / sizeof(Real); break;
+	default: size = 4; break;
+	}
+	unsigned offset = program->registerSize;
+	if (size > 1) offset = (offset + 3) & ~3u;	//Keep vector types 16 byte aligned
+	if (offset + size > SHADER_MAX_REGISTERS) {
+		if (!failed) std::cout << std::endl << "Shader graph needs more than " << SHADER_MAX_REGISTERS << " registers, using node delegates instead.";
+		failed = true;
+		return 0;
+	}
+	program->registerSize = offset + size;
+	return offset;
+}
+
+uint16_t Compiler::Emit(const OpCode _op, const SocketType _type, const uint16_t _a, const uint16_t _b, const uint16_t _c, const uint16_t _d, const void *_data) {
+	const InstructionKey key(_op, _a, _b, _c, _d, _data);
+	if (_op != OpCode::CALL) {
+		const auto it = instructions.find(key);
+		if (it != instructions.end()) return it->second;
+	}
+	Instruction i;
+	i.op = _op;
+	i.out = Allocate(_type);
+	i.in[0] = _a;
+	i.in[1] = _b;
+	i.in[2] = _c;
+	i.in[3] = _d;
+	i.data = _data;
+	program->code.push_back(i);
+	if (_op != OpCode::CALL) instructions[key] = i.out;
+	return i.out;
+}
+
+uint16_t Compiler::Load(const SocketType _type, const void *_data) {
+	switch (_type) {
+	case SocketType::TYPE_SCALAR: return Emit(OpCode::LOAD_SCALAR, _type, 0, 0, 0, 0, _data);
+	case SocketType::TYPE_VEC2: return Emit(OpCode::LOAD_VEC2, _type, 0, 0, 0, 0, _data);
+	case SocketType::TYPE_VEC3: return Emit(OpCode::LOAD_VEC3, _type, 0, 0, 0, 0, _data);
+	case SocketType::TYPE_COLOUR: return Emit(OpCode::LOAD_COLOUR, _type, 0, 0, 0, 0, _data);
+	case SocketType::TYPE_SPECTRUM: return Emit(OpCode::LOAD_SPECTRUM, _type, 0, 0, 0, 0, _data);
+	default:
+		failed = true;
+		return 0;
+	}
+}
+
+uint16_t Compiler::Value(const SocketRef &_input, const SocketType _type) {
+	if (!_input.socket) return Load(_type, _input.data);	//Unlinked inputs read their default value
+	const auto key = std::make_pair((const Socket *)_input.socket, _type);
+	const auto it = values.find(key);
+	if (it != values.end()) return it->second;
+	const uint16_t reg = Convert(Native(_input.socket), _input.socket->socketType, _type);
+	values[key] = reg;
+	return reg;
+}
+
+uint16_t Compiler::Native(const Socket *_socket) {
+	const auto key = std::make_pair(_socket, _socket->socketType);
+	const auto it = values.find(key);
+	if (it != values.end()) return it->second;
+	if (!visiting.insert(_socket->node).second) {
+		std::cout << std::endl << "Shader graph has a cycle at node \"" << _socket->node->nodeTag << "\", using node delegates instead.";
+		failed = true;
+		return 0;
+	}
+	const uint16_t reg = Lower(_socket);
+	visiting.erase(_socket->node);
+	values[key] = reg;
+	return reg;
+}
+
+uint16_t Compiler::Lower(const Socket *_socket) {
+	const Node *node = _socket->node;
+	const unsigned output = _socket - node->outputSockets.get();
+	const SocketRef *in = node->inputSockets.get();
+
+	if (const ScalarInput *n = dynamic_cast<const ScalarInput *>(node)) return Load(SocketType::TYPE_SCALAR, &n->value);
+	if (const Vec2Input *n = dynamic_cast<const Vec2Input *>(node)) return Load(SocketType::TYPE_VEC2, &n->vec2);
+	if (const RGBInput *n = dynamic_cast<const RGBInput *>(node)) return Load(SocketType::TYPE_COLOUR, &n->rgb);
+	if (const SpectralInput *n = dynamic_cast<const SpectralInput *>(node)) return Load(SocketType::TYPE_SPECTRUM, &n->spec);
+	if (const BlackbodyInput *n = dynamic_cast<const BlackbodyInput *>(node))
+		return Emit(OpCode::BLACKBODY, SocketType::TYPE_SPECTRUM, Value(in[0], SocketType::TYPE_SCALAR), 0, 0, 0, n);
+	if (const ImageTextureInput *n = dynamic_cast<const ImageTextureInput *>(node)) {	//Both outputs share one lookup
+		const uint16_t rgba = Emit(OpCode::TEXTURE, SocketType::TYPE_COLOUR, 0, 0, 0, 0, &n->tex);
+		return output == 0 ? rgba : Emit(OpCode::EXTRACT, SocketType::TYPE_SCALAR, rgba, 0);
+	}
+	if (const ImageTextureChannelInput *n = dynamic_cast<const ImageTextureChannelInput *>(node))
+		return Emit(OpCode::EXTRACT, SocketType::TYPE_SCALAR, Emit(OpCode::TEXTURE, SocketType::TYPE_COLOUR, 0, 0, 0, 0, &n->tex), n->channel);
+	if (const SpectralTextureInput *n = dynamic_cast<const SpectralTextureInput *>(node))
+		return Emit(OpCode::SPECTRAL_TEXTURE, SocketType::TYPE_SPECTRUM, 0, 0, 0, 0, &n->tex);
+	if (dynamic_cast<const SurfaceInfoInput *>(node)) return Emit(OpCode::SURFACE_NORMAL, SocketType::TYPE_VEC3);
+	if (dynamic_cast<const FresnelInput *>(node)) return Emit(OpCode::FRESNEL, SocketType::TYPE_SCALAR, Value(in[0], SocketType::TYPE_SCALAR));
+	if (const Textures::Noise *n = dynamic_cast<const Textures::Noise *>(node)) return Emit(OpCode::NOISE, SocketType::TYPE_SCALAR, 0, 0, 0, 0, n);
+
+	if (const Maths::ScalarMathsNode *n = dynamic_cast<const Maths::ScalarMathsNode *>(node)) {
+		const uint16_t a = Value(in[0], SocketType::TYPE_SCALAR);
+		if (n->operatorType == Maths::ScalarOperatorType::SQRT) return Emit(OpCode::SCALAR_SQRT, SocketType::TYPE_SCALAR, a);
+		const uint16_t b = Value(in[1], SocketType::TYPE_SCALAR);
+		switch (n->operatorType) {
+		case Maths::ScalarOperatorType::ADD: return Emit(OpCode::SCALAR_ADD, SocketType::TYPE_SCALAR, a, b);
+		case Maths::ScalarOperatorType::SUBTRACT: return Emit(OpCode::SCALAR_SUBTRACT, SocketType::TYPE_SCALAR, a, b);
+		case Maths::ScalarOperatorType::MULTIPLY: return Emit(OpCode::SCALAR_MULTIPLY, SocketType::TYPE_SCALAR, a, b);
+		case Maths::ScalarOperatorType::DIVIDE: return Emit(OpCode::SCALAR_DIVIDE, SocketType::TYPE_SCALAR, a, b);
+		default: return Emit(OpCode::SCALAR_POWER, SocketType::TYPE_SCALAR, a, b);
+		}
+	}
+	if (const Maths::VectorMathsNode *n = dynamic_cast<const Maths::VectorMathsNode *>(node)) {
+		const uint16_t a = Value(in[0], SocketType::TYPE_VEC3);
+		const uint16_t b = Value(in[1], SocketType::TYPE_VEC3);
+		switch (n->operatorType) {
+		case Maths::VectorOperatorType::ADD: return Emit(OpCode::VEC3_ADD, SocketType::TYPE_VEC3, a, b);
+		case Maths::VectorOperatorType::SUBTRACT: return Emit(OpCode::VEC3_SUBTRACT, SocketType::TYPE_VEC3, a, b);
+		case Maths::VectorOperatorType::MULTIPLY: return Emit(OpCode::VEC3_MULTIPLY, SocketType::TYPE_VEC3, a, b);
+		default: return Emit(OpCode::VEC3_DIVIDE, SocketType::TYPE_VEC3, a, b);
+		}
+	}
+	if (dynamic_cast<const Maths::DotProductNode *>(node))
+		return Emit(OpCode::DOT, SocketType::TYPE_SCALAR, Value(in[0], SocketType::TYPE_VEC3), Value(in[1], SocketType::TYPE_VEC3));
+	if (dynamic_cast<const Maths::CrossProductNode *>(node))
+		return Emit(OpCode::CROSS, SocketType::TYPE_VEC3, Value(in[0], SocketType::TYPE_VEC3), Value(in[1], SocketType::TYPE_VEC3));
+	if (dynamic_cast<const Maths::VectorLength *>(node))
+		return Emit(OpCode::LENGTH, SocketType::TYPE_SCALAR, Value(in[0], SocketType::TYPE_VEC3));
+
+	if (dynamic_cast<const Converter::SeparateXYZ *>(node))
+		return Emit(OpCode::EXTRACT, SocketType::TYPE_SCALAR, Value(in[0], SocketType::TYPE_VEC3), output);
+	if (dynamic_cast<const Converter::SeparateRGBA *>(node))
+		return Emit(OpCode::EXTRACT, SocketType::TYPE_SCALAR, Value(in[0], SocketType::TYPE_COLOUR), output);
+	if (dynamic_cast<const Converter::MergeXYZ *>(node)) {
+		const uint16_t x = Value(in[0], SocketType::TYPE_SCALAR);
+		const uint16_t y = Value(in[1], SocketType::TYPE_SCALAR);
+		const uint16_t z = Value(in[2], SocketType::TYPE_SCALAR);
+		return Emit(OpCode::MERGE_VEC3, SocketType::TYPE_VEC3, x, y, z);
+	}
+	if (dynamic_cast<const Converter::MergeRGBA *>(node)) {
+		const uint16_t r = Value(in[0], SocketType::TYPE_SCALAR);
+		const uint16_t g = Value(in[1], SocketType::TYPE_SCALAR);
+		const uint16_t b = Value(in[2], SocketType::TYPE_SCALAR);
+		const uint16_t a = Value(in[3], SocketType::TYPE_SCALAR);
+		return Emit(OpCode::MERGE_COLOUR, SocketType::TYPE_COLOUR, r, g, b, a);
+	}
+	if (dynamic_cast<const Converter::ScalarToColour *>(node))
+		return Emit(OpCode::SCALAR_TO_COLOUR, SocketType::TYPE_COLOUR, Value(in[0], SocketType::TYPE_SCALAR));
+
+	//Backgrounds re-read their inputs at other coordinates and custom nodes are opaque, they still evaluate their own inputs
+	program->calls.push_back(_socket);
+	return Emit(OpCode::CALL, _socket->socketType, program->calls.size() - 1);
+}
+
+uint16_t Compiler::Convert(const uint16_t _reg, const SocketType _from, const SocketType _to) {
+	if (_from == _to) return _reg;
+	switch (_to) {
+	case SocketType::TYPE_SCALAR:
+		switch (_from) {
+		case SocketType::TYPE_COLOUR: return Emit(OpCode::COLOUR_TO_SCALAR, _to, _reg);
+		case SocketType::TYPE_VEC2: return Emit(OpCode::VEC2_TO_SCALAR, _to, _reg);
+		case SocketType::TYPE_VEC3: return Emit(OpCode::VEC3_TO_SCALAR, _to, _reg);
+		case SocketType::TYPE_SPECTRUM: return Emit(OpCode::SPECTRUM_TO_SCALAR, _to, _reg);
+		default: return Load(_to, &zeroScalar);
+		}
+	case SocketType::TYPE_COLOUR:
+		switch (_from) {
+		case SocketType::TYPE_SCALAR: return Emit(OpCode::SCALAR_TO_COLOUR, _to, _reg);
+		case SocketType::TYPE_SPECTRUM: return Emit(OpCode::SPECTRUM_TO_COLOUR, _to, _reg);
+		case SocketType::TYPE_VEC3: return Emit(OpCode::VEC3_TO_COLOUR, _to, _reg);
+		case SocketType::TYPE_VEC2: return Emit(OpCode::VEC2_TO_COLOUR, _to, _reg);
+		default: return Load(_to, &missingColour);
+		}
+	case SocketType::TYPE_VEC2:
+		switch (_from) {
+		case SocketType::TYPE_VEC3: return Emit(OpCode::VEC3_TO_VEC2, _to, _reg);
+		case SocketType::TYPE_SCALAR: return Emit(OpCode::SCALAR_TO_VEC2, _to, _reg);
+		default: return Load(_to, &zeroVec2);
+		}
+	case SocketType::TYPE_VEC3:
+		switch (_from) {
+		case SocketType::TYPE_VEC2: return Emit(OpCode::VEC2_TO_VEC3, _to, _reg);
+		case SocketType::TYPE_SCALAR: return Emit(OpCode::SCALAR_TO_VEC3, _to, _reg);
+		default: return Load(_to, &zeroVec3);
+		}
+	default:
+		failed = true;	//Nodes never read spectra or bxdfs from other nodes
+		return 0;
+	}
+}
+
+SG_END
+
+LAMBDA_END
@@ -0,0 +1,67 @@
+/*
+	Flattens the subgraphs feeding every input of a BxDF node into one ShaderProgram.
+
+	Nodes are visited depth first from each input, so instructions come out in dependency
+	order. Every value is keyed by the socket it came from and the type it was read as, and
+	every instruction by its opcode and operands, so a node or expression used by several
+	inputs is only emitted once. Conversions between socket types are picked here rather than
+	switched on when the graph runs. The built-in maths, converter, input, texture and noise
+	nodes have their own opcodes; other nodes are called through their socket delegate.
+*/
+
+#pragma once
+#include <map>
+#include <tuple>
+#include <unordered_set>
+#include "ShaderGraph.h"
+
+LAMBDA_BEGIN
+
+SG_BEGIN
+
+class Compiler {
+	public:
+		/*
+			Compiles the linked inputs of _node that aren't BxDFs. Returns nullptr if there are
+			none, the graph has a cycle or it needs more than SHADER_MAX_REGISTERS, in which case
+			the inputs should keep using their delegates.
+		*/
+		ShaderProgram *Compile(const Node &_node);
+
+	private:
+		using InstructionKey = std::tuple<OpCode, uint16_t, uint16_t, uint16_t, uint16_t, const void *>;
+
+		ShaderProgram *program;
+		std::map<std::pair<const Socket *, SocketType>, uint16_t> values;
+		std::map<InstructionKey, uint16_t> instructions;
+		std::unordered_set<const Node *> visiting;
+		bool failed;
+
+		uint16_t Allocate(const SocketType _type);
+
+		/*
+			Register of an identical earlier instruction if there is one, else appends a new one.
+			CALLs are never merged.
+		*/
+		uint16_t Emit(const OpCode _op, const SocketType _type, const uint16_t _a = 0, const uint16_t _b = 0, const uint16_t _c = 0, const uint16_t _d = 0, const void *_data = nullptr);
+
+		uint16_t Load(const SocketType _type, const void *_data);
+
+		/*
+			Register holding _input read as _type.
+		*/
+		uint16_t Value(const SocketRef &_input, const SocketType _type);
+
+		/*
+			Register holding _socket's output in its own type.
+		*/
+		uint16_t Native(const Socket *_socket);
+
+		uint16_t Lower(const Socket *_socket);
+
+		uint16_t Convert(const uint16_t _reg, const SocketType _from, const SocketType _to);
+};
+
+SG_END
+
+LAMBDA_END
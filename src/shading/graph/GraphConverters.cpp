@@ -18,13 +18,13 @@ namespace Converter {
 	}
 
 	void SeparateXYZ::GetY(const ScatterEvent &_event, void *_out) const {
-		ASSERT_INPUTS(inputSockets[1]);
-		*reinterpret_cast<Real *>(_out) = inputSockets[1].socket->GetAs<Vec3>(_event).y;
+		ASSERT_INPUTS(inputSockets[0]);
+		*reinterpret_cast<Real *>(_out) = inputSockets[0].socket->GetAs<Vec3>(_event).y;
 	}
 
 	void SeparateXYZ::GetZ(const ScatterEvent &_event, void *_out) const {
-		ASSERT_INPUTS(inputSockets[2]);
-		*reinterpret_cast<Real *>(_out) = inputSockets[2].socket->GetAs<Vec3>(_event).z;
+		ASSERT_INPUTS(inputSockets[0]);
+		*reinterpret_cast<Real *>(_out) = inputSockets[0].socket->GetAs<Vec3>(_event).z;
 	}
 
 
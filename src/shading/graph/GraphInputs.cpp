@@ -80,8 +80,15 @@ namespace ShaderGraph {
 		outputSockets[0] = MAKE_SOCKET(SocketType::TYPE_SPECTRUM, &BlackbodyInput::GetSpectrum, "Spectrum");
 	}
 
+	static void Blackbody(const Real *_lambda, int _n, Real _T, Real *_Le);
+	static inline void BlackbodyNormalized(const Real *_lambda, int _n, Real _temp, Real *_Le);
+
 	void BlackbodyInput::GetSpectrum(const ScatterEvent &_event, void *_out) const {
-		*reinterpret_cast<Spectrum *>(_out) = MakeBlackbodySpectrum(inputSockets[0].socket->GetAs<Real>(_event), samples);
+		*reinterpret_cast<Spectrum *>(_out) = Evaluate(inputSockets[0].socket->GetAs<Real>(_event));
+	}
+
+	Spectrum BlackbodyInput::Evaluate(const Real _temp) const {
+		return MakeBlackbodySpectrum(_temp, samples);
 	}
 
 	static void Blackbody(const Real *_lambda, int _n, Real _T, Real *_Le) {
@@ -126,13 +133,23 @@ namespace ShaderGraph {
 	}
 
 	void ImageTextureInput::GetColour(const ScatterEvent &_event, void *_out) const {
-		const Vec2 uvs = maths::Fract(_event.hit->uvCoords);
-		*reinterpret_cast<Colour *>(_out) = tex->GetPixelUV(uvs.x, uvs.y);
+		*reinterpret_cast<Colour *>(_out) = SampleTexture(tex, *_event.hit);
 	}
 
 	void ImageTextureInput::GetScalar(const ScatterEvent &_event, void *_out) const {
-		const Vec2 uvs = maths::Fract(_event.hit->uvCoords);
-		*reinterpret_cast<Real *>(_out) = tex->GetPixelUV(uvs.x, uvs.y).r;
+		*reinterpret_cast<Real *>(_out) = SampleTexture(tex, *_event.hit).r;
+	}
+
+	void ImageTextureInput::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		for (unsigned i = 0; i < _n; ++i) {
+			const Colour c = SampleTexture(tex, *_events[i]->hit);
+			_out[i] = c.r;
+			if (_output == 0) {
+				_out[SHADER_BATCH_SIZE + i] = c.g;
+				_out[2 * SHADER_BATCH_SIZE + i] = c.b;
+				_out[3 * SHADER_BATCH_SIZE + i] = c.a;
+			}
+		}
 	}
 
 	/*
@@ -146,8 +163,13 @@ namespace ShaderGraph {
 	}
 
 	void ImageTextureChannelInput::GetScalar(const ScatterEvent &_event, void *_out) const {
-		const Vec2 uvs = maths::Fract(_event.hit->uvCoords);
-		*reinterpret_cast<Real *>(_out) = tex->GetPixelUV(uvs.x, uvs.y)[channel];
+		*reinterpret_cast<Real *>(_out) = SampleTexture(tex, *_event.hit)[channel];
+	}
+
+	void ImageTextureChannelInput::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		for (unsigned i = 0; i < _n; ++i) {
+			_out[i] = SampleTexture(tex, *_events[i]->hit)[channel];
+		}
 	}
 
 	/*
@@ -160,8 +182,7 @@ namespace ShaderGraph {
 	}
 
 	void SpectralTextureInput::GetSpectrum(const ScatterEvent &_event, void *_out) const {
-		const Vec2 uvs = maths::Fract(_event.hit->uvCoords);
-		*reinterpret_cast<Spectrum *>(_out) = tex->GetPixelUV(uvs.x, uvs.y);
+		*reinterpret_cast<Spectrum *>(_out) = SampleTexture(tex, *_event.hit);
 	}
 
 	/*
@@ -186,13 +207,7 @@ namespace ShaderGraph {
 	}
 
 	void FresnelInput::SchlickApprox(const ScatterEvent &_event, void *_out) const {
-		const Real n1 = _event.eta;
-		const Real n2 = inputSockets[0].GetAs<Real>(_event);
-		Real R0 = (n1 - n2) / (n1 + n2);
-		R0 *= R0;
-		const Real c = 1 - _event.woL.y;
-		const Real R = R0 + (1 - R0) * c * c * c * c * c;
-		*reinterpret_cast<Real *>(_out) = R;
+		*reinterpret_cast<Real *>(_out) = Schlick(_event.eta, inputSockets[0].GetAs<Real>(_event), _event.woL.y);
 	}
 }
 
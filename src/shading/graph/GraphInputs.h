@@ -7,6 +7,15 @@ LAMBDA_BEGIN
 
 namespace ShaderGraph {
 
+	/*
+		Lookup filtered over the hit's footprint, which is zero for rays without differentials.
+	*/
+	template<class TextureType>
+	inline auto SampleTexture(const TextureType *_tex, const RayHit &_hit) {
+		const Vec2 uvs = maths::Fract(_hit.uvCoords);
+		return _tex->GetPixelUV(uvs.x, uvs.y, _hit.dudx, _hit.dvdx, _hit.dudy, _hit.dvdy);
+	}
+
 	class ScalarInput : public Node {
 		public:
 			Real value;
@@ -62,6 +71,11 @@ namespace ShaderGraph {
 
 			void GetSpectrum(const ScatterEvent &_event, void *_out) const;
 
+			/*
+				Normalised emission at temperature _temp.
+			*/
+			Spectrum Evaluate(const Real _temp) const;
+
 		private:
 			inline Spectrum MakeBlackbodySpectrum(const Real _temp, const unsigned _samples) const;
 	};
@@ -77,6 +91,8 @@ namespace ShaderGraph {
 			void GetColour(const ScatterEvent &_event, void *_out) const;
 
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
+
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
 	};
 
 
@@ -89,6 +105,8 @@ namespace ShaderGraph {
 			ImageTextureChannelInput(Texture *_tex = nullptr, const uint8_t _channel = 0);
 
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
+
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
 	};
 
 
@@ -118,6 +136,13 @@ namespace ShaderGraph {
 			FresnelInput(Socket *_ior = nullptr);
 
 			void SchlickApprox(const ScatterEvent &_event, void *_out) const;
+
+			static inline Real Schlick(const Real _n1, const Real _n2, const Real _cosTheta) {
+				Real R0 = (_n1 - _n2) / (_n1 + _n2);
+				R0 *= R0;
+				const Real c = 1 - _cosTheta;
+				return R0 + (1 - R0) * c * c * c * c * c;
+			}
 	};
 }
 
@@ -27,6 +27,28 @@ namespace Maths {
 		case ScalarOperatorType::DIVIDE:
 			*reinterpret_cast<Real *>(_out) = inputSockets[0].socket->GetAs<Real>(_event) / inputSockets[1].socket->GetAs<Real>(_event);
 			break;
+		case ScalarOperatorType::SQRT:
+			*reinterpret_cast<Real *>(_out) = std::sqrt(inputSockets[0].socket->GetAs<Real>(_event));
+			break;
+		case ScalarOperatorType::POWER:
+			*reinterpret_cast<Real *>(_out) = std::pow(inputSockets[0].socket->GetAs<Real>(_event), inputSockets[1].socket->GetAs<Real>(_event));
+			break;
+		}
+	}
+
+
+
+	void ScalarMathsNode::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		Real a[SHADER_BATCH_SIZE], b[SHADER_BATCH_SIZE];
+		inputSockets[0].GetBatch(_events, _n, SocketType::TYPE_SCALAR, a);
+		if (operatorType != ScalarOperatorType::SQRT) inputSockets[1].GetBatch(_events, _n, SocketType::TYPE_SCALAR, b);
+		switch (operatorType) {
+		case ScalarOperatorType::ADD: for (unsigned i = 0; i < _n; ++i) _out[i] = a[i] + b[i]; break;
+		case ScalarOperatorType::SUBTRACT: for (unsigned i = 0; i < _n; ++i) _out[i] = a[i] - b[i]; break;
+		case ScalarOperatorType::MULTIPLY: for (unsigned i = 0; i < _n; ++i) _out[i] = a[i] * b[i]; break;
+		case ScalarOperatorType::DIVIDE: for (unsigned i = 0; i < _n; ++i) _out[i] = a[i] / b[i]; break;
+		case ScalarOperatorType::SQRT: for (unsigned i = 0; i < _n; ++i) _out[i] = std::sqrt(a[i]); break;
+		case ScalarOperatorType::POWER: for (unsigned i = 0; i < _n; ++i) _out[i] = std::pow(a[i], b[i]); break;
 		}
 	}
 
@@ -59,6 +81,22 @@ namespace Maths {
 
 
 
+	void VectorMathsNode::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		Real a[3 * SHADER_BATCH_SIZE], b[3 * SHADER_BATCH_SIZE];
+		inputSockets[0].GetBatch(_events, _n, SocketType::TYPE_VEC3, a);
+		inputSockets[1].GetBatch(_events, _n, SocketType::TYPE_VEC3, b);
+		for (unsigned c = 0; c < 3 * SHADER_BATCH_SIZE; c += SHADER_BATCH_SIZE) {
+			switch (operatorType) {
+			case VectorOperatorType::ADD: for (unsigned i = c; i < c + _n; ++i) _out[i] = a[i] + b[i]; break;
+			case VectorOperatorType::SUBTRACT: for (unsigned i = c; i < c + _n; ++i) _out[i] = a[i] - b[i]; break;
+			case VectorOperatorType::MULTIPLY: for (unsigned i = c; i < c + _n; ++i) _out[i] = a[i] * b[i]; break;
+			case VectorOperatorType::DIVIDE: for (unsigned i = c; i < c + _n; ++i) _out[i] = a[i] / b[i]; break;
+			}
+		}
+	}
+
+
+
 	DotProductNode::DotProductNode(Socket *_valueA, Socket *_valueB) : Node(2, 1, "Dot") {
 		inputSockets[0] = MAKE_INPUT_SOCKET(SocketType::TYPE_VEC3, _valueA, "Vector");
 		inputSockets[1] = MAKE_INPUT_SOCKET(SocketType::TYPE_VEC3, _valueB, "Vector");
@@ -22,6 +22,8 @@ namespace Maths {
 			ScalarMathsNode(ScalarOperatorType _operatorType = ScalarOperatorType::ADD, Socket *_valueA = nullptr, Socket *_valueB = nullptr);
 	
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
+
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
 	};
 
 
@@ -40,6 +42,8 @@ namespace Maths {
 			VectorMathsNode(VectorOperatorType _operatorType = VectorOperatorType::ADD, Socket *_valueA = nullptr, Socket *_valueB = nullptr);
 
 			void GetVec3(const ScatterEvent &_event, void *_out) const;
+
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
 	};
 
 
@@ -49,6 +49,17 @@ namespace {
 		return _x * _x * (3 - 2 * _x);
 	}
 
+	/*
+		Qualified calls so each lane doesn't go through the Noise vtable.
+	*/
+	template<class T>
+	inline void NoiseBatch(const T *_noise, const ScatterEvent *const *_events, const unsigned _n, Real *_out) {
+		for (unsigned i = 0; i < _n; ++i) {
+			const ScatterEvent &event = *_events[i];
+			_out[i] = event.mediumInteraction ? _noise->T::Get3D(event.hit->point) : _noise->T::Get2D(event.hit->uvCoords);
+		}
+	}
+
 }
 
 namespace Textures {
@@ -63,6 +74,10 @@ namespace Textures {
 		else *reinterpret_cast<Real *>(_out) = Get2D(_event.hit->uvCoords);
 	}
 
+	void PerlinNoise::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		NoiseBatch(this, _events, _n, _out);
+	}
+
 	Real PerlinNoise::Get2D(Vec2 _texCoords) const {
 		_texCoords *= scale;
 		const Real gridX = std::floor(_texCoords.x);
@@ -102,6 +117,10 @@ namespace Textures {
 		else *reinterpret_cast<Real *>(_out) = Get2D(_event.hit->uvCoords);
 	}
 
+	void Checker::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		NoiseBatch(this, _events, _n, _out);
+	}
+
 	inline Real Checker::Get2D(Vec2 _texCoords) const {
 		_texCoords = maths::Fract(_texCoords * scale);
 		return (_texCoords.x > .5f) == (_texCoords.y > .5f) ? 0 : 1;
@@ -124,6 +143,10 @@ namespace Textures {
 		else *reinterpret_cast<Real *>(_out) = Get2D(_event.hit->uvCoords);
 	}
 
+	void ValueNoise::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		NoiseBatch(this, _events, _n, _out);
+	}
+
 	inline Real ValueNoise::Get2D(Vec2 _texCoords) const {
 		_texCoords *= scale;
 		const Vec2 p00(std::floor(_texCoords.x), std::floor(_texCoords.y));
@@ -154,6 +177,10 @@ namespace Textures {
 		else *reinterpret_cast<Real *>(_out) = Get2D(_event.hit->uvCoords);
 	}
 
+	void OctaveNoise::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		NoiseBatch(this, _events, _n, _out);
+	}
+
 	Real OctaveNoise::Get2D(Vec2 _texCoords) const {
 		Real out = 0, amp = .5, scl = 1;
 		for (unsigned i = 0; i < octaves; ++i) {
@@ -186,6 +213,10 @@ namespace Textures {
 		else *reinterpret_cast<Real *>(_out) = Get2D(_event.hit->uvCoords);
 	}
 
+	void Voronoi::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+		NoiseBatch(this, _events, _n, _out);
+	}
+
 	Real Voronoi::Get2D(Vec2 _texCoords) const {
 		_texCoords *= scale;
 		const Vec2 p00(std::floor(_texCoords.x), std::floor(_texCoords.y));
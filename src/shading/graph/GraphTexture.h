@@ -22,6 +22,8 @@ namespace Textures {
 
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
 
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
+
 			Real Get2D(Vec2 _texCoords) const override;
 
 			Real Get3D(Vec3 _point) const override;
@@ -37,6 +39,8 @@ namespace Textures {
 
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
 
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
+
 			Real Get2D(Vec2 _texCoords) const override;
 
 			Real Get3D(Vec3 _point) const override;
@@ -52,6 +56,8 @@ namespace Textures {
 
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
 
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
+
 			Real Get2D(Vec2 _texCoords) const override;
 
 			Real Get3D(Vec3 _point) const override;
@@ -69,6 +75,8 @@ namespace Textures {
 
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
 
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
+
 			Real Get2D(Vec2 _texCoords) const override;
 
 			Real Get3D(Vec3 _point) const override;
@@ -82,6 +90,8 @@ namespace Textures {
 
 			void GetScalar(const ScatterEvent &_event, void *_out) const;
 
+			void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const override;
+
 			Real Get2D(Vec2 _texCoords) const override;
 
 			Real Get3D(Vec3 _point) const override;
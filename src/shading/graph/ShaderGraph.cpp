@@ -1,18 +1,494 @@
 #pragma once
 #include "ShaderGraph.h"
+#include "GraphInputs.h"
+#include "GraphTexture.h"
 
 LAMBDA_BEGIN
 
 SG_BEGIN
 
+std::atomic<unsigned> graphRevision(0);
+std::atomic<unsigned> valueEpoch(0);
+
+static std::atomic<uint64_t> nextProgramSerial(1);
+
+ShaderProgram::ShaderProgram() : serial(nextProgramSerial++) {}
+
+namespace {
+
+	/*
+		Everything about an event the built-in nodes read, plus the value epoch. Two events with
+		equal keys shade the same point the same way.
+	*/
+	struct ShadingKey {
+		const RayHit *hit = nullptr;
+		Vec3 point, normal, wo, wi;
+		Vec2 uv;
+		Real eta = 0;
+		bool mediumInteraction = false;
+		unsigned epoch = 0;
+
+		inline void Set(const ScatterEvent &_event) {
+			hit = _event.hit;
+			point = _event.hit->point;
+			normal = _event.hit->normalS;
+			uv = _event.hit->uvCoords;
+			wo = _event.wo;
+			wi = _event.wi;
+			eta = _event.eta;
+			mediumInteraction = _event.mediumInteraction;
+			epoch = valueEpoch.load(std::memory_order_relaxed);
+		}
+
+		inline bool Matches(const ScatterEvent &_event) const {
+			return hit == _event.hit && point == _event.hit->point && normal == _event.hit->normalS && uv == _event.hit->uvCoords
+				&& wo == _event.wo && wi == _event.wi && eta == _event.eta
+				&& mediumInteraction == _event.mediumInteraction && epoch == valueEpoch.load(std::memory_order_relaxed);
+		}
+	};
+
+	/*
+		A mix of two BxDFs reads three programs at each point, so keep a few runs per thread.
+	*/
+	constexpr unsigned registerCacheSize = 4;
+
+	struct RegisterCache {
+		uint64_t serial[registerCacheSize] = {};
+		ShadingKey key[registerCacheSize];
+		alignas(16) Real registers[registerCacheSize][SHADER_MAX_REGISTERS];
+		unsigned next = 0;
+	};
+
+	struct BatchRegisterCache {
+		uint64_t serial = 0;
+		const ScatterEvent *const *events = nullptr;
+		unsigned n = 0;
+		ShadingKey key[SHADER_BATCH_SIZE];
+		alignas(64) Real registers[SHADER_BATCH_REGISTERS];
+	};
+
+	thread_local RegisterCache registerCache;
+	thread_local BatchRegisterCache batchRegisterCache;
+
+}
+
+#define REG(_type, _offset) (*reinterpret_cast<_type *>(_registers + (_offset)))
+#define CREG(_type, _offset) (*reinterpret_cast<const _type *>(_registers + (_offset)))
+
+void ShaderProgram::Execute(const ScatterEvent &_event, Real *_registers) const {
+	for (const Instruction &i : code) {
+		switch (i.op) {
+		case OpCode::LOAD_SCALAR: REG(Real, i.out) = *reinterpret_cast<const Real *>(i.data); break;
+		case OpCode::LOAD_VEC2: REG(Vec2, i.out) = *reinterpret_cast<const Vec2 *>(i.data); break;
+		case OpCode::LOAD_VEC3: REG(Vec3, i.out) = *reinterpret_cast<const Vec3 *>(i.data); break;
+		case OpCode::LOAD_COLOUR: REG(Colour, i.out) = *reinterpret_cast<const Colour *>(i.data); break;
+		case OpCode::LOAD_SPECTRUM: REG(Spectrum, i.out) = *reinterpret_cast<const Spectrum *>(i.data); break;
+		case OpCode::CALL: calls[i.in[0]]->callback(_event, _registers + i.out); break;
+		case OpCode::SCALAR_TO_COLOUR: REG(Colour, i.out) = Colour(REG(Real, i.in[0])); break;
+		case OpCode::SCALAR_TO_VEC2: REG(Vec2, i.out) = Vec2(REG(Real, i.in[0]), REG(Real, i.in[0])); break;
+		case OpCode::SCALAR_TO_VEC3: REG(Vec3, i.out) = Vec3(REG(Real, i.in[0]), REG(Real, i.in[0]), REG(Real, i.in[0])); break;
+		case OpCode::COLOUR_TO_SCALAR:
+		{
+			const Colour &c = REG(Colour, i.in[0]);
+			REG(Real, i.out) = c.r * (Real).3 + c.g * (Real).59 + c.b * (Real).11;
+			break;
+		}
+		case OpCode::VEC2_TO_SCALAR: REG(Real, i.out) = (REG(Vec2, i.in[0]).x + REG(Vec2, i.in[0]).y) * (Real).5; break;
+		case OpCode::VEC2_TO_COLOUR: REG(Colour, i.out) = Colour((REG(Vec2, i.in[0]).x + REG(Vec2, i.in[0]).y) * (Real).5); break;
+		case OpCode::VEC2_TO_VEC3: REG(Vec3, i.out) = Vec3(REG(Vec2, i.in[0]).x, REG(Vec2, i.in[0]).y, 0); break;
+		case OpCode::VEC3_TO_SCALAR:
+		{
+			const Vec3 &v = REG(Vec3, i.in[0]);
+			REG(Real, i.out) = (v.x + v.y + v.z) * (Real).333333333333;
+			break;
+		}
+		case OpCode::VEC3_TO_COLOUR: REG(Colour, i.out) = Colour(REG(Vec3, i.in[0]).x, REG(Vec3, i.in[0]).y, REG(Vec3, i.in[0]).z); break;
+		case OpCode::VEC3_TO_VEC2: REG(Vec2, i.out) = Vec2(REG(Vec3, i.in[0]).x, REG(Vec3, i.in[0]).y); break;
+		case OpCode::SPECTRUM_TO_SCALAR: REG(Real, i.out) = REG(Spectrum, i.in[0]).y(); break;
+		case OpCode::SPECTRUM_TO_COLOUR:
+		{
+			Colour &c = REG(Colour, i.out);
+			REG(Spectrum, i.in[0]).ToRGB(&c.r);
+			c.a = 1;
+			break;
+		}
+		case OpCode::SCALAR_ADD: REG(Real, i.out) = REG(Real, i.in[0]) + REG(Real, i.in[1]); break;
+		case OpCode::SCALAR_SUBTRACT: REG(Real, i.out) = REG(Real, i.in[0]) - REG(Real, i.in[1]); break;
+		case OpCode::SCALAR_MULTIPLY: REG(Real, i.out) = REG(Real, i.in[0]) * REG(Real, i.in[1]); break;
+		case OpCode::SCALAR_DIVIDE: REG(Real, i.out) = REG(Real, i.in[0]) / REG(Real, i.in[1]); break;
+		case OpCode::SCALAR_SQRT: REG(Real, i.out) = std::sqrt(REG(Real, i.in[0])); break;
+		case OpCode::SCALAR_POWER: REG(Real, i.out) = std::pow(REG(Real, i.in[0]), REG(Real, i.in[1])); break;
+		case OpCode::VEC3_ADD: REG(Vec3, i.out) = REG(Vec3, i.in[0]) + REG(Vec3, i.in[1]); break;
+		case OpCode::VEC3_SUBTRACT: REG(Vec3, i.out) = REG(Vec3, i.in[0]) - REG(Vec3, i.in[1]); break;
+		case OpCode::VEC3_MULTIPLY: REG(Vec3, i.out) = REG(Vec3, i.in[0]) * REG(Vec3, i.in[1]); break;
+		case OpCode::VEC3_DIVIDE: REG(Vec3, i.out) = REG(Vec3, i.in[0]) / REG(Vec3, i.in[1]); break;
+		case OpCode::DOT: REG(Real, i.out) = maths::Dot(REG(Vec3, i.in[0]), REG(Vec3, i.in[1])); break;
+		case OpCode::CROSS: REG(Vec3, i.out) = maths::Cross(REG(Vec3, i.in[0]), REG(Vec3, i.in[1])); break;
+		case OpCode::LENGTH: REG(Real, i.out) = REG(Vec3, i.in[0]).Magnitude(); break;
+		case OpCode::EXTRACT: REG(Real, i.out) = _registers[i.in[0] + i.in[1]]; break;
+		case OpCode::MERGE_VEC3: REG(Vec3, i.out) = Vec3(REG(Real, i.in[0]), REG(Real, i.in[1]), REG(Real, i.in[2])); break;
+		case OpCode::MERGE_COLOUR: REG(Colour, i.out) = Colour(REG(Real, i.in[0]), REG(Real, i.in[1]), REG(Real, i.in[2]), REG(Real, i.in[3])); break;
+		case OpCode::TEXTURE: REG(Colour, i.out) = SampleTexture(*reinterpret_cast<Texture *const *>(i.data), *_event.hit); break;
+		case OpCode::SPECTRAL_TEXTURE: REG(Spectrum, i.out) = SampleTexture(*reinterpret_cast<texture_t<Spectrum> *const *>(i.data), *_event.hit); break;
+		case OpCode::SURFACE_NORMAL: REG(Vec3, i.out) = _event.hit->normalS; break;
+		case OpCode::FRESNEL: REG(Real, i.out) = FresnelInput::Schlick(_event.eta, REG(Real, i.in[0]), _event.woL.y); break;
+		case OpCode::BLACKBODY: REG(Spectrum, i.out) = reinterpret_cast<const BlackbodyInput *>(i.data)->Evaluate(REG(Real, i.in[0])); break;
+		case OpCode::NOISE:
+		{
+			const Textures::Noise *noise = reinterpret_cast<const Textures::Noise *>(i.data);
+			REG(Real, i.out) = _event.mediumInteraction ? noise->Get3D(_event.hit->point) : noise->Get2D(_event.hit->uvCoords);
+			break;
+		}
+		}
+	}
+}
+
+const Real *ShaderProgram::Run(const ScatterEvent &_event) const {
+	RegisterCache &cache = registerCache;
+	for (unsigned e = 0; e < registerCacheSize; ++e) {
+		if (cache.serial[e] == serial && cache.key[e].Matches(_event)) return cache.registers[e];
+	}
+	const unsigned e = cache.next;
+	cache.next = (e + 1) % registerCacheSize;
+	cache.serial[e] = 0;	//Not valid until the run finishes
+	Execute(_event, cache.registers[e]);
+	cache.serial[e] = serial;
+	cache.key[e].Set(_event);
+	return cache.registers[e];
+}
+
+/*
+	Result conversions match Socket::GetAs().
+*/
+
+template<> Real ShaderProgram::Get<Real>(const ScatterEvent &_event, const unsigned _output) const {
+	const Real *_registers = Run(_event);
+	const uint16_t result = outputs[_output].reg;
+	switch (outputs[_output].type) {
+	case SocketType::TYPE_SCALAR: return CREG(Real, result);
+	case SocketType::TYPE_COLOUR:
+	{
+		const Colour &c = CREG(Colour, result);
+		return c.r * (Real).3 + c.g * (Real).59 + c.b * (Real).11;
+	}
+	case SocketType::TYPE_VEC2: return (CREG(Vec2, result).x + CREG(Vec2, result).y) * (Real).5;
+	case SocketType::TYPE_VEC3: return (CREG(Vec3, result).x + CREG(Vec3, result).y + CREG(Vec3, result).z) * (Real).333333333333;
+	case SocketType::TYPE_SPECTRUM: return CREG(Spectrum, result).y();
+	default: return 0;
+	}
+}
+
+template<> Colour ShaderProgram::Get<Colour>(const ScatterEvent &_event, const unsigned _output) const {
+	const Real *_registers = Run(_event);
+	const uint16_t result = outputs[_output].reg;
+	switch (outputs[_output].type) {
+	case SocketType::TYPE_COLOUR: return CREG(Colour, result);
+	case SocketType::TYPE_SCALAR: return Colour(CREG(Real, result));
+	case SocketType::TYPE_SPECTRUM:
+	{
+		Colour c;
+		CREG(Spectrum, result).ToRGB(&c.r);
+		return c;
+	}
+	case SocketType::TYPE_VEC3: return Colour(CREG(Vec3, result).x, CREG(Vec3, result).y, CREG(Vec3, result).z);
+	case SocketType::TYPE_VEC2: return Colour((CREG(Vec2, result).x + CREG(Vec2, result).y) * (Real).5);
+	default: return Colour(1, 0, 1);
+	}
+}
+
+template<> Vec2 ShaderProgram::Get<Vec2>(const ScatterEvent &_event, const unsigned _output) const {
+	const Real *_registers = Run(_event);
+	const uint16_t result = outputs[_output].reg;
+	switch (outputs[_output].type) {
+	case SocketType::TYPE_VEC2: return CREG(Vec2, result);
+	case SocketType::TYPE_VEC3: return Vec2(CREG(Vec3, result).x, CREG(Vec3, result).y);
+	case SocketType::TYPE_SCALAR: return Vec2(CREG(Real, result), CREG(Real, result));
+	default: return Vec2(0, 0);
+	}
+}
+
+template<> Vec3 ShaderProgram::Get<Vec3>(const ScatterEvent &_event, const unsigned _output) const {
+	const Real *_registers = Run(_event);
+	const uint16_t result = outputs[_output].reg;
+	switch (outputs[_output].type) {
+	case SocketType::TYPE_VEC3: return CREG(Vec3, result);
+	case SocketType::TYPE_VEC2: return Vec3(CREG(Vec2, result).x, CREG(Vec2, result).y, 0);
+	case SocketType::TYPE_SCALAR: return Vec3(CREG(Real, result), CREG(Real, result), CREG(Real, result));
+	default: return Vec3(0, 0, 0);
+	}
+}
+
+template<> BxDF *ShaderProgram::Get<BxDF *>(const ScatterEvent &_event, const unsigned _output) const {
+	return nullptr;	//BxDF sockets are never compiled
+}
+
+Spectrum ShaderProgram::GetSpectrum(const ScatterEvent &_event, const unsigned _output, const SpectrumType _type) const {
+	const Real *_registers = Run(_event);
+	const uint16_t result = outputs[_output].reg;
+	switch (outputs[_output].type) {
+	case SocketType::TYPE_COLOUR: return Spectrum::FromRGB(&CREG(Colour, result).r, _type);
+	case SocketType::TYPE_SCALAR: return Spectrum(CREG(Real, result));
+	case SocketType::TYPE_SPECTRUM: return CREG(Spectrum, result);
+	default: return Spectrum(0);
+	}
+}
+
+#undef CREG
+#undef REG
+
+#define LANES for (unsigned l = 0; l < _n; ++l)
+#define IN(_c) _in[(_c) * SHADER_BATCH_SIZE + l]
+#define OUT(_c) _out[(_c) * SHADER_BATCH_SIZE + l]
+
+static inline Spectrum GatherSpectrum(const Real *_in, const unsigned _lane) {
+	Spectrum s;
+	for (unsigned c = 0; c < Spectrum::nSamples; ++c) s[c] = _in[c * SHADER_BATCH_SIZE + _lane];
+	return s;
+}
+
+static inline void ScatterSpectrum(const Spectrum &_s, Real *_out, const unsigned _lane) {
+	for (unsigned c = 0; c < Spectrum::nSamples; ++c) _out[c * SHADER_BATCH_SIZE + _lane] = _s[c];
+}
+
+void ConvertBatch(const Real *_in, const SocketType _from, Real *_out, const SocketType _to, const unsigned _n) {
+	if (_from == _to) {
+		const unsigned nc = ComponentCount(_to);
+		for (unsigned c = 0; c < nc; ++c) LANES OUT(c) = IN(c);
+		return;
+	}
+	switch (_to) {
+	case SocketType::TYPE_SCALAR:
+		switch (_from) {
+		case SocketType::TYPE_COLOUR: LANES OUT(0) = IN(0) * (Real).3 + IN(1) * (Real).59 + IN(2) * (Real).11; return;
+		case SocketType::TYPE_VEC2: LANES OUT(0) = (IN(0) + IN(1)) * (Real).5; return;
+		case SocketType::TYPE_VEC3: LANES OUT(0) = (IN(0) + IN(1) + IN(2)) * (Real).333333333333; return;
+		case SocketType::TYPE_SPECTRUM: LANES OUT(0) = GatherSpectrum(_in, l).y(); return;
+		default: LANES OUT(0) = 0; return;
+		}
+	case SocketType::TYPE_COLOUR:
+		switch (_from) {
+		case SocketType::TYPE_SCALAR: LANES { OUT(0) = OUT(1) = OUT(2) = IN(0); OUT(3) = 1; } return;
+		case SocketType::TYPE_SPECTRUM:
+			LANES {
+				Real rgb[3];
+				GatherSpectrum(_in, l).ToRGB(rgb);
+				OUT(0) = rgb[0]; OUT(1) = rgb[1]; OUT(2) = rgb[2]; OUT(3) = 1;
+			}
+			return;
+		case SocketType::TYPE_VEC3: LANES { OUT(0) = IN(0); OUT(1) = IN(1); OUT(2) = IN(2); OUT(3) = 1; } return;
+		case SocketType::TYPE_VEC2: LANES { OUT(0) = OUT(1) = OUT(2) = (IN(0) + IN(1)) * (Real).5; OUT(3) = 1; } return;
+		default: LANES { OUT(0) = 1; OUT(1) = 0; OUT(2) = 1; OUT(3) = 1; } return;
+		}
+	case SocketType::TYPE_VEC2:
+		switch (_from) {
+		case SocketType::TYPE_VEC3: LANES { OUT(0) = IN(0); OUT(1) = IN(1); } return;
+		case SocketType::TYPE_SCALAR: LANES OUT(0) = OUT(1) = IN(0); return;
+		default: LANES OUT(0) = OUT(1) = 0; return;
+		}
+	case SocketType::TYPE_VEC3:
+		switch (_from) {
+		case SocketType::TYPE_VEC2: LANES { OUT(0) = IN(0); OUT(1) = IN(1); OUT(2) = 0; } return;
+		case SocketType::TYPE_SCALAR: LANES OUT(0) = OUT(1) = OUT(2) = IN(0); return;
+		default: LANES OUT(0) = OUT(1) = OUT(2) = 0; return;
+		}
+	case SocketType::TYPE_SPECTRUM:
+		switch (_from) {
+		case SocketType::TYPE_COLOUR:
+			LANES {
+				const Real rgb[3] = { IN(0), IN(1), IN(2) };
+				ScatterSpectrum(Spectrum::FromRGB(rgb, SpectrumType::Reflectance), _out, l);
+			}
+			return;
+		case SocketType::TYPE_SCALAR: for (unsigned c = 0; c < Spectrum::nSamples; ++c) LANES OUT(c) = IN(0); return;
+		default: for (unsigned c = 0; c < Spectrum::nSamples; ++c) LANES OUT(c) = 0; return;
+		}
+	default:
+		return;
+	}
+}
+
+#undef IN
+#undef OUT
+
+#define B(_offset, _c) _registers[((_offset) + (_c)) * SHADER_BATCH_SIZE + l]
+#define R(_offset) (_registers + (_offset) * SHADER_BATCH_SIZE)
+
+void ShaderProgram::ExecuteBatch(const ScatterEvent *const *_events, const unsigned _n, Real *_registers) const {
+	for (const Instruction &i : code) {
+		switch (i.op) {
+		case OpCode::LOAD_SCALAR:
+		case OpCode::LOAD_VEC2:
+		case OpCode::LOAD_VEC3:
+		case OpCode::LOAD_COLOUR:
+		case OpCode::LOAD_SPECTRUM:
+		{
+			static const SocketType loadTypes[] = { SocketType::TYPE_SCALAR, SocketType::TYPE_VEC2, SocketType::TYPE_VEC3, SocketType::TYPE_COLOUR, SocketType::TYPE_SPECTRUM };
+			const Real *v = reinterpret_cast<const Real *>(i.data);
+			const unsigned nc = ComponentCount(loadTypes[(unsigned)i.op - (unsigned)OpCode::LOAD_SCALAR]);
+			for (unsigned c = 0; c < nc; ++c) LANES B(i.out, c) = v[c];
+			break;
+		}
+		case OpCode::CALL:
+		{
+			const Socket *socket = calls[i.in[0]];
+			socket->node->EvaluateBatch(socket - socket->node->outputSockets.get(), _events, _n, R(i.out));
+			break;
+		}
+		case OpCode::SCALAR_TO_COLOUR: ConvertBatch(R(i.in[0]), SocketType::TYPE_SCALAR, R(i.out), SocketType::TYPE_COLOUR, _n); break;
+		case OpCode::SCALAR_TO_VEC2: ConvertBatch(R(i.in[0]), SocketType::TYPE_SCALAR, R(i.out), SocketType::TYPE_VEC2, _n); break;
+		case OpCode::SCALAR_TO_VEC3: ConvertBatch(R(i.in[0]), SocketType::TYPE_SCALAR, R(i.out), SocketType::TYPE_VEC3, _n); break;
+		case OpCode::COLOUR_TO_SCALAR: ConvertBatch(R(i.in[0]), SocketType::TYPE_COLOUR, R(i.out), SocketType::TYPE_SCALAR, _n); break;
+		case OpCode::VEC2_TO_SCALAR: ConvertBatch(R(i.in[0]), SocketType::TYPE_VEC2, R(i.out), SocketType::TYPE_SCALAR, _n); break;
+		case OpCode::VEC2_TO_COLOUR: ConvertBatch(R(i.in[0]), SocketType::TYPE_VEC2, R(i.out), SocketType::TYPE_COLOUR, _n); break;
+		case OpCode::VEC2_TO_VEC3: ConvertBatch(R(i.in[0]), SocketType::TYPE_VEC2, R(i.out), SocketType::TYPE_VEC3, _n); break;
+		case OpCode::VEC3_TO_SCALAR: ConvertBatch(R(i.in[0]), SocketType::TYPE_VEC3, R(i.out), SocketType::TYPE_SCALAR, _n); break;
+		case OpCode::VEC3_TO_COLOUR: ConvertBatch(R(i.in[0]), SocketType::TYPE_VEC3, R(i.out), SocketType::TYPE_COLOUR, _n); break;
+		case OpCode::VEC3_TO_VEC2: ConvertBatch(R(i.in[0]), SocketType::TYPE_VEC3, R(i.out), SocketType::TYPE_VEC2, _n); break;
+		case OpCode::SPECTRUM_TO_SCALAR: ConvertBatch(R(i.in[0]), SocketType::TYPE_SPECTRUM, R(i.out), SocketType::TYPE_SCALAR, _n); break;
+		case OpCode::SPECTRUM_TO_COLOUR: ConvertBatch(R(i.in[0]), SocketType::TYPE_SPECTRUM, R(i.out), SocketType::TYPE_COLOUR, _n); break;
+		case OpCode::SCALAR_ADD: LANES B(i.out, 0) = B(i.in[0], 0) + B(i.in[1], 0); break;
+		case OpCode::SCALAR_SUBTRACT: LANES B(i.out, 0) = B(i.in[0], 0) - B(i.in[1], 0); break;
+		case OpCode::SCALAR_MULTIPLY: LANES B(i.out, 0) = B(i.in[0], 0) * B(i.in[1], 0); break;
+		case OpCode::SCALAR_DIVIDE: LANES B(i.out, 0) = B(i.in[0], 0) / B(i.in[1], 0); break;
+		case OpCode::SCALAR_SQRT: LANES B(i.out, 0) = std::sqrt(B(i.in[0], 0)); break;
+		case OpCode::SCALAR_POWER: LANES B(i.out, 0) = std::pow(B(i.in[0], 0), B(i.in[1], 0)); break;
+		case OpCode::VEC3_ADD: for (unsigned c = 0; c < 3; ++c) LANES B(i.out, c) = B(i.in[0], c) + B(i.in[1], c); break;
+		case OpCode::VEC3_SUBTRACT: for (unsigned c = 0; c < 3; ++c) LANES B(i.out, c) = B(i.in[0], c) - B(i.in[1], c); break;
+		case OpCode::VEC3_MULTIPLY: for (unsigned c = 0; c < 3; ++c) LANES B(i.out, c) = B(i.in[0], c) * B(i.in[1], c); break;
+		case OpCode::VEC3_DIVIDE: for (unsigned c = 0; c < 3; ++c) LANES B(i.out, c) = B(i.in[0], c) / B(i.in[1], c); break;
+		case OpCode::DOT: LANES B(i.out, 0) = B(i.in[0], 0) * B(i.in[1], 0) + B(i.in[0], 1) * B(i.in[1], 1) + B(i.in[0], 2) * B(i.in[1], 2); break;
+		case OpCode::CROSS:
+			LANES {
+				const Real x = B(i.in[0], 1) * B(i.in[1], 2) - B(i.in[0], 2) * B(i.in[1], 1);
+				const Real y = B(i.in[0], 2) * B(i.in[1], 0) - B(i.in[0], 0) * B(i.in[1], 2);
+				const Real z = B(i.in[0], 0) * B(i.in[1], 1) - B(i.in[0], 1) * B(i.in[1], 0);
+				B(i.out, 0) = x;
+				B(i.out, 1) = y;
+				B(i.out, 2) = z;
+			}
+			break;
+		case OpCode::LENGTH: LANES B(i.out, 0) = std::sqrt(B(i.in[0], 0) * B(i.in[0], 0) + B(i.in[0], 1) * B(i.in[0], 1) + B(i.in[0], 2) * B(i.in[0], 2)); break;
+		case OpCode::EXTRACT: LANES B(i.out, 0) = B(i.in[0], i.in[1]); break;
+		case OpCode::MERGE_VEC3: for (unsigned c = 0; c < 3; ++c) LANES B(i.out, c) = B(i.in[c], 0); break;
+		case OpCode::MERGE_COLOUR: for (unsigned c = 0; c < 4; ++c) LANES B(i.out, c) = B(i.in[c], 0); break;
+		case OpCode::TEXTURE:
+		{
+			const Texture *tex = *reinterpret_cast<Texture *const *>(i.data);
+			LANES {
+				const Colour c = SampleTexture(tex, *_events[l]->hit);
+				B(i.out, 0) = c.r;
+				B(i.out, 1) = c.g;
+				B(i.out, 2) = c.b;
+				B(i.out, 3) = c.a;
+			}
+			break;
+		}
+		case OpCode::SPECTRAL_TEXTURE:
+		{
+			const texture_t<Spectrum> *tex = *reinterpret_cast<texture_t<Spectrum> *const *>(i.data);
+			LANES ScatterSpectrum(SampleTexture(tex, *_events[l]->hit), R(i.out), l);
+			break;
+		}
+		case OpCode::SURFACE_NORMAL:
+			LANES {
+				const Vec3 &n = _events[l]->hit->normalS;
+				B(i.out, 0) = n.x;
+				B(i.out, 1) = n.y;
+				B(i.out, 2) = n.z;
+			}
+			break;
+		case OpCode::FRESNEL: LANES B(i.out, 0) = FresnelInput::Schlick(_events[l]->eta, B(i.in[0], 0), _events[l]->woL.y); break;
+		case OpCode::BLACKBODY:
+		{
+			const BlackbodyInput *node = reinterpret_cast<const BlackbodyInput *>(i.data);
+			LANES ScatterSpectrum(node->Evaluate(B(i.in[0], 0)), R(i.out), l);
+			break;
+		}
+		case OpCode::NOISE:
+		{
+			const Textures::Noise *noise = reinterpret_cast<const Textures::Noise *>(i.data);
+			LANES {
+				const ScatterEvent &event = *_events[l];
+				B(i.out, 0) = event.mediumInteraction ? noise->Get3D(event.hit->point) : noise->Get2D(event.hit->uvCoords);
+			}
+			break;
+		}
+		}
+	}
+}
+
+#undef B
+#undef R
+#undef LANES
+
+void ShaderProgram::GetBatch(const ScatterEvent *const *_events, const unsigned _n, const unsigned _output, const SocketType _type, Real *_out) const {
+	const ProgramOutput &output = outputs[_output];
+	if (registerSize * SHADER_BATCH_SIZE <= SHADER_BATCH_REGISTERS) {
+		BatchRegisterCache &cache = batchRegisterCache;
+		bool cached = cache.serial == serial && cache.events == _events && cache.n == _n;
+		for (unsigned l = 0; cached && l < _n; ++l) cached = cache.key[l].Matches(*_events[l]);
+		if (!cached) {
+			cache.serial = 0;	//Not valid until the run finishes
+			ExecuteBatch(_events, _n, cache.registers);
+			cache.serial = serial;
+			cache.events = _events;
+			cache.n = _n;
+			for (unsigned l = 0; l < _n; ++l) cache.key[l].Set(*_events[l]);
+		}
+		ConvertBatch(cache.registers + output.reg * SHADER_BATCH_SIZE, output.type, _out, _type, _n);
+		return;
+	}
+	alignas(64) Real registers[SHADER_BATCH_SIZE * (Spectrum::nSamples > 4 ? Spectrum::nSamples : 4)];
+	const unsigned nc = ComponentCount(output.type);
+	for (unsigned l = 0; l < _n; ++l) {
+		const Real *single = Run(*_events[l]);
+		for (unsigned c = 0; c < nc; ++c) registers[c * SHADER_BATCH_SIZE + l] = single[output.reg + c];
+	}
+	ConvertBatch(registers, output.type, _out, _type, _n);
+}
+
+
+
+void SocketRef::GetBatch(const ScatterEvent *const *_events, const unsigned _n, const SocketType _type, Real *_out) const {
+	if (!socket) {	//Default values only have room for four components
+		const unsigned nc = ComponentCount(_type);
+		for (unsigned c = 0; c < nc; ++c) {
+			for (unsigned l = 0; l < _n; ++l) _out[c * SHADER_BATCH_SIZE + l] = c < 4 ? data[c] : 0;
+		}
+		return;
+	}
+	if (program && program->IsCurrent()) {
+		program->GetBatch(_events, _n, output, _type, _out);
+		return;
+	}
+	const unsigned output = socket - socket->node->outputSockets.get();
+	if (socket->socketType == _type) {
+		socket->node->EvaluateBatch(output, _events, _n, _out);
+		return;
+	}
+	alignas(64) Real native[SHADER_BATCH_SIZE * (Spectrum::nSamples > 4 ? Spectrum::nSamples : 4)];
+	socket->node->EvaluateBatch(output, _events, _n, native);
+	ConvertBatch(native, socket->socketType, _out, _type, _n);
+}
+
+void SocketRef::GetAsSpectrumBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const {
+	alignas(64) Real values[SHADER_BATCH_SIZE * Spectrum::nSamples];
+	GetBatch(_events, _n, SocketType::TYPE_SPECTRUM, values);
+	for (unsigned l = 0; l < _n; ++l) _out[l] = GatherSpectrum(values, l);
+}
+
+
+
 void SocketRef::operator=(Socket *_rhs) {
 	socket = _rhs;
+	Invalidate();
 }
 
 
 
 bool Connect(SocketRef &_socketRef, const Socket &_socket) {
 	_socketRef.socket = (Socket *)&_socket;
+	Invalidate();
 	return true;
 }
 
@@ -22,6 +498,7 @@ bool Connect(const Socket &_socket, SocketRef &_socketRef) {
 
 void Disconnect(SocketRef &_socketRef) {
 	_socketRef.socket = nullptr;
+	Invalidate();
 }
 
 
@@ -48,6 +525,16 @@ Node::Node(const Node &_node) :
 	}
 }
 
+void Node::EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const {
+	const Socket &socket = outputSockets[_output];
+	const unsigned nc = ComponentCount(socket.socketType);
+	alignas(16) Real value[sizeof(Spectrum) / sizeof(Real) + 4];
+	for (unsigned l = 0; l < _n; ++l) {
+		socket.callback(*_events[l], value);
+		for (unsigned c = 0; c < nc; ++c) _out[c * SHADER_BATCH_SIZE + l] = value[c];
+	}
+}
+
 SocketRef *Node::GetInputSocket(const unsigned _index) {
 	return &inputSockets[_index];
 }
@@ -3,6 +3,8 @@
 #include <memory>
 #include <cassert>
 #include <stack>
+#include <vector>
+#include <atomic>
 #include <utility/Delegate.h>
 #include <core/Spectrum.h>
 #include "../ScatterEvent.h"
@@ -37,7 +39,7 @@ using NodeDelegate = Delegate<void, const ScatterEvent &, void *>;
 
 #define MAKE_SOCKET_CALLBACK(_func) NodeDelegate::FromFunction<std::remove_reference<decltype(*this)>::type, (_func)>(this)
 
-#define MAKE_SOCKET(_type, _callback, _tag) {	(_tag), MAKE_SOCKET_CALLBACK(_callback), nullptr, (_type) 	}
+#define MAKE_SOCKET(_type, _callback, _tag) {	(_tag), MAKE_SOCKET_CALLBACK(_callback), this, (_type) 	}
 
 #define MAKE_INPUT_SOCKET(_type, _socketPtr, _tag) { {0,0,0,0},	(_type), (_socketPtr), (_tag)	};
 
@@ -251,11 +253,179 @@ struct Socket {
 	}
 };
 
+/*
+	Incremented whenever a link in any shader graph changes. Programs compiled before the
+	current revision are stale and sockets fall back to their delegates until recompiled.
+*/
+extern std::atomic<unsigned> graphRevision;
+
+/*
+	Marks every compiled program as stale. Connect() and Disconnect() call this, it only needs
+	calling directly after changing a node's operator type or texture channel.
+*/
+inline void Invalidate() {
+	++graphRevision;
+}
+
+/*
+	Incremented by Scene::CompileMaterials() before every pass. Registers cached by programs are
+	only reused within one epoch, so edits to input node values between passes are always seen.
+*/
+extern std::atomic<unsigned> valueEpoch;
+
+enum class OpCode : uint8_t {
+	LOAD_SCALAR,
+	LOAD_VEC2,
+	LOAD_VEC3,
+	LOAD_COLOUR,
+	LOAD_SPECTRUM,
+	CALL,
+	SCALAR_TO_COLOUR,
+	SCALAR_TO_VEC2,
+	SCALAR_TO_VEC3,
+	COLOUR_TO_SCALAR,
+	VEC2_TO_SCALAR,
+	VEC2_TO_COLOUR,
+	VEC2_TO_VEC3,
+	VEC3_TO_SCALAR,
+	VEC3_TO_COLOUR,
+	VEC3_TO_VEC2,
+	SPECTRUM_TO_SCALAR,
+	SPECTRUM_TO_COLOUR,
+	SCALAR_ADD,
+	SCALAR_SUBTRACT,
+	SCALAR_MULTIPLY,
+	SCALAR_DIVIDE,
+	SCALAR_SQRT,
+	SCALAR_POWER,
+	VEC3_ADD,
+	VEC3_SUBTRACT,
+	VEC3_MULTIPLY,
+	VEC3_DIVIDE,
+	DOT,
+	CROSS,
+	LENGTH,
+	EXTRACT,
+	MERGE_VEC3,
+	MERGE_COLOUR,
+	TEXTURE,
+	SPECTRAL_TEXTURE,
+	SURFACE_NORMAL,
+	FRESNEL,
+	BLACKBODY,
+	NOISE
+};
+
+/*
+	Operands are register offsets in Reals. EXTRACT keeps its component index in in[1] and CALL
+	its delegate index in in[0]. Loads and textures read through data, so edits to input node
+	values and texture pointers are seen without recompiling. BLACKBODY's data is its node and
+	NOISE's the node's Noise.
+*/
+struct Instruction {
+	OpCode op;
+	uint16_t out;
+	uint16_t in[4];
+	const void *data;
+};
+
+constexpr unsigned SHADER_MAX_REGISTERS = 1024;
+
+/*
+	Batches hold up to SHADER_BATCH_SIZE events. Batched values are structure-of-arrays:
+	component c of event i is at [c * SHADER_BATCH_SIZE + i].
+*/
+constexpr unsigned SHADER_BATCH_SIZE = 16;
+constexpr unsigned SHADER_BATCH_REGISTERS = 4096;
+
+/*
+	Number of Reals making up a value of _type.
+*/
+inline unsigned ComponentCount(const SocketType _type) {
+	switch (_type) {
+	case SocketType::TYPE_SCALAR: return 1;
+	case SocketType::TYPE_VEC2: return 2;
+	case SocketType::TYPE_VEC3: return 3;
+	case SocketType::TYPE_COLOUR: return 4;
+	case SocketType::TYPE_SPECTRUM: return Spectrum::nSamples;
+	default: return 0;
+	}
+}
+
+/*
+	Converts _n batched values from _from to _to, matching Socket::GetAs(). _in and _out must not overlap.
+*/
+void ConvertBatch(const Real *_in, const SocketType _from, Real *_out, const SocketType _to, const unsigned _n);
+
+/*
+	Where one input's value is left by a program, in the upstream socket's own type.
+*/
+struct ProgramOutput {
+	uint16_t reg = 0;
+	SocketType type = SocketType::TYPE_NULL;	//Null for inputs that weren't compiled
+};
+
+/*
+	The subgraphs feeding every input of one BxDF node flattened into register bytecode by
+	Compiler. Values are computed once in dependency order, so nodes shared between inputs are
+	only evaluated once per run. Results are converted on read, exactly like Socket::GetAs().
+	- A run's registers are cached per thread and keyed on the shading point, so reading the
+	BxDF's other inputs at the same point doesn't run the program again.
+*/
+class ShaderProgram {
+	public:
+		std::vector<Instruction> code;
+		std::vector<const Socket *> calls;
+		std::vector<ProgramOutput> outputs;	//Per input socket of the BxDF node
+		unsigned registerSize = 0;
+		unsigned revision = 0;
+		const uint64_t serial;	//Unique to this program, keys the register caches
+
+		ShaderProgram();
+
+		inline bool IsCurrent() const {
+			return revision == graphRevision.load(std::memory_order_relaxed);
+		}
+
+		/*
+			Runs every instruction, leaving the values in _registers.
+		*/
+		void Execute(const ScatterEvent &_event, Real *_registers) const;
+
+		/*
+			Runs every instruction across _n events, each register holding SHADER_BATCH_SIZE lanes.
+		*/
+		void ExecuteBatch(const ScatterEvent *const *_events, const unsigned _n, Real *_registers) const;
+
+		/*
+			Registers after running at _event, from this thread's cache if the program already ran
+			at the same shading point. Valid until the thread runs another program.
+		*/
+		const Real *Run(const ScatterEvent &_event) const;
+
+		/*
+			Batched _output read as _type. Programs too large for a batched register file run once per event.
+		*/
+		void GetBatch(const ScatterEvent *const *_events, const unsigned _n, const unsigned _output, const SocketType _type, Real *_out) const;
+
+		template<class T> T Get(const ScatterEvent &_event, const unsigned _output) const;
+
+		Spectrum GetSpectrum(const ScatterEvent &_event, const unsigned _output, const SpectrumType _type = SpectrumType::Reflectance) const;
+};
+
+template<> Real ShaderProgram::Get<Real>(const ScatterEvent &_event, const unsigned _output) const;
+template<> Colour ShaderProgram::Get<Colour>(const ScatterEvent &_event, const unsigned _output) const;
+template<> Vec2 ShaderProgram::Get<Vec2>(const ScatterEvent &_event, const unsigned _output) const;
+template<> Vec3 ShaderProgram::Get<Vec3>(const ScatterEvent &_event, const unsigned _output) const;
+template<> BxDF *ShaderProgram::Get<BxDF *>(const ScatterEvent &_event, const unsigned _output) const;
+
 struct SocketRef {
 	Real data[4];	// all socket types are made of Reals
 	SocketType socketType;
 	Socket *socket;
 	std::string tag;
+	std::shared_ptr<const ShaderProgram> program;	// Set by Material::Compile(), shared by the node's inputs
+	uint16_t output = 0;	// This input's index into program->outputs
 
 	// unsafe - add type check static assert
 	template<class T>
@@ -275,14 +445,23 @@ struct SocketRef {
 	template<class T>
 	inline T GetAs(const ScatterEvent &_event) {
 		if (!socket) return GetDefaultValue<T>();
+		if (program && program->IsCurrent()) return program->Get<T>(_event, output);
 		return socket->GetAs<T>(_event);
 	}
 
 	inline Spectrum GetAsSpectrum(const ScatterEvent &_event) {
 		if (!socket) return GetDefaultValue<Spectrum>();
+		if (program && program->IsCurrent()) return program->GetSpectrum(_event, output);
 		return socket->GetAsSpectrum(_event);
 	}
 
+	/*
+		Reads this input as _type for _n events, writing batched values to _out.
+	*/
+	void GetBatch(const ScatterEvent *const *_events, const unsigned _n, const SocketType _type, Real *_out) const;
+
+	void GetAsSpectrumBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const;
+
 	void operator=(Socket *_rhs);
 };
 
@@ -309,6 +488,14 @@ class Node {
 
 		Node(const Node &_node);
 
+		virtual ~Node() {}
+
+		/*
+			Evaluates output socket _output for _n events at once, writing batched values of the
+			socket's type to _out. The default calls the socket's delegate once per event.
+		*/
+		virtual void EvaluateBatch(const unsigned _output, const ScatterEvent *const *_events, const unsigned _n, Real *_out) const;
+
 		SocketRef *GetInputSocket(const unsigned _index);
 
 		SocketRef *GetInputSocket(const char *_tag);
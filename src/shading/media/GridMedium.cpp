@@ -0,0 +1,131 @@
+#include <cstring>
+#include <sampling/RandomSampler.h>
+#include "GridMedium.h"
+
+LAMBDA_BEGIN
+
+namespace {
+
+	inline Real MaxComponent(const Spectrum &_s) {
+		Real m = _s[0];
+		for (unsigned i = 1; i < Spectrum::nSamples; ++i) m = std::max(m, _s[i]);
+		return m;
+	}
+
+	inline Real Average(const Spectrum &_s) {
+		Real sum = 0;
+		for (unsigned i = 0; i < Spectrum::nSamples; ++i) sum += _s[i];
+		return sum / (Real)Spectrum::nSamples;
+	}
+
+	/*
+		Stream for one tracking walk, seeded from the path's sampler and the ray so walks that read
+		the same wrapped sampler dimensions still differ.
+	*/
+	inline RandomSampler TrackingSampler(Sampler &_sampler, const Ray &_ray) {
+		const Vec2 u = _sampler.Get2D();
+		uint64_t seed = ((uint64_t)(u.x * 0x1p32) << 32) ^ (uint64_t)(u.y * 0x1p32);
+		const float bits[4] = { (float)_ray.o.x, (float)_ray.o.y, (float)_ray.o.z, (float)(_ray.d.x + 2 * _ray.d.y + 4 * _ray.d.z) };
+		for (const float b : bits) {
+			uint32_t v;
+			std::memcpy(&v, &b, sizeof(v));
+			seed = (seed ^ v) * 0x100000001b3ull;
+		}
+		return RandomSampler(seed);
+	}
+}
+
+GridMedium::GridMedium(const VolumeGrid *_grid, const Spectrum &_sigmaA, const Spectrum &_sigmaS) {
+	grid = _grid;
+	sigmaA = _sigmaA;
+	sigmaS = _sigmaS;
+}
+
+Spectrum GridMedium::Tr(const Ray &_ray, const Real _tFar, Sampler &_sampler) const {
+	const Spectrum sigmaT = sigmaA + sigmaS;
+	const Real sigmaTMax = MaxComponent(sigmaT);
+	Spectrum Tr(1);
+	if (!grid || sigmaTMax <= 0) return Tr;
+	RandomSampler rng = TrackingSampler(_sampler, _ray);
+	VolumeGrid::MajorantIterator it = grid->Majorants(_ray, std::min(_tFar, MAX_REAL));
+	Real t0, t1, majorant;
+	while (it.Next(&t0, &t1, &majorant)) {
+		const Real mu = majorant * sigmaTMax;
+		if (mu <= 0) continue;	//Empty cell
+		Real t = t0;
+		for (;;) {
+			t -= std::log(1 - rng.Get1D()) / mu;
+			if (t >= t1) break;
+			Tr *= Spectrum(1) - sigmaT * (grid->Density(_ray.o + _ray.d * t) / mu);
+			const Real trMax = MaxComponent(Tr);
+			if (trMax < (Real).1) {	//Little left to lose, so stop early some of the time
+				if (rng.Get1D() >= trMax) return Spectrum(0);
+				Tr = Tr / trMax;
+			}
+		}
+	}
+	return Tr;
+}
+
+Spectrum GridMedium::SampleDistance(const Ray &_ray, Sampler &_sampler, ScatterEvent &_event, Real *_t, Real *_pdf) const {
+	const Real tFar = _event.hit->tFar;
+	const Spectrum sigmaT = sigmaA + sigmaS;
+	const Real sigmaTMax = MaxComponent(sigmaT), sigmaTAvg = Average(sigmaT);
+	_event.mediumInteraction = false;
+	Spectrum weight(1);
+	if (grid && sigmaTMax > 0) {
+		RandomSampler rng = TrackingSampler(_sampler, _ray);
+		VolumeGrid::MajorantIterator it = grid->Majorants(_ray, std::min(tFar, MAX_REAL));
+		Real t0, t1, majorant;
+		while (!_event.mediumInteraction && it.Next(&t0, &t1, &majorant)) {
+			const Real mu = majorant * sigmaTMax;
+			if (mu <= 0) continue;	//Empty cell
+			Real t = t0;
+			for (;;) {
+				t -= std::log(1 - rng.Get1D()) / mu;
+				if (t >= t1) break;
+				const Real density = grid->Density(_ray.o + _ray.d * t);
+				const Real pCollide = std::min(density * sigmaTAvg / mu, (Real)1);
+				if (rng.Get1D() < pCollide) {	//Real collision, absorption is folded into the albedo weight
+					weight *= sigmaS / sigmaTAvg;
+					_event.mediumInteraction = true;
+					if (_t) *_t = t;
+					if (_pdf) *_pdf = PDFDistance(t);
+					break;
+				}
+				weight *= (Spectrum(mu) - sigmaT * density) / (mu * (1 - pCollide));	//Null collision
+			}
+		}
+	}
+	if (!_event.mediumInteraction) {
+		if (_t) *_t = tFar;
+		if (_pdf) {
+			const Real sigmaMean = grid ? grid->MeanDensity() * sigmaTAvg : 0;
+			*_pdf = std::exp(-sigmaMean * std::min(tFar, MAX_REAL));
+			if (*_pdf == 0) *_pdf = 1;
+		}
+	}
+	return weight;
+}
+
+Real GridMedium::PDFDistance(const Real _t) const {
+	const Real sigmaMean = grid ? grid->MeanDensity() * Average(sigmaA + sigmaS) : 0;
+	return sigmaMean * std::exp(-sigmaMean * std::min(_t, MAX_REAL));
+}
+
+Spectrum GridMedium::SampleEquiangular(const Ray &_ray, Sampler &_sampler, ScatterEvent &_event, const Vec3 &_lightPoint, Real *_t, Real *_pdf) const {
+	Real pdf;
+	const Real t = SampleEquiangularT(_ray, _lightPoint, _event.hit->tFar, _sampler.Get1D(), &pdf);
+	*_t = t;
+	*_pdf = pdf;
+	_event.mediumInteraction = t < _event.hit->tFar;
+	const Real density = grid ? grid->Density(_ray.o + _ray.d * t) : 0;
+	if (density == 0 || pdf == 0) return Spectrum(0);
+	return Tr(_ray, t, _sampler) * sigmaS * density / pdf;
+}
+
+Real GridMedium::PDFEquiangular(const Ray &_ray, const Vec3 &_lightPoint, const Real _tFar, const Real _t) const {
+	return EquiangularPdf(_ray, _lightPoint, _tFar, _t);
+}
+
+LAMBDA_END
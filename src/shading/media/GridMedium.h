@@ -0,0 +1,54 @@
+#pragma once
+#include "Media.h"
+#include "VolumeGrid.h"
+
+LAMBDA_BEGIN
+
+/*
+	Heterogeneous medium whose coefficients are scaled by the density of a VolumeGrid, for clouds
+	and smoke. Tracks against the grid's majorants, after:
+		Monte Carlo Methods for Volumetric Light Transport Simulation - Novák et al.
+	- SampleDistance() uses weighted delta tracking, so chromatic media never terminate a path on
+	a null collision, only reweight it.
+	- Tr() uses ratio tracking, with russian roulette once the estimate gets small.
+	- Tracking takes its random numbers from a stream seeded by the path's sampler, which only has
+	a few decorrelated dimensions per sample.
+	- Distance pdfs can't be evaluated in closed form here. PDFDistance() returns the pdf of a
+	homogeneous medium of the grid's mean density, and SampleDistance() reports the same, so MIS
+	weights against equiangular sampling still sum to one.
+*/
+class GridMedium : public Medium {
+	public:
+		Spectrum sigmaA, sigmaS;	//Per unit density
+		const VolumeGrid *grid;
+
+		GridMedium(const VolumeGrid *_grid, const Spectrum &_sigmaA, const Spectrum &_sigmaS);
+
+		/*
+			Ratio tracked beam transmittance through a ray segment in the volume.
+		*/
+		Spectrum Tr(const Ray &_ray, const Real _tFar, Sampler &_sampler) const override;
+
+		/*
+			Delta tracks to a volume or surface interaction (_event.mediumInteraction), returning the
+			path weight of the interaction.
+		*/
+		Spectrum SampleDistance(const Ray &_ray, Sampler &_sampler, ScatterEvent &_event, Real *_t, Real *_pdf) const override;
+
+		/*
+			Approximate probability of sampling distance _t, see above.
+		*/
+		Real PDFDistance(const Real _t) const override;
+
+		/*
+			Samples t along ray segment within medium proportionally to the contribution from _lightPoint.
+		*/
+		Spectrum SampleEquiangular(const Ray &_ray, Sampler &_sampler, ScatterEvent &_event, const Vec3 &_lightPoint, Real *_t, Real *_pdf) const override;
+
+		/*
+			Probability of sampling distance _t along ray segment from _lightPoint.
+		*/
+		Real PDFEquiangular(const Ray &_ray, const Vec3 &_lightPoint, const Real _tFar, const Real _t) const override;
+};
+
+LAMBDA_END
@@ -42,53 +42,30 @@ Real HomogeneousMedium::PDFDistance(const Real _t) const {
 	const Spectrum Tr = Spectrum::Exp(-sigmaT * std::min(_t, MAX_REAL));
 	Real pdf = 0;
 	for (int i = 0; i < Spectrum::nSamples; ++i) pdf += sigmaT[i] * Tr[i];
-	pdf *= 1 / Spectrum::nSamples;
+	pdf *= 1 / (Real)Spectrum::nSamples;
 	return pdf;
 }
 
 Spectrum HomogeneousMedium::SampleEquiangular(const Ray &_ray, Sampler &_sampler, ScatterEvent &_event, const Vec3 &_lightPoint, Real *_t, Real *_pdf) const {
-	const Vec3 delta = _lightPoint - _event.hit->point;
-	const Real l = maths::Dot(_ray.d, delta);	//Distance along _ray to perpendicular bisection from _lightPoint
-	const Real D = std::sqrt(maths::Dot(delta, delta) - l * l);
-	//if (D == 0) {
-		//https://fpsunflower.github.io/ckulla/data/volume-rendering-techniques.pdf
-	//}
-
 	/*
 		TODO: Account for cone of influence of lights (mesh lights and spotlights)
 	*/
-	const Real thetaA = -std::atan2(l, D);	//Angles representing light's subtention of ray segment (might be smaller for spotlights).
-	const Real thetaB = std::atan2(_event.hit->tFar - l, D);
-
-	const Real epsilon = _sampler.Get1D();
-	const Real dist = D * std::tan(maths::Lerp(thetaB, thetaA, epsilon));
-	const Real t = std::min(t, _event.hit->tFar);
+	Real pdf;
+	const Real t = SampleEquiangularT(_ray, _lightPoint, _event.hit->tFar, _sampler.Get1D(), &pdf);
 	*_t = t;
-
+	*_pdf = pdf;
 	_event.mediumInteraction = t < _event.hit->tFar;
 
-	const Vec2 u = _sampler.Get2D();
-	const unsigned channel = std::min((unsigned)(u.x * Spectrum::nSamples), Spectrum::nSamples - 1);
-
-	const Real pdf = D / ((thetaB - thetaA) * (D * D + t * t));
-	*_pdf = pdf;
 	const Spectrum sigmaT = sigmaA + sigmaS;
 	const Spectrum Tr = Spectrum::Exp(-sigmaT * std::min(t, MAX_REAL));
 	return Tr * sigmaS / pdf;
 }
 
 Real HomogeneousMedium::PDFEquiangular(const Ray &_ray, const Vec3 &_lightPoint, const Real _tFar, const Real _t) const {
-	const Vec3 delta = _lightPoint - _ray.o;
-	const Real l = maths::Dot(_ray.d, delta);
-	const Real D = std::sqrt(maths::Dot(delta, delta) - l * l);
 	/*
 		TODO: Account for light cone of influence
 	*/
-	const Real thetaA = -std::atan2(l, D);
-	const Real thetaB = std::atan2(_tFar - l, D);
-
-	const Real pdf = D / ((thetaB - thetaA) * (D * D + _t * _t));
-	return pdf;
+	return EquiangularPdf(_ray, _lightPoint, _tFar, _t);
 }
 
 LAMBDA_END
\ No newline at end of file
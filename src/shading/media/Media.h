@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
 #include <core/Spectrum.h>
 #include "PhaseFunction.h"
 #include "../ScatterEvent.h"
@@ -36,6 +38,33 @@ class Medium {
 			
 		*/
 		virtual Real PDFEquiangular(const Ray &_ray, const Vec3 &_lightPoint, const Real _tFar, const Real _t) const = 0;
+
+	protected:
+		/*
+			Samples t in [0, _tFar] along _ray proportionally to the inverse squared distance to _lightPoint, after:
+				Importance Sampling Techniques for Path Tracing in Participating Media - Kulla & Fajardo
+		*/
+		static inline Real SampleEquiangularT(const Ray &_ray, const Vec3 &_lightPoint, const Real _tFar, const Real _u, Real *_pdf) {
+			const Vec3 delta = _lightPoint - _ray.o;
+			const Real l = maths::Dot(_ray.d, delta);	//Distance along _ray to the point closest to _lightPoint
+			const Real D = std::max(std::sqrt(std::max(maths::Dot(delta, delta) - l * l, (Real)0)), (Real)1e-6);
+			const Real thetaA = std::atan2(-l, D), thetaB = std::atan2(_tFar - l, D);	//Angles the segment's ends subtend from the closest point
+			const Real dist = D * std::tan(maths::Lerp(thetaA, thetaB, _u));
+			*_pdf = D / ((thetaB - thetaA) * (D * D + dist * dist));
+			return std::min(std::max(l + dist, (Real)0), _tFar);
+		}
+
+		/*
+			Pdf of SampleEquiangularT() producing _t.
+		*/
+		static inline Real EquiangularPdf(const Ray &_ray, const Vec3 &_lightPoint, const Real _tFar, const Real _t) {
+			const Vec3 delta = _lightPoint - _ray.o;
+			const Real l = maths::Dot(_ray.d, delta);
+			const Real D = std::max(std::sqrt(std::max(maths::Dot(delta, delta) - l * l, (Real)0)), (Real)1e-6);
+			const Real thetaA = std::atan2(-l, D), thetaB = std::atan2(_tFar - l, D);
+			const Real dist = _t - l;
+			return D / ((thetaB - thetaA) * (D * D + dist * dist));
+		}
 };
 
 class MediaBoundary {
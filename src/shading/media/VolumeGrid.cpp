@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "VolumeGrid.h"
+
+LAMBDA_BEGIN
+
+namespace {
+
+	constexpr char volumeMagic[4] = { 'L', 'V', 'O', 'L' };
+
+	enum VolumeFormat : uint32_t {
+		VOLUME_DENSE = 0,
+		VOLUME_SPARSE = 1
+	};
+
+	struct VolumeHeader {
+		char magic[4];
+		uint32_t format;
+		uint32_t resolution[3];
+		float boundsMin[3], boundsMax[3];
+	};
+
+	constexpr uint64_t maxVoxels = (uint64_t)1 << 34;	//Rejects corrupt headers before allocating
+}
+
+bool VolumeGrid::MajorantIterator::Next(Real *_t0, Real *_t1, Real *_majorant) {
+	if (!grid || t >= tEnd) return false;
+	const unsigned axis = nextT[0] < nextT[1] ? (nextT[0] < nextT[2] ? 0 : 2) : (nextT[1] < nextT[2] ? 1 : 2);
+	const Real tNext = std::min(nextT[axis], tEnd);
+	*_t0 = t;
+	*_t1 = tNext;
+	*_majorant = grid->majorants[grid->CellIndex(cell[0], cell[1], cell[2])];
+	t = tNext;
+	cell[axis] += step[axis];
+	nextT[axis] += deltaT[axis];
+	if (cell[axis] == end[axis]) t = tEnd;
+	return true;
+}
+
+VolumeGrid::VolumeGrid() : resolution{ 0, 0, 0 }, bricks{ 0, 0, 0 }, maxDensity(0), meanDensity(0) {}
+
+void VolumeGrid::Allocate() {
+	size_t numCells = 1;
+	for (unsigned a = 0; a < 3; ++a) {
+		bricks[a] = (resolution[a] + brickSize - 1) / brickSize;
+		numCells *= bricks[a];
+	}
+	brickIndex.assign(numCells, emptyBrick);
+	brickData.clear();
+	majorants.clear();
+	maxDensity = meanDensity = 0;
+}
+
+void VolumeGrid::Build(const unsigned _resolution[3], const float *_density, const Bounds &_bounds) {
+	bounds = _bounds;
+	for (unsigned a = 0; a < 3; ++a) resolution[a] = _resolution[a];
+	Allocate();
+	float brick[brickVoxels];
+	for (unsigned bz = 0; bz < bricks[2]; ++bz) {
+		for (unsigned by = 0; by < bricks[1]; ++by) {
+			for (unsigned bx = 0; bx < bricks[0]; ++bx) {
+				bool empty = true;
+				for (unsigned i = 0; i < brickVoxels; ++i) {
+					const unsigned x = bx * brickSize + i % brickSize, y = by * brickSize + (i / brickSize) % brickSize, z = bz * brickSize + i / (brickSize * brickSize);
+					const bool inside = x < resolution[0] && y < resolution[1] && z < resolution[2];
+					brick[i] = inside ? std::max(_density[((size_t)z * resolution[1] + y) * resolution[0] + x], 0.f) : 0;
+					empty &= brick[i] == 0;
+				}
+				if (empty) continue;
+				brickIndex[CellIndex(bx, by, bz)] = (uint32_t)(brickData.size() / brickVoxels);
+				brickData.insert(brickData.end(), brick, brick + brickVoxels);
+			}
+		}
+	}
+	BuildMajorants();
+}
+
+bool VolumeGrid::Load(const std::string &_path) {
+	std::ifstream file(_path, std::ios::binary);
+	if (!file) {
+		std::cout << std::endl << "Volume file not found: " << _path;
+		return false;
+	}
+	VolumeHeader header;
+	uint64_t numVoxels = 1;
+	file.read((char*)&header, sizeof(header));
+	for (unsigned a = 0; a < 3 && file; ++a) numVoxels *= header.resolution[a];
+	if (!file || std::memcmp(header.magic, volumeMagic, sizeof(volumeMagic)) != 0 || numVoxels == 0 || numVoxels > maxVoxels) {
+		std::cout << std::endl << "Not a volume file: " << _path;
+		return false;
+	}
+	const Bounds fileBounds(Vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]), Vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+
+	if (header.format == VOLUME_DENSE) {
+		std::vector<float> density(numVoxels);
+		file.read((char*)density.data(), numVoxels * sizeof(float));
+		if (!file) {
+			std::cout << std::endl << "Volume file is truncated: " << _path;
+			return false;
+		}
+		Build(header.resolution, density.data(), fileBounds);
+		return true;
+	}
+	if (header.format != VOLUME_SPARSE) {
+		std::cout << std::endl << "Unknown volume format " << header.format << " in " << _path;
+		return false;
+	}
+
+	bounds = fileBounds;
+	for (unsigned a = 0; a < 3; ++a) resolution[a] = header.resolution[a];
+	Allocate();
+	uint32_t numBricks = 0;
+	file.read((char*)&numBricks, sizeof(numBricks));
+	if (!file || numBricks > brickIndex.size()) {
+		std::cout << std::endl << "Volume file has a bad brick count: " << _path;
+		resolution[0] = resolution[1] = resolution[2] = 0;
+		Allocate();
+		return false;
+	}
+	brickData.resize((size_t)numBricks * brickVoxels);
+	for (uint32_t i = 0; i < numBricks; ++i) {
+		uint32_t coords[3];
+		file.read((char*)coords, sizeof(coords));
+		file.read((char*)&brickData[(size_t)i * brickVoxels], brickVoxels * sizeof(float));
+		const bool inside = coords[0] < bricks[0] && coords[1] < bricks[1] && coords[2] < bricks[2];
+		if (!file || !inside || brickIndex[CellIndex(coords[0], coords[1], coords[2])] != emptyBrick) {
+			std::cout << std::endl << "Volume file has a bad brick " << i << ": " << _path;
+			resolution[0] = resolution[1] = resolution[2] = 0;
+			Allocate();
+			return false;
+		}
+		brickIndex[CellIndex(coords[0], coords[1], coords[2])] = i;
+		for (size_t v = (size_t)i * brickVoxels; v < (size_t)(i + 1) * brickVoxels; ++v) brickData[v] = std::max(brickData[v], 0.f);
+	}
+	BuildMajorants();
+	return true;
+}
+
+bool VolumeGrid::Save(const std::string &_path) const {
+	std::ofstream file(_path, std::ios::binary);
+	if (!file) {
+		std::cout << std::endl << "Could not write volume file: " << _path;
+		return false;
+	}
+	VolumeHeader header;
+	std::memcpy(header.magic, volumeMagic, sizeof(volumeMagic));
+	header.format = VOLUME_SPARSE;
+	for (unsigned a = 0; a < 3; ++a) {
+		header.resolution[a] = resolution[a];
+		header.boundsMin[a] = (float)bounds.min[a];
+		header.boundsMax[a] = (float)bounds.max[a];
+	}
+	file.write((const char*)&header, sizeof(header));
+	const uint32_t numBricks = (uint32_t)NumBricks();
+	file.write((const char*)&numBricks, sizeof(numBricks));
+	for (uint32_t bz = 0; bz < bricks[2]; ++bz) {
+		for (uint32_t by = 0; by < bricks[1]; ++by) {
+			for (uint32_t bx = 0; bx < bricks[0]; ++bx) {
+				const uint32_t index = brickIndex[CellIndex(bx, by, bz)];
+				if (index == emptyBrick) continue;
+				const uint32_t coords[3] = { bx, by, bz };
+				file.write((const char*)coords, sizeof(coords));
+				file.write((const char*)&brickData[(size_t)index * brickVoxels], brickVoxels * sizeof(float));
+			}
+		}
+	}
+	return (bool)file;
+}
+
+void VolumeGrid::BuildMajorants() {
+	std::vector<float> brickMax(brickIndex.size(), 0);
+	double total = 0;
+	maxDensity = 0;
+	for (size_t c = 0; c < brickIndex.size(); ++c) {
+		if (brickIndex[c] == emptyBrick) continue;
+		const float *voxels = &brickData[(size_t)brickIndex[c] * brickVoxels];
+		for (unsigned i = 0; i < brickVoxels; ++i) {
+			brickMax[c] = std::max(brickMax[c], voxels[i]);
+			total += voxels[i];
+		}
+		maxDensity = std::max(maxDensity, (Real)brickMax[c]);
+	}
+	const double numVoxels = (double)resolution[0] * resolution[1] * resolution[2];
+	meanDensity = numVoxels > 0 ? (Real)(total / numVoxels) : 0;
+
+	majorants.assign(brickIndex.size(), 0);
+	for (unsigned bz = 0; bz < bricks[2]; ++bz) {
+		for (unsigned by = 0; by < bricks[1]; ++by) {
+			for (unsigned bx = 0; bx < bricks[0]; ++bx) {
+				float m = 0;
+				for (unsigned z = bz ? bz - 1 : 0; z <= std::min(bz + 1, bricks[2] - 1); ++z)
+					for (unsigned y = by ? by - 1 : 0; y <= std::min(by + 1, bricks[1] - 1); ++y)
+						for (unsigned x = bx ? bx - 1 : 0; x <= std::min(bx + 1, bricks[0] - 1); ++x) m = std::max(m, brickMax[CellIndex(x, y, z)]);
+				majorants[CellIndex(bx, by, bz)] = m;
+			}
+		}
+	}
+}
+
+float VolumeGrid::Voxel(const int _x, const int _y, const int _z) const {
+	if (_x < 0 || _y < 0 || _z < 0 || _x >= (int)resolution[0] || _y >= (int)resolution[1] || _z >= (int)resolution[2]) return 0;
+	const uint32_t index = brickIndex[CellIndex(_x / brickSize, _y / brickSize, _z / brickSize)];
+	if (index == emptyBrick) return 0;
+	return brickData[(size_t)index * brickVoxels + ((_z % brickSize) * brickSize + _y % brickSize) * brickSize + _x % brickSize];
+}
+
+Real VolumeGrid::Density(const Vec3 &_p) const {
+	if (brickData.empty() || !bounds.Contains(_p)) return 0;
+	Real g[3];
+	int v[3];
+	for (unsigned a = 0; a < 3; ++a) {
+		g[a] = (_p[a] - bounds.min[a]) / (bounds.max[a] - bounds.min[a]) * resolution[a] - (Real).5;	//Voxel centres are at half integers
+		const Real fl = std::floor(g[a]);
+		v[a] = (int)fl;
+		g[a] -= fl;
+	}
+	const Real d00 = maths::Lerp<Real>(Voxel(v[0], v[1], v[2]), Voxel(v[0] + 1, v[1], v[2]), g[0]);
+	const Real d10 = maths::Lerp<Real>(Voxel(v[0], v[1] + 1, v[2]), Voxel(v[0] + 1, v[1] + 1, v[2]), g[0]);
+	const Real d01 = maths::Lerp<Real>(Voxel(v[0], v[1], v[2] + 1), Voxel(v[0] + 1, v[1], v[2] + 1), g[0]);
+	const Real d11 = maths::Lerp<Real>(Voxel(v[0], v[1] + 1, v[2] + 1), Voxel(v[0] + 1, v[1] + 1, v[2] + 1), g[0]);
+	return maths::Lerp(maths::Lerp(d00, d10, g[1]), maths::Lerp(d01, d11, g[1]), g[2]);
+}
+
+VolumeGrid::MajorantIterator VolumeGrid::Majorants(const Ray &_ray, const Real _tMax) const {
+	MajorantIterator it;
+	it.t = 0;
+	it.tEnd = 0;
+	if (brickData.empty()) return it;
+	Real t0 = 0, t1 = _tMax;
+	for (unsigned a = 0; a < 3; ++a) {	//Clip the ray to the grid's box
+		if (_ray.d[a] == 0) {
+			if (_ray.o[a] < bounds.min[a] || _ray.o[a] > bounds.max[a]) return it;
+			continue;
+		}
+		const Real inv = 1 / _ray.d[a];
+		Real tNear = (bounds.min[a] - _ray.o[a]) * inv, tFar = (bounds.max[a] - _ray.o[a]) * inv;
+		if (tNear > tFar) std::swap(tNear, tFar);
+		t0 = std::max(t0, tNear);
+		t1 = std::min(t1, tFar);
+	}
+	if (t0 >= t1) return it;
+
+	it.grid = this;
+	it.t = t0;
+	it.tEnd = t1;
+	const Vec3 p = _ray.o + _ray.d * t0;
+	for (unsigned a = 0; a < 3; ++a) {
+		const Real cellSize = (bounds.max[a] - bounds.min[a]) * brickSize / resolution[a];
+		it.cell[a] = std::min(std::max((int)std::floor((p[a] - bounds.min[a]) / cellSize), 0), (int)bricks[a] - 1);
+		if (_ray.d[a] > 0) {
+			it.step[a] = 1;
+			it.end[a] = bricks[a];
+			it.nextT[a] = t0 + (bounds.min[a] + (it.cell[a] + 1) * cellSize - p[a]) / _ray.d[a];
+			it.deltaT[a] = cellSize / _ray.d[a];
+		}
+		else if (_ray.d[a] < 0) {
+			it.step[a] = -1;
+			it.end[a] = -1;
+			it.nextT[a] = t0 + (bounds.min[a] + it.cell[a] * cellSize - p[a]) / _ray.d[a];
+			it.deltaT[a] = -cellSize / _ray.d[a];
+		}
+		else {
+			it.step[a] = 0;
+			it.end[a] = -1;
+			it.nextT[a] = MAX_REAL;
+			it.deltaT[a] = 0;
+		}
+	}
+	return it;
+}
+
+LAMBDA_END
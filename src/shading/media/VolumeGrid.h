@@ -0,0 +1,126 @@
+/*
+	Sparse voxel densities over a box in world space, for heterogeneous media.
+	- Voxels are grouped into bricks of brickSize^3. Bricks whose voxels are all zero aren't
+	stored, so empty space in clouds and smoke costs one index per brick.
+	- Every brick cell also keeps a majorant, a bound on the density anywhere the trilinear
+	filter can reach inside it. Tracking steps through these cells with a DDA, so thin regions
+	take long steps and empty cells are skipped outright.
+	- Volume files (.lvol) are little endian:
+		char magic[4] = "LVOL", uint32 format (0 = dense, 1 = sparse), uint32 resolution[3],
+		float boundsMin[3], float boundsMax[3], then
+		dense: resolution[0] * resolution[1] * resolution[2] floats, x fastest
+		sparse: uint32 numBricks, then per brick uint32 brick[3] and brickSize^3 floats, x fastest
+*/
+#pragma once
+#include <string>
+#include <vector>
+#include <Lambda.h>
+#include <maths/maths.h>
+#include <core/Ray.h>
+
+LAMBDA_BEGIN
+
+class VolumeGrid {
+	public:
+		static constexpr unsigned brickSize = 8;
+		static constexpr unsigned brickVoxels = brickSize * brickSize * brickSize;
+
+		/*
+			Steps along a ray through the brick cells it crosses, front to back.
+		*/
+		class MajorantIterator {
+			public:
+				/*
+					Next segment [_t0, _t1) of the ray and the majorant density over it. Returns
+					false once the ray has left the grid or passed its end.
+				*/
+				bool Next(Real *_t0, Real *_t1, Real *_majorant);
+
+			private:
+				friend class VolumeGrid;
+
+				const VolumeGrid *grid = nullptr;
+				Real t, tEnd;
+				Real nextT[3], deltaT[3];
+				int cell[3], step[3], end[3];
+		};
+
+		VolumeGrid();
+
+		/*
+			Builds the grid from dense densities of _resolution voxels spanning _bounds, x fastest.
+		*/
+		void Build(const unsigned _resolution[3], const float *_density, const Bounds &_bounds);
+
+		/*
+			Reads a dense or sparse volume file. Returns false and leaves the grid empty on failure.
+		*/
+		bool Load(const std::string &_path);
+
+		/*
+			Writes the grid as a sparse volume file.
+		*/
+		bool Save(const std::string &_path) const;
+
+		/*
+			Trilinearly filtered density at world point _p, 0 outside the grid.
+		*/
+		Real Density(const Vec3 &_p) const;
+
+		/*
+			Iterates the majorants along _ray from t = 0 to _tMax. _ray's direction must be normalised
+			for t to be a distance.
+		*/
+		MajorantIterator Majorants(const Ray &_ray, const Real _tMax) const;
+
+		inline const Bounds &GetBounds() const {
+			return bounds;
+		}
+
+		inline Real MaxDensity() const {
+			return maxDensity;
+		}
+
+		/*
+			Density averaged over the whole box, empty bricks included.
+		*/
+		inline Real MeanDensity() const {
+			return meanDensity;
+		}
+
+		inline size_t NumBricks() const {
+			return brickData.size() / brickVoxels;
+		}
+
+	private:
+		static constexpr uint32_t emptyBrick = ~0u;
+
+		Bounds bounds;
+		unsigned resolution[3], bricks[3];
+		std::vector<uint32_t> brickIndex;	//Per brick cell, into brickData in units of bricks, or emptyBrick
+		std::vector<float> brickData;
+		std::vector<float> majorants;	//Per brick cell
+		Real maxDensity, meanDensity;
+
+		inline size_t CellIndex(const unsigned _x, const unsigned _y, const unsigned _z) const {
+			return ((size_t)_z * bricks[1] + _y) * bricks[0] + _x;
+		}
+
+		/*
+			Unfiltered density of voxel (_x, _y, _z), 0 outside the grid.
+		*/
+		float Voxel(const int _x, const int _y, const int _z) const;
+
+		/*
+			Sizes the brick cells for the current resolution, all empty.
+		*/
+		void Allocate();
+
+		/*
+			Bounds every cell by the largest voxel of itself and its neighbours, as the filter reads
+			one voxel into them, and totals the mean density.
+		*/
+		void BuildMajorants();
+};
+
+LAMBDA_END
@@ -4,6 +4,10 @@ LAMBDA_BEGIN
 
 BxDF::BxDF(const BxDFType _type) : type(_type) {}
 
+void BxDF::fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const {
+	for (unsigned i = 0; i < _n; ++i) _out[i] = f(*_events[i]);
+}
+
 Spectrum BxDF::Sample_f(ScatterEvent &_event, Sampler &_sampler, Real &_pdf) const {
 	_event.wiL = Sampling::SampleCosineHemisphere(_sampler.Get2D());
 	if (_event.woL.y < 0) _event.wiL.y *= -1;
@@ -31,6 +35,11 @@ Spectrum LambertianBRDF::f(const ScatterEvent &_event) const {
 	return albedoSocket->GetAsSpectrum(_event) * INV_PI;
 }
 
+void LambertianBRDF::fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const {
+	albedoSocket->GetAsSpectrumBatch(_events, _n, _out);
+	for (unsigned i = 0; i < _n; ++i) _out[i] *= INV_PI;
+}
+
 Spectrum LambertianBRDF::Rho(const ScatterEvent &_event, const unsigned _nSample, Vec2 *_smpls) const {
 	return albedoSocket->GetAsSpectrum(_event);
 }
@@ -48,6 +57,15 @@ Spectrum MixBSDF::f(const ScatterEvent &_event) const {
 	return aSocket->GetAs<BxDF *>(_event)->f(_event) * ((Real)1 - ratio) + bSocket->GetAs<BxDF *>(_event)->f(_event) * ratio;
 }
 
+void MixBSDF::fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const {
+	Real ratio[ShaderGraph::SHADER_BATCH_SIZE];
+	Spectrum bf[ShaderGraph::SHADER_BATCH_SIZE];
+	ratioSocket->GetBatch(_events, _n, ShaderGraph::SocketType::TYPE_SCALAR, ratio);
+	aSocket->GetAs<BxDF *>(*_events[0])->fBatch(_events, _n, _out);	//Bxdf sockets don't depend on the event
+	bSocket->GetAs<BxDF *>(*_events[0])->fBatch(_events, _n, bf);
+	for (unsigned i = 0; i < _n; ++i) _out[i] = _out[i] * ((Real)1 - ratio[i]) + bf[i] * ratio[i];
+}
+
 Spectrum MixBSDF::Sample_f(ScatterEvent &_event, Sampler &_sampler, Real &_pdf) const {
 	const Real ratio = ratioSocket->GetAs<Real>(_event);
 	if (_sampler.Get1D() > ratio) {
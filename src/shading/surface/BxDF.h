@@ -28,6 +28,12 @@ class BxDF {
 		*/
 		virtual Spectrum f(const ScatterEvent &_event) const = 0;
 
+		/*
+			f() for up to ShaderGraph::SHADER_BATCH_SIZE events at once, so shader inputs can be
+			evaluated across the batch. The default calls f() once per event.
+		*/
+		virtual void fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const;
+
 		/*
 			Samples a scattering direction, storing it in _event->wiL and _event->wi and returns the respective bxdf
 			for this direction.
@@ -61,6 +67,8 @@ class LambertianBRDF : public BxDF {
 
 		Spectrum f(const ScatterEvent &_event) const override;
 
+		void fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const override;
+
 		Spectrum Rho(const ScatterEvent &_event, const unsigned _nSample, Vec2 *_smpls) const override;
 };
 
@@ -74,6 +82,8 @@ class MixBSDF : public BxDF {
 
 		Spectrum f(const ScatterEvent &_event) const override;
 
+		void fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const override;
+
 		Spectrum Sample_f(ScatterEvent &_event, Sampler &_sampler, Real &_pdf) const override;
 
 		Real Pdf(const Vec3 &_wo, const Vec3 &_wi, const ScatterEvent &_event) const override;
@@ -26,6 +26,13 @@ Spectrum OrenNayarBRDF::f(const ScatterEvent &_event) const {
 	return albedoSpec * INV_PI * oN;
 }
 
+void OrenNayarBRDF::fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const {
+	Real sigma[ShaderGraph::SHADER_BATCH_SIZE];
+	sigmaSocket->GetBatch(_events, _n, ShaderGraph::SocketType::TYPE_SCALAR, sigma);
+	albedoSocket->GetAsSpectrumBatch(_events, _n, _out);
+	for (unsigned i = 0; i < _n; ++i) _out[i] *= INV_PI * OrenNayarTerm(*_events[i], sigma[i]);
+}
+
 //Spectrum OrenNayarBRDF::Sample_f(ScatterEvent &_event, Sampler &_sampler, Real &_pdf) const {
 //	_event.wiL = Sampling::SampleCosineHemisphere(_sampler.Get2D());
 //	const bool isInside = _event.woL.y < 0;
@@ -11,6 +11,8 @@ class OrenNayarBRDF : public BxDF {
 
 		Spectrum f(const ScatterEvent &_event) const override;
 
+		void fBatch(const ScatterEvent *const *_events, const unsigned _n, Spectrum *_out) const override;
+
 		//Spectrum Sample_f(ScatterEvent &_event, Sampler &_sampler, Real &_pdf) const override;
 };
 
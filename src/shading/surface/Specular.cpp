@@ -18,7 +18,16 @@ static inline Vec3 FaceForward(const Vec3 &_n, const Vec3 &_v) {
 Spectrum FresnelBSDF::Sample_f(ScatterEvent &_event, Sampler &_sampler, Real &_pdf) const {
 	const bool entering = _event.woL.y > 0;
 
-	const Real ior = iorSocket->GetAs<Real>(_event);
+	Real ior = iorSocket->GetAs<Real>(_event);
+	Spectrum dispersionWeight(1);
+	if (dispersion > 0 && _event.wavelength) {	//Wavelength dependent IOR, the path carries the wavelength's colour from here on
+		const Real l = _event.wavelength->lambda * (Real)1e-3;
+		ior += dispersion * ((Real)1 / (l * l) - (Real)1 / ((Real).5893 * (Real).5893));
+		if (!_event.wavelength->resolved) {
+			dispersionWeight = _event.wavelength->Weight();
+			_event.wavelength->resolved = true;
+		}
+	}
 	
 	const Real fr = Fresnel::FrDielectric(_event.woL.y, 1, ior);
 	if (_sampler.Get1D() < fr) {
@@ -27,14 +36,14 @@ Spectrum FresnelBSDF::Sample_f(ScatterEvent &_event, Sampler &_sampler, Real &_p
 		const Real cosTheta = std::abs(_event.wiL.y);
 		_event.hit->point += _event.hit->normalG * (entering ? SURFACE_EPSILON : -SURFACE_EPSILON);
 		_pdf = fr;
-		return albedoSocket->GetAsSpectrum(_event) * fr / cosTheta;
+		return albedoSocket->GetAsSpectrum(_event) * dispersionWeight * fr / cosTheta;
 	}
 	else {
 		const Real etaI = _event.eta = entering ? 1 : ior;
 		const Real etaT = entering ? ior : 1;
 		const bool refract = Refract(_event.woL, FaceForward(Vec3(0, 1, 0), _event.woL), etaI / etaT, &_event.wiL);
 		if (!refract) return 0;
-		Spectrum ft = albedoSocket->GetAsSpectrum(_event) * (1 - fr);
+		Spectrum ft = albedoSocket->GetAsSpectrum(_event) * dispersionWeight * (1 - fr);
 		if (refract) ft *= (etaI * etaI) / (etaT * etaT);
 		const Real cosTheta = std::abs(_event.wiL.y);
 		_event.wi = _event.ToWorld(_event.wiL);
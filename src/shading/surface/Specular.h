@@ -7,6 +7,7 @@ LAMBDA_BEGIN
 class FresnelBSDF : public BxDF {
 	public:
 		ShaderGraph::SocketRef *albedoSocket, *iorSocket;
+		Real dispersion = 0;	//Cauchy B coefficient in um^2, only applies with spectralDispersion. IOR is taken at 589.3nm.
 
 		FresnelBSDF(ShaderGraph::SocketRef *_albedoSocket, ShaderGraph::SocketRef *_iorSocket);
 
@@ -1,42 +1,125 @@
 #pragma once
+#include <algorithm>
 #include "Concurrency.h"
 
-void ThreadPool::RunWorker() {
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local unsigned current_worker = 0;
+
+void Task::Release() {
+	if (--pending == 0) {
+		std::shared_ptr<Task> task = std::move(parked);
+		pool->Schedule(std::move(task));
+	}
+}
+
+void Task::Cancel() {
+	const std::shared_ptr<Task> self = std::move(parked);	//Keeps the task alive until it is done cancelling
+	std::vector<Task *> released;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (is_done) return;
+		is_cancelled = true;
+		is_done = true;
+		released.swap(successors);
+	}
+	wait_condition.notify_all();
+	for (Task *successor : released) successor->Cancel();
+}
+
+void Task::operator()() {
+	impl->Call();
+	std::vector<Task *> released;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_done = true;
+		released.swap(successors);
+	}
+	wait_condition.notify_all();
+	for (Task *successor : released) successor->Release();
+}
+
+void ThreadPool::RunWorker(const unsigned _index) {
+	current_pool = this;
+	current_worker = _index;
 	while (!done) {
 		std::shared_ptr<Task> task;
-		work_queue.WaitToPop(task);
-		if (!done) {
+		if (TryGetTask(_index, task)) {
 			task->operator()();
+			continue;
 		}
-		else {
-			Enqueue(task);
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleep_condition.wait(lock, [this]() {
+			return num_queued > 0 || done;
+		});
+	}
+}
+
+bool ThreadPool::TryGetTask(const unsigned _index, std::shared_ptr<Task> &_task) {
+	if (work_queues[_index]->TryPop(_task)) {
+		--num_queued;
+		return true;
+	}
+	for (unsigned i = 1; i < num_threads; ++i) {
+		if (work_queues[(_index + i) % num_threads]->TrySteal(_task)) {
+			--num_queued;
+			return true;
 		}
 	}
+	return false;
+}
+
+void ThreadPool::Schedule(std::shared_ptr<Task> _task) {
+	const unsigned i = current_pool == this ? current_worker : next_queue++ % num_threads;
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);	//Prevents a worker missing the wake-up between its check and its wait
+		work_queues[i]->Push(std::move(_task));
+		++num_queued;
+	}
+	sleep_condition.notify_one();
 }
 
 ThreadPool::ThreadPool(unsigned _num_threads) {
 	done = false;
+	num_queued = 0;
+	next_queue = 0;
 	if (_num_threads == 0) {
 		_num_threads = std::thread::hardware_concurrency();
 	}
+	if (_num_threads == 0) _num_threads = 1;
+	num_threads = _num_threads;
+	work_queues.reserve(_num_threads);
+	for (unsigned i = 0; i < _num_threads; ++i) {
+		work_queues.emplace_back(new WorkStealingQueue<std::shared_ptr<Task>>);
+	}
 	try {
 		threads.reserve(_num_threads);
 		for (unsigned i = 0; i < _num_threads; ++i) {
-			threads.push_back(std::thread(&ThreadPool::RunWorker, this));
+			threads.push_back(std::thread(&ThreadPool::RunWorker, this, i));
 		}
 	}
 	catch (...) {
-		done = true;
+		SignalDone();
+		for (auto &thread : threads) thread.join();
 		throw;
 	}
 }
 
 void ThreadPool::Enqueue(std::shared_ptr<Task> &_task) {
-	work_queue.Push(_task);
+	_task->pool = this;
+	_task->parked = _task;
+	_task->Release();	//Drops the enqueue hold, schedules now if there are no unfinished predecessors
+}
+
+void ThreadPool::SignalDone() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		done = true;
+	}
+	sleep_condition.notify_all();
 }
 
 void ThreadPool::Abort() {
-	done = true;
+	SignalDone();
 }
 
 void ThreadPool::Start() {
@@ -44,6 +127,27 @@ void ThreadPool::Start() {
 }
 
 ThreadPool::~ThreadPool() {
-	done = true;
-	for (auto &thread : threads) thread.join();
+	SignalDone();
+	for (auto &thread : threads) if (thread.joinable()) thread.join();
+	threads.clear();
+	//Tasks still queued never ran, cancel them so nothing waiting on them hangs
+	std::shared_ptr<Task> task;
+	for (auto &queue : work_queues) {
+		while (queue->TryPop(task)) {
+			--num_queued;
+			task->Cancel();
+			task.reset();
+		}
+	}
+}
+
+void ParallelChunks(ThreadPool &_pool, const size_t _count, const size_t _chunkSize, const std::function<void(size_t, size_t, size_t)> &_func) {
+	std::vector<std::shared_ptr<Task>> tasks;
+	for (size_t chunk = 0, begin = 0; begin < _count; ++chunk, begin += _chunkSize) {
+		const size_t end = std::min(_count, begin + _chunkSize);
+		std::function<void()> func = [&_func, chunk, begin, end]() { _func(chunk, begin, end); };
+		tasks.emplace_back(Task::MakeTask<void>(func));
+		_pool.Enqueue(tasks.back());
+	}
+	for (const auto &task : tasks) task->Wait();
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <functional>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <memory>
 #include "Delegate.h"
 
 template<class T>
@@ -47,7 +49,55 @@ class ThreadsafeQueue {
 		}
 };
 
-class Task {
+/*
+	Per-worker deque for work stealing. The owning worker pushes and pops at the back
+	while other workers steal from the front, so the lock is rarely contended.
+*/
+template<class T>
+class WorkStealingQueue {
+	private:
+		mutable std::mutex mutex;
+		std::deque<T> queue;
+
+	public:
+		WorkStealingQueue() {}
+
+		void Push(T _val) {
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(_val));
+		}
+
+		bool TryPop(T &_val) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queue.empty()) return false;
+			_val = std::move(queue.back());
+			queue.pop_back();
+			return true;
+		}
+
+		bool TrySteal(T &_val) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queue.empty()) return false;
+			_val = std::move(queue.front());
+			queue.pop_front();
+			return true;
+		}
+
+		bool Empty() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return queue.empty();
+		}
+};
+
+class ThreadPool;
+
+/*
+	Dependencies are counted rather than waited on: a task enqueued with unfinished
+	predecessors is parked and handed to the pool by whichever predecessor finishes last,
+	so it never occupies a worker while waiting.
+	- WaitFor() must be called before the task is enqueued.
+*/
+class Task : public std::enable_shared_from_this<Task> {
 	private:
 		struct ImplBase {
 			virtual void Call() = 0;
@@ -68,16 +118,35 @@ class Task {
 			}
 		};
 
+		friend class ThreadPool;
+
 		std::unique_ptr<ImplBase> impl;
-		std::vector<const Task *> wait_for;
+		mutable std::vector<Task *> successors;
 		mutable std::mutex mutex;
 		mutable std::condition_variable wait_condition;
 		std::atomic<bool> is_done;
+		std::atomic<bool> is_cancelled;	//Finished without running because its pool shut down
+		std::atomic<unsigned> pending;	//Unfinished predecessors, +1 until enqueued
+		std::shared_ptr<Task> parked;	//Keeps the task alive while it waits on predecessors
+		ThreadPool *pool;
+
+		/*
+			Called by a finishing predecessor. Schedules the task if it was the last one.
+		*/
+		void Release();
+
+		/*
+			Marks the task and everything waiting on it done without running them, so Wait() returns.
+		*/
+		void Cancel();
 
 	public:
 		Task() {
 			impl = nullptr;
 			is_done = true;
+			is_cancelled = false;
+			pending = 1;
+			pool = nullptr;
 		}
 
 		template<class Ret, typename... params>
@@ -96,37 +165,59 @@ class Task {
 			});
 		}
 
+		/*
+			Makes this task runnable only after _task has finished.
+		*/
 		void WaitFor(const Task &_task) {
-			std::lock_guard<std::mutex> lock(mutex);
-			wait_for.push_back(&_task);
+			std::lock_guard<std::mutex> lock(_task.mutex);
+			if (_task.is_done) return;
+			++pending;
+			_task.successors.push_back(this);
 		}
 
-		void operator()() {
-			{
-				std::lock_guard<std::mutex> lock(mutex);
-				const unsigned s = wait_for.size();
-				for (unsigned i = 0; i < s; ++i) {
-					wait_for[i]->Wait();
-				}
-				impl->Call();
-				is_done = true;
-			}
-			wait_condition.notify_all();
-		}
+		void operator()();
 
 		bool IsDone() const {
 			return static_cast<bool>(is_done);
 		}
+
+		bool IsCancelled() const {
+			return static_cast<bool>(is_cancelled);
+		}
 };
 
+/*
+	Work-stealing thread pool. Each worker owns a deque; tasks enqueued from a worker go
+	to its own deque, tasks enqueued from outside are distributed round-robin. Idle
+	workers steal from the others before sleeping.
+*/
 class ThreadPool {
 	private:
 		std::vector<std::thread> threads;
-		ThreadsafeQueue<std::shared_ptr<Task>> work_queue;
+		std::vector<std::unique_ptr<WorkStealingQueue<std::shared_ptr<Task>>>> work_queues;
 		std::atomic<bool> done;
+		std::atomic<unsigned> num_queued;
+		std::atomic<unsigned> next_queue;
+		std::mutex sleep_mutex;
+		std::condition_variable sleep_condition;
 		unsigned num_threads;
 
-		void RunWorker();
+		friend class Task;
+
+		void RunWorker(const unsigned _index);
+
+		/*
+			Pushes a runnable task onto a worker deque and wakes a sleeping worker.
+		*/
+		void Schedule(std::shared_ptr<Task> _task);
+
+		bool TryGetTask(const unsigned _index, std::shared_ptr<Task> &_task);
+
+		/*
+			Wakes every worker to exit. done is set under sleep_mutex so no worker can check it and
+			then sleep through the notify.
+		*/
+		void SignalDone();
 
 	public:
 		/* 0 = hardware threads */
@@ -139,4 +230,10 @@ class ThreadPool {
 		void Start();
 
 		~ThreadPool();
-};
\ No newline at end of file
+};
+
+/*
+	Runs _func(chunk, begin, end) over [0, _count) in chunks of _chunkSize on _pool and waits for
+	all of them. Blocks, so only call it from outside the pool.
+*/
+void ParallelChunks(ThreadPool &_pool, const size_t _count, const size_t _chunkSize, const std::function<void(size_t, size_t, size_t)> &_func);
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "FileStamp.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+bool FileStamp::Read(const std::string &_path) {
+	size = modified = 0;
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(_path.c_str(), GetFileExInfoStandard, &attributes)) return false;
+	size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	modified = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+#else
+bool FileStamp::Read(const std::string &_path) {
+	size = modified = 0;
+	struct stat info;
+	if (stat(_path.c_str(), &info) != 0) return false;
+	size = (uint64_t)info.st_size;
+#ifdef __APPLE__
+	modified = (uint64_t)info.st_mtimespec.tv_sec * 1000000000ull + (uint64_t)info.st_mtimespec.tv_nsec;
+#else
+	modified = (uint64_t)info.st_mtim.tv_sec * 1000000000ull + (uint64_t)info.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/*
+	Size and last write time of a file, for telling whether a file derived from it is stale.
+*/
+struct FileStamp {
+	uint64_t size = 0;
+	uint64_t modified = 0;	//Platform specific units, only ever compared for equality
+
+	/*
+		Reads the stamp of _path. Returns false and leaves the stamp zeroed if it can't be read.
+	*/
+	bool Read(const std::string &_path);
+
+	inline bool IsValid() const { return size > 0; }
+
+	inline bool operator==(const FileStamp &_s) const { return size == _s.size && modified == _s.modified; }
+
+	inline bool operator!=(const FileStamp &_s) const { return !(*this == _s); }
+};
@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+	data = nullptr;
+	size = 0;
+#ifdef _WIN32
+	file = mapping = nullptr;
+#else
+	file = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string &_path) {
+	Close();
+	file = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (mapping) data = (char *)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (!data) {
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	data = nullptr;
+	mapping = file = nullptr;
+	size = 0;
+}
+#else
+bool MappedFile::Open(const std::string &_path) {
+	Close();
+	file = open(_path.c_str(), O_RDONLY);
+	if (file < 0) return false;
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		Close();
+		return false;
+	}
+	void *view = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	data = (char *)view;
+	size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) munmap(data, size);
+	if (file >= 0) close(file);
+	data = nullptr;
+	file = -1;
+	size = 0;
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/*
+	Read-only view of a whole file mapped into memory. Pages are copy-on-write, so the view can
+	be handed out as mutable buffers without the file ever being written.
+*/
+class MappedFile {
+	private:
+		char *data;
+		size_t size;
+	#ifdef _WIN32
+		void *file, *mapping;
+	#else
+		int file;
+	#endif
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+	public:
+		MappedFile();
+
+		~MappedFile();
+
+		/*
+			Maps _path, closing any file already mapped. Returns false if it can't be opened or is empty.
+		*/
+		bool Open(const std::string &_path);
+
+		void Close();
+
+		inline char *Data() const { return data; }
+
+		inline size_t Size() const { return size; }
+
+		inline bool IsOpen() const { return data != nullptr; }
+};
@@ -0,0 +1,83 @@
+#include <cmath>
+#include <iostream>
+#include <lighting/ManyLightSampler.h>
+
+LAMBDA_BEGIN
+
+/*
+	Checks that choosing a split leaves the buckets it was given untouched, so running FindSplit()
+	twice on the same buckets picks the same split with the same cones.
+*/
+class ManyLightSamplerTest {
+	public:
+		static bool SameCone(const ManyLightSampler::OrientationCone &_a, const ManyLightSampler::OrientationCone &_b) {
+			return _a.axis == _b.axis && _a.thetaO == _b.thetaO && _a.thetaE == _b.thetaE;
+		}
+
+		static bool FindSplitIsRepeatable() {
+			using Bucket = ManyLightSampler::Bucket;
+			constexpr unsigned numBuckets = ManyLightSampler::numBuckets;
+			ManyLightSampler::LightNode node = {};
+			Bucket buckets[3][numBuckets], all;
+
+			//Lights along a line with directions turning around it, so bucket cones have different widths
+			std::vector<ManyLightSampler::BuildLight> lights(64);
+			for (unsigned i = 0; i < lights.size(); ++i) {
+				const Real t = (Real)i / lights.size();
+				const Vec3 p(t * 10, std::sin(t * 7) * 3, std::cos(t * 5) * 2);
+				lights[i].bounds = Bounds(p - Vec3(.1, .1, .1), p + Vec3(.1, .1, .1));
+				lights[i].centre = p;
+				lights[i].direction = Vec3(std::cos(t * PI2), std::sin(t * PI2), i % 3 == 0 ? (Real)-1 : (Real)1).Normalised();
+				lights[i].power = 1 + (i % 5);
+				lights[i].light = nullptr;
+				all.Add(lights[i]);
+			}
+			node.numLights = all.numLights;
+			node.bounds = all.bounds;
+			node.orientationCone = all.cone;
+			node.totalPower = all.totalPower;
+			for (const ManyLightSampler::BuildLight &light : lights) {
+				for (unsigned a = 0; a < 3; ++a) buckets[a][ManyLightSampler::BucketIndex(node.bounds, light.centre, a)].Add(light);
+			}
+			Bucket before[3][numBuckets];
+			for (unsigned a = 0; a < 3; ++a)
+				for (unsigned b = 0; b < numBuckets; ++b) before[a][b] = buckets[a][b];
+
+			Real cost[2] = { INFINITY, INFINITY };
+			unsigned axis[2] = {}, index[2] = {};
+			Bucket left[2], right[2];
+			for (unsigned run = 0; run < 2; ++run) {
+				if (!ManyLightSampler::FindSplit(&node, buckets, &cost[run], &axis[run], &index[run], &left[run], &right[run])) {
+					std::cout << std::endl << "No split found.";
+					return false;
+				}
+			}
+
+			bool ok = true;
+			for (unsigned a = 0; a < 3; ++a) {
+				for (unsigned b = 0; b < numBuckets; ++b) {
+					if (!SameCone(before[a][b].cone, buckets[a][b].cone)) {
+						std::cout << std::endl << "FindSplit() changed the cone of bucket " << b << " on axis " << a << ".";
+						ok = false;
+					}
+				}
+			}
+			if (cost[0] != cost[1] || axis[0] != axis[1] || index[0] != index[1]) {
+				std::cout << std::endl << "FindSplit() chose axis " << axis[0] << " bucket " << index[0] << " then axis " << axis[1] << " bucket " << index[1] << ".";
+				ok = false;
+			}
+			if (!SameCone(left[0].cone, left[1].cone) || !SameCone(right[0].cone, right[1].cone)) {
+				std::cout << std::endl << "FindSplit() returned different child cones.";
+				ok = false;
+			}
+			return ok;
+		}
+};
+
+LAMBDA_END
+
+int main() {
+	const bool ok = lambda::ManyLightSamplerTest::FindSplitIsRepeatable();
+	std::cout << std::endl << (ok ? "Passed." : "Failed.") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+	Times the SIMD kernels in maths/simd.h against the inlined loops CoefficientSpectrum uses
+	otherwise, for RGB and 32 sample spectra, and the SSE vec3<float> Dot and Cross against their
+	scalar form. Also checks that every Exp kernel passes NaN through.
+	g++ -O2 -std=c++17 -I../../src main.cpp ../../src/maths/simd.cpp
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <Lambda.h>
+#include <core/Spectrum.h>
+#include <maths/vec3.h>
+
+using namespace lambda;
+using namespace maths::simd;
+
+static volatile float sink;
+
+/*
+	Best of five runs of _f, in ns per call of the body when it runs _calls times.
+*/
+template<class F>
+static double Time(const size_t _calls, F _f) {
+	double best = 1e30;
+	for (unsigned run = 0; run < 5; ++run) {
+		const auto start = std::chrono::steady_clock::now();
+		_f();
+		best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best / _calls;
+}
+
+/*
+	One row per operation: the inlined loop, CoefficientSpectrum as built, then each kernel table
+	the CPU supports.
+*/
+template<unsigned N>
+static void SpectrumBench() {
+	typedef CoefficientSpectrum<N> S;
+	//Few enough spectra to stay in cache, so the loops aren't bound by memory bandwidth
+	const size_t count = 256, reps = (1 << 20) / (count * N), calls = count * reps;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> uniform(-2, 2);
+	std::vector<S> a(count), b(count), out(count);
+	for (size_t i = 0; i < count; ++i) {
+		for (unsigned j = 0; j < N; ++j) {
+			a[i][j] = uniform(rng);
+			b[i][j] = std::abs(uniform(rng)) + .1f;
+		}
+	}
+	std::vector<ISA> isas = { ISA::SCALAR };
+	for (const ISA isa : { ISA::SSE4, ISA::AVX2, ISA::AVX512 })
+		if (GetKernels(isa).isa == isa) isas.push_back(isa);
+
+	printf("\n%u samples, ns per spectrum     inline   Spectrum", N);
+	for (const ISA isa : isas) printf(" %10s", ISAName(isa));
+
+	printf("\n  mul");
+	printf("%27.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) for (unsigned j = 0; j < N; ++j) out[i][j] = a[i][j] * b[i][j]; }));
+	printf(" %10.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) out[i] = a[i] * b[i]; }));
+	for (const ISA isa : isas) {
+		const Kernels &k = GetKernels(isa);
+		printf(" %10.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) k.mul(&a[i][0], &b[i][0], &out[i][0], N); }));
+	}
+
+	printf("\n  exp");
+	printf("%27.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) for (unsigned j = 0; j < N; ++j) out[i][j] = std::exp(a[i][j]); }));
+	printf(" %10.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) out[i] = S::Exp(a[i]); }));
+	for (const ISA isa : isas) {
+		const Kernels &k = GetKernels(isa);
+		printf(" %10.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) k.exp(&a[i][0], &out[i][0], N); }));
+	}
+
+	printf("\n  sqrt");
+	printf("%26.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) for (unsigned j = 0; j < N; ++j) out[i][j] = std::sqrt(b[i][j]); }));
+	printf(" %10.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) out[i] = S::Sqrt(b[i]); }));
+	for (const ISA isa : isas) {
+		const Kernels &k = GetKernels(isa);
+		printf(" %10.2f", Time(calls, [&]() { for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) k.sqrt(&b[i][0], &out[i][0], N); }));
+	}
+
+	printf("\n  dot");
+	printf("%27.2f", Time(calls, [&]() {
+		float sum = 0;
+		for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) for (unsigned j = 0; j < N; ++j) sum += a[i][j] * b[i][j];
+		sink = sum;
+	}));
+	printf(" %10s", "-");
+	for (const ISA isa : isas) {
+		const Kernels &k = GetKernels(isa);
+		printf(" %10.2f", Time(calls, [&]() { float sum = 0; for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) sum += k.dot(&a[i][0], &b[i][0], N); sink = sum; }));
+	}
+
+	printf("\n  isBlack");
+	printf("%23.2f", Time(calls, [&]() {
+		unsigned black = 0;
+		for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) {
+			bool zero = true;
+			for (unsigned j = 0; j < N; ++j) zero &= b[i][j] == 0;
+			black += zero;
+		}
+		sink = (float)black;
+	}));
+	printf(" %10.2f", Time(calls, [&]() { unsigned black = 0; for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) black += b[i].IsBlack(); sink = (float)black; }));
+	for (const ISA isa : isas) {
+		const Kernels &k = GetKernels(isa);
+		printf(" %10.2f", Time(calls, [&]() { unsigned black = 0; for (size_t r = 0; r < reps; ++r) for (size_t i = 0; i < count; ++i) black += k.isBlack(&b[i][0], N); sink = (float)black; }));
+	}
+	printf("\n");
+}
+
+/*
+	Every Exp kernel must return NaN for NaN, including in the short tail of an RGB spectrum.
+*/
+static bool ExpPassesNaN() {
+	bool ok = true;
+	for (const ISA isa : { ISA::SCALAR, ISA::SSE4, ISA::AVX2, ISA::AVX512 }) {
+		const Kernels &k = GetKernels(isa);
+		if (k.isa != isa) continue;
+		for (const unsigned n : { 3u, 4u, 19u, 32u }) {
+			std::vector<float> in(n, 1.f), out(n);
+			in[n - 1] = NAN;
+			in[0] = -INFINITY;
+			k.exp(&in[0], &out[0], n);
+			if (!std::isnan(out[n - 1]) || out[0] != 0 || std::abs(out[1] - std::exp(1.f)) > 1e-6f) {
+				printf("\n%s exp of %u floats: %g %g %g", ISAName(isa), n, out[0], out[1], out[n - 1]);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+static inline float ScalarDot(const vec3<float> &_a, const vec3<float> &_b) {
+	return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z;
+}
+
+static inline vec3<float> ScalarCross(const vec3<float> &_a, const vec3<float> &_b) {
+	return vec3<float>(_a.y * _b.z - _a.z * _b.y, _a.z * _b.x - _a.x * _b.z, _a.x * _b.y - _a.y * _b.x);
+}
+
+/*
+	Independent calls over arrays, then a dependent chain like building and applying a frame.
+*/
+static void Vec3Bench() {
+	const size_t count = 1 << 20;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> uniform(-1, 1);
+	std::vector<vec3<float>> a(count), b(count), out(count);
+	std::vector<float> d(count);
+	for (size_t i = 0; i < count; ++i) {
+		a[i] = vec3<float>(uniform(rng), uniform(rng), uniform(rng));
+		b[i] = vec3<float>(uniform(rng), uniform(rng), uniform(rng));
+	}
+	bool same = true;
+	for (size_t i = 0; i < count; ++i) same &= maths::Dot(a[i], b[i]) == ScalarDot(a[i], b[i]) && maths::Cross(a[i], b[i]) == ScalarCross(a[i], b[i]);
+
+	printf("\nvec3<float>, ns per call          scalar        SSE");
+	printf("\n  Dot %30.2f", Time(count, [&]() { for (size_t i = 0; i < count; ++i) d[i] = ScalarDot(a[i], b[i]); }));
+	printf(" %10.2f", Time(count, [&]() { for (size_t i = 0; i < count; ++i) d[i] = maths::Dot(a[i], b[i]); }));
+	printf("\n  Cross %28.2f", Time(count, [&]() { for (size_t i = 0; i < count; ++i) out[i] = ScalarCross(a[i], b[i]); }));
+	printf(" %10.2f", Time(count, [&]() { for (size_t i = 0; i < count; ++i) out[i] = maths::Cross(a[i], b[i]); }));
+	printf("\n  Dot + Cross chain %16.2f", Time(count, [&]() {
+		vec3<float> v(1, 2, 3);
+		float sum = 0;
+		for (size_t i = 0; i < count; ++i) {
+			sum += ScalarDot(v, a[i]);
+			v = ScalarCross(v, b[i]) * .5f + a[i];
+		}
+		sink = sum;
+	}));
+	printf(" %10.2f", Time(count, [&]() {
+		vec3<float> v(1, 2, 3);
+		float sum = 0;
+		for (size_t i = 0; i < count; ++i) {
+			sum += maths::Dot(v, a[i]);
+			v = maths::Cross(v, b[i]) * .5f + a[i];
+		}
+		sink = sum;
+	}));
+	printf("\n  SSE results %s scalar\n", same ? "match" : "DIFFER from");
+}
+
+int main() {
+	printf("\nDetected %s", ISAName(DetectISA()));
+	SpectrumBench<3>();
+	SpectrumBench<32>();
+	Vec3Bench();
+	const bool ok = ExpPassesNaN();
+	printf("\nExp NaN pass through: %s\n", ok ? "Passed." : "Failed.");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/*
+	Compares the texel layouts in TextureEncoding for packed RGBA8 levels: bytes allocated and
+	bilinear lookup time, for coherent (camera-like) and random lookups. Sizes include
+	non power of two and non square images, which layouts padded to a power of two square
+	pay for in memory.
+	Only needs the headers: g++ -O2 -std=c++17 -I../../src main.cpp
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <image/TextureEncoding.h>
+
+using namespace lambda;
+
+static float gammaToLinear[256];
+
+template<class Encoding>
+class PackedLevel {
+	public:
+		PackedLevel(const unsigned _w, const unsigned _h) : w(_w), h(_h), texels(Encoding::Size(_w, _h) * 4) {
+			for (unsigned y = 0; y < h; ++y) {
+				for (unsigned x = 0; x < w; ++x) {
+					uint8_t *t = &texels[Encoding::Index(w, h, x, y) * 4];
+					t[0] = x;
+					t[1] = y;
+					t[2] = x ^ y;
+					t[3] = 255;
+				}
+			}
+		}
+
+		inline size_t Bytes() const {
+			return texels.size();
+		}
+
+		/*
+			Clamped bilinear lookup, decoding like Texture::Unpack() does for RGBA8.
+		*/
+		inline float Bilinear(const float _u, const float _v) const {
+			const float fx = std::min((float)(w - 1), _u * w), fy = std::min((float)(h - 1), _v * h);
+			const unsigned x = fx, y = fy, x1 = std::min(x + 1, w - 1), y1 = std::min(y + 1, h - 1);
+			const float tx = fx - x, ty = fy - y;
+			float a[4], b[4], c[4], d[4];
+			Texel(x, y, a);
+			Texel(x1, y, b);
+			Texel(x, y1, c);
+			Texel(x1, y1, d);
+			float sum = 0;
+			for (unsigned i = 0; i < 4; ++i) sum += (a[i] * (1 - tx) + b[i] * tx) * (1 - ty) + (c[i] * (1 - tx) + d[i] * tx) * ty;
+			return sum;
+		}
+
+	private:
+		unsigned w, h;
+		std::vector<uint8_t> texels;
+
+		inline void Texel(const unsigned _x, const unsigned _y, float *_out) const {
+			const uint8_t *t = &texels[Encoding::Index(w, h, _x, _y) * 4];
+			_out[0] = gammaToLinear[t[0]];
+			_out[1] = gammaToLinear[t[1]];
+			_out[2] = gammaToLinear[t[2]];
+			_out[3] = t[3] * (1.f / 255);
+		}
+};
+
+/*
+	Best of five runs, in ns per lookup.
+*/
+template<class Encoding>
+static double Time(const PackedLevel<Encoding> &_level, const std::vector<float> &_uvs) {
+	volatile float sink = 0;
+	double best = 1e30;
+	for (unsigned run = 0; run < 5; ++run) {
+		const auto start = std::chrono::steady_clock::now();
+		float sum = 0;
+		for (size_t i = 0; i < _uvs.size(); i += 2) sum += _level.Bilinear(_uvs[i], _uvs[i + 1]);
+		sink = sink + sum;
+		const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		best = std::min(best, ns / (_uvs.size() / 2));
+	}
+	return best;
+}
+
+template<class Encoding>
+static void Run(const char *_name, const unsigned _w, const unsigned _h, const std::vector<float> &_coherent, const std::vector<float> &_random) {
+	const PackedLevel<Encoding> level(_w, _h);
+	const double ideal = (double)_w * _h * 4;
+	printf("\n%-9s %5ux%-5u %7.1f MB (%.2fx)  coherent %6.2f ns  random %6.2f ns",
+		_name, _w, _h, level.Bytes() / 1048576., level.Bytes() / ideal, Time(level, _coherent), Time(level, _random));
+}
+
+int main() {
+	for (unsigned i = 0; i < 256; ++i) gammaToLinear[i] = std::pow(i / 255.f, 2.2f);
+
+	//Rows of a slightly rotated grid stand in for camera rays, random lookups for incoherent bounces
+	std::vector<float> coherent, random;
+	const float angle = .3f;
+	for (unsigned j = 0; j < 1024; ++j) {
+		for (unsigned i = 0; i < 2048; ++i) {
+			const float x = i / 2048.f, y = j / 1024.f;
+			coherent.push_back(std::fmod(std::abs(x * std::cos(angle) - y * std::sin(angle)) * .9f, 1.f));
+			coherent.push_back(std::fmod(std::abs(x * std::sin(angle) + y * std::cos(angle)) * .9f, 1.f));
+		}
+	}
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> uniform(0, 1);
+	for (size_t i = 0; i < coherent.size(); ++i) random.push_back(uniform(rng));
+
+	const unsigned sizes[][2] = { { 1024, 1024 }, { 4096, 2048 }, { 4097, 4097 }, { 8192, 512 }, { 1000, 751 } };
+	for (const auto &size : sizes) {
+		Run<TextureEncoding::ScanlineRow>("scanline", size[0], size[1], coherent, random);
+		Run<TextureEncoding::Block<4>>("block4", size[0], size[1], coherent, random);
+		Run<TextureEncoding::Block<8>>("block8", size[0], size[1], coherent, random);
+		Run<TextureEncoding::Morton>("morton", size[0], size[1], coherent, random);
+		printf("\n");
+	}
+	return 0;
+}